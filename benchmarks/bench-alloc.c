@@ -0,0 +1,36 @@
+#include "bench.h"
+
+/* Direct libc calls, `rpmalloc.h` maps `malloc` and `free` to `rpmalloc`. */
+#undef malloc
+#undef free
+
+#define BENCH_CLEAR_EVERY 1024
+
+int main(int argc, char **argv) {
+    arena_t arena = arena_init(0);
+    unique_t *scope = unique_init_arena();
+    size_t count = 0;
+    bench_setup(argc, argv, "allocation, 64 bytes");
+
+    BENCH("baseline libc malloc/free") free(BENCH_KEEP(malloc(64)));
+    BENCH("baseline rp_malloc/rp_free") rp_free(BENCH_KEEP(rp_malloc(64)));
+    BENCH("arena_alloc, cleared every 1024") {
+        BENCH_KEEP(arena_alloc(arena, 64));
+        if (++count % BENCH_CLEAR_EVERY == 0)
+            arena_clear(arena);
+    }
+    BENCH("arena_bump, cleared every 1024") {
+        BENCH_KEEP(arena_bump(arena, 64));
+        if (++count % BENCH_CLEAR_EVERY == 0)
+            arena_clear(arena);
+    }
+    BENCH("malloc_by arena scope, cleared every 1024") {
+        BENCH_KEEP(malloc_by(scope, 64));
+        if (++count % BENCH_CLEAR_EVERY == 0)
+            arena_clear(scope->arena);
+    }
+
+    arena_free(arena);
+    raii_delete(scope);
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include "bench.h"
+
+static volatile int deferred = 0;
+static void bench_deferred(void *arg) {
+    deferred++;
+}
+
+static int guard_empty(void)
+guard {
+    deferred++;
+} unguarded(0);
+
+static int guard_defer(void)
+guard {
+    _defer(bench_deferred, NULL);
+} unguarded(0);
+
+static int guard_local_defer(void)
+guard_local {
+    _defer(bench_deferred, NULL);
+} unguarded(0);
+
+static int guard_malloc(void)
+guard {
+    BENCH_KEEP(_malloc(64));
+    BENCH_KEEP(_malloc(64));
+    BENCH_KEEP(_malloc(64));
+    BENCH_KEEP(_malloc(64));
+} unguarded(0);
+
+static int guard_arena_malloc(void)
+guard_arena {
+    BENCH_KEEP(_malloc(64));
+    BENCH_KEEP(_malloc(64));
+    BENCH_KEEP(_malloc(64));
+    BENCH_KEEP(_malloc(64));
+} unguarded(0);
+
+int main(int argc, char **argv) {
+    unique_t *scope = unique_init();
+    bench_setup(argc, argv, "defer/guard");
+
+    BENCH("raii_deferred + raii_deferred_free") {
+        raii_deferred(scope, bench_deferred, NULL);
+        raii_deferred_free(scope);
+    }
+    BENCH("raii_deferred x16 + raii_deferred_free") {
+        int j;
+        for (j = 0; j < 16; j++)
+            raii_deferred(scope, bench_deferred, NULL);
+        raii_deferred_free(scope);
+    }
+    BENCH("unique_init + raii_delete") raii_delete(unique_init());
+    BENCH("guard empty") guard_empty();
+    BENCH("guard + _defer") guard_defer();
+    BENCH("guard_local + _defer") guard_local_defer();
+    BENCH("guard + 4 x _malloc(64)") guard_malloc();
+    BENCH("guard_arena + 4 x _malloc(64)") guard_arena_malloc();
+
+    raii_delete(scope);
+    return deferred == 0;
+}
@@ -0,0 +1,63 @@
+#include "bench.h"
+#include <setjmp.h>
+
+EX_EXCEPTION(bench_error);
+
+static volatile int bench_depth_hit = 0;
+
+static void throw_at(int depth) {
+    if (depth < 0)
+        return;
+    else if (depth == 0)
+        throw(bench_error);
+
+    throw_at(depth - 1);
+    bench_depth_hit++;
+}
+
+static ex_result_t result_at(int depth) {
+    if (depth == 0)
+        ex_fail(bench_error, "bench");
+
+    try_result(result_at(depth - 1));
+    return ex_ok(NULL);
+}
+
+static jmp_buf bench_jmp;
+static void longjmp_at(int depth) {
+    if (depth < 0)
+        return;
+    else if (depth == 0)
+        longjmp(bench_jmp, 1);
+
+    longjmp_at(depth - 1);
+    bench_depth_hit++;
+}
+
+int main(int argc, char **argv) {
+    jmp_buf buf;
+    volatile int counter = 0;
+    bench_setup(argc, argv, "exceptions");
+
+    BENCH("baseline setjmp") if (setjmp(buf) == 0) counter++;
+#ifdef sigsetjmp
+    {
+        sigjmp_buf sbuf;
+        BENCH("baseline sigsetjmp(buf, 1)") if (sigsetjmp(sbuf, 1) == 0) counter++;
+    }
+#endif
+    BENCH("ex_try entry/exit") ex_try { counter++; } ex_end_try;
+    BENCH("ex_try_fast entry/exit") ex_try_fast { counter++; } ex_end_try;
+    BENCH("ex_try_signal entry/exit") ex_try_signal { counter++; } ex_end_try;
+
+    BENCH("baseline setjmp/longjmp depth 1") if (setjmp(bench_jmp) == 0) longjmp_at(1);
+    BENCH("baseline setjmp/longjmp depth 32") if (setjmp(bench_jmp) == 0) longjmp_at(32);
+    BENCH("throw/catch depth 1") ex_try { throw_at(1); } ex_catch(bench_error) { counter++; } ex_end_try;
+    BENCH("throw/catch depth 8") ex_try { throw_at(8); } ex_catch(bench_error) { counter++; } ex_end_try;
+    BENCH("throw/catch depth 32") ex_try { throw_at(32); } ex_catch(bench_error) { counter++; } ex_end_try;
+    BENCH("throw/catch_any depth 8") ex_try_fast { throw_at(8); } ex_catch_any { counter++; } ex_end_try;
+    BENCH("ex_result propagate depth 8") if (!ex_is_ok(result_at(8))) counter++;
+    BENCH("ex_result propagate depth 32") if (!ex_is_ok(result_at(32))) counter++;
+
+    return counter == 0;
+}
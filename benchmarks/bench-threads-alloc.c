@@ -0,0 +1,351 @@
+#include "bench.h"
+#if defined(__linux__)
+#   include <unistd.h>
+#endif
+
+/* Direct libc calls, `rpmalloc.h` maps `malloc` and `free` to `rpmalloc`. */
+#undef malloc
+#undef free
+
+/* Blocks allocated, then all released, per round of burst pattern. */
+#define BENCH_BURST 1024
+/* Blocks kept alive, replaced at random, by long-lived pattern. */
+#define BENCH_LIVE 4096
+/* Per `thread` ring of producer/consumer pairs, power of two. */
+#define BENCH_RING 1024
+/* Every n-th operation timed, for latency percentiles. */
+#define BENCH_SAMPLE_EVERY 16
+#define BENCH_SAMPLES 65536
+#define BENCH_THREADS_MAX 64
+/* Allocations per `thread` for backends that never release, keeping memory bounded. */
+#define BENCH_UNFREED 8192
+
+/* Allocator under test, `release` is `NULL` for those only freeing all at once by `reset`. */
+typedef struct {
+    const char *name;
+    void *(*create)(void);
+    void *(*alloc)(void *ctx, size_t size);
+    void (*release)(void *ctx, void *ptr);
+    void (*reset)(void *ctx);
+    void (*destroy)(void *ctx);
+} bench_backend_t;
+
+typedef struct bench_worker_s bench_worker_t;
+struct bench_worker_s {
+    const bench_backend_t *backend;
+    int pattern;
+    int id;
+    size_t ops;
+    size_t samples;
+    size_t rss;
+    unsigned int seed;
+    double latency[BENCH_SAMPLES / BENCH_THREADS_MAX];
+    /* producer side of pair, consumer reads it */
+    void *volatile ring[BENCH_RING];
+    volatile size_t head;
+    volatile size_t tail;
+    bench_worker_t *peer;
+};
+
+enum {
+    BENCH_BURST_FREE,
+    BENCH_LONG_LIVED,
+    BENCH_PRODUCER_CONSUMER
+};
+
+static const char *bench_patterns[] = {"burst free", "long-lived mixed", "producer/consumer"};
+
+static void *libc_create(void) {
+    return NULL;
+}
+
+static void *libc_alloc(void *ctx, size_t size) {
+    return malloc(size);
+}
+
+static void libc_release(void *ctx, void *ptr) {
+    free(ptr);
+}
+
+static void *rp_alloc(void *ctx, size_t size) {
+    return rp_malloc(size);
+}
+
+static void rp_release(void *ctx, void *ptr) {
+    rp_free(ptr);
+}
+
+static void *arena_create(void) {
+    return arena_init(0);
+}
+
+static void *arena_allocate(void *ctx, size_t size) {
+    return arena_alloc((arena_t)ctx, (long)size);
+}
+
+static void arena_clear_ctx(void *ctx) {
+    arena_clear((arena_t)ctx);
+}
+
+static void arena_destroy(void *ctx) {
+    arena_free((arena_t)ctx);
+}
+
+static void *scope_create(void) {
+    return unique_init_arena();
+}
+
+static void *scope_alloc(void *ctx, size_t size) {
+    return malloc_by((memory_t *)ctx, size);
+}
+
+static void scope_reset(void *ctx) {
+    arena_clear((arena_t)((memory_t *)ctx)->arena);
+}
+
+static void scope_destroy(void *ctx) {
+    raii_delete((memory_t *)ctx);
+}
+
+static void *thrd_alloc_by(void *ctx, size_t size) {
+    return thrd_alloc(size);
+}
+
+static const bench_backend_t bench_backends[] = {
+    {"libc malloc", libc_create, libc_alloc, libc_release, NULL, NULL},
+    {"rpmalloc", libc_create, rp_alloc, rp_release, NULL, NULL},
+    {"arena_alloc", arena_create, arena_allocate, NULL, arena_clear_ctx, arena_destroy},
+    {"malloc_by arena scope", scope_create, scope_alloc, NULL, scope_reset, scope_destroy},
+#ifndef RAII_NO_EMULATED
+    /* shared sharded arenas, released at exit only */
+    {"thrd_alloc", libc_create, thrd_alloc_by, NULL, NULL, NULL},
+#endif
+};
+
+static int bench_threads = 4;
+
+static unsigned int bench_rand(unsigned int *seed) {
+    *seed = *seed * 1103515245u + 12345u;
+    return *seed >> 8;
+}
+
+/* Mostly small, some medium, few large, as a typical service mix. */
+static size_t bench_size(unsigned int *seed) {
+    unsigned int pick = bench_rand(seed);
+    if (pick % 100 < 80)
+        return 16 + pick % 241;
+    else if (pick % 100 < 98)
+        return 256 + pick % 3841;
+
+    return 4096 + pick % 61441;
+}
+
+static size_t bench_rss(void) {
+#if defined(__linux__)
+    long pages = 0, resident = 0;
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (is_empty(statm))
+        return 0;
+
+    if (fscanf(statm, "%ld %ld", &pages, &resident) != 2)
+        resident = 0;
+
+    fclose(statm);
+    return (size_t)resident * (size_t)sysconf(_SC_PAGESIZE);
+#else
+    return 0;
+#endif
+}
+
+static RAII_INLINE void *bench_timed(bench_worker_t *worker, void *ctx, size_t size) {
+    double start;
+    void *ptr;
+    if (worker->ops++ % BENCH_SAMPLE_EVERY != 0
+        || worker->samples == BENCH_SAMPLES / BENCH_THREADS_MAX)
+        return worker->backend->alloc(ctx, size);
+
+    start = bench_now();
+    ptr = worker->backend->alloc(ctx, size);
+    worker->latency[worker->samples++] = bench_now() - start;
+    return ptr;
+}
+
+static void bench_burst(bench_worker_t *worker, void *ctx, size_t rounds) {
+    void *blocks[BENCH_BURST];
+    size_t round, i;
+
+    for (round = 0; round < rounds; round++) {
+        for (i = 0; i < BENCH_BURST; i++)
+            blocks[i] = BENCH_KEEP(bench_timed(worker, ctx, bench_size(&worker->seed)));
+
+        if (worker->backend->release) {
+            for (i = 0; i < BENCH_BURST; i++)
+                worker->backend->release(ctx, blocks[i]);
+        } else if (worker->backend->reset) {
+            worker->backend->reset(ctx);
+        }
+    }
+}
+
+static void bench_long_lived(bench_worker_t *worker, void *ctx, size_t count) {
+    void **live = calloc(BENCH_LIVE, sizeof(void *));
+    size_t i, slot;
+
+    for (i = 0; i < count; i++) {
+        slot = bench_rand(&worker->seed) % BENCH_LIVE;
+        if (worker->backend->release && !is_empty(live[slot]))
+            worker->backend->release(ctx, live[slot]);
+
+        live[slot] = bench_timed(worker, ctx, bench_size(&worker->seed));
+        /* bulk only backends, whole generation replaced at once */
+        if (!worker->backend->release && worker->backend->reset && (i + 1) % (BENCH_LIVE * 4) == 0) {
+            worker->backend->reset(ctx);
+            memset(live, 0, BENCH_LIVE * sizeof(void *));
+        }
+    }
+
+    worker->rss = bench_rss();
+    if (worker->backend->release) {
+        for (slot = 0; slot < BENCH_LIVE; slot++) {
+            if (!is_empty(live[slot]))
+                worker->backend->release(ctx, live[slot]);
+        }
+    }
+
+    free(live);
+}
+
+static void bench_produce(bench_worker_t *worker, void *ctx, size_t count) {
+    size_t i, head;
+    for (i = 0; i < count; i++) {
+        head = atomic_size_load_relaxed(&worker->head);
+        while (head - atomic_size_load(&worker->tail) == BENCH_RING)
+            thrd_yield();
+
+        worker->ring[head % BENCH_RING] = bench_timed(worker, ctx, bench_size(&worker->seed));
+        atomic_size_store(&worker->head, head + 1);
+    }
+}
+
+/* Frees what it's peer produced, so every block is released by another `thread`. */
+static void bench_consume(bench_worker_t *worker, void *ctx, size_t count) {
+    bench_worker_t *producer = worker->peer;
+    size_t i, tail;
+    for (i = 0; i < count; i++) {
+        tail = atomic_size_load_relaxed(&producer->tail);
+        while (atomic_size_load(&producer->head) == tail)
+            thrd_yield();
+
+        worker->backend->release(ctx, producer->ring[tail % BENCH_RING]);
+        atomic_size_store(&producer->tail, tail + 1);
+    }
+}
+
+static int bench_worker(void *arg) {
+    bench_worker_t *worker = (bench_worker_t *)arg;
+    void *ctx = worker->backend->create();
+    size_t count = worker->backend->release || worker->backend->reset
+        ? bench_iterations : MIN(bench_iterations, BENCH_UNFREED);
+
+    switch (worker->pattern) {
+        case BENCH_BURST_FREE:
+            bench_burst(worker, ctx, MAX(count / BENCH_BURST, 1));
+            worker->rss = bench_rss();
+            break;
+        case BENCH_LONG_LIVED:
+            bench_long_lived(worker, ctx, count);
+            break;
+        case BENCH_PRODUCER_CONSUMER:
+            if (worker->id % 2 == 0)
+                bench_produce(worker, ctx, bench_iterations);
+            else
+                bench_consume(worker, ctx, bench_iterations);
+
+            worker->rss = bench_rss();
+            break;
+    }
+
+    if (worker->backend->destroy)
+        worker->backend->destroy(ctx);
+
+    return 0;
+}
+
+static int bench_compare(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void bench_run(const bench_backend_t *backend, int pattern) {
+    bench_worker_t *workers = calloc(bench_threads, sizeof(bench_worker_t));
+    thrd_t threads[BENCH_THREADS_MAX];
+    double *latency = calloc(BENCH_SAMPLES, sizeof(double));
+    double start, elapsed;
+    size_t samples = 0, ops = 0, rss = 0, before = bench_rss(), i;
+    int t;
+
+    for (t = 0; t < bench_threads; t++) {
+        workers[t].backend = backend;
+        workers[t].pattern = pattern;
+        workers[t].id = t;
+        workers[t].seed = 0x9e3779b9u * (unsigned int)(t + 1);
+        workers[t].peer = &workers[t & ~1];
+    }
+
+    start = bench_now();
+    for (t = 0; t < bench_threads; t++)
+        thrd_create(&threads[t], bench_worker, &workers[t]);
+
+    for (t = 0; t < bench_threads; t++)
+        thrd_join(threads[t], NULL);
+
+    elapsed = bench_now() - start;
+    for (t = 0; t < bench_threads; t++) {
+        for (i = 0; i < workers[t].samples; i++)
+            latency[samples++] = workers[t].latency[i];
+
+        ops += workers[t].ops;
+        rss = MAX(rss, workers[t].rss);
+    }
+
+    qsort(latency, samples, sizeof(double), bench_compare);
+    printf("%-20s %-22s %12.2f %12.0f %12.0f %12.2f\n", bench_patterns[pattern], backend->name,
+           ops / (elapsed / 1e3), samples ? latency[samples / 2] : 0.0,
+           samples ? latency[samples * 99 / 100] : 0.0,
+           rss > before ? (double)(rss - before) / (1024.0 * 1024.0) : 0.0);
+    fflush(stdout);
+    free(latency);
+    free(workers);
+}
+
+int main(int argc, char **argv) {
+    size_t b;
+    int pattern;
+
+    if (argc > 2 && atoi(argv[2]) > 0)
+        bench_threads = MIN(atoi(argv[2]), BENCH_THREADS_MAX) & ~1;
+
+    if (bench_threads < 2)
+        bench_threads = 2;
+
+#ifndef RAII_NO_EMULATED
+    thrd_init();
+#endif
+    if (argc > 1 && atol(argv[1]) > 0)
+        bench_iterations = (size_t)atol(argv[1]);
+
+    printf("\nallocators under %d threads, %zu allocations per thread, sizes 16 bytes to 64 KiB\n",
+           bench_threads, bench_iterations);
+    printf("%-20s %-22s %12s %12s %12s %12s\n", "pattern", "backend", "Mops/s", "p50 ns", "p99 ns", "RSS MiB");
+    for (pattern = BENCH_BURST_FREE; pattern <= BENCH_PRODUCER_CONSUMER; pattern++) {
+        for (b = 0; b < sizeof(bench_backends) / sizeof(bench_backends[0]); b++) {
+            /* blocks must be freed one by one, on another `thread` */
+            if (pattern == BENCH_PRODUCER_CONSUMER && !bench_backends[b].release)
+                continue;
+
+            bench_run(&bench_backends[b], pattern);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,97 @@
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include "raii.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(_WIN32) || defined(_WIN64)
+#   include <windows.h>
+#else
+#   include <time.h>
+#endif
+
+/* Default iterations per benchmark, override with first program argument. */
+#ifndef BENCH_ITERATIONS
+#   define BENCH_ITERATIONS 1000000
+#endif
+
+static size_t bench_iterations = BENCH_ITERATIONS;
+
+/* Allocations counter, only counts when linked with `--wrap=rp_malloc,--wrap=rp_calloc`. */
+static volatile size_t bench_allocs = 0;
+
+#ifdef BENCH_WRAP_MALLOC
+void *__real_rp_malloc(size_t size);
+void *__real_rp_calloc(size_t count, size_t size);
+
+void *__wrap_rp_malloc(size_t size) {
+    bench_allocs++;
+    return __real_rp_malloc(size);
+}
+
+void *__wrap_rp_calloc(size_t count, size_t size) {
+    bench_allocs++;
+    return __real_rp_calloc(count, size);
+}
+#endif
+
+static double bench_now(void) {
+#if defined(_WIN32) || defined(_WIN64)
+    LARGE_INTEGER count, frequency;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&count);
+    return (double)count.QuadPart * 1e9 / (double)frequency.QuadPart;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec * 1e9 + (double)now.tv_nsec;
+#endif
+}
+
+static void bench_setup(int argc, char **argv, const char *title) {
+    if (argc > 1 && atol(argv[1]) > 0)
+        bench_iterations = (size_t)atol(argv[1]);
+
+    printf("\n%s, %zu iterations\n", title, bench_iterations);
+    printf("%-40s %12s %12s\n", "benchmark", "ns/op", "allocs/op");
+}
+
+static const char *bench_name;
+static size_t bench_i, bench_start_allocs;
+static double bench_start_time;
+
+static void bench_report(void) {
+    double elapsed = bench_now() - bench_start_time;
+#ifdef BENCH_WRAP_MALLOC
+    printf("%-40s %12.2f %12.2f\n", bench_name, elapsed / bench_iterations,
+           (double)(bench_allocs - bench_start_allocs) / bench_iterations);
+#else
+    printf("%-40s %12.2f %12s\n", bench_name, elapsed / bench_iterations, "n/a");
+#endif
+    fflush(stdout);
+}
+
+static void bench_start(const char *name) {
+    bench_name = name;
+    bench_i = 0;
+    bench_start_allocs = bench_allocs;
+    bench_start_time = bench_now();
+}
+
+static int bench_next(void) {
+    if (bench_i++ < bench_iterations)
+        return 1;
+
+    bench_report();
+    return 0;
+}
+
+/* Runs following statement `bench_iterations` times, reports time and allocations per iteration. */
+#define BENCH(name) for (bench_start(name); bench_next();)
+
+/* Keeps compiler from optimizing away `value`. */
+static volatile void *bench_sink;
+#define BENCH_KEEP(value)   (void *)(bench_sink = (volatile void *)(value))
+
+#endif /* BENCH_H_ */
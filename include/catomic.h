@@ -0,0 +1,208 @@
+#ifndef RAII_ATOMIC_H
+#define RAII_ATOMIC_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#if defined(_WIN32) || defined(_WIN64)
+    #include <windows.h>
+    #include <intrin.h>
+#endif
+
+#ifndef FORCEINLINE
+  #if defined(_MSC_VER) && !defined(__clang__)
+    #define FORCEINLINE __forceinline
+  #elif defined(__GNUC__)
+    #define FORCEINLINE __inline__
+  #else
+    #define FORCEINLINE
+  #endif
+#endif
+
+/* Minimal portable atomic operations, all `sequentially consistent`, except `_relaxed`
+ones, only the types this library needs: `void *`, `size_t` and `int`. */
+#if defined(__GNUC__) || defined(__clang__) || defined(__TINYC__)
+#   define ATOMIC_SEQ __ATOMIC_SEQ_CST
+static FORCEINLINE void *atomic_ptr_load(void *volatile *ptr) {
+    return __atomic_load_n(ptr, ATOMIC_SEQ);
+}
+
+static FORCEINLINE void atomic_ptr_store(void *volatile *ptr, void *value) {
+    __atomic_store_n(ptr, value, ATOMIC_SEQ);
+}
+
+static FORCEINLINE void *atomic_ptr_swap(void *volatile *ptr, void *value) {
+    return __atomic_exchange_n(ptr, value, ATOMIC_SEQ);
+}
+
+/* Store `desired` if `*ptr == *expected`, otherwise `*expected` receives current value. */
+static FORCEINLINE bool atomic_ptr_cas(void *volatile *ptr, void **expected, void *desired) {
+    return __atomic_compare_exchange_n(ptr, expected, desired, false, ATOMIC_SEQ, ATOMIC_SEQ);
+}
+
+static FORCEINLINE size_t atomic_size_load(volatile size_t *ptr) {
+    return __atomic_load_n(ptr, ATOMIC_SEQ);
+}
+
+static FORCEINLINE void atomic_size_store(volatile size_t *ptr, size_t value) {
+    __atomic_store_n(ptr, value, ATOMIC_SEQ);
+}
+
+/* No ordering, no torn values, for counters with a single writer. */
+static FORCEINLINE size_t atomic_size_load_relaxed(volatile size_t *ptr) {
+    return __atomic_load_n(ptr, __ATOMIC_RELAXED);
+}
+
+static FORCEINLINE void atomic_size_store_relaxed(volatile size_t *ptr, size_t value) {
+    __atomic_store_n(ptr, value, __ATOMIC_RELAXED);
+}
+
+/* Returns the value `before` addition. */
+static FORCEINLINE size_t atomic_size_add(volatile size_t *ptr, size_t value) {
+    return __atomic_fetch_add(ptr, value, ATOMIC_SEQ);
+}
+
+/* Returns the value `before` subtraction. */
+static FORCEINLINE size_t atomic_size_sub(volatile size_t *ptr, size_t value) {
+    return __atomic_fetch_sub(ptr, value, ATOMIC_SEQ);
+}
+
+static FORCEINLINE bool atomic_size_cas(volatile size_t *ptr, size_t *expected, size_t desired) {
+    return __atomic_compare_exchange_n(ptr, expected, desired, false, ATOMIC_SEQ, ATOMIC_SEQ);
+}
+
+static FORCEINLINE int atomic_int_load(volatile int *ptr) {
+    return __atomic_load_n(ptr, ATOMIC_SEQ);
+}
+
+static FORCEINLINE void atomic_int_store(volatile int *ptr, int value) {
+    __atomic_store_n(ptr, value, ATOMIC_SEQ);
+}
+
+static FORCEINLINE int atomic_int_add(volatile int *ptr, int value) {
+    return __atomic_fetch_add(ptr, value, ATOMIC_SEQ);
+}
+
+static FORCEINLINE int atomic_int_swap(volatile int *ptr, int value) {
+    return __atomic_exchange_n(ptr, value, ATOMIC_SEQ);
+}
+
+static FORCEINLINE bool atomic_int_cas(volatile int *ptr, int *expected, int desired) {
+    return __atomic_compare_exchange_n(ptr, expected, desired, false, ATOMIC_SEQ, ATOMIC_SEQ);
+}
+
+static FORCEINLINE void atomic_fence(void) {
+    __atomic_thread_fence(ATOMIC_SEQ);
+}
+
+/* Cpu hint for `spin-wait` loops. */
+static FORCEINLINE void atomic_pause(void) {
+#   if defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#   elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield");
+#   else
+    __atomic_signal_fence(ATOMIC_SEQ);
+#   endif
+}
+#elif defined(_MSC_VER)
+static FORCEINLINE void *atomic_ptr_load(void *volatile *ptr) {
+    return InterlockedCompareExchangePointer(ptr, NULL, NULL);
+}
+
+static FORCEINLINE void atomic_ptr_store(void *volatile *ptr, void *value) {
+    InterlockedExchangePointer(ptr, value);
+}
+
+static FORCEINLINE void *atomic_ptr_swap(void *volatile *ptr, void *value) {
+    return InterlockedExchangePointer(ptr, value);
+}
+
+static FORCEINLINE bool atomic_ptr_cas(void *volatile *ptr, void **expected, void *desired) {
+    void *prev = InterlockedCompareExchangePointer(ptr, desired, *expected);
+    if (prev == *expected)
+        return true;
+
+    *expected = prev;
+    return false;
+}
+
+#   if defined(_WIN64)
+#       define atomic_size_x(name) name##64
+#       define atomic_size_v __int64
+#   else
+#       define atomic_size_x(name) name
+#       define atomic_size_v long
+#   endif
+static FORCEINLINE size_t atomic_size_load(volatile size_t *ptr) {
+    return (size_t)atomic_size_x(InterlockedCompareExchange)((volatile atomic_size_v *)ptr, 0, 0);
+}
+
+static FORCEINLINE void atomic_size_store(volatile size_t *ptr, size_t value) {
+    atomic_size_x(InterlockedExchange)((volatile atomic_size_v *)ptr, (atomic_size_v)value);
+}
+
+/* Aligned `volatile` word access is never torn, nor reordered by MSVC. */
+static FORCEINLINE size_t atomic_size_load_relaxed(volatile size_t *ptr) {
+    return *ptr;
+}
+
+static FORCEINLINE void atomic_size_store_relaxed(volatile size_t *ptr, size_t value) {
+    *ptr = value;
+}
+
+static FORCEINLINE size_t atomic_size_add(volatile size_t *ptr, size_t value) {
+    return (size_t)atomic_size_x(InterlockedExchangeAdd)((volatile atomic_size_v *)ptr, (atomic_size_v)value);
+}
+
+static FORCEINLINE size_t atomic_size_sub(volatile size_t *ptr, size_t value) {
+    return (size_t)atomic_size_x(InterlockedExchangeAdd)((volatile atomic_size_v *)ptr, -(atomic_size_v)value);
+}
+
+static FORCEINLINE bool atomic_size_cas(volatile size_t *ptr, size_t *expected, size_t desired) {
+    size_t prev = (size_t)atomic_size_x(InterlockedCompareExchange)((volatile atomic_size_v *)ptr,
+                                                                    (atomic_size_v)desired, (atomic_size_v)*expected);
+    if (prev == *expected)
+        return true;
+
+    *expected = prev;
+    return false;
+}
+
+static FORCEINLINE int atomic_int_load(volatile int *ptr) {
+    return (int)InterlockedCompareExchange((volatile long *)ptr, 0, 0);
+}
+
+static FORCEINLINE void atomic_int_store(volatile int *ptr, int value) {
+    InterlockedExchange((volatile long *)ptr, (long)value);
+}
+
+static FORCEINLINE int atomic_int_add(volatile int *ptr, int value) {
+    return (int)InterlockedExchangeAdd((volatile long *)ptr, (long)value);
+}
+
+static FORCEINLINE int atomic_int_swap(volatile int *ptr, int value) {
+    return (int)InterlockedExchange((volatile long *)ptr, (long)value);
+}
+
+static FORCEINLINE bool atomic_int_cas(volatile int *ptr, int *expected, int desired) {
+    int prev = (int)InterlockedCompareExchange((volatile long *)ptr, (long)desired, (long)*expected);
+    if (prev == *expected)
+        return true;
+
+    *expected = prev;
+    return false;
+}
+
+static FORCEINLINE void atomic_fence(void) {
+    MemoryBarrier();
+}
+
+static FORCEINLINE void atomic_pause(void) {
+    YieldProcessor();
+}
+#else
+#   error "Unsupported compiler, no atomic operations available!"
+#endif
+
+#endif /* RAII_ATOMIC_H */
@@ -27,7 +27,7 @@
 #ifndef	_SYS_TREE_H_
 #define	_SYS_TREE_H_
 
-#include <sys/_null.h>
+#include "_null.h"
 
 /*
  * This file defines data structures for different types of trees:
@@ -29,6 +29,8 @@
 #endif
 
 #include "rpmalloc.h"
+#include "cthread.h"
+#include "raii_config.h"
 #if !defined(RAII_MALLOC) || !defined(RAII_FREE) || !defined(RAII_REALLOC)|| !defined(RAII_CALLOC)
   #define RAII_MALLOC malloc
   #define RAII_FREE free
@@ -67,15 +69,21 @@
 #endif
 
 #ifdef USE_DEBUG
-    #define RAII_LOG(s) puts(s)
-    #define RAII_INFO(s, ...) printf(s, __VA_ARGS__ )
-    #define RAII_HERE() fprintf(stderr, "Here %s:%d\n", __FILE__, __LINE__)
+    #define RAII_LOG(s) ex_log(EX_LOG_OUT, "%s\n", s)
+    #define RAII_INFO(s, ...) ex_log(EX_LOG_OUT, s, __VA_ARGS__ )
+    #define RAII_HERE() ex_log(EX_LOG_ERR, "Here %s:%d\n", __FILE__, __LINE__)
 #else
     #define RAII_LOG(s) (void)s
     #define RAII_INFO(s, ...)  (void)s
     #define RAII_HERE()  (void)0
 #endif
 
+/* Enables allocation/defer/exception statistics counting, on by default in `USE_DEBUG` builds,
+when not defined all counting compiles out, stats functions return zeros. */
+#if defined(USE_DEBUG) && !defined(RAII_STATS) && !defined(RAII_NO_STATS)
+    #define RAII_STATS 1
+#endif
+
  /* Public API qualifier. */
 #ifndef C_API
     #define C_API extern
@@ -91,6 +99,16 @@ typedef void (*ex_setup_func)(ex_context_t *, const char *, const char *);
 typedef void (*ex_terminate_func)(void);
 typedef void (*ex_unwind_func)(void *);
 
+/* Per `thread` throw site counters, see `ex_stats`. */
+typedef struct {
+    const char *ex;
+    const char *file;
+    const char *function;
+    int line;
+    size_t thrown;
+    size_t caught;
+} ex_stats_t;
+
 /* low-level api
  */
 C_API void ex_throw(const char *ex, const char *file, int, const char *line, const char *message);
@@ -111,12 +129,113 @@ C_API void ex_signal(int sig, const char *ex);
 /* Convert signals into exceptions */
 C_API void ex_signal_setup(void);
 
+/* Log destinations, `EX_LOG_FATAL` is `stderr` text written just before terminating. */
+enum {
+    EX_LOG_OUT = 1,
+    EX_LOG_ERR = 2,
+    EX_LOG_FATAL = 3
+};
+
+/* Longest text `ex_log` formats, longer is truncated, uncaught exception reports included. */
+#ifndef EX_LOG_LINE
+    #define EX_LOG_LINE 1024
+#endif
+
+/* Log sink, receives each whole formatted message, `NULL` writes `stdout`/`stderr`
+directly, an single `fwrite` each. Fatal messages must be written before returning. */
+typedef void (*ex_log_func)(int level, const char *text, size_t length);
+
+/* Format and hand message to current sink, `ex_print` and debug `RAII_LOG` go through it. */
+C_API void ex_log(int level, const char *fmt, ...);
+C_API void ex_log_write(int level, const char *text, size_t length);
+
 /* Reset signal handler to default */
 C_API void ex_signal_default(void);
 
+/* Alternate signal stack size, `ex_signal_thread` default. */
+#ifndef EX_ALTSTACK_SIZE
+    #define EX_ALTSTACK_SIZE (64 * 1024)
+#endif
+
+/* Register current `thread` for short path signal dispatch, on an alternate stack of
+`size` bytes, `0` for `EX_ALTSTACK_SIZE`: handler only records exception into preallocated
+state, then `siglongjmp`, unwinding happens where `try` lands. A `SIGSEGV` from
+overflowing `thread` stack is then recoverable, as `stack_overflow` subclass of `sig_segv`.
+Returns `0`, or `-1`. POSIX only, a no-op on Windows, there `stack_overflow` arrives by SEH,
+is not an `sig_segv`, and guard page is not restored for another overflow. */
+C_API int ex_signal_thread(size_t size);
+
+/* Finish, outside signal context, an exception `ex_signal_thread` handler recorded,
+`try` calls this on landing. */
+C_API void ex_signal_landed(ex_context_t *ctx);
+
+/* Remove current `thread` alternate signal stack, before `thread` exits. */
+C_API void ex_signal_thread_free(void);
+
+/* Make `ex` an subclass of `parent`, both exception names as created by `EX_EXCEPTION`,
+a `catch` of `parent` will also catch `ex`, register before any threads started. */
+C_API void ex_class_set(const char *ex, const char *parent);
+
+/* Returns `parent` of exception `ex`, or `NULL` if none registered. */
+C_API const char *ex_class_parent(const char *ex);
+
+/* Check if exception `ex` is `base`, or one of it's subclasses, by pointer identity. */
+C_API bool ex_is_a(const char *ex, const char *base);
+
+/* With `EX_BACKTRACE` defined, every throw records raw return addresses,
+into an per `thread` ring of last `EX_BACKTRACE_RING` throws, symbols resolved only on print. */
+#ifndef EX_BACKTRACE_DEPTH
+    #define EX_BACKTRACE_DEPTH 32
+#endif
+
+#ifndef EX_BACKTRACE_RING
+    #define EX_BACKTRACE_RING 4
+#endif
+
+/* Copy up to `max` return addresses of current `thread` last throw into `frames`,
+returns number copied, `0` if none or backtraces not enabled/supported. */
+C_API int ex_backtrace(void **frames, int max);
+
+/* Print symbolized backtrace of current `thread` last throw to `stderr`. */
+C_API void ex_backtrace_print(void);
+
+/* Maximum distinct throw sites counted per `thread`, later sites are not recorded. */
+#ifndef EX_STATS_SITES
+    #define EX_STATS_SITES 64
+#endif
+
+/* Copy up to `max` throw site counters of current `thread` into `sites`,
+returns number copied, `0` if none or `RAII_STATS` not enabled. */
+C_API int ex_stats(ex_stats_t *sites, int max);
+
+/* Print current `thread` throw site counters to `stderr`, most thrown first. */
+C_API void ex_stats_dump(void);
+
+/* Clear current `thread` throw site counters. */
+C_API void ex_stats_reset(void);
+
+/* Count exception of `ctx` as caught, used by `catch` blocks. */
+C_API void ex_stats_caught(ex_context_t *ctx);
+
+#ifdef RAII_STATS
+#   define EX_STAT_CAUGHT() ex_stats_caught(&ex_err)
+#else
+#   define EX_STAT_CAUGHT()
+#endif
+
+/* Record catch of `ctx` exception at `file:line`, used by `catch` blocks. */
+C_API void ex_record_caught(ex_context_t *ctx, const char *file, int line);
+
+#ifdef RAII_RECORD
+#   define EX_RECORD_CAUGHT() ex_record_caught(&ex_err, __FILE__, __LINE__)
+#else
+#   define EX_RECORD_CAUGHT()
+#endif
+
 #ifdef _WIN32
 #define EXCEPTION_PANIC 0xE0000001
 C_API void ex_signal_seh(DWORD sig, const char *ex);
+C_API void ex_signal_defer(bool block);
 C_API int catch_seh(const char *exception, DWORD code, struct _EXCEPTION_POINTERS *ep);
 C_API int catch_filter_seh(DWORD code, struct _EXCEPTION_POINTERS *ep);
 #endif
@@ -160,18 +279,50 @@ enum {
 #define EX_EXCEPTION(E) \
         const char EX_NAME(E)[] = EX_STR(E)
 
+/* Register exception `E` as subclass of `P`, see `ex_class_set`. */
+#define ex_extends(E, P)                \
+    do {                                \
+        C_API const char EX_NAME(E)[];  \
+        C_API const char EX_NAME(P)[];  \
+        ex_class_set(EX_NAME(E), EX_NAME(P));   \
+    } while (0)
+
  /* context savings
 */
 #ifdef sigsetjmp
     #define ex_jmp_buf  sigjmp_buf
-    #define ex_setjmp(buf)  sigsetjmp(buf,1)
+    #define ex_setjmp_signal(buf)  sigsetjmp(buf,1)
+    #define ex_setjmp_fast(buf)  sigsetjmp(buf,0)
     #define ex_longjmp(buf,st)  siglongjmp(buf,st)
 #else
     #define ex_jmp_buf  jmp_buf
-    #define ex_setjmp(buf)  setjmp(buf)
+    #define ex_setjmp_signal(buf)  setjmp(buf)
+    #define ex_setjmp_fast(buf)  setjmp(buf)
     #define ex_longjmp(buf,st)  longjmp(buf,st)
 #endif
 
+/* With `EX_TRY_FAST` defined, `ex_try` does not save/restore the signal mask,
+no `sigprocmask` syscall per `try`, use `ex_try_signal` for blocks that need it. */
+#ifdef EX_TRY_FAST
+    #define ex_setjmp(buf)  ex_setjmp_fast(buf)
+#else
+    #define ex_setjmp(buf)  ex_setjmp_signal(buf)
+#endif
+
+/* Signal handler install on first `try`/`guard`, and finish of an exception
+recorded by handler once `try` lands, both gone with `EX_NO_SIGNALS`. */
+#ifdef EX_NO_SIGNALS
+    #define EX_SIGNAL_SETUP()
+    #define EX_SIGNAL_LANDED(ctx)
+#else
+    #define EX_SIGNAL_SETUP()       \
+        if (!exception_signal_set)  \
+            ex_signal_setup()
+    #define EX_SIGNAL_LANDED(ctx)               \
+        if ((ctx)->state != ex_try_st)          \
+            ex_signal_landed(ctx)
+#endif
+
 #define ex_throw_loc(E, F, L, C)        \
     do {                                \
         C_API const char EX_NAME(E)[];  \
@@ -196,37 +347,40 @@ throws an exception of given message. */
             ex_throw(ex_err.ex, ex_err.file, ex_err.line, ex_err.function, ex_err.panic); \
         }
 
-#define ex_signal_block(ctrl)               \
-    CRITICAL_SECTION ctrl##__FUNCTION__;    \
-    InitializeCriticalSection(&ctrl##__FUNCTION__); \
-    EnterCriticalSection(&ctrl##__FUNCTION__);
-
-#define ex_signal_unblock(ctrl)                 \
-    LeaveCriticalSection(&ctrl##__FUNCTION__);  \
-    DeleteCriticalSection(&ctrl##__FUNCTION__);
+/* Defers asynchronous signals until `ex_signal_unblock`, process wide, as console
+`CTRL_C` handlers run on a `thread` of their own, faults are never deferred. */
+#define ex_signal_block(ctrl)   ex_signal_defer(true)
+#define ex_signal_unblock(ctrl) ex_signal_defer(false)
 
-#define ex_try                              \
+#define ex_try_by(setjmp_func)              \
 {                                           \
-    if (!exception_signal_set)              \
-        ex_signal_setup();                  \
+    EX_SIGNAL_SETUP();                      \
     /* local context */                     \
     ex_context_t ex_err;                    \
     ex_err.next = ex_init();               \
     ex_err.stack = 0;                       \
+    EX_PROTECT_ENTER();                     \
     ex_err.ex = 0;                          \
     ex_err.unstack = 0;                     \
+    ex_err.is_emulated = ex_err.next->is_emulated;  \
     ex_err.is_rethrown = false;             \
     /* global context updated */            \
     ex_update(&ex_err);                     \
     /* save jump location */                \
-    ex_err.state = ex_setjmp(ex_err.buf);   \
+    ex_err.state = setjmp_func(ex_err.buf); \
     if (ex_err.state == ex_try_st) {		\
 		__try {
 
+#define ex_try          ex_try_by(ex_setjmp)
+#define ex_try_fast     ex_try_by(ex_setjmp_fast)
+#define ex_try_signal   ex_try_by(ex_setjmp_signal)
+
 #define ex_catch(E)                             \
 		} __except(catch_seh(EX_STR(E), GetExceptionCode(), GetExceptionInformation())) {   \
 			if (ex_err.state == ex_throw_st) {  \
 				EX_MAKE_IF();                   \
+				EX_STAT_CAUGHT();               \
+				EX_RECORD_CAUGHT();             \
 				ex_err.state = ex_catch_st;
 
 #define ex_finally						\
@@ -240,6 +394,7 @@ throws an exception of given message. */
 
 #define ex_end_try                          \
     }										\
+    EX_PROTECT_LEAVE();                     \
     if (ex_init() == &ex_err)  \
         /* global context updated */        \
         ex_update(ex_err.next);             \
@@ -253,6 +408,8 @@ throws an exception of given message. */
         } __except(catch_filter_seh(GetExceptionCode(), GetExceptionInformation())) {   \
             if (ex_err.state == ex_throw_st) {  \
                 EX_MAKE_IF();                   \
+                EX_STAT_CAUGHT();               \
+                EX_RECORD_CAUGHT();             \
                 ex_err.state = ex_catch_st;
 
 #define ex_catch_if                             \
@@ -282,24 +439,36 @@ throws an exception of given message. */
 
 #define throw(E) \
     ex_throw_loc(E, __FILE__, __LINE__, __FUNCTION__)
-#define ex_try                              \
+#define ex_try_by(setjmp_func)              \
 {                                           \
-    if (!exception_signal_set)              \
-        ex_signal_setup();                  \
+    EX_SIGNAL_SETUP();                      \
     /* local context */                     \
     ex_context_t ex_err;                    \
     ex_err.next = ex_init();                \
     ex_err.stack = 0;                       \
+    EX_PROTECT_ENTER();                     \
     ex_err.ex = 0;                          \
     ex_err.unstack = 0;                     \
+    ex_err.is_emulated = ex_err.next->is_emulated;  \
     /* global context updated */            \
     ex_update(&ex_err);                     \
     /* save jump location */                \
-    ex_err.state = ex_setjmp(ex_err.buf);   \
+    ex_err.state = setjmp_func(ex_err.buf); \
+    EX_SIGNAL_LANDED(&ex_err);              \
     if (ex_err.state == ex_try_st)          \
         {                                   \
         {
 
+/* Begin protected block, signal mask saving depends on `EX_TRY_FAST`. */
+#define ex_try          ex_try_by(ex_setjmp)
+
+/* Same as `ex_try`, never saves signal mask, no syscall on entry/throw. */
+#define ex_try_fast     ex_try_by(ex_setjmp_fast)
+
+/* Same as `ex_try`, always saves/restores signal mask,
+for blocks that call `ex_signal_block` or are entered from signal handlers. */
+#define ex_try_signal   ex_try_by(ex_setjmp_signal)
+
 #define ex_catch_any                    \
     }                                \
     }                                \
@@ -307,6 +476,8 @@ throws an exception of given message. */
     {                                \
         {                            \
             EX_MAKE();               \
+            EX_STAT_CAUGHT();        \
+            EX_RECORD_CAUGHT();      \
             ex_err.state = ex_catch_st;
 
 #define ex_catch_if                    \
@@ -329,6 +500,7 @@ throws an exception of given message. */
 #define ex_end_try                            \
     }                                      \
     }                                      \
+    EX_PROTECT_LEAVE();                    \
     if (ex_init() == &ex_err)  \
         /* global context updated */       \
         ex_update(ex_err.next);            \
@@ -342,9 +514,11 @@ throws an exception of given message. */
     if (ex_err.state == ex_throw_st)    \
     {                                   \
         C_API const char EX_NAME(E)[];  \
-        if (ex_err.ex == EX_NAME(E))    \
+        if (ex_err.ex == EX_NAME(E) || ex_is_a(ex_err.ex, EX_NAME(E)))    \
         {                               \
             EX_MAKE();                  \
+            EX_STAT_CAUGHT();           \
+            EX_RECORD_CAUGHT();         \
             ex_err.state = ex_catch_st;
 #endif
 
@@ -387,6 +561,9 @@ struct ex_context_s {
 
     int unstack;
 
+    /* Protection stack depth at `try` entry, with `EX_PROTECT_STACK` defined. */
+    int protect_base;
+
     /* The program state in which the handler was created, and the one to which it shall return. */
     ex_jmp_buf buf;
 };
@@ -403,8 +580,13 @@ struct ex_ptr_s {
 /* extern declaration
 */
 
-C_API ex_setup_func exception_setup_func;
-C_API ex_unwind_func exception_unwind_func;
+/* Per `thread` throw setup/unwind handlers, `guard` sections swap them in and out. */
+C_API thread_local ex_setup_func exception_setup_func;
+/* Called on every throw, before any unwinding, for profiling, `NULL` by default. */
+C_API ex_setup_func exception_throw_hook;
+/* Process wide log sink, see `ex_log_func`, `raii_log_start` installs an asynchronous one. */
+C_API ex_log_func exception_log_func;
+C_API thread_local ex_unwind_func exception_unwind_func;
 C_API ex_terminate_func exception_terminate_func;
 C_API ex_terminate_func exception_ctrl_c_func;
 C_API bool exception_signal_set;
@@ -414,16 +596,110 @@ C_API bool exception_signal_set;
 C_API ex_ptr_t ex_protect_ptr(ex_ptr_t *const_ptr, void *ptr, void (*func)(void *));
 C_API void ex_unprotected_ptr(ex_ptr_t *const_ptr);
 
+/* With `EX_PROTECT_STACK` defined, `protected`/`unprotected` push/pop an per `thread`
+contiguous array of `EX_PROTECT_DEPTH` slots, instead of linking `ex_ptr_t` into `ctx->stack`,
+unwinding then scans it linearly from top to current `try` entry depth. */
+#ifndef EX_PROTECT_DEPTH
+    #define EX_PROTECT_DEPTH 256
+#endif
+
+C_API int ex_protect_push(void **ptr, ex_unwind_func func);
+C_API void ex_protect_pop(int depth);
+C_API int ex_protect_depth(void);
+
 /* Protects dynamically allocated memory against exceptions.
 If the object pointed by `ptr` changes before `unprotected()`,
 the new object will be automatically protected.
 
 If `ptr` is not null, `func(ptr)` will be invoked during stack unwinding. */
+#ifdef EX_PROTECT_STACK
+#define protected(ptr, func) int EX_PNAME(ptr) = ex_protect_push((void **)&ptr, func)
+
+/* Remove memory pointer protection, does not free the memory. */
+#define unprotected(p) ex_protect_pop(EX_PNAME(p))
+
+#define EX_PROTECT_ENTER()  ex_err.protect_base = ex_protect_depth()
+#define EX_PROTECT_LEAVE()  ex_protect_pop(ex_err.protect_base)
+#else
 #define protected(ptr, func) ex_ptr_t EX_PNAME(ptr) = ex_protect_ptr(&EX_PNAME(ptr), &ptr, func)
 
 /* Remove memory pointer protection, does not free the memory. */
 #define unprotected(p) (ex_local()->stack = EX_PNAME(p).next)
 
+#define EX_PROTECT_ENTER()  ex_err.protect_base = 0
+#define EX_PROTECT_LEAVE()
+#endif
+
+/* result returns
+*/
+
+/* Error-code alternative to `throw`, for expected failures, unwinds by normal returns.
+Same exception identities as `EX_EXCEPTION`, `ex` is `NULL` on success. */
+typedef struct {
+    const char *ex;
+    const char *message;
+    void *value;
+} ex_result_t;
+
+static RAII_INLINE ex_result_t ex_result_ok(void *value) {
+    ex_result_t result;
+    result.ex = NULL;
+    result.message = NULL;
+    result.value = value;
+    return result;
+}
+
+static RAII_INLINE ex_result_t ex_result_err(const char *ex, const char *message) {
+    ex_result_t result;
+    result.ex = ex;
+    result.message = message;
+    result.value = NULL;
+    return result;
+}
+
+/* Throw `result` error as an exception, does nothing on success. */
+C_API void ex_result_throw(ex_result_t result, const char *file, int line, const char *function);
+
+/* Successful result of `value`. */
+#define ex_ok(value)    ex_result_ok((void *)(value))
+
+/* Return from current function, an error result of exception `E`. */
+#define ex_fail(E, message)                     \
+    do {                                        \
+        C_API const char EX_NAME(E)[];          \
+        return ex_result_err(EX_NAME(E), (message));    \
+    } while (0)
+
+#define ex_is_ok(result)        ((result).ex == NULL)
+
+/* Check if `result` error is exception `E`, or one of it's subclasses.
+Without `GNU` statement expressions, `E` must be declared where used,
+as `EX_EXCEPTION`, or `C_API const char EX_NAME(E)[];`, does. */
+#if defined(__GNUC__) || defined(__clang__) || defined(__TINYC__)
+#define ex_result_is(result, E)             \
+    __extension__({                         \
+        C_API const char EX_NAME(E)[];      \
+        ex_is_a((result).ex, EX_NAME(E));   \
+    })
+#else
+#define ex_result_is(result, E) ex_is_a((result).ex, EX_NAME(E))
+#endif
+
+/* Return `result` from current function, if it's an error. */
+#define propagate(result)                       \
+    do {                                        \
+        ex_result_t ex_res_ = (result);         \
+        if (!ex_is_ok(ex_res_))                 \
+            return ex_res_;                     \
+    } while (0)
+
+/* Evaluate `expr`, returning from current function, if it's an error. */
+#define try_result(expr)    propagate(expr)
+
+/* Evaluate `expr`, throwing it as an exception, if it's an error. */
+#define ex_unwrap(expr) \
+    ex_result_throw((expr), __FILE__, __LINE__, __FUNCTION__)
+
 #ifdef __cplusplus
 }
 #endif
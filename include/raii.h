@@ -1,7 +1,26 @@
 #ifndef RAII_H
 #define RAII_H
 
+/* AddressSanitizer manual poisoning, of arena free space and quarantined blocks,
+ahead of `rtypes.h` macros. */
+#if defined(__SANITIZE_ADDRESS__)
+    #define RAII_ASAN 1
+#elif defined(__has_feature)
+    #if __has_feature(address_sanitizer)
+        #define RAII_ASAN 1
+    #endif
+#endif
+#ifdef RAII_ASAN
+    #include <sanitizer/asan_interface.h>
+    #define RAII_POISON(ptr, size)      ASAN_POISON_MEMORY_REGION(ptr, size)
+    #define RAII_UNPOISON(ptr, size)    ASAN_UNPOISON_MEMORY_REGION(ptr, size)
+#else
+    #define RAII_POISON(ptr, size)      ((void)(ptr), (void)(size))
+    #define RAII_UNPOISON(ptr, size)    ((void)(ptr), (void)(size))
+#endif
+
 #include "rtypes.h"
+#include "catomic.h"
 #include "exception.h"
 #include "cthread.h"
 #include <stdio.h>
@@ -15,6 +34,17 @@
 all other fields private, this object binds any additional requests to it's lifetime. */
 typedef struct memory_s memory_t;
 typedef memory_t unique_t;
+typedef struct raii_inbox_s {
+    /* blocks pushed by other `thread`s, first word of each links to next */
+    void *volatile head;
+    /* blocks queued, at most `RAII_INBOX_MAX`, senders free any more themselves */
+    volatile size_t count;
+    /* bumped each time inbox is handed to a new `thread`, inboxes are recycled, never freed */
+    volatile size_t generation;
+    /* set once owner `thread` exited */
+    volatile int closed;
+    struct raii_inbox_s *next;
+} raii_inbox_t;
 typedef void (*func_t)(void *);
 typedef void (*func_args_t)(void *, ...);
 typedef void *(*raii_func_t)(void *);
@@ -73,6 +103,10 @@ typedef enum {
     RAII_ARENA,
     RAII_THREAD,
     RAII_GUARDED_STATUS,
+    RAII_AIO,
+    RAII_SHARED,
+    RAII_GROUP,
+    RAII_DEF_ASYNC,
     RAII_COUNT
 } raii_type;
 
@@ -121,24 +155,178 @@ typedef struct {
     func_t dtor;
 } object_t;
 
+/* Growable vector, type `RAII_ARRAY` for user data, capacity doubling,
+see `raii_array_of`, `raii_array_arena`. */
 typedef struct {
     raii_type type;
     void *base;
     size_t elements;
+    size_t capacity;
+    /* element size of typed vector, `0` when given per call */
+    size_t size;
+    /* `arena_t` storage comes from, `NULL` for heap */
+    void *arena;
 } raii_array_t;
 
 typedef struct {
+    /* `RAII_DEF_FUNC`, or `RAII_ARRAY` for range over `count` objects `data` points to */
     raii_type type;
-    raii_array_t base;
-} defer_t;
-
-typedef struct {
-    raii_type type;
+    /* registration number, tags `defer_handle_t` to it */
+    unsigned int serial;
     void (*func)(void *);
     void *data;
     void *check;
+    size_t count;
 } defer_func_t;
 
+/* Generation tagged deferred entry, see `raii_deferred_arm`, `0` is never valid. */
+typedef uint64_t defer_handle_t;
+
+/* Number of deferred entries stored inline, within `memory_t` itself,
+before any heap allocation, must be at least `1`. */
+#ifndef RAII_DEFER_INLINE
+    #define RAII_DEFER_INLINE 8
+#endif
+
+/* Number of released heap scopes each `thread` keeps for reuse by `unique_init`,
+must be at least `1`. */
+#ifndef RAII_SCOPE_CACHE
+    #define RAII_SCOPE_CACHE 64
+#endif
+
+/* Number of arguments stored inline, within `args_t` itself,
+before any heap allocation, `args_local` accepts no more. */
+#ifndef RAII_ARGS_INLINE
+    #define RAII_ARGS_INLINE 8
+#endif
+
+/* Characters an `raii_value_t` holds inline, longer strings are referred to. */
+#define RAII_VALUE_SMALL 14
+
+/* Compact 16 byte tagged value, an single word, or small string of up to
+`RAII_VALUE_SMALL` characters, `type` being it's format character for either.
+Wide 128 byte `values_type` remains opt-in, by `raii_value_wide`. */
+typedef union {
+    struct {
+        union {
+            size_t max_size;
+            int64_t long_long;
+            double precision;
+            char schar;
+            char *char_ptr;
+            char **array;
+            void *object;
+            raii_func_t func;
+        } value;
+        char reserved[7];
+        char type;
+    } word;
+    struct {
+        char chars[RAII_VALUE_SMALL + 1];
+        char type;
+    } small;
+} raii_value_t;
+
+/* Compact argument storage, of `args_t`. */
+typedef raii_value_t args_value_t;
+
+#ifdef RAII_STATS
+    #define RAII_STAT(expr) expr
+#else
+    #define RAII_STAT(expr)
+#endif
+
+#ifdef RAII_TRACE
+    #define RAII_TRACED(expr) expr
+#else
+    #define RAII_TRACED(expr)
+#endif
+
+#ifdef RAII_RECORD
+    #define RAII_RECORDED(expr) expr
+#else
+    #define RAII_RECORDED(expr)
+#endif
+
+#ifdef RAII_MEMCHECK
+    #define RAII_MEMCHECKED(expr) expr
+#else
+    #define RAII_MEMCHECKED(expr)
+#endif
+
+/* Frames of allocation site `RAII_MEMCHECK` records. */
+#ifndef RAII_MEMCHECK_DEPTH
+    #define RAII_MEMCHECK_DEPTH 6
+#endif
+
+/* Blocks released through scopes `RAII_MEMCHECK` keeps poisoned, before really freeing. */
+#ifndef RAII_MEMCHECK_QUARANTINE
+    #define RAII_MEMCHECK_QUARANTINE 1024
+#endif
+
+/* Released arena chunks `RAII_MEMCHECK` keeps inaccessible, before unmapping. */
+#ifndef RAII_MEMCHECK_CHUNKS
+    #define RAII_MEMCHECK_CHUNKS 64
+#endif
+
+/* Events each `thread` trace ring holds, older ones overwritten. */
+#ifndef RAII_TRACE_RING
+    #define RAII_TRACE_RING 8192
+#endif
+
+/* Events each `thread` record ring holds, older ones overwritten. */
+#ifndef RAII_RECORD_RING
+    #define RAII_RECORD_RING 8192
+#endif
+
+/* Distinct file and exception names `RAII_RECORD` events refer to, later ones saved as `?`. */
+#ifndef RAII_RECORD_NAMES
+    #define RAII_RECORD_NAMES 1024
+#endif
+
+/* Distinct locks `RAII_LOCK_PROFILE` keeps counts of, ones past it go unrecorded. */
+#ifndef RAII_LOCK_PROFILES
+    #define RAII_LOCK_PROFILES 256
+#endif
+
+/* Holder call sites kept per lock, those most often making others wait. */
+#ifndef RAII_LOCK_SITES
+    #define RAII_LOCK_SITES 4
+#endif
+
+/* Wait time histogram buckets, first under `1` microsecond, each next twice as wide. */
+#define RAII_LOCK_BUCKETS 16
+
+/* Checks `raii_mutex_lock` makes, each after a cpu `pause`, before parking. */
+#ifndef RAII_MUTEX_SPIN
+    #define RAII_MUTEX_SPIN 128
+#endif
+
+/* Scope `defer` statistics, see `raii_scope_stats`. */
+typedef struct {
+    size_t registered;
+    size_t fired;
+    size_t cancelled;
+    /* most deferred functions pending at once */
+    size_t peak;
+} raii_stats_t;
+
+typedef struct {
+    raii_type type;
+    /* heap storage, `NULL` while entries fit in `local` */
+    raii_array_t base;
+    defer_func_t local[RAII_DEFER_INLINE];
+    /* last registration number handed out, kept across unwinds */
+    unsigned int serial;
+} defer_t;
+
+/* Bytes scopes sharing it may hold, see `raii_budget`. */
+typedef struct {
+    /* bytes allowed, `0` unlimited */
+    size_t limit;
+    volatile size_t used;
+} raii_budget_t;
+
 struct memory_s {
     void *arena;
     int status;
@@ -148,20 +336,48 @@ struct memory_s {
     bool is_protected;
     bool is_arena;
     bool is_emulated;
+    bool is_local;
     ex_ptr_t *protector;
     defer_t defer;
     size_t mid;
+    raii_stats_t stats;
+    /* `thread` it was created on, `RAII_FREE` defers ran elsewhere go back to it,
+    while it's inbox still has `owner_generation` */
+    raii_inbox_t *owner;
+    size_t owner_generation;
+    /* rpmalloc first class heap, by `unique_init_heap`, `NULL` if none */
+    void *heap;
+    /* own, or enclosing scope's inherited, `NULL` if unlimited */
+    raii_budget_t *budget;
+    raii_budget_t limits;
+    /* bytes this scope charged to `budget`, returned on `raii_deferred_free` */
+    size_t charged;
+    /* enclosing scope, of `unique_child`, releasing this one unless deleted first,
+    `child` being it's entry there */
+    memory_t *parent;
+    defer_handle_t child;
+    /* `arena` is `parent` one, rewound on exit, never freed */
+    bool is_borrowed;
 };
 
+/* Caller provided, usually `stack` resident, scope storage for `guard_local`. */
+typedef struct {
+    unique_t scope;
+    ex_ptr_t protector;
+} unique_frame_t;
+
 typedef struct args_s {
     raii_type type;
-    /* allocated array of arguments */
-    raii_values_t *args;
+    /* arguments, `inlined` or allocated array if more */
+    args_value_t *args;
     unique_t *context;
 
     /* total number of args in set */
     size_t n_args;
     bool defer_set;
+    /* caller provided storage, by `args_local` */
+    bool is_local;
+    args_value_t inlined[RAII_ARGS_INLINE];
 } args_t;
 
 /**
@@ -181,6 +397,7 @@ C_API void args_free(args_t *params);
 * * `d` signed integer,
 * * `c` character,
 * * `s` string,
+* * `S` small string, copied inline if at most `RAII_VALUE_SMALL` characters,
 * * `a` array,
 * * `x` function,
 * * `f` double/float,
@@ -189,6 +406,134 @@ C_API void args_free(args_t *params);
 */
 C_API args_t *raii_args_for(memory_t *scope, const char *desc, ...);
 
+/**
+* Same as `raii_args_for`, but into caller provided, usually `stack` resident,
+* `params` storage, no allocation, at most `RAII_ARGS_INLINE` arguments.
+* `params` must outlive any use, `args_free` leaves it alone.
+*
+* @param params storage to fill
+* @param desc format, same as `raii_args_for()`
+* @param arguments indexed by `desc` format order
+*/
+C_API args_t *args_local(args_t *params, const char *desc, ...);
+
+/**
+* Fills `params`, like `args_local`, from `count` already built `values`,
+* no format parsing, nor `va_list`. Used by `args_pack`.
+*
+* @param params storage to fill
+* @param count number of `values`, at most `RAII_ARGS_INLINE`
+* @param values compact argument slots
+*/
+C_API args_t *args_packed(args_t *params, int count, const args_value_t *values);
+
+/* Compact argument slot of given type, `type` set to it's `raii_args_for` format character. */
+C_API args_value_t args_of_i(size_t value);
+C_API args_value_t args_of_d(int64_t value);
+C_API args_value_t args_of_c(int value);
+C_API args_value_t args_of_f(double value);
+C_API args_value_t args_of_s(const char *value);
+C_API args_value_t args_of_a(char **value);
+C_API args_value_t args_of_x(raii_func_t value);
+C_API args_value_t args_of_p(void *value);
+
+#if !defined(__cplusplus) && ((defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L) \
+    || defined(__GNUC__) || defined(__clang__))
+/* Argument slot picked by type at compile time, an `struct` or `union` fails to build. */
+#define args_slot(x) _Generic((x),                                                  \
+    char: args_of_c, signed char: args_of_c, unsigned char: args_of_c,              \
+    short: args_of_d, int: args_of_d, long: args_of_d, long long: args_of_d,        \
+    _Bool: args_of_i, unsigned short: args_of_i, unsigned int: args_of_i,           \
+    unsigned long: args_of_i, unsigned long long: args_of_i,                        \
+    float: args_of_f, double: args_of_f,                                            \
+    char *: args_of_s, const char *: args_of_s, char **: args_of_a,                 \
+    raii_func_t: args_of_x, default: args_of_p)(x)
+
+#define RAII_ARGS_N(...) RAII_ARGS_N_(__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define RAII_ARGS_N_(_1, _2, _3, _4, _5, _6, _7, _8, n, ...) n
+#define RAII_ARGS_CAT(a, b) RAII_ARGS_CAT_(a, b)
+#define RAII_ARGS_CAT_(a, b) a##b
+#define RAII_ARGS_MAP1(a) args_slot(a)
+#define RAII_ARGS_MAP2(a, ...) args_slot(a), RAII_ARGS_MAP1(__VA_ARGS__)
+#define RAII_ARGS_MAP3(a, ...) args_slot(a), RAII_ARGS_MAP2(__VA_ARGS__)
+#define RAII_ARGS_MAP4(a, ...) args_slot(a), RAII_ARGS_MAP3(__VA_ARGS__)
+#define RAII_ARGS_MAP5(a, ...) args_slot(a), RAII_ARGS_MAP4(__VA_ARGS__)
+#define RAII_ARGS_MAP6(a, ...) args_slot(a), RAII_ARGS_MAP5(__VA_ARGS__)
+#define RAII_ARGS_MAP7(a, ...) args_slot(a), RAII_ARGS_MAP6(__VA_ARGS__)
+#define RAII_ARGS_MAP8(a, ...) args_slot(a), RAII_ARGS_MAP7(__VA_ARGS__)
+
+/**
+* Fill `params` from one up to `RAII_ARGS_INLINE` arguments, their layout and
+* format fixed at compile time, no `desc` string. Ready to hand to `thrd_async`.
+*
+* `args_pack(&args, 12, "name", ptr)` same as `args_local(&args, "dsp", ...)`.
+*/
+#define args_pack(params, ...)                                                      \
+    args_packed(params, RAII_ARGS_N(__VA_ARGS__), (const args_value_t[]) {          \
+        RAII_ARGS_CAT(RAII_ARGS_MAP, RAII_ARGS_N(__VA_ARGS__))(__VA_ARGS__)         \
+    })
+
+#if defined(__GNUC__) || defined(__clang__)
+#define RAII_ARGS_FIELDS1(a) a _0;
+#define RAII_ARGS_FIELDS2(a, b) a _0; b _1;
+#define RAII_ARGS_FIELDS3(a, b, c) a _0; b _1; c _2;
+#define RAII_ARGS_FIELDS4(a, b, c, d) a _0; b _1; c _2; d _3;
+#define RAII_ARGS_FIELDS5(a, b, c, d, e) a _0; b _1; c _2; d _3; e _4;
+#define RAII_ARGS_FIELDS6(a, b, c, d, e, f) a _0; b _1; c _2; d _3; e _4; f _5;
+#define RAII_ARGS_FIELDS7(a, b, c, d, e, f, g) a _0; b _1; c _2; d _3; e _4; f _5; g _6;
+#define RAII_ARGS_FIELDS8(a, b, c, d, e, f, g, h) a _0; b _1; c _2; d _3; e _4; f _5; g _6; h _7;
+
+/* Type of argument `i` in signature `sig`, no `default`, other types fail to build. */
+#define RAII_ARGS_T(sig, i) __typeof__(((sig *)0)->_##i)
+#define RAII_ARGS_AS(sig, i, a) _Generic((a), RAII_ARGS_T(sig, i): args_slot(a))
+#define RAII_ARGS_AS1(sig, a) RAII_ARGS_AS(sig, 0, a)
+#define RAII_ARGS_AS2(sig, a, b) RAII_ARGS_AS1(sig, a), RAII_ARGS_AS(sig, 1, b)
+#define RAII_ARGS_AS3(sig, a, b, c) RAII_ARGS_AS2(sig, a, b), RAII_ARGS_AS(sig, 2, c)
+#define RAII_ARGS_AS4(sig, a, b, c, d) RAII_ARGS_AS3(sig, a, b, c), RAII_ARGS_AS(sig, 3, d)
+#define RAII_ARGS_AS5(sig, a, b, c, d, e) RAII_ARGS_AS4(sig, a, b, c, d), RAII_ARGS_AS(sig, 4, e)
+#define RAII_ARGS_AS6(sig, a, b, c, d, e, f) RAII_ARGS_AS5(sig, a, b, c, d, e), RAII_ARGS_AS(sig, 5, f)
+#define RAII_ARGS_AS7(sig, a, b, c, d, e, f, g)                                     \
+    RAII_ARGS_AS6(sig, a, b, c, d, e, f), RAII_ARGS_AS(sig, 6, g)
+#define RAII_ARGS_AS8(sig, a, b, c, d, e, f, g, h)                                  \
+    RAII_ARGS_AS7(sig, a, b, c, d, e, f, g), RAII_ARGS_AS(sig, 7, h)
+
+/**
+* Declare argument pack signature `name`, of one up to `RAII_ARGS_INLINE` types,
+* shared by packing and receiving side, `args_pack_as` fails to build on any argument
+* not of exactly it's signature type, or wrong count, `args_get` reads back as that type.
+*
+* `args_signature(job_args, int, char *, double);`
+*/
+#define args_signature(name, ...)                                                   \
+    typedef struct {                                                                \
+        RAII_ARGS_CAT(RAII_ARGS_FIELDS, RAII_ARGS_N(__VA_ARGS__))(__VA_ARGS__)      \
+        char n_args[RAII_ARGS_N(__VA_ARGS__)];                                      \
+    } name
+
+/* Same as `args_pack`, arguments checked against signature `sig`, at compile time. */
+#define args_pack_as(sig, params, ...)                                              \
+    args_packed(params, RAII_ARGS_N(__VA_ARGS__)                                    \
+        + 0 * (int)sizeof(char[sizeof(((sig *)0)->n_args) == RAII_ARGS_N(__VA_ARGS__) ? 1 : -1]), \
+        (const args_value_t[]) {                                                    \
+        RAII_ARGS_CAT(RAII_ARGS_AS, RAII_ARGS_N(__VA_ARGS__))(sig, __VA_ARGS__)     \
+    })
+
+/* Argument `i`, an literal index, of `params` packed by `args_pack_as` signature `sig`,
+as signature type. */
+#define args_get(sig, params, i) ((RAII_ARGS_T(sig, i))_Generic((((sig *)0)->_##i),     \
+    char: args_in(params, i).schar, signed char: args_in(params, i).schar,              \
+    unsigned char: args_in(params, i).schar, short: args_in(params, i).long_long,       \
+    int: args_in(params, i).long_long, long: args_in(params, i).long_long,              \
+    long long: args_in(params, i).long_long, _Bool: args_in(params, i).max_size,        \
+    unsigned short: args_in(params, i).max_size, unsigned int: args_in(params, i).max_size, \
+    unsigned long: args_in(params, i).max_size, unsigned long long: args_in(params, i).max_size, \
+    float: args_in(params, i).precision, double: args_in(params, i).precision,          \
+    char *: args_in(params, i).char_ptr, const char *: args_in(params, i).const_char,   \
+    char **: args_in(params, i).array, raii_func_t: args_in(params, i).func,            \
+    default: args_in(params, i).object))
+#endif
+#endif
+
 /**
 * Returns generic union `values_type` of argument, will auto `release/free`
 * allocated memory when scoped return/exit.
@@ -208,18 +553,180 @@ C_API values_type get_args(void *params, int item);
 */
 C_API values_type args_in(args_t *params, int index);
 
+/* Compact value of string, copied inline as `S` type if at most
+`RAII_VALUE_SMALL` characters, otherwise refers to it as `s` type. */
+C_API raii_value_t raii_value_str(const char *text);
+
+/* Returns string of compact value, inline or referred to, `NULL` if not an string. */
+C_API const char *raii_value_string(const raii_value_t *value);
+
+/* Returns format character of compact value, same as `raii_args_for` `desc`. */
+C_API char raii_value_type(const raii_value_t *value);
+
+/* Returns wide `values_type` of compact value, small string copied into `const_char`. */
+C_API values_type raii_value_wide(const raii_value_t *value);
+
 C_API memory_t *raii_local(void);
+
+#ifndef RAII_INBOX_MAX
+    #define RAII_INBOX_MAX 4096
+#endif
+
+/* Returns current `thread` queue of memory released by other `thread`s,
+an lock-free MPSC list, drained at this `thread` next scope exit, and at `thread` exit. */
+C_API raii_inbox_t *raii_inbox(void);
+
+#ifdef emulate_tls
+    #undef RAII_THREAD_STATE
+#endif
+
+#ifdef RAII_THREAD_STATE
+#if defined(__GNUC__) || defined(__clang__)
+    #define RAII_TLS_MODEL __attribute__((tls_model("initial-exec")))
+#else
+    #define RAII_TLS_MODEL
+#endif
+/* All per `thread` state hot paths touch, in one native TLS block,
+so each `defer`/`_malloc` does a single TLS access. */
+typedef struct {
+    /* `raii_local` */
+    memory_t *scope;
+    /* last `ex_init` result, `NULL` forces lookup */
+    ex_context_t *context;
+    /* `thrd_scope`, worker's or `thrd_unique` created */
+    unique_t *thrd;
+    raii_inbox_t *inbox;
+    /* released scopes kept for `unique_init` */
+    struct raii_scopes_s *scopes;
+    /* slots of `raii_tls_create` */
+    struct raii_tls_s *tls;
+} raii_thread_t;
+
+C_API thread_local raii_thread_t raii_thread RAII_TLS_MODEL;
+#endif
+
+#ifndef RAII_TLS_SLOTS
+    #define RAII_TLS_SLOTS 32
+#endif
+#ifndef RAII_TLS_BYTES
+    #define RAII_TLS_BYTES 1024
+#endif
+
+/* Slot of per `thread` block, all library and user thread locals share one block,
+allocated once per `thread`, behind single key, or native TLS pointer. */
+typedef int raii_tls_t;
+
+/* Register slot, `size` of `0` makes pointer slot, as `tss_create`, `dtor` called with it's
+value, if not `NULL`, at `thread` exit. Otherwise `size` zeroed bytes kept inline in block,
+out of `RAII_TLS_BYTES`, `dtor` called with their address. Slots are released last first.
+Returns `thrd_error` once `RAII_TLS_SLOTS`, or `RAII_TLS_BYTES`, used up. */
+C_API int raii_tls_create(raii_tls_t *key, size_t size, func_t dtor);
+
+/* Value of pointer slot, address of inline slot, of current `thread`,
+`NULL`, and `thrd_nomem` set, when block can't be allocated, nothing is thrown. */
+C_API void *raii_tls_get(raii_tls_t key);
+C_API int raii_tls_set(raii_tls_t key, void *value);
+
+/* Per `thread` `type` as slot in shared block, `var()` returns it, zeroed at first use. */
+#define raii_thread_local(type, var)                                    \
+    static raii_tls_t raii_##var##_key;                                 \
+    static once_flag raii_##var##_once = ONCE_FLAG_INIT;                \
+    static void raii_##var##_setup(void) {                              \
+        if (raii_tls_create(&raii_##var##_key, sizeof(type), NULL) != thrd_success) \
+            raii_panic("Raii `raii_tls_create` failed!");               \
+    }                                                                   \
+    static RAII_INLINE type *var(void) {                                \
+        call_once(&raii_##var##_once, raii_##var##_setup);              \
+        return (type *)raii_tls_get(raii_##var##_key);                  \
+    }
+
+/* Give `ptr` back to `owner` thread, for it to `RAII_FREE`, instead of freeing here,
+freed at once if `owner` is current `thread`, has exited, or has `RAII_INBOX_MAX` queued.
+Block must hold at least a pointer. Scopes do this for their `RAII_FREE` defers,
+protected `malloc_by`/`calloc_by` memory still needs releasing on it's own `thread`. */
+C_API void raii_free_to(raii_inbox_t *owner, void *ptr);
+
+/* Free all blocks given back to current `thread`, returns number freed. */
+C_API size_t raii_inbox_drain(void);
+/* Make `scope` current `thread` smart memory pointer, returns previous,
+for switching between coroutines, see `routine_create`. */
+C_API memory_t *raii_local_swap(memory_t *scope);
 /* Return current `thread` smart memory pointer. */
 C_API memory_t *raii_init(void);
 C_API void raii_unwind_set(ex_context_t *ctx, const char *ex, const char *message);
 C_API int raii_deferred_init(defer_t *array);
 
+/* Untyped vector owned by `scope`, released when it exits or unwinds,
+elements appended by `raii_array_append` of given size. */
+C_API raii_array_t *raii_array_new(memory_t *scope);
+
+/* Vector of `size` byte elements owned by `scope`, `raii_array_of` by type. */
+C_API raii_array_t *raii_array_typed(memory_t *scope, size_t size);
+#define raii_array_of(scope, type) raii_array_typed(scope, sizeof(type))
+
+/* Same as `raii_array_typed`, but storage from `arena`, released along with it,
+vector handle itself owned by `scope`. */
+C_API raii_array_t *raii_array_arena(memory_t *scope, void *arena, size_t size);
+
+C_API int raii_array_init(raii_array_t *a);
+C_API int raii_array_reset(raii_array_t *a);
+
+/* Returns new uninitialized element of `element_size` at end, `NULL` if out of memory. */
+C_API void *raii_array_append(raii_array_t *a, size_t element_size);
+
+/* Make room for at least `count` elements, returns `0`, or `-1`. */
+C_API int raii_array_reserve(raii_array_t *a, size_t count);
+
+/* Copy `element` at end, returns it's slot, uninitialized if `element` is `NULL`. */
+C_API void *raii_array_push(raii_array_t *a, const void *element);
+
+/* Copy `count` elements at end, by single `memcpy`, returns first of them. */
+C_API void *raii_array_extend(raii_array_t *a, const void *elements, size_t count);
+
+/* Copy `element` before `index`, shifting those after, returns it's slot. */
+C_API void *raii_array_insert(raii_array_t *a, size_t index, const void *element);
+
+/* Remove last element, copied into `out` if not `NULL`, returns `false` if empty. */
+C_API bool raii_array_pop(raii_array_t *a, void *out);
+
+/* Returns element at `index`, `NULL` if out of range. */
+C_API void *raii_array_at(raii_array_t *a, size_t index);
+C_API size_t raii_array_count(raii_array_t *a);
+
+/* Remove all elements, keeping capacity. */
+C_API void raii_array_clear(raii_array_t *a);
+
+#define raii_array_get(a, type, index)  (((type *)(a)->base)[index])
+#define raii_array_emplace(a, type)     ((type *)raii_array_push(a, NULL))
+
 C_API size_t raii_mid(void);
 C_API size_t raii_last_mid(memory_t *scope);
 
 /* Defer execution `LIFO` of given function with argument,
 to current `thread` scope lifetime/destruction. */
 C_API size_t raii_defer(func_t, void *);
+C_API size_t raii_defer_many(func_t, void **data, size_t n);
+
+/* Single `defer` for whole intrusive list of `compat/sys/queue.h`, at `scope` exit or unwind,
+list at `head` is walked as it is then, calling `dtor` on each element in order, `link`
+being offset of element's `*_ENTRY` field. Afterwards `head` is empty again, `is_tailed`
+heads, `SIMPLEQ` and `TAILQ`, also get their `last` pointer reset. */
+C_API size_t raii_deferred_list(memory_t *scope, void *head, size_t link, bool is_tailed, func_t dtor);
+
+/* Of `struct type` elements linked by `field`, all these heads, and entries,
+start with next element pointer. */
+#define raii_slist_by(scope, head, type, field, dtor)   \
+    raii_deferred_list(scope, (void *)(head), offsetof(struct type, field), false, (func_t)(dtor))
+#define raii_list_by(scope, head, type, field, dtor)    \
+    raii_deferred_list(scope, (void *)(head), offsetof(struct type, field), false, (func_t)(dtor))
+#define raii_simpleq_by(scope, head, type, field, dtor) \
+    raii_deferred_list(scope, (void *)(head), offsetof(struct type, field), true, (func_t)(dtor))
+#define raii_tailq_by(scope, head, type, field, dtor)   \
+    raii_deferred_list(scope, (void *)(head), offsetof(struct type, field), true, (func_t)(dtor))
+#define _slist(head, type, field, dtor) raii_slist_by(_$##__FUNCTION__, head, type, field, dtor)
+#define _list(head, type, field, dtor) raii_list_by(_$##__FUNCTION__, head, type, field, dtor)
+#define _simpleq(head, type, field, dtor) raii_simpleq_by(_$##__FUNCTION__, head, type, field, dtor)
+#define _tailq(head, type, field, dtor) raii_tailq_by(_$##__FUNCTION__, head, type, field, dtor)
 
 C_API void raii_defer_cancel(size_t index);
 C_API void raii_deferred_cancel(memory_t *scope, size_t index);
@@ -227,6 +734,35 @@ C_API void raii_deferred_cancel(memory_t *scope, size_t index);
 C_API void raii_defer_fire(size_t index);
 C_API void raii_deferred_fire(memory_t *scope, size_t index);
 
+/* Same as `raii_deferred`, but returns generation tagged handle, which
+`raii_deferred_disarm` and `raii_deferred_trigger` check in `O(1)`, a stale handle
+of an already fired, cancelled or unwound entry, does nothing and returns `false`. */
+C_API defer_handle_t raii_deferred_arm(memory_t *scope, func_t, void *);
+C_API bool raii_deferred_disarm(memory_t *scope, defer_handle_t handle);
+C_API bool raii_deferred_trigger(memory_t *scope, defer_handle_t handle);
+/* Is `handle` entry still pending. */
+C_API bool raii_deferred_armed(memory_t *scope, defer_handle_t handle);
+
+/* Hand `ptr` over from `from` to `to`, no copy, it's pending entry, `RAII_FREE` or other
+release, detached from `from` and appended to `to`, so released only when `to` exits or
+unwinds. Returns handle of entry in `to`, `0` if `from` has none for `ptr`. Searches `from`
+newest first, `raii_deferred_move` takes entry by handle in `O(1)`. Any budget charge
+stays with `from`. */
+C_API defer_handle_t raii_move(memory_t *from, memory_t *to, void *ptr);
+C_API defer_handle_t raii_deferred_move(memory_t *from, defer_handle_t handle, memory_t *to);
+#define _move(to, ptr) raii_move(_$##__FUNCTION__, to, ptr)
+
+/* Same as `raii_defer`, but on scope exit or unwind `func(data)` is only queued,
+with any other such entries of that unwind, as one batch, to a background reclaimer `thread`,
+running each batch in order entries would have run, off caller's latency path.
+For costly teardown not needed before scope returns, `raii_deferred_trigger` still runs it at once. */
+C_API size_t raii_defer_async(func_t func, void *data);
+C_API size_t raii_deferred_async(memory_t *scope, func_t func, void *data);
+#define _defer_async(func, ptr) raii_deferred_async(_$##__FUNCTION__, (func_t)func, ptr)
+
+/* Block until reclaimer `thread` ran every batch queued so far. */
+C_API void raii_reclaim_wait(void);
+
 /* Same as `raii_defer` but allows recover from an Error condition throw/panic,
 you must call `raii_caught` inside function to mark Error condition handled. */
 C_API void raii_recover(func_t, void *);
@@ -247,11 +783,71 @@ C_API const char *raii_message(void);
 /* Get scoped error condition string. */
 C_API const char *raii_message_by(memory_t *scope);
 
+/* Error records each `thread` keeps, reused oldest first, see `raii_error`. */
+#ifndef RAII_ERR_DEPTH
+    #define RAII_ERR_DEPTH 8
+#endif
+
+/* Characters of formatted message, an error record holds. */
+#ifndef RAII_ERR_MESSAGE
+    #define RAII_ERR_MESSAGE 256
+#endif
+
+/* Error context, type `RAII_ERR_CONTEXT`, an record of calling `thread`'s fixed ring,
+so making and throwing one never allocates. Still valid inside `catch`, and for
+`RAII_ERR_DEPTH - 1` newer errors of same `thread`, copy any needed longer. */
+typedef struct raii_error_s raii_error_t;
+struct raii_error_s {
+    raii_type type;
+    int code;
+    /* error this one wraps, `NULL` if none, or once it's record got reused */
+    raii_error_t *cause;
+    /* set when thrown by `throw_error` */
+    const char *ex;
+    const char *file;
+    int line;
+    char message[RAII_ERR_MESSAGE];
+};
+
+/* Returns next error record of calling `thread`, `printf` like formatted, truncated
+to `RAII_ERR_MESSAGE`, wrapping `cause`, which may be `NULL`. */
+C_API raii_error_t *raii_error(raii_error_t *cause, int code, const char *fmt, ...);
+C_API raii_error_t *raii_verror(raii_error_t *cause, int code, const char *fmt, va_list args);
+
+/* Throw exception `ex`, it's message being `err` message. */
+C_API void raii_error_throw(const char *ex, const char *file, int line, const char *function, raii_error_t *err);
+#define throw_error(E, err)                 \
+    do {                                    \
+        C_API const char EX_NAME(E)[];      \
+        raii_error_throw(EX_NAME(E), __FILE__, __LINE__, __FUNCTION__, (err));  \
+    } while (0)
+
+/* Returns error record `message` belongs to, as `raii_message` or `ex_err.panic`
+inside `catch`, `NULL` if it's an plain string. */
+C_API raii_error_t *raii_error_of(const char *message);
+
+/* Returns error record of current error condition, `NULL` if none, or plain message. */
+C_API raii_error_t *raii_error_caught(void);
+
+/* Returns latest error record made by calling `thread`, `NULL` if none. */
+C_API raii_error_t *raii_error_last(void);
+
+/* Number of records in `err` cause chain, itself included. */
+C_API size_t raii_error_depth(const raii_error_t *err);
+
 /* Defer execution `LIFO` of given function with argument,
 to the given `scoped smart pointer` lifetime/destruction. */
 C_API size_t raii_deferred(memory_t *, func_t, void *);
 C_API size_t raii_deferred_count(memory_t *);
 
+/* Same as `raii_deferred`, but an single entry, that calls `func` on each of
+`n` objects in `data` array, `LIFO` from last, array itself is not copied. */
+C_API size_t raii_deferred_many(memory_t *, func_t, void **data, size_t n);
+
+/* Returns `scope` deferred functions registered/fired/cancelled counts,
+only counted when `RAII_STATS` defined. */
+C_API raii_stats_t raii_scope_stats(memory_t *scope);
+
 /* Request/return raw memory of given `size`, using smart memory pointer's lifetime scope handle.
 DO NOT `free`, will be freed with given `func`, when scope smart pointer panics/returns/exits. */
 C_API void *malloc_full(memory_t *scope, size_t size, func_t func);
@@ -270,6 +866,18 @@ DO NOT `free`, will be freed when scope smart pointer panics/returns/exits. */
 C_API void *calloc_by(memory_t *scope, int count, size_t size);
 C_API void *calloc_arena(memory_t *scope, int count, size_t size);
 
+/* Limit bytes `scope` and scopes created within it, while it's current `guard`,
+may request by `malloc_*`/`calloc_*`, `0` removes any limit. Going over throws
+`out_of_memory`, through the normal unwind path. Child scopes must end before `scope`. */
+C_API void raii_budget(memory_t *scope, size_t bytes);
+
+/* Returns bytes held against `scope` budget, by it and child scopes. */
+C_API size_t raii_budget_used(memory_t *scope);
+
+/* Used by `guard` sections, `scope` without budget joins `parent` one,
+enclosing `guard` scope, or current `thread` scope if `NULL`. */
+C_API void raii_budget_inherit(memory_t *scope, memory_t *parent);
+
 /* Same as `raii_deferred_free`, but also destroy smart pointer. */
 C_API void raii_delete(memory_t *ptr);
 C_API void raii_delete_arena(memory_t *ptr);
@@ -287,8 +895,31 @@ C_API void raii_deferred_clean(void);
 /* Creates smart memory pointer, this object binds any additional requests to it's lifetime.
 for use with `malloc_*` `calloc_*` wrapper functions to request/return raw memory. */
 C_API unique_t *unique_init(void);
+
+/* Same as `unique_init`, with it's own `arena`, `malloc_by`/`calloc_by`
+bump allocate from, all released at once by `raii_delete`. */
 C_API unique_t *unique_init_arena(void);
 
+/* Same as `unique_init`, owning an rpmalloc first class heap, `malloc_by`/`calloc_by`
+allocate from, all released at once by `raii_delete`. Heap must only be used by creating
+`thread`. Without `RPMALLOC_FIRST_CLASS_HEAPS` same as `unique_init_arena`. */
+C_API unique_t *unique_init_heap(void);
+
+/* Same as `unique_init`, but released by `parent`, `LIFO` along with it's other
+deferred functions, when `parent` exits or unwinds, so whole tree goes with root,
+each scope in `O(1)`. A child is released at it's place in `parent` order, not before
+entries `parent` registered later. A child deleted first detaches itself from `parent`. */
+C_API unique_t *unique_child(memory_t *parent);
+
+/* Same as `unique_child`, `malloc_by`/`calloc_by` bump allocate from `parent` arena,
+rewound on child exit to where it was at creation, so `parent` must not allocate
+from it while child lives. A `parent` without arena gives child an own one. */
+C_API unique_t *unique_child_arena(memory_t *parent);
+
+/* Initialize scope within given `frame`, no allocation takes place,
+until more than `RAII_DEFER_INLINE` deferred functions are registered. */
+C_API unique_t *unique_local(unique_frame_t *frame);
+
 /* Request/return raw memory of given `size`,
 uses current `thread` smart pointer,
 DO NOT `free`, will be `RAII_FREE`
@@ -319,6 +950,11 @@ C_API bool is_guard(void *self);
 C_API bool is_exception_emulated(ex_context_t *);
 C_API bool is_protection_emulated(ex_ptr_t *);
 C_API bool is_scope_emulated(memory_t *);
+#ifdef RAII_NO_EMULATED
+    #define is_exception_emulated(storage)  ((void)(storage), false)
+    #define is_protection_emulated(storage) ((void)(storage), false)
+    #define is_scope_emulated(storage)      ((void)(storage), false)
+#endif
 
 C_API void *try_calloc(int, size_t);
 C_API void *try_malloc(size_t);
@@ -338,17 +974,26 @@ C_API void guard_delete(memory_t *ptr);
 
 #define NONE
 
-/* Returns protected raw memory pointer,
+/* Returns protected raw memory pointer, from scope's `arena` within `guard_arena`,
 DO NOT FREE, will `throw/panic` if memory request fails. */
-#define _malloc(size)           malloc_full(_$##__FUNCTION__, size, RAII_FREE)
+#define _malloc(size)           malloc_by(_$##__FUNCTION__, size)
 
-/* Returns protected raw memory pointer,
+/* Returns protected raw memory pointer, from scope's `arena` within `guard_arena`,
 DO NOT FREE, will `throw/panic` if memory request fails. */
-#define _calloc(count, size)    calloc_full(_$##__FUNCTION__, count, size, RAII_FREE)
+#define _calloc(count, size)    calloc_by(_$##__FUNCTION__, count, size)
 
 /* Defer execution `LIFO` of given function with argument,
 execution begins when current `guard` scope exits or panic/throw. */
 #define _defer(func, ptr)       raii_recover_by(_$##__FUNCTION__, (func_t)func, ptr)
+#define _defer_many(func, array, n)  raii_deferred_many(_$##__FUNCTION__, (func_t)func, (void **)array, n)
+
+/* Mark `arena`, allocations made after, are released
+when current `guard` scope exits or panic/throw. */
+#define _arena_mark(arena)      arena_rewind_by(_$##__FUNCTION__, arena)
+
+/* Limit bytes current `guard` scope, and `guard`s nested within, may request,
+going over throws `out_of_memory`. */
+#define _budget(bytes)          raii_budget(_$##__FUNCTION__, bytes)
 
 /* Compare `err` to scoped error condition, will mark exception handled, if `true`. */
 #define _recover(err)   raii_is_caught(raii_init()->arena, err)
@@ -369,7 +1014,8 @@ throws an exception of given message. */
 #define _assign_ptr(scope)      unique_t *scope = _$##__FUNCTION__
 
 /* Exit `guarded` section, begin executing deferred functions,
-return given `value` when done, use `NONE` for no return. */
+return given `value` when done, use `NONE` for no return.
+`value` is evaluated after, it must not read anything scope released. */
 #define _return(value)              \
     raii_delete(_$##__FUNCTION__);  \
     guard_reset(s##__FUNCTION__, sf##__FUNCTION__, uf##__FUNCTION__);   \
@@ -378,26 +1024,60 @@ return given `value` when done, use `NONE` for no return. */
         ex_update(ex_err.next);     \
     return value;
 
-/* Creates an scoped guard section, it replaces `{`.
-Usage of: `_defer`, `_malloc`, `_calloc`, `_assign_ptr` macros
-are only valid between these sections.
-    - Use `_return(x);` macro, or `break;` to exit early.
-    - Use `_assign_ptr(var)` macro, to make assignment of block scoped smart pointer. */
-#define guard                                           \
-{                                                       \
-    if (!exception_signal_set)                          \
-        ex_signal_setup();                              \
+/* Exit `guarded` section if `result` is an error, executing deferred functions,
+then return `result`, see `ex_result_t`. */
+#define _propagate(result)                  \
+    do {                                    \
+        ex_result_t ex_res_ = (result);     \
+        if (!ex_is_ok(ex_res_)) {           \
+            _return(ex_res_);               \
+        }                                   \
+    } while (0)
+
+/* Setup given `scope` as current guarded section, internal use by `guard` macros. */
+#define guard_begin(scope)                              \
+    EX_SIGNAL_SETUP();                                  \
     void *s##__FUNCTION__ = raii_init()->arena;         \
     ex_setup_func sf##__FUNCTION__ = exception_setup_func;      \
     ex_unwind_func uf##__FUNCTION__ = exception_unwind_func;    \
     exception_unwind_func = (ex_unwind_func)raii_deferred_free; \
     exception_setup_func = guard_set;                   \
-    unique_t *_$##__FUNCTION__ = unique_init();         \
+    unique_t *_$##__FUNCTION__ = scope;                 \
     (_$##__FUNCTION__)->status = RAII_GUARDED_STATUS;   \
+    raii_budget_inherit(_$##__FUNCTION__, (memory_t *)s##__FUNCTION__); \
     raii_init()->arena = (void *)_$##__FUNCTION__;      \
     ex_try {                                            \
         do {
 
+/* Creates an scoped guard section, it replaces `{`.
+Usage of: `_defer`, `_malloc`, `_calloc`, `_assign_ptr` macros
+are only valid between these sections.
+    - Use `_return(x);` macro, or `break;` to exit early.
+    - Use `_assign_ptr(var)` macro, to make assignment of block scoped smart pointer. */
+#define guard                                           \
+{                                                       \
+    guard_begin(unique_init())
+
+/* Same as `guard`, but scope lives in callers `stack` frame,
+avoiding any heap allocation for small guarded sections.
+Ends with `unguarded(result)` or `guarded`, same macros also valid. */
+#define guard_local                                     \
+{                                                       \
+    unique_frame_t l$##__FUNCTION__;                    \
+    guard_begin(unique_local(&l$##__FUNCTION__))
+
+/* Same as `guard`, but guards given `scope`, owned by caller,
+as worker threads do with their own reused scope. */
+#define guard_by(scope)                                 \
+{                                                       \
+    guard_begin(scope)
+
+/* Same as `guard`, but `_malloc`/`_calloc` bump allocate from scope's own `arena`,
+no per allocation `defer`, whole `arena` is released once on scope exit. */
+#define guard_arena                                     \
+{                                                       \
+    guard_begin(unique_init_arena())
+
     /* This ends an scoped guard section, it replaces `}`.
     On exit will begin executing deferred functions,
     return given `result` when done, use `NONE` for no return. */
@@ -457,25 +1137,100 @@ are only valid between these sections.
 
 #define time_spec(sec, nsec) &(struct timespec){ .tv_sec = sec ,.tv_nsec = nsec }
 
+/* Absolute `TIME_UTC` deadline `ms` milliseconds from now, for `cnd_timedwait`. */
+C_API struct timespec time_deadline(unsigned int ms);
+
+/* Check if `TIME_UTC` clock has passed `deadline`. */
+C_API bool time_expired(const struct timespec *deadline);
+
+#ifndef emulate_tls
 thrd_local_create(memory_t, raii)
 thrd_local_create(ex_context_t, except)
-thread_storage_create(ex_context_t, local_except)
+#endif
+
+/* Emulated `thrd_init` exception context, pointer slot of `raii_tls` block,
+`local_except_tls` non zero while set up. */
+C_API int local_except_tls;
+C_API raii_tls_t local_except_key;
+C_API ex_context_t *local_except(void);
+C_API void local_except_delete(void);
+
+/* Released arena chunks are first kept in a per `thread` cache, up to arena's
+`threshold` count, then in lock-free process wide stacks, one per size class,
+of this many chunks in all, at most `65535`, `0` disables. Smallest chunk that fits
+is reused, never one over twice size arena would grow a new one. */
+#ifndef ARENA_OVERFLOW_MAX
+    #define ARENA_OVERFLOW_MAX 64
+#endif
+
+/* Largest chunk size an arena grows to, doubling from initial `arena_init` size. */
+#ifndef ARENA_CHUNK_MAX
+    #define ARENA_CHUNK_MAX Mb(1)
+#endif
+
+/* Recycled regions `arena_calloc` clears at least this large, use non-temporal stores,
+sparing cache for memory not read back right away. */
+#ifndef ARENA_ZERO_STREAM
+    #define ARENA_ZERO_STREAM Kb(256)
+#endif
+
+/* Requests at least this large, not fitting current chunk, get own pages straight from
+system, kept apart from chunks, returned to system by `arena_clear`, see `arena_direct`. */
+#ifndef ARENA_DIRECT
+    #define ARENA_DIRECT Kb(256)
+#endif
 
 typedef struct arena_s *arena_t;
 struct arena_s {
     raii_type type;
+    bool is_global;
     arena_t next;
     char *avail;
     char *limit;
     void *base;
-    bool is_global;
-    size_t threshold;
+    /* `[MAX(zeroed, avail), limit)` known to hold only zeros, `arena_calloc` skips clearing it */
+    char *zeroed;
+    unsigned int threshold;
+    /* `arena_direct` size, `0` disabled */
+    unsigned int direct;
     size_t bytes;
     size_t total;
+    /* size of the next new chunk */
+    unsigned int chunk;
+    /* chunk growth limit */
+    unsigned int max;
+    /* pages mapped for requests past `direct`, newest first */
+    void *mapped;
+    /* `RAII_STATS` counters, all fields must fit chunk header */
+    size_t requested;
+    size_t peak;
+    size_t hits;
+    size_t misses;
+    /* `arena_budget` limit of `total`, `0` unlimited */
+    size_t budget;
 };
 
-/* Allocates, initializes, a new arena, `size` is allocation threshold.
-Default `0` = `10` = `10kb` additional added onto `arena_alloc` requests. */
+/* Arena statistics, see `arena_stats`, only counted when `RAII_STATS` defined. */
+typedef struct {
+    /* bytes handed out */
+    size_t requested;
+    /* bytes held in chunks */
+    size_t reserved;
+    /* high-water mark of `reserved` */
+    size_t peak;
+    /* chunks held */
+    size_t chunks;
+    /* chunks reused from `thread` cache or overflow stack */
+    size_t hits;
+    /* chunks newly allocated */
+    size_t misses;
+    /* bytes in pages mapped for `arena_direct` sized requests, counted always */
+    size_t mapped;
+} arena_stats_t;
+
+/* Allocates, initializes, a new arena, `size` is first chunk size in `kb`,
+each additional chunk doubles, up to `ARENA_CHUNK_MAX`.
+Default `0` = `10` = `10kb`, also number of chunks a `thread` keeps for reuse. */
 C_API arena_t arena_init(size_t);
 
 /* Deallocates all of the space in arena, deallocates the arena itself, and
@@ -486,6 +1241,19 @@ C_API void arena_free(arena_t arena);
 The bytes are uninitialized. Will `Panic` if allocation fails. */
 C_API void *arena_alloc(arena_t arena, long nbytes);
 
+/* Same as `arena_alloc`, but past `arena_budget` returns `NULL` instead of
+throwing, for callers holding a lock, which throw once released. */
+C_API void *arena_take(arena_t arena, long nbytes);
+
+/* Same as `arena_alloc`, but returned pointer is a multiple of `align`,
+must be a power of two, `16`, `32`, `64` cache line, up to page size `4096`. */
+C_API void *arena_alloc_aligned(arena_t arena, long nbytes, size_t align);
+
+/* Resize `ptr` block of `old_size` to `new_size` bytes, in place when `ptr`
+is arena's last allocation and current chunk has room, otherwise copied to new space.
+The bytes past `old_size` are uninitialized. Will `Panic` if allocation fails. */
+C_API void *arena_realloc(arena_t arena, void *ptr, long old_size, long new_size);
+
 /* Allocates space in arena for an array of count elements, each occupying nbytes,
 and returns a pointer to the first element.
 The bytes are initialized to zero. Will `Panic` if allocation fails. */
@@ -495,19 +1263,1097 @@ C_API void *arena_calloc(arena_t arena, long count, long nbytes);
 the last call to `arena_clear`. */
 C_API void arena_clear(arena_t arena);
 
+/* Same as `arena_clear`, but arena's largest chunk, newest of equal ones, stays attached,
+empty, only others are released, so an arena cleared each request, or task,
+reuses same warm memory, instead of whichever chunk `thread` cache holds. */
+C_API void arena_reset(arena_t arena);
+
+/* Arena position, for `arena_rewind`. */
+typedef struct {
+    arena_t chunk;
+    char *avail;
+    size_t bytes;
+    void *mapped;
+} arena_mark_t;
+
+/* Returns current position in arena, a savepoint. */
+C_API arena_mark_t arena_mark(arena_t arena);
+
+/* Deallocates all of the space in arena allocated since `mark` was taken,
+unmapping `arena_direct` pages too, keeping everything before it.
+A `mark` taken before `arena_clear` is no longer valid. */
+C_API void arena_rewind(arena_t arena, arena_mark_t mark);
+
+/* Marks `arena` now, allocations made after, are released in `O(1)`
+when `scope` smart pointer panics/returns/exits. */
+C_API void arena_rewind_by(memory_t *scope, arena_t arena);
+
+/* Limit bytes `arena` may hold in chunks, `0` unlimited,
+growing past throws `out_of_memory`. */
+C_API void arena_budget(arena_t arena, size_t bytes);
+
+/* Requests of at least `bytes`, `ARENA_DIRECT` by default, `0` never, when current chunk
+has no room, are mapped on their own pages, instead of growing a chunk that is recycled
+at that size. Pages come zeroed, count against `arena_budget`, and are unmapped
+by `arena_clear`, `arena_rewind` and `arena_free`. */
+C_API void arena_direct(arena_t arena, size_t bytes);
+
 C_API size_t arena_capacity(const arena_t arena);
 C_API size_t arena_total(const arena_t arena);
 C_API void arena_print(const arena_t arena);
 
-C_API tss_t thrd_arena_tss;
+/* Returns `arena` statistics. */
+C_API arena_stats_t arena_stats(const arena_t arena);
+
+/* Current `thread` arenas only reuse chunks it released itself, never from,
+or into, process wide overflow stack, keeping pinned workers memory node local. */
+C_API void arena_thread_bind(void);
+
+/* Returns current `thread` totals, of all arenas, chunk level only, `requested` is always `0`. */
+C_API arena_stats_t arena_thread_stats(void);
+
+#if defined(__GNUC__) || defined(__clang__) || defined(__TINYC__)
+#   define RAII_ALIGNOF(type) __alignof__(type)
+#elif defined(_MSC_VER)
+#   define RAII_ALIGNOF(type) __alignof(type)
+#else
+#   define RAII_ALIGNOF(type) offsetof(struct { char c; type member; }, member)
+#endif
+
+/* Allocates `count` uninitialized elements of `type` in arena,
+aligned for `type`, returns typed pointer. */
+#define arena_new(arena, type, count) \
+    ((type *)arena_alloc_aligned(arena, (long)(sizeof(type) * (count)), RAII_ALIGNOF(type)))
+
+/* Inlined bump-pointer fast path of `arena_alloc`, a compare and add,
+only calls out when current chunk is exhausted. `arena` must not be `NULL`. */
+static RAII_INLINE void *arena_bump(arena_t arena, size_t nbytes) {
+    nbytes = align_up(nbytes, sizeof(u16));
+    if (LIKELY(nbytes <= (size_t)(arena->limit - arena->avail))) {
+        RAII_STAT(arena->requested += nbytes);
+        RAII_UNPOISON(arena->avail, nbytes);
+        arena->bytes = nbytes;
+        arena->avail += nbytes;
+        return arena->avail - nbytes;
+    }
+
+    return arena_alloc(arena, (long)nbytes);
+}
+
+/* Number of process wide arenas `thrd_alloc` spreads threads over,
+each with it's own lock, threads are assigned round-robin on first use. */
+#ifndef THRD_ARENA_SHARDS
+    #define THRD_ARENA_SHARDS 16
+#endif
+
 C_API void thrd_init(void);
+
+/* rpmalloc settings, for `raii_config`, zero fields keep defaults. */
+typedef struct {
+    /* map large/huge pages, if available */
+    bool huge_pages;
+    /* spans to map at each virtual memory request */
+    size_t span_map_count;
+    /* names of mapped, and huge mapped regions, where supported */
+    const char *page_name;
+    const char *huge_page_name;
+} raii_config_t;
+
+/* Initialize rpmalloc with given `config`, must be called before any other
+library function, or allocation, on any `thread`. Returns `RAII_OK` on success,
+`RAII_ERR` if rpmalloc was already initialized, or `config` could not be applied
+as given, like huge pages not available. */
+C_API int raii_config(const raii_config_t *config);
 C_API void thrd_defer(func_t, void *);
 C_API void *thrd_unique(size_t);
 C_API void *thrd_get(void);
+
+/* Returns memory from current `thread` assigned global arena shard,
+released at program exit, DO NOT FREE. */
 C_API void *thrd_alloc(size_t);
 C_API void *thrd_malloc(size_t);
 C_API unique_t *thrd_scope(void);
 
+/* Returns one of current `thread` two scratch arenas, the one not `conflict`,
+created on first use, freed at `thread` exit. Pass arena a result is built in,
+or `NULL`, so temporaries never land in, and get rewound out of, that result. */
+C_API arena_t thrd_scratch(arena_t conflict);
+
+/* Same as `thrd_scratch`, but marked, and rewound when `scope` exits or unwinds,
+an `O(1)` reset without freeing any chunk. */
+C_API arena_t thrd_scratch_by(memory_t *scope, arena_t conflict);
+#define _scratch(conflict) thrd_scratch_by(_$##__FUNCTION__, conflict)
+
+/* Slots in each worker's own task deque, must be power of `2`,
+tasks beyond are queued on pool's shared, unbounded, injection queue. */
+#ifndef WORKERS_DEQUE
+    #define WORKERS_DEQUE 1024
+#endif
+
+/* Slots of `workers_stats` latency histograms, slot `i` counts durations
+below `2^(i + 1)` nanoseconds, last slot everything longer. */
+#ifndef WORKERS_LATENCY_BUCKETS
+    #define WORKERS_LATENCY_BUCKETS 32
+#endif
+
+/* Work-stealing thread pool, an `Chase-Lev` deque per worker,
+idle workers steal from random victims. */
+typedef struct workers_s workers_t;
+
+/* Creates pool of `count` worker threads, `0` for number of cpu cores. */
+C_API workers_t *workers_create(int count);
+
+/* Worker placement, for `workers_create_by`. */
+typedef struct {
+    /* worker threads, `0` for one per CPU in `cpus`, or per cpu core */
+    int count;
+    /* CPU ids workers are restricted to, `NULL` for no placement */
+    const int *cpus;
+    int cpu_count;
+    /* pin each worker to one CPU of `cpus` round-robin, otherwise whole set */
+    bool pin_each;
+    /* elastic pool when above `count`, which is then minimum kept: another worker starts
+    while all are busy and more tasks are queued than workers, up to `max` */
+    int max;
+    /* elastic pool workers above `count` idle this many milliseconds retire,
+    releasing their `thread` scope, arena and caches, `0` never */
+    unsigned int idle_ms;
+} workers_config_t;
+
+/* Creates pool as configured, each worker applies it's affinity before
+creating it's own scope `arena`, so first touched pages are node local. */
+C_API workers_t *workers_create_by(const workers_config_t *config);
+
+/* Returns one past highest online NUMA node id, `1` when topology is unknown,
+ids in between may have no CPUs, `workers_numa_cpus` returns `0` for them. */
+C_API int workers_numa_nodes(void);
+
+/* Store up to `max` CPU ids of NUMA `node` into `cpus`, returns total found,
+pass `NULL` and `0` to only count. */
+C_API int workers_numa_cpus(int node, int *cpus, int max);
+
+/* Creates one pool per NUMA node, up to `max`, workers restricted to node's CPUs,
+returns number of pools stored into `pools`. */
+C_API int workers_create_numa(workers_t **pools, int max);
+
+/* Queue `func(arg)`, each task runs inside own guarded scope on it's worker,
+uncaught exceptions end only that task. From within a task of same pool,
+pushes to current worker's deque. Returns `0`, or `pool_shutdown`. */
+C_API int workers_submit(workers_t *pool, func_t func, void *arg);
+
+/* Queue `func(args[i])` for each of `count` arguments, with one lock acquisition,
+and one wakeup of idle workers, same rules as `workers_submit`. */
+C_API int workers_submit_batch(workers_t *pool, func_t func, void **args, size_t count);
+
+/* Range function of `workers_for`, called with `[begin, end)` sub range. */
+typedef void (*workers_for_func)(size_t begin, size_t end, void *arg);
+
+/* Split `[begin, end)` into `grain` sized sub ranges, `0` picks an grain per worker,
+run `fn` on each in `pool`, returns once all done. First exception any sub range raised,
+is rethrown. From within `pool` tasks, current worker also runs sub ranges. */
+C_API void workers_for(workers_t *pool, size_t begin, size_t end, size_t grain, workers_for_func fn, void *arg);
+
+/* Tasks spawned together into `pool`, joined when owning `scope` exits, type `RAII_GROUP`.
+First exception any task raises is kept, and cancels it's siblings:
+queued ones never start, running ones get `task_cancelled` at next `workers_checkpoint`. */
+typedef struct workers_group_s workers_group_t;
+
+/* Creates group joined by `scope` on exit, waiting for all it's tasks, then rethrowing
+first exception they raised, unless `scope` already unwinds, then tasks are cancelled instead. */
+C_API workers_group_t *group_create(memory_t *scope, workers_t *pool);
+#define _group(pool) group_create(_$##__FUNCTION__, pool)
+
+/* Run `fn(arg)` on group's pool, returns `0`, or `pool_shutdown`,
+tasks spawned after group is cancelled never run. */
+C_API int group_spawn(workers_group_t *group, func_t fn, void *arg);
+
+/* Stop group's tasks not yet finished, as first exception does. */
+C_API void group_cancel(workers_group_t *group);
+
+/* Wait for all tasks spawned so far, rethrowing first exception any raised.
+From within `pool` tasks, runs other pending tasks while waiting. */
+C_API void group_wait(workers_group_t *group);
+
+/* Block until all submitted tasks finished, must not be called from pool's own tasks. */
+C_API void workers_wait(workers_t *pool);
+
+/* Finish all submitted tasks, then stop and free pool. */
+C_API void workers_destroy(workers_t *pool);
+
+/* Returns pool of current `thread`, if it's one of it's workers, otherwise `NULL`. */
+C_API workers_t *workers_current(void);
+
+/* Defer `func(arg)` to end of current pool task, runs when task returns or panics. */
+C_API size_t workers_defer(func_t func, void *arg);
+
+/* Returns scope of pool task now running on current `thread`, otherwise `NULL`.
+Outermost task on each worker shares one persistent scope, it's `arena` is cleared
+between tasks, `thrd_scope` returns this scope while inside tasks. */
+C_API unique_t *workers_scope(void);
+
+/* Returns number of worker threads in `pool`, now running for elastic pools. */
+C_API int workers_count(workers_t *pool);
+
+/* Pool wide snapshot, see `workers_stats`. */
+typedef struct {
+    int count;
+    /* tasks queued, not yet started, and highest ever seen */
+    size_t queued;
+    size_t peak;
+    size_t submitted;
+    size_t completed;
+    /* submits refused, pool shutdown or invalid task */
+    size_t rejected;
+    /* submit to start, and start to finish, histograms */
+    size_t wait_ns[WORKERS_LATENCY_BUCKETS];
+    size_t run_ns[WORKERS_LATENCY_BUCKETS];
+} workers_stats_t;
+
+typedef struct {
+    size_t completed;
+    size_t busy_ns;
+    size_t idle_ns;
+} workers_worker_stats_t;
+
+/* Sum per worker counters of `pool` into `stats`, and copy up to `max` of them
+into `workers`, when not `NULL`. Always counted, returns number of `workers` copied. */
+C_API int workers_stats(workers_t *pool, workers_stats_t *stats, workers_worker_stats_t *workers, int max);
+
+/* Returns upper bound, in nanoseconds, of `percent` of `histogram` entries,
+as in `workers_percentile(stats.wait_ns, 99)`, `0` if histogram empty. */
+C_API size_t workers_percentile(const size_t *histogram, double percent);
+
+/* Run one pending task of `pool` on current `thread`, if it's one of `pool` workers,
+returns `false` if nothing was run. For waiting inside tasks, without blocking whole worker. */
+C_API bool workers_yield(workers_t *pool);
+
+/* Result of an `thrd_async` task, type `RAII_FUTURE`. */
+typedef struct future_s future_t;
+
+/* Run `fn(args)` on `pool`, returns future of it's result, `args` not released,
+exceptions thrown by `fn` are captured, and rethrown by `future_get`. */
+C_API future_t *thrd_async(workers_t *pool, raii_func_t fn, args_t *args);
+
+/* Same as `thrd_async`, but task is cancelled once `ms` milliseconds passed since
+submit, see `workers_checkpoint`, never started if already expired when taken. */
+C_API future_t *thrd_async_for(workers_t *pool, raii_func_t fn, args_t *args, unsigned int ms);
+
+/* Request cancellation of `future` task, a queued task is never started,
+a running one gets `task_cancelled` at it's next `workers_checkpoint`.
+Returns `false` if already finished. */
+C_API bool future_cancel(future_t *future);
+
+/* Throws `task_cancelled` if current `thrd_async` task is cancelled, or past it's deadline,
+unwinding through task's `guard`/`_defer` cleanup, to be rethrown by `future_get`.
+Also fires expired `timer_add` timers of worker, `timer_timeout` ones throwing `timeout_error`. */
+C_API void workers_checkpoint(void);
+
+/* Check, without throwing, if current `thrd_async` task is cancelled, or past deadline. */
+C_API bool workers_cancelled(void);
+
+/* Wait for result, rethrowing any exception task raised, releases `future`.
+From within `pool` tasks, runs other pending tasks while waiting. */
+C_API void *future_get(future_t *future);
+
+/* Wait at most `ms` milliseconds, returns `true` if result is ready. */
+C_API bool future_wait_for(future_t *future, unsigned int ms);
+
+/* Check if result is ready, without waiting. */
+C_API bool future_is_ready(future_t *future);
+
+/* Wait for task, then release `future`, discarding result and any exception. */
+C_API void future_free(future_t *future);
+
+/* Stack size of each coroutine, when none given to `routine_create`. */
+#ifndef ROUTINE_STACK
+    #define ROUTINE_STACK (64 * 1024)
+#endif
+
+/* Stackful coroutine, type `RAII_ROUTINE`, it has own defer scope and exception chain,
+`defer`, `guard` and `try` sections remain valid across `routine_yield`. */
+typedef struct routine_s routine_t;
+
+/* Per `thread` coroutine scheduler, type `RAII_SCHED`, created on first use. */
+typedef struct sched_s sched_t;
+
+/* Create coroutine running `fn(arg)` on current `thread` scheduler, `stack_size` of `0`
+uses `ROUTINE_STACK`, under an guard page. Must be either `routine_join` or `routine_detach`. */
+C_API routine_t *routine_create(raii_func_t fn, void *arg, size_t stack_size);
+#define routine_go(fn, arg) routine_create((raii_func_t)(fn), (void *)(arg), 0)
+
+/* Wait for `co` to finish, rethrowing any exception it raised, releases `co`.
+From within a coroutine of same scheduler suspends only caller, otherwise runs
+scheduler until done, and `co` of another `thread` scheduler blocks caller `thread`. */
+C_API void *routine_join(routine_t *co);
+
+/* Release `co` when it finishes, any exception it raises is discarded. */
+C_API void routine_detach(routine_t *co);
+
+/* Switch to next ready coroutine, caller placed at end of ready queue.
+Returns `false` if not called from a coroutine. */
+C_API bool routine_yield(void);
+
+/* Suspend current coroutine, until another call `routine_resume` on it. */
+C_API void routine_suspend(void);
+
+/* Place suspended `co` back on it's scheduler ready queue,
+only valid from `thread` of it's scheduler. */
+C_API void routine_resume(routine_t *co);
+
+/* Same as `routine_resume`, from any `thread`, `co` may still be running,
+then it's scheduler queues it once it has suspended. */
+C_API void routine_wake(routine_t *co);
+
+/* Returns coroutine now running on current `thread`, otherwise `NULL`. */
+C_API routine_t *routine_current(void);
+
+/* Returns current `thread` scheduler, creating it on first call. */
+C_API sched_t *sched_init(void);
+
+/* Run ready coroutines of current `thread` until none are left ready. */
+C_API void sched_run(void);
+
+/* Returns number of unfinished coroutines on current `thread` scheduler. */
+C_API size_t sched_count(void);
+
+/* Release current `thread` scheduler, all coroutines must be finished. */
+C_API void sched_free(void);
+
+/* Set `waker(arg)` called by `routine_wake` from other `thread`s, for a `thread`
+waiting elsewhere than it's scheduler, as pool workers do. */
+C_API void sched_waker(void (*waker)(void *), void *arg);
+
+/* Queue task on `pool` running `fn(arg)` as detached coroutine, under scheduler
+of worker `thread` that takes it, returns as `workers_submit`. It counts as
+unfinished for `workers_wait` till it returns. */
+C_API int workers_go(workers_t *pool, raii_func_t fn, void *arg);
+
+/* Bounded MPMC message channel, type `RAII_CHANNEL`, a lock-free ring buffer,
+blocking calls wait on condition variable, or park when inside a coroutine,
+timed ones of a coroutine yield between attempts. */
+typedef struct channel_s channel_t;
+
+/* Create channel holding up to `capacity` messages, rounded up to power of `2`, at least `2`. */
+C_API channel_t *channel_create(size_t capacity);
+
+/* Same as `channel_create`, but closed and released when `scope` exits or unwinds. */
+C_API channel_t *channel_by(memory_t *scope, size_t capacity);
+#define _channel(capacity) channel_by(_$##__FUNCTION__, capacity)
+
+/* Refuse further sends, wakes all blocked, receivers still drain queued messages. */
+C_API void channel_close(channel_t *ch);
+C_API bool channel_is_closed(channel_t *ch);
+
+/* Close, wait for blocked callers to leave, then release `ch`. */
+C_API void channel_free(channel_t *ch);
+
+/* Send `value`, waiting while full, returns `false` if channel closed. */
+C_API bool channel_send(channel_t *ch, void *value);
+
+/* Send `value` only if there is room now, and channel is open. */
+C_API bool channel_try_send(channel_t *ch, void *value);
+
+/* Same as `channel_send`, giving up after `ms` milliseconds. */
+C_API bool channel_send_for(channel_t *ch, void *value, unsigned int ms);
+
+/* Receive into `value`, waiting while empty, returns `false` once closed and drained. */
+C_API bool channel_recv(channel_t *ch, void **value);
+
+/* Receive into `value` only if message is queued now. */
+C_API bool channel_try_recv(channel_t *ch, void **value);
+
+/* Same as `channel_recv`, giving up after `ms` milliseconds. */
+C_API bool channel_recv_for(channel_t *ch, void **value, unsigned int ms);
+
+/* Fixed size object pool, type `RAII_OBJ`, recycles objects in `O(1)` by an
+intrusive free list, backing chunks of `per_chunk` objects each, all released
+at once with pool. Only creating `thread` takes objects, any `thread` may return them,
+those are queued lock-free, then taken over by owner once it's own list runs dry. */
+typedef struct object_pool_s object_pool_t;
+
+/* Create pool of `size` byte objects, released when `scope` exits or unwinds,
+`scope` may be `NULL` for caller to `pool_free` it, `per_chunk` `0` for `64`. */
+C_API object_pool_t *pool_create(memory_t *scope, size_t size, size_t per_chunk);
+#define pool_of(scope, type, per_chunk) pool_create(scope, sizeof(type), per_chunk)
+#define _pool(type, per_chunk) pool_of(_$##__FUNCTION__, type, per_chunk)
+
+/* Release pool and all of it's chunks, objects still out becomes invalid. */
+C_API void pool_free(object_pool_t *pool);
+
+/* Returns uninitialized object, recycled if any returned, Will `Panic` if allocation fails,
+or called from another `thread` then pool's owner. */
+C_API void *pool_get(object_pool_t *pool);
+#define pool_new(pool, type) ((type *)pool_get(pool))
+
+/* Return `ptr` object taken from `pool`, for reuse. */
+C_API void pool_put(object_pool_t *pool, void *ptr);
+
+/* Number of objects `pool` chunks hold, in use or not. */
+C_API size_t pool_capacity(object_pool_t *pool);
+
+/* Open addressing hash map, type `RAII_OA_HASH`, `SwissTable` style: control bytes
+probed a group at a time, by `SSE2` when available. Keys are copied, `NUL` terminated,
+into map's arena, values are pointers, no allocation per entry. */
+typedef struct hash_s hash_t;
+
+/* Create map sized for `capacity` entries, growing as needed, released when `scope`
+exits or unwinds, `scope` may be `NULL` for caller to `hash_free` it. */
+C_API hash_t *hash_create(memory_t *scope, size_t capacity);
+
+/* Same as `hash_create`, but keys and tables come from `arena`, map goes with
+`arena_free`/`arena_clear` of it, only `hash_free` for map handle itself. */
+C_API hash_t *hash_create_arena(arena_t arena, size_t capacity);
+#define _hash(capacity) hash_create(_$##__FUNCTION__, capacity)
+
+C_API void hash_free(hash_t *map);
+
+/* Insert, or replace value of, `key` of `length` bytes. */
+C_API void hash_put(hash_t *map, const void *key, size_t length, void *value);
+
+/* Returns value of `key`, or `NULL` if none. */
+C_API void *hash_get(hash_t *map, const void *key, size_t length);
+C_API bool hash_has(hash_t *map, const void *key, size_t length);
+
+/* Remove `key`, returns `false` if none, it's key copy is kept till map freed. */
+C_API bool hash_remove(hash_t *map, const void *key, size_t length);
+C_API size_t hash_count(hash_t *map);
+
+/* Iterate entries, `cursor` starting at `0`, returns `false` when no more,
+any of `key`, `length`, `value` may be `NULL`. */
+C_API bool hash_next(hash_t *map, size_t *cursor, const char **key, size_t *length, void **value);
+
+/* Hash of `length` bytes at `key`, as map uses. */
+C_API uint64_t hash_bytes(const void *key, size_t length);
+
+#define hash_str_put(map, key, value)   hash_put(map, key, strlen(key), value)
+#define hash_str_get(map, key)          hash_get(map, key, strlen(key))
+#define hash_str_remove(map, key)       hash_remove(map, key, strlen(key))
+
+/* String builder, type `RAII_STRING`, always `NUL` terminated, capacity doubling. */
+typedef struct sb_s sb_t;
+
+/* Create builder of initial `capacity` characters, released when `scope` exits or unwinds,
+`scope` may be `NULL` for caller to `sb_free` it. Within `guard_arena` scopes,
+buffer comes from scope's `arena`, growing in place while it's last allocation. */
+C_API sb_t *sb_create(memory_t *scope, size_t capacity);
+#define _sb(capacity) sb_create(_$##__FUNCTION__, capacity)
+
+/* Same as `sb_create`, builder and buffer from `arena`, released along with it. */
+C_API sb_t *sb_arena(arena_t arena, size_t capacity);
+C_API void sb_free(sb_t *sb);
+
+C_API void sb_append(sb_t *sb, const char *str, size_t length);
+C_API void sb_puts(sb_t *sb, const char *str);
+C_API void sb_putc(sb_t *sb, char c);
+
+/* Append formatted, straight into buffer, returns characters appended, or `vsnprintf` error. */
+C_API int sb_printf(sb_t *sb, const char *fmt, ...);
+C_API int sb_vprintf(sb_t *sb, const char *fmt, va_list args);
+
+C_API const char *sb_str(sb_t *sb);
+C_API size_t sb_len(sb_t *sb);
+C_API void sb_truncate(sb_t *sb, size_t length);
+C_API void sb_clear(sb_t *sb);
+
+/* Take buffer without copy, caller then owns it, to `RAII_FREE`, unless builder
+is arena backed, builder restarts empty. */
+C_API char *sb_steal(sb_t *sb);
+
+/* Ordered map, type `RAII_MAP_STRUCT`, an red-black tree of `compat/sys/tree.h`,
+nodes recycled by map's own object pool, all released at once with map.
+Keys are not copied, they must outlive their entries. No locking, bound to creating
+`thread`, as it's pool, `map_put` from any other `thread` will `Panic`. */
+typedef struct map_s map_t;
+
+/* Key order, negative, `0` or positive, as `strcmp`. */
+typedef int (*map_cmp_func)(const void *, const void *);
+
+/* Range iterator, type `RAII_MAP_ITER`, see `map_next`. */
+typedef struct {
+    raii_type type;
+    map_t *map;
+    void *node;
+    const void *hi;
+    bool is_bounded;
+} map_iter_t;
+
+/* Create map ordered by `cmp`, `NULL` for keys that are `intptr_t` integers,
+released when `scope` exits or unwinds, `scope` may be `NULL` for caller to `map_free` it. */
+C_API map_t *map_create(memory_t *scope, map_cmp_func cmp);
+#define _map(cmp) map_create(_$##__FUNCTION__, cmp)
+C_API void map_free(map_t *map);
+
+/* String keys order, for `map_create`. */
+C_API int map_cmp_str(const void *a, const void *b);
+
+/* Insert, or replace value of, `key`, returns previous value, `NULL` if none. */
+C_API void *map_put(map_t *map, const void *key, void *value);
+C_API void *map_get(map_t *map, const void *key);
+C_API bool map_has(map_t *map, const void *key);
+
+/* Remove `key`, it's value copied into `value` if not `NULL`, returns `false` if none. */
+C_API bool map_remove(map_t *map, const void *key, void **value);
+
+/* Remove smallest entry, as timers expire, returns `false` if map empty. */
+C_API bool map_pop_first(map_t *map, const void **key, void **value);
+C_API size_t map_count(map_t *map);
+
+/* Iterate all entries in order. */
+C_API map_iter_t map_begin(map_t *map);
+
+/* Iterate entries from `lo` on, inclusive. */
+C_API map_iter_t map_from(map_t *map, const void *lo);
+
+/* Iterate entries from `lo` inclusive, up to `hi` exclusive. */
+C_API map_iter_t map_range(map_t *map, const void *lo, const void *hi);
+
+/* Next entry of `it`, returns `false` when no more, entry just returned may be removed. */
+C_API bool map_next(map_iter_t *it, const void **key, void **value);
+
+/* `raii_mmap` options, `RAII_MAP_READ` default, read-only private view. */
+enum {
+    RAII_MAP_READ = 0,
+    /* shared writable view, writes go to file */
+    RAII_MAP_WRITE = 1 << 0,
+    RAII_MAP_SEQUENTIAL = 1 << 1,
+    RAII_MAP_RANDOM = 1 << 2,
+    /* read ahead whole file, pre-faulted on Linux */
+    RAII_MAP_PREFETCH = 1 << 3,
+    /* transparent huge pages, where supported */
+    RAII_MAP_HUGE = 1 << 4
+};
+
+/* Memory mapped file view, type `RAII_MAP_VALUE`, `data` is `NULL` for empty file. */
+typedef struct {
+    raii_type type;
+    void *data;
+    size_t length;
+    int flags;
+} raii_map_t;
+
+/* Map whole file at `path`, unmapped when `scope` exits or unwinds, `scope` may be
+`NULL` for caller to `raii_munmap` it. Returns `NULL`, with `errno` set, on failure. */
+C_API raii_map_t *raii_mmap(memory_t *scope, const char *path, int flags);
+#define _mmap(path, flags) raii_mmap(_$##__FUNCTION__, path, flags)
+C_API void raii_munmap(raii_map_t *map);
+
+/* Arena over memory shared between processes, type `RAII_PROCESS`. Blocks are kept as
+offsets from region start, valid in every process whatever address each maps it at,
+bump allocated lock-free, and released only all at once with region. */
+typedef struct raii_process_s raii_process_t;
+
+/* Map `size` bytes shared region, creating it, or attaching when `name` already exists.
+`name` is `NULL` for anonymous region, inherited by `fork` children only, or like `/index`
+for one any process can attach. Unmapped when `scope` exits or unwinds, creator also
+removes `name`. `scope` may be `NULL` for caller to `process_arena_free` it.
+Returns `NULL`, with `errno` set, on failure. */
+C_API raii_process_t *process_arena(memory_t *scope, const char *name, size_t size);
+#define _process_arena(name, size) process_arena(_$##__FUNCTION__, name, size)
+C_API void process_arena_free(raii_process_t *arena);
+
+/* Zeroed block, 16 bytes aligned, safe to call from any `thread` of any process
+sharing `arena`. Returns `NULL`, with `errno` set to `ENOMEM`, when region is full. */
+C_API void *process_alloc(raii_process_t *arena, size_t size);
+
+/* Position of `ptr` in `arena`, `0` for `NULL`, store these inside shared structures. */
+C_API size_t process_offset(raii_process_t *arena, const void *ptr);
+
+/* This process address of `offset` in `arena`, `NULL` for `0`. */
+C_API void *process_ptr(raii_process_t *arena, size_t offset);
+
+/* Publish `root` of a structure built in `arena`, for other processes to `process_root`. */
+C_API void process_publish(raii_process_t *arena, const void *root);
+C_API void *process_root(raii_process_t *arena);
+
+/* Bytes of `arena` allocated so far, by all processes. */
+C_API size_t process_used(raii_process_t *arena);
+
+#if defined(_WIN32)
+    typedef uintptr_t raii_socket_t;
+    #define RAII_BAD_SOCKET (~(raii_socket_t)0)
+#else
+    typedef int raii_socket_t;
+    #define RAII_BAD_SOCKET (-1)
+#endif
+
+/* Bytes of each buffered reader/writer buffer. */
+#ifndef RAII_IO_BUFFER
+    #define RAII_IO_BUFFER 16384
+#endif
+
+/* Released buffers each `thread` keeps, for it's next reader/writer. */
+#ifndef RAII_IO_POOL
+    #define RAII_IO_POOL 8
+#endif
+
+/* Open file, as `open`, closed when `scope` exits or unwinds, `scope` may be `NULL`
+for caller to `raii_close` it. Returns `-1`, with `errno` set, on failure. */
+C_API int raii_open(memory_t *scope, const char *path, int flags, int mode);
+#define _file_open(path, flags, mode) raii_open(_$##__FUNCTION__, path, flags, mode)
+C_API int raii_close(int fd);
+
+/* Create socket, as `socket`, closed when `scope` exits or unwinds,
+returns `RAII_BAD_SOCKET` on failure. */
+C_API raii_socket_t raii_socket(memory_t *scope, int domain, int type, int protocol);
+C_API int raii_socket_close(raii_socket_t sock);
+
+/* Buffered reader or writer, over an descriptor or socket it does not own,
+buffer taken from calling `thread` pool, returned to it when released,
+along with `scope`, unwinding too, a writer's pending output is flushed then. */
+typedef struct raii_io_s raii_io_t;
+C_API raii_io_t *raii_reader(memory_t *scope, int fd);
+C_API raii_io_t *raii_writer(memory_t *scope, int fd);
+C_API raii_io_t *raii_socket_io(memory_t *scope, raii_socket_t sock, bool is_writer);
+C_API void raii_io_free(raii_io_t *io);
+
+/* Read up to `length` bytes, returns bytes read, `0` at end, `-1` on error. */
+C_API long raii_read(raii_io_t *io, void *buf, size_t length);
+
+/* Read up to and including `\n`, at most `size - 1` bytes, always `NUL` terminated,
+returns length, `0` at end, `-1` on error. */
+C_API long raii_read_line(raii_io_t *io, char *line, size_t size);
+
+/* Buffer `length` bytes, writing out once full, returns `length`, `-1` on error. */
+C_API long raii_write(raii_io_t *io, const void *buf, size_t length);
+C_API int raii_flush(raii_io_t *io);
+
+/* Asynchronous I/O queue, type `RAII_AIO`, over `io_uring` when built with `RAII_IO_URING`
+and kernel allows it, otherwise `poll` readiness then plain calls. Only for it's creating
+`thread`, operations complete, and handlers run, in `aio_run`/`aio_await`/`aio_loop`. */
+typedef struct aio_s aio_t;
+typedef struct aio_op_s aio_op_t;
+
+/* Completion handler, see `aio_result` and `aio_buffer`, it may `aio_op_free` it's `op`. */
+typedef void (*aio_func)(aio_op_t *op, void *data);
+
+/* Create queue of `depth` entries, at least `8`, released when `scope` exits or unwinds,
+`scope` may be `NULL` for caller to `aio_free` it. Operations still in flight are cancelled. */
+C_API aio_t *aio_create(memory_t *scope, unsigned int depth);
+#define _aio(depth) aio_create(_$##__FUNCTION__, depth)
+C_API void aio_free(aio_t *aio);
+
+/* Read up to `length` bytes of `fd` at `offset`, `-1` for current position, into
+buffer operation owns. Operation released when `scope` exits or unwinds, cancelled
+first if in flight, `scope` may be `NULL` for caller to `aio_op_free` it. */
+C_API aio_op_t *aio_read(memory_t *scope, aio_t *aio, int fd, size_t length, long long offset, aio_func done, void *data);
+#define _aio_read(aio, fd, length, offset) aio_read(_$##__FUNCTION__, aio, fd, length, offset, NULL, NULL)
+
+/* Same as `aio_read`, writing copy of `buf`. */
+C_API aio_op_t *aio_write(memory_t *scope, aio_t *aio, int fd, const void *buf, size_t length, long long offset, aio_func done, void *data);
+#define _aio_write(aio, fd, buf, length, offset) aio_write(_$##__FUNCTION__, aio, fd, buf, length, offset, NULL, NULL)
+
+/* Accept connection on listening `sock`, result is new socket. */
+C_API aio_op_t *aio_accept(memory_t *scope, aio_t *aio, raii_socket_t sock, aio_func done, void *data);
+C_API void aio_op_free(aio_op_t *op);
+
+/* Request cancellation, completes with `-ECANCELED` unless already finishing,
+returns `false` if no longer in flight. */
+C_API bool aio_cancel(aio_op_t *op);
+
+/* Deliver completions, waiting up to `ms` if none, `-1` forever, returns number delivered. */
+C_API int aio_run(aio_t *aio, int ms);
+
+/* Wait for `op`, inside coroutine suspends only caller, another must drive queue,
+otherwise runs queue, and current `thread` coroutines, until done. Returns `aio_result`. */
+C_API long aio_await(aio_op_t *op);
+
+/* Drive queue, and current `thread` coroutines, until no operation in flight. */
+C_API void aio_loop(aio_t *aio);
+
+/* Bytes transferred, accepted socket, or negated `errno`. */
+C_API long aio_result(aio_op_t *op);
+C_API void *aio_buffer(aio_op_t *op);
+C_API bool aio_is_done(aio_op_t *op);
+C_API size_t aio_pending(aio_t *aio);
+C_API bool aio_is_uring(aio_t *aio);
+
+/* Timers of calling `thread`, on an hierarchical wheel of millisecond ticks, so adding
+and cancelling are `O(1)` however many are live. Fired only by that `thread`, from
+`timer_run`, or `workers_checkpoint` of `thrd_async` tasks. */
+typedef struct raii_timer_s raii_timer_t;
+
+/* Call `fn(data)` once `ms` milliseconds passed, cancelled when `scope` exits or unwinds,
+`scope` may be `NULL` for caller to `timer_cancel` it. Handle invalid once fired or cancelled. */
+C_API raii_timer_t *timer_add(memory_t *scope, unsigned int ms, func_t fn, void *data);
+#define _timer(ms, fn, data) timer_add(_$##__FUNCTION__, ms, (func_t)(fn), data)
+
+/* Same as `timer_add`, but expiry throws `timeout_error` out of `timer_run`,
+into whichever task of calling `thread` is running it. */
+C_API raii_timer_t *timer_timeout(memory_t *scope, unsigned int ms);
+#define _timeout(ms) timer_timeout(_$##__FUNCTION__, ms)
+C_API void timer_cancel(raii_timer_t *timer);
+
+/* Fire expired timers of calling `thread`, returns number fired. */
+C_API int timer_run(void);
+
+/* Milliseconds calling `thread` may sleep before `timer_run` has work, `-1` if no timers. */
+C_API int timer_next(void);
+C_API size_t timer_count(void);
+
+/* Reference counted block, type `RAII_SHARED`, counts in an header just before it,
+atomic unless made by `shared_local`. Released, `dtor` then memory, once last strong
+reference is; header itself once last weak one is too. */
+typedef struct raii_weak_s raii_weak_t;
+
+/* Returns block of `size` bytes, zeroed, holding one strong reference,
+`dtor` may be `NULL`, called with block before it's freed. */
+C_API void *shared_alloc(size_t size, func_t dtor);
+
+/* Same as `shared_alloc`, plain counts, only for it's creating `thread`. */
+C_API void *shared_local(size_t size, func_t dtor);
+
+/* Add strong reference to `ptr`, returns `ptr`. */
+C_API void *shared_retain(void *ptr);
+
+/* Same as `shared_retain`, reference released when `scope` exits or unwinds. */
+C_API void *shared_retain_by(memory_t *scope, void *ptr);
+#define _shared_retain(ptr) shared_retain_by(_$##__FUNCTION__, ptr)
+
+/* Same as `shared_alloc`, it's reference released when `scope` exits or unwinds. */
+C_API void *shared_by(memory_t *scope, size_t size, func_t dtor);
+#define _shared(size, dtor) shared_by(_$##__FUNCTION__, size, (func_t)(dtor))
+
+/* Drop strong reference, releasing `ptr` when it's last, `ptr` may be `NULL`. */
+C_API void shared_release(void *ptr);
+C_API size_t shared_count(void *ptr);
+
+/* Weak reference, keeps header, not block, alive. */
+C_API raii_weak_t *shared_weak(void *ptr);
+
+/* Returns block, with an new strong reference, `NULL` if already released. */
+C_API void *shared_lock(raii_weak_t *weak);
+C_API void shared_weak_release(raii_weak_t *weak);
+
+/* Trace events, recorded only when built with `RAII_TRACE`. */
+enum {
+    RAII_TRACE_SCOPE_BEGIN,
+    RAII_TRACE_SCOPE_END,
+    RAII_TRACE_DEFER,
+    RAII_TRACE_CHUNK
+};
+
+/* Record event into calling `thread` ring, `ptr` being scope, deferred function or arena,
+with duration since `start`, `0` for none, as `raii_trace_now` nanoseconds. */
+C_API void raii_trace_event(int kind, const void *ptr, uint64_t start, size_t value);
+C_API uint64_t raii_trace_now(void);
+
+/* Write events of every `thread` ring as Chrome trace JSON, loadable by Perfetto,
+scopes as async spans by address, deferred calls named by function address,
+returns number written. Rings are read as they are, call once traced `thread`s are quiet. */
+C_API size_t raii_trace_dump(FILE *out);
+C_API void raii_trace_clear(void);
+
+/* Record events, recorded only when built with `RAII_RECORD`. */
+enum {
+    RAII_RECORD_SCOPE_CREATE = 1,
+    RAII_RECORD_SCOPE_RELEASE,
+    RAII_RECORD_DEFER_ADD,
+    RAII_RECORD_DEFER_FIRE,
+    RAII_RECORD_DEFER_CANCEL,
+    RAII_RECORD_THROW,
+    RAII_RECORD_CATCH
+};
+
+/* One recorded event, as `raii_record_save` writes it. */
+typedef struct {
+    /* `raii_trace_now` nanoseconds */
+    uint64_t ts;
+    /* scope, or deferred function, address, exception name index for throw and catch */
+    uint64_t ref;
+    /* `defer` serial, or throw and catch line */
+    uint32_t value;
+    uint16_t kind;
+    /* file name index of throw and catch, `0` none */
+    uint16_t site;
+} raii_record_t;
+
+/* Record `kind` event of scope, or deferred function, `ref` into calling `thread` ring. */
+C_API void raii_record_event(int kind, const void *ref, unsigned int value);
+
+/* Record throw, or catch, of exception `ex` at `file:line` into calling `thread` ring. */
+C_API void raii_record_site(int kind, const char *ex, const char *file, int line);
+
+/* Pause or resume recording, for all `thread`s, returns previous state, on at start. */
+C_API bool raii_record_enable(bool on);
+
+/* Write events of every `thread` ring in compact binary form, native byte order,
+names of throw and catch sites included once, returns number written.
+Rings are read as they are, call once recorded `thread`s are quiet. */
+C_API size_t raii_record_save(FILE *out);
+
+/* Read a `raii_record_save` recording, writing each `thread` timeline as text,
+times from first event recorded, nested by scope, returns number of events decoded,
+with `errno` set to `EINVAL` if not a recording, or cut short. */
+C_API size_t raii_record_decode(FILE *in, FILE *out);
+C_API void raii_record_clear(void);
+
+/* Adaptive mutex, for short critical sections, spins a while on contention, then parks
+on futex, or `WaitOnAddress`, sleeping only when holder takes long. Not recursive,
+not usable with `cnd_wait`, zeroed, or `RAII_MUTEX_INIT`, is unlocked. */
+typedef struct {
+    /* `0` unlocked, `1` locked, `2` locked with waiters parked */
+    volatile int state;
+} raii_mutex_t;
+
+#define RAII_MUTEX_INIT {0}
+C_API void raii_mutex_init(raii_mutex_t *mutex);
+C_API void raii_mutex_lock(raii_mutex_t *mutex);
+C_API bool raii_mutex_trylock(raii_mutex_t *mutex);
+C_API void raii_mutex_unlock(raii_mutex_t *mutex);
+
+/* Lock of library's own short critical sections, `thrd_alloc` shards, workers queue,
+`raii_mutex_t`, unless built with `RAII_NATIVE_LOCKS`, or `RAII_LOCK_PROFILE`, to profile them. */
+#if defined(RAII_NATIVE_LOCKS) || defined(RAII_LOCK_PROFILE)
+    typedef mtx_t raii_fastlock_t;
+    #define raii_fastlock_init(lock)    mtx_init(lock, mtx_plain)
+    #define raii_fastlock_lock(lock)    mtx_lock(lock)
+    #define raii_fastlock_unlock(lock)  mtx_unlock(lock)
+    #define raii_fastlock_destroy(lock) mtx_destroy(lock)
+#else
+    typedef raii_mutex_t raii_fastlock_t;
+    static FORCEINLINE int raii_fastlock_init(raii_fastlock_t *lock) {
+        raii_mutex_init(lock);
+        return thrd_success;
+    }
+
+    static FORCEINLINE int raii_fastlock_lock(raii_fastlock_t *lock) {
+        raii_mutex_lock(lock);
+        return thrd_success;
+    }
+
+    static FORCEINLINE int raii_fastlock_unlock(raii_fastlock_t *lock) {
+        raii_mutex_unlock(lock);
+        return thrd_success;
+    }
+
+    #define raii_fastlock_destroy(lock) ((void)(lock))
+#endif
+
+/* Call site holding a lock while others waited for it. */
+typedef struct {
+    const char *file;
+    int line;
+    /* acquisitions that had to wait on this holder */
+    size_t count;
+} raii_lock_site_t;
+
+/* Lock profile, of `raii_lock_stats`, counted only when built with `RAII_LOCK_PROFILE`. */
+typedef struct {
+    const void *lock;
+    /* `raii_lock_name`, `NULL` if never named */
+    const char *name;
+    size_t acquired;
+    /* acquisitions that found it held */
+    size_t contended;
+    /* nanoseconds blocked acquiring, total and longest */
+    size_t wait_ns;
+    size_t max_ns;
+    size_t histogram[RAII_LOCK_BUCKETS];
+    /* `cnd_wait`/`cnd_timedwait` calls on it, and nanoseconds in them */
+    size_t cnd_waits;
+    size_t cnd_ns;
+    /* last holder */
+    const char *file;
+    int line;
+    raii_lock_site_t sites[RAII_LOCK_SITES];
+} raii_lock_stats_t;
+
+/* Built with `RAII_LOCK_PROFILE`, every `mtx_lock`, `mtx_trylock`, `cnd_wait` and `cnd_timedwait`
+compiled including `raii.h`, library's own too, goes through these, recording per lock counts,
+keyed by address, updated while holding it. Otherwise they only forward. */
+C_API int raii_mtx_lock(mtx_t *mtx, const char *file, int line);
+C_API int raii_mtx_trylock(mtx_t *mtx, const char *file, int line);
+C_API int raii_cnd_wait(cnd_t *cnd, mtx_t *mtx, const char *file, int line);
+C_API int raii_cnd_timedwait(cnd_t *cnd, mtx_t *mtx, const struct timespec *ts, const char *file, int line);
+
+/* Label `lock` in profiles, `name` must outlive it. */
+C_API void raii_lock_name(const void *lock, const char *name);
+
+/* Copy up to `max` lock profiles into `out`, longest total wait first, returns number copied.
+Counts of locks still in use are read as they are. */
+C_API int raii_lock_stats(raii_lock_stats_t *out, int max);
+
+/* Write `raii_lock_stats` as text table, returns number of locks written. */
+C_API int raii_lock_report(FILE *out);
+
+/* Forget all profiles, for locks no longer in use. */
+C_API void raii_lock_reset(void);
+
+#if defined(RAII_LOCK_PROFILE) && !defined(RAII_LOCK_UNPROFILED)
+    #define mtx_lock(mtx)                   raii_mtx_lock(mtx, __FILE__, __LINE__)
+    #define mtx_trylock(mtx)                raii_mtx_trylock(mtx, __FILE__, __LINE__)
+    #define cnd_wait(cnd, mtx)              raii_cnd_wait(cnd, mtx, __FILE__, __LINE__)
+    #define cnd_timedwait(cnd, mtx, ts)     raii_cnd_timedwait(cnd, mtx, ts, __FILE__, __LINE__)
+#endif
+
+/* Memory check mode, built with `RAII_MEMCHECK`: `malloc_full`/`calloc_full` blocks and
+arenas record their allocation site, blocks released by scopes are poisoned and held
+in quarantine, a second release reported, not done. Arena chunks get an inaccessible
+guard page past their end, and become inaccessible once released, so overruns and use
+after unwind fault, into `sig_segv`. Anything still live is reported at exit. */
+C_API void raii_memcheck_track(const void *ptr, size_t size);
+C_API void raii_memcheck_forget(const void *ptr);
+
+/* Returns `false` if `ptr` untracked, for caller to free. */
+C_API bool raii_memcheck_free(void *ptr);
+C_API void *raii_memcheck_chunk(size_t size);
+C_API void raii_memcheck_chunk_free(void *chunk, void *limit);
+
+/* Write each live block, with it's allocation site, returns number written. */
+C_API size_t raii_memcheck_report(FILE *out);
+
+/* Same as `raii_memcheck_report` to `stderr`, only once, as done at exit. */
+C_API size_t raii_memcheck_leaks(void);
+C_API size_t raii_memcheck_live(void);
+C_API size_t raii_memcheck_double_frees(void);
+
+/* Asynchronous log sink, each `thread` copies messages into it's own lock-free
+ring of `ring_size` bytes, at least `4096`, an background `thread` writes them out,
+batched by `writev`. Full rings are drained by writer, fatal reports written directly.
+Returns `RAII_ERR` if already started. */
+C_API int raii_log_start(size_t ring_size);
+
+/* Write out everything queued so far, on calling `thread`. */
+C_API void raii_log_flush(void);
+
+/* Drain, stop background `thread`, restore previous `exception_log_func`. */
+C_API void raii_log_stop(void);
+
+/* Epoch based reclamation, for lock-free structures: readers mark themselves inside
+an epoch, objects unlinked by writers are retired, then run their `dtor` on retiring
+`thread` once two epoch advances passed, no reader can be holding them by then.
+Each `thread` epoch record is made on first use, recycled once it exits. */
+
+/* Enter/exit an read side section, they nest, objects reached inside are valid till exit. */
+C_API void ebr_enter(void);
+C_API void ebr_exit(void);
+
+/* Same as `ebr_enter`, exited when `scope` exits or unwinds, as `guard` sections do. */
+C_API void ebr_guard(memory_t *scope);
+#define _ebr() ebr_guard(_$##__FUNCTION__)
+
+/* Call `dtor` with `ptr`, already unreachable for new readers, once it's safe,
+on calling `thread`, from a later `ebr_retire` or `ebr_flush`. */
+C_API void ebr_retire(void *ptr, func_t dtor);
+
+/* Try to advance epoch, and run what is safe now, returns number still retired.
+Pool workers call it before waiting for more work. */
+C_API size_t ebr_flush(void);
+
+/* Number of objects calling `thread` still has retired. */
+C_API size_t ebr_pending(void);
+
+/* Event dispatcher, type `RAII_EVENT_ARG`, listeners kept in an contiguous array,
+copied on every subscribe/unsubscribe, emitters walk current copy without locking,
+old copies freed once no emitter is inside one. Handlers must not throw. */
+typedef struct event_s event_t;
+
+/* Listener, `data` as given to `event_on`, `arg` as given to `event_emit`. */
+typedef void (*event_func)(void *data, void *arg);
+
+/* Create dispatcher, released when `scope` exits or unwinds, `scope` may be `NULL`
+for caller to `event_free` it. It must outlive scopes of it's listeners. */
+C_API event_t *event_create(memory_t *scope);
+#define _event() event_create(_$##__FUNCTION__)
+C_API void event_free(event_t *ev);
+
+/* Subscribe `fn`, returns listener id, unsubscribed when `scope` exits or unwinds,
+`scope` may be `NULL` for caller to `event_off` it. */
+C_API size_t event_on(memory_t *scope, event_t *ev, event_func fn, void *data);
+#define _event_on(ev, fn, data) event_on(_$##__FUNCTION__, ev, fn, data)
+
+/* Unsubscribe listener `id`, returns `false` if none. */
+C_API bool event_off(event_t *ev, size_t id);
+
+/* Call every listener with `arg`, returns number called. */
+C_API size_t event_emit(event_t *ev, void *arg);
+
+/* Call every listener for each of `count` `args`, one listener at a time,
+one snapshot for whole batch, returns number of listeners. */
+C_API size_t event_emit_batch(event_t *ev, void **args, size_t count);
+C_API size_t event_count(event_t *ev);
+
+/* Field of a reflected struct, entry of `RAII_REFLECT` table. */
+typedef struct reflect_field_s {
+    const char *name;
+    size_t offset;
+    size_t size;
+    /* numeric `RAII_INT` ... `RAII_UCHAR`, `RAII_CHAR_P` owned string, copied,
+    `RAII_OBJ` embedded struct of `nested`, `RAII_PTR` owned pointer to `nested`,
+    copied too, or kept as is when `nested` is `NULL` */
+    raii_type type;
+    const struct reflect_type_s *nested;
+} reflect_field_t;
+
+/* Static type descriptor, type `RAII_REFLECT_TYPE`, built by `RAII_REFLECT`
+in read-only data, field names and offsets precomputed, no runtime registration. */
+typedef struct reflect_type_s {
+    raii_type type;
+    const char *name;
+    size_t size;
+    size_t count;
+    const reflect_field_t *fields;
+} reflect_type_t;
+
+#define RAII_FIELD(st, member, kind)    \
+    {#member, offsetof(st, member), sizeof(((st *)0)->member), kind, NULL}
+#define RAII_FIELD_OBJ(st, member, desc)    \
+    {#member, offsetof(st, member), sizeof(((st *)0)->member), RAII_OBJ, &(desc)}
+#define RAII_FIELD_PTR(st, member, desc)    \
+    {#member, offsetof(st, member), sizeof(((st *)0)->member), RAII_PTR, &(desc)}
+
+/* Define `static const reflect_type_t name` of struct `st`, from `RAII_FIELD` entries.
+    RAII_REFLECT(point_reflect, point_t, RAII_FIELD(point_t, x, RAII_INT), ...); */
+#define RAII_REFLECT(name, st, ...)                                         \
+    static const reflect_field_t name##_fields[] = {__VA_ARGS__};           \
+    static const reflect_type_t name = {RAII_REFLECT_TYPE, #st, sizeof(st), \
+        sizeof(name##_fields) / sizeof(reflect_field_t), name##_fields}
+
+/* Returns field `name` of `desc`, `NULL` if none. */
+C_API const reflect_field_t *reflect_field(const reflect_type_t *desc, const char *name);
+
+/* Returns `field` of `obj` widened into generic storage, `type` as field's. */
+C_API raii_values_t reflect_get(const void *obj, const reflect_field_t *field);
+
+/* Store `value` into numeric or pointer `field` of `obj`, narrowed to field size. */
+C_API void reflect_set(void *obj, const reflect_field_t *field, values_type value);
+
+/* Deep copy `src` into `dst`, strings and owned pointers duplicated, bound to `scope`,
+or `NULL` for heap copies the caller releases with `reflect_free`, returns `dst`. */
+C_API void *reflect_copy(memory_t *scope, const reflect_type_t *desc, void *dst, const void *src);
+#define _reflect_copy(desc, dst, src) reflect_copy(_$##__FUNCTION__, desc, dst, src)
+
+/* Release owned strings and pointers of heap made `reflect_copy`, not `obj` itself. */
+C_API void reflect_free(const reflect_type_t *desc, void *obj);
+
+/* Compact length prefixed binary messages, for handing `args_t` and reflected structs
+to another process of same host, native byte order. Strings are length prefixed and
+`NUL` terminated, so decoding is an zero-copy view, reading straight from received buffer. */
+
+/* Returns total bytes of message at `buf`, from it's header, `0` if `size` holds no header. */
+C_API size_t raii_encoded_size(const void *buf, size_t size);
+
+/* Encode `params` into `buf` of `size` bytes, returns message bytes needed, all written
+only if at most `size`, `0` if any argument is an pointer, array or function. */
+C_API size_t args_encode(args_t *params, void *buf, size_t size);
+
+/* Fills `params`, as `args_local`, from message in `buf`, strings refer into `buf`,
+which must outlive `params`, returns `NULL` if malformed, or more than `RAII_ARGS_INLINE`. */
+C_API args_t *args_view(args_t *params, const void *buf, size_t size);
+
+/* Same as `args_encode`, for reflected `obj`, `RAII_PTR` fields without `nested` and
+functions are not encoded, decoded as `NULL`. */
+C_API size_t reflect_encode(const reflect_type_t *desc, const void *obj, void *buf, size_t size);
+
+/* Decode reflected `obj` from message in `buf`, strings refer into `buf`, no allocation,
+except nested structs of `RAII_PTR` fields, taken from `scope`, those fail if `NULL`.
+Returns bytes read, `0` if malformed or not of `desc`. */
+C_API size_t reflect_view(memory_t *scope, const reflect_type_t *desc, void *obj, const void *buf, size_t size);
+
+#ifdef RAII_INLINE_API
+#   include "raii_inline.h"
+#endif
+
 #ifdef __cplusplus
     }
 #endif
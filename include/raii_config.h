@@ -0,0 +1,26 @@
+#ifndef RAII_CONFIG_H
+#define RAII_CONFIG_H
+
+/* Compile time feature removal, each an CMake option of same name, all off by default.
+They change what `ex_try`, `guard` and `unique_init` expand into, so library
+and every user must be built with same set, CMake exports them `PUBLIC`. */
+
+/* `EX_NO_SIGNALS`: signals, and Windows structured exceptions, are never translated
+into exceptions. `ex_signal_setup` only registers exception classes, `try` and `guard`
+skip checking for installed handlers and for an signal landing, `throw` skips
+blocking signals while unwinding. Implies `EX_TRY_FAST`, no handler to restore mask for.
+Faults then terminate process as they would without this library. */
+#ifdef EX_NO_SIGNALS
+    #ifndef EX_TRY_FAST
+        #define EX_TRY_FAST
+    #endif
+#endif
+
+/* `RAII_NO_EMULATED`: exception contexts and scopes only in native `thread_local` storage,
+`thrd_init` emulated `thread` scopes are unavailable, `is_*_emulated` are constant `false`,
+`ex_init`/`ex_update` skip their `tss` lookups. Ignored where `thread_local` is itself emulated. */
+#ifdef emulate_tls
+    #undef RAII_NO_EMULATED
+#endif
+
+#endif /* RAII_CONFIG_H */
@@ -0,0 +1,80 @@
+#ifndef RAII_INLINE_H
+#define RAII_INLINE_H
+
+/* Header copies of trivial checks and allocation fast paths, included by `raii.h`
+when `RAII_INLINE_API` is defined, so user code inlines them without LTO.
+Library always exports out of line versions, same behavior, for any other caller. */
+
+static RAII_INLINE raii_type raii_type_of_(void *self) {
+    return ((var_t *)self)->type;
+}
+
+static RAII_INLINE bool raii_is_type_(void *self, raii_type check) {
+    return ((var_t *)self)->type == check;
+}
+
+static RAII_INLINE bool raii_is_value_(void *self) {
+    return (raii_type_of_(self) > RAII_NULL) && (raii_type_of_(self) < RAII_NAN);
+}
+
+static RAII_INLINE bool raii_is_instance_(void *self) {
+    return (raii_type_of_(self) > RAII_NAN) && (raii_type_of_(self) < RAII_NO_INSTANCE);
+}
+
+static RAII_INLINE bool raii_is_instance_of_(void *self, void *check) {
+    return raii_type_of_(self) == raii_type_of_(check);
+}
+
+static RAII_INLINE bool raii_is_valid_(void *self) {
+    return raii_is_value_(self) || raii_is_instance_(self);
+}
+
+static RAII_INLINE bool raii_is_guard_(void *self) {
+    return self != NULL && ((unique_t *)self)->status == RAII_GUARDED_STATUS;
+}
+
+static RAII_INLINE size_t raii_arena_capacity_(const arena_t arena) {
+    return arena != NULL && raii_is_type_(arena, RAII_ARENA + RAII_STRUCT)
+        ? arena->limit - arena->avail
+        : 0;
+}
+
+static RAII_INLINE size_t raii_arena_total_(const arena_t arena) {
+    return arena != NULL && raii_is_type_(arena, RAII_ARENA + RAII_STRUCT)
+        ? arena->total
+        : 0;
+}
+
+/* Budgeted scopes take `malloc_by`/`calloc_by`, which charge before allocating. */
+static RAII_INLINE void *raii_malloc_arena_(memory_t *scope, size_t size) {
+    if (UNLIKELY(scope->budget != NULL))
+        return malloc_by(scope, size);
+
+    return arena_bump((arena_t)scope->arena, size);
+}
+
+static RAII_INLINE void *raii_calloc_arena_(memory_t *scope, int count, size_t size) {
+    if (UNLIKELY(scope->budget != NULL))
+        return calloc_by(scope, count, size);
+
+    return arena_calloc((arena_t)scope->arena, (long)count, (long)size);
+}
+
+#define type_of(self)               raii_type_of_(self)
+#define is_type(self, check)        raii_is_type_(self, check)
+#define is_instance_of(self, check) raii_is_instance_of_(self, check)
+#define is_value(self)              raii_is_value_(self)
+#define is_instance(self)           raii_is_instance_(self)
+#define is_valid(self)              raii_is_valid_(self)
+#define is_zero(self)               ((size_t)(self) == 0)
+#define is_empty(self)              ((void *)(self) == NULL)
+#define is_true(self)               ((bool)(self) == true)
+#define is_false(self)              ((bool)(self) == false)
+#define is_guard(self)              raii_is_guard_(self)
+#define arena_capacity(arena)       raii_arena_capacity_(arena)
+#define arena_total(arena)          raii_arena_total_(arena)
+#define malloc_arena(scope, size)   raii_malloc_arena_(scope, size)
+#define calloc_arena(scope, count, size)    raii_calloc_arena_(scope, count, size)
+#define raii_defer(func, data)      raii_deferred(raii_init(), func, data)
+
+#endif /* RAII_INLINE_H */
@@ -0,0 +1,582 @@
+#if defined(_WIN32)
+    /* ahead of `windows.h`, that raii.h includes */
+    #include <winsock2.h>
+#endif
+#include "raii.h"
+#if defined(_WIN32)
+    #include <io.h>
+    #define poll WSAPoll
+#else
+    #include <unistd.h>
+    #include <poll.h>
+    #include <sys/socket.h>
+#endif
+#if defined(__linux__) && defined(RAII_IO_URING)
+    #include <linux/io_uring.h>
+    #include <sys/syscall.h>
+    #include <sys/mman.h>
+#endif
+
+enum {
+    AIO_READ,
+    AIO_WRITE,
+    AIO_ACCEPT
+};
+
+/* Each operation sits on one list, of it's queue `inflight`, or `completed`
+till delivered, unlinked once delivered. */
+typedef struct {
+    aio_op_t *head;
+} aio_list_t;
+
+struct aio_op_s {
+    aio_t *aio;
+    aio_list_t *list;
+    aio_op_t *next;
+    aio_op_t *prev;
+    raii_socket_t fd;
+    int opcode;
+    long long offset;
+    char *buf;
+    size_t length;
+    long result;
+    bool is_done;
+    aio_func done;
+    void *data;
+    routine_t *waiter;
+};
+
+#if defined(__linux__) && defined(RAII_IO_URING)
+typedef struct {
+    int fd;
+    unsigned entries;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ring, *cq_ring;
+    size_t sq_size, cq_size;
+    /* queued, not yet handed to kernel */
+    unsigned unsubmitted;
+    struct __kernel_timespec timeout;
+} aio_uring_t;
+#endif
+
+struct aio_s {
+    raii_type type;
+    aio_list_t inflight[1];
+    aio_list_t completed[1];
+    size_t pending;
+    unsigned int depth;
+    /* `poll` backend, grown to number in flight */
+    struct pollfd *fds;
+    aio_op_t **polled;
+    size_t polled_size;
+#if defined(__linux__) && defined(RAII_IO_URING)
+    aio_uring_t ring[1];
+    bool is_uring;
+#endif
+};
+
+static void aio_link(aio_list_t *list, aio_op_t *op) {
+    op->list = list;
+    op->prev = NULL;
+    op->next = list->head;
+    if (!is_empty(list->head))
+        list->head->prev = op;
+
+    list->head = op;
+}
+
+static void aio_unlink(aio_op_t *op) {
+    if (is_empty(op->list))
+        return;
+
+    if (!is_empty(op->prev))
+        op->prev->next = op->next;
+    else
+        op->list->head = op->next;
+
+    if (!is_empty(op->next))
+        op->next->prev = op->prev;
+
+    op->list = NULL;
+    op->next = op->prev = NULL;
+}
+
+/* Kernel or `poll` pass finished `op`, delivered by `aio_deliver`. */
+static void aio_finish(aio_op_t *op, long result) {
+    aio_unlink(op);
+    op->result = result;
+    op->aio->pending--;
+    aio_link(op->aio->completed, op);
+}
+
+/* Mark done, detach from queue, wake waiter, then call handler, which may release `op`. */
+static int aio_deliver(aio_t *aio) {
+    aio_op_t *op;
+    int count = 0;
+
+    while (!is_empty(op = aio->completed->head)) {
+        aio_unlink(op);
+        op->aio = NULL;
+        op->is_done = true;
+        if (!is_empty(op->waiter))
+            routine_resume(op->waiter);
+
+        if (!is_empty(op->done))
+            op->done(op, op->data);
+
+        count++;
+    }
+
+    return count;
+}
+
+#if defined(__linux__) && defined(RAII_IO_URING)
+static int aio_uring_enter(aio_uring_t *ring, unsigned wait) {
+    int submitted = (int)syscall(__NR_io_uring_enter, ring->fd, ring->unsubmitted, wait,
+                                 wait > 0 ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+    if (submitted > 0)
+        ring->unsubmitted -= (unsigned)submitted;
+
+    return submitted;
+}
+
+static void aio_uring_close(aio_uring_t *ring) {
+    if (!is_empty(ring->sqes))
+        munmap(ring->sqes, ring->entries * sizeof(struct io_uring_sqe));
+
+    if (!is_empty(ring->cq_ring) && ring->cq_ring != ring->sq_ring)
+        munmap(ring->cq_ring, ring->cq_size);
+
+    if (!is_empty(ring->sq_ring))
+        munmap(ring->sq_ring, ring->sq_size);
+
+    close(ring->fd);
+}
+
+/* Returns `false` where kernel lacks, or refuses, `io_uring`. */
+static bool aio_uring_init(aio_uring_t *ring, unsigned depth) {
+    struct io_uring_params params;
+    char *sq, *cq;
+    void *sqes;
+
+    memset(&params, 0, sizeof(params));
+    memset(ring, 0, sizeof(aio_uring_t));
+    if ((ring->fd = (int)syscall(__NR_io_uring_setup, depth, &params)) < 0)
+        return false;
+
+    ring->entries = params.sq_entries;
+    ring->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        ring->sq_size = ring->cq_size = ring->sq_size > ring->cq_size ? ring->sq_size : ring->cq_size;
+
+    sq = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (sq == MAP_FAILED) {
+        close(ring->fd);
+        return false;
+    }
+
+    ring->sq_ring = sq;
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        cq = sq;
+    } else if ((cq = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          ring->fd, IORING_OFF_CQ_RING)) == MAP_FAILED) {
+        aio_uring_close(ring);
+        return false;
+    }
+
+    ring->cq_ring = cq;
+    sqes = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        aio_uring_close(ring);
+        return false;
+    }
+
+    ring->sqes = sqes;
+    ring->sq_head = (unsigned *)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+    ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    return true;
+}
+
+/* Next free submission entry, zeroed, handing queued ones to kernel when full. */
+static struct io_uring_sqe *aio_uring_sqe(aio_uring_t *ring) {
+    unsigned tail = *ring->sq_tail, index;
+    struct io_uring_sqe *sqe;
+
+    while (tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >= ring->entries) {
+        if (aio_uring_enter(ring, 0) < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+            raii_panic("Failed! `io_uring_enter`");
+    }
+
+    index = tail & *ring->sq_mask;
+    sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    ring->sq_array[index] = index;
+    return sqe;
+}
+
+static void aio_uring_push(aio_uring_t *ring) {
+    __atomic_store_n(ring->sq_tail, *ring->sq_tail + 1, __ATOMIC_RELEASE);
+    ring->unsubmitted++;
+}
+
+static void aio_uring_submit(aio_t *aio, aio_op_t *op) {
+    struct io_uring_sqe *sqe = aio_uring_sqe(aio->ring);
+    sqe->fd = op->fd;
+    sqe->user_data = (uintptr_t)op;
+    switch (op->opcode) {
+        case AIO_READ:
+        case AIO_WRITE:
+            sqe->opcode = op->opcode == AIO_READ ? IORING_OP_READ : IORING_OP_WRITE;
+            sqe->addr = (uintptr_t)op->buf;
+            sqe->len = (unsigned)op->length;
+            sqe->off = op->offset < 0 ? (uint64_t)-1 : (uint64_t)op->offset;
+            break;
+        case AIO_ACCEPT:
+            sqe->opcode = IORING_OP_ACCEPT;
+            break;
+    }
+
+    aio_uring_push(aio->ring);
+}
+
+/* Entries of `user_data` `0`, timeouts and cancels, are ours, only wake us. */
+static void aio_uring_reap(aio_t *aio) {
+    aio_uring_t *ring = aio->ring;
+    unsigned head = *ring->cq_head, tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    struct io_uring_cqe *cqe;
+
+    for (; head != tail; head++) {
+        cqe = &ring->cqes[head & *ring->cq_mask];
+        if (cqe->user_data != 0)
+            aio_finish((aio_op_t *)(uintptr_t)cqe->user_data, cqe->res);
+    }
+
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+}
+
+static void aio_uring_run(aio_t *aio, int ms) {
+    aio_uring_t *ring = aio->ring;
+    struct io_uring_sqe *sqe;
+    unsigned wait = ms != 0 && aio->pending > 0 && is_empty(aio->completed->head)
+        && *ring->cq_head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+
+    if (wait && ms > 0) {
+        ring->timeout.tv_sec = ms / 1000;
+        ring->timeout.tv_nsec = (ms % 1000) * 1000000L;
+        sqe = aio_uring_sqe(ring);
+        sqe->opcode = IORING_OP_TIMEOUT;
+        sqe->addr = (uintptr_t)&ring->timeout;
+        sqe->len = 1;
+        aio_uring_push(ring);
+    }
+
+    if ((ring->unsubmitted > 0 || wait) && aio_uring_enter(ring, wait) < 0
+        && errno != EINTR && errno != EAGAIN && errno != EBUSY && errno != ETIME)
+        raii_panic("Failed! `io_uring_enter`");
+
+    aio_uring_reap(aio);
+}
+#endif
+
+/* Try `op` now, a negated `errno` of `EAGAIN` leaves it in flight. */
+static long aio_perform(aio_op_t *op) {
+    long done = -1;
+    switch (op->opcode) {
+        case AIO_READ:
+#if defined(_WIN32)
+            if (op->offset < 0 || _lseeki64((int)op->fd, op->offset, SEEK_SET) >= 0)
+                done = _read((int)op->fd, op->buf, (unsigned)op->length);
+#else
+            done = op->offset < 0 ? (long)read(op->fd, op->buf, op->length)
+                : (long)pread(op->fd, op->buf, op->length, (off_t)op->offset);
+#endif
+            break;
+        case AIO_WRITE:
+#if defined(_WIN32)
+            if (op->offset < 0 || _lseeki64((int)op->fd, op->offset, SEEK_SET) >= 0)
+                done = _write((int)op->fd, op->buf, (unsigned)op->length);
+#else
+            done = op->offset < 0 ? (long)write(op->fd, op->buf, op->length)
+                : (long)pwrite(op->fd, op->buf, op->length, (off_t)op->offset);
+#endif
+            break;
+        case AIO_ACCEPT:
+#if defined(_WIN32)
+            done = (long)accept(op->fd, NULL, NULL);
+            if (done == (long)INVALID_SOCKET)
+                return WSAGetLastError() == WSAEWOULDBLOCK ? -EAGAIN : -EIO;
+#else
+            done = (long)accept(op->fd, NULL, NULL);
+#endif
+            break;
+    }
+
+    return done < 0 ? (errno == EWOULDBLOCK ? -EAGAIN : -errno) : done;
+}
+
+/* Readiness pass over everything in flight, then plain calls on those ready. */
+static void aio_poll_run(aio_t *aio, int ms) {
+    size_t count = 0, i;
+    long result;
+    aio_op_t *op;
+
+    if (aio->pending == 0)
+        return;
+
+    if (aio->polled_size < aio->pending) {
+        aio->polled_size = aio->pending * 2;
+        aio->fds = try_realloc(aio->fds, aio->polled_size * sizeof(struct pollfd));
+        aio->polled = try_realloc(aio->polled, aio->polled_size * sizeof(aio_op_t *));
+    }
+
+    for (op = aio->inflight->head; !is_empty(op); op = op->next) {
+#if defined(_WIN32)
+        /* only sockets can be polled, files always counted ready */
+        if (op->opcode != AIO_ACCEPT) {
+            ms = 0;
+            continue;
+        }
+#endif
+        aio->fds[count].fd = op->fd;
+        aio->fds[count].events = op->opcode == AIO_WRITE ? POLLOUT : POLLIN;
+        aio->fds[count].revents = 0;
+        aio->polled[count++] = op;
+    }
+
+    if (count > 0 && poll(aio->fds, (unsigned long)count, aio->completed->head ? 0 : ms) <= 0)
+        count = 0;
+
+#if defined(_WIN32)
+    for (op = aio->inflight->head; !is_empty(op);) {
+        aio_op_t *next = op->next;
+        if (op->opcode != AIO_ACCEPT)
+            aio_finish(op, aio_perform(op));
+
+        op = next;
+    }
+#endif
+    for (i = 0; i < count; i++) {
+        op = aio->polled[i];
+        if (aio->fds[i].revents == 0)
+            continue;
+
+        if ((result = aio_perform(op)) != -EAGAIN && result != -EINTR)
+            aio_finish(op, result);
+    }
+}
+
+static void aio_submit(aio_op_t *op) {
+    aio_t *aio = op->aio;
+    aio_link(aio->inflight, op);
+    aio->pending++;
+#if defined(__linux__) && defined(RAII_IO_URING)
+    if (aio->is_uring)
+        aio_uring_submit(aio, op);
+#endif
+}
+
+/* Stop `op` if in flight, it's completion delivered by next `aio_run`. */
+static bool aio_stop(aio_op_t *op) {
+#if defined(__linux__) && defined(RAII_IO_URING)
+    struct io_uring_sqe *sqe;
+#endif
+    if (op->list != op->aio->inflight)
+        return false;
+
+#if defined(__linux__) && defined(RAII_IO_URING)
+    if (op->aio->is_uring) {
+        sqe = aio_uring_sqe(op->aio->ring);
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->addr = (uintptr_t)op;
+        aio_uring_push(op->aio->ring);
+        aio_uring_enter(op->aio->ring, 0);
+        return true;
+    }
+#endif
+    aio_finish(op, -ECANCELED);
+    return true;
+}
+
+int aio_run(aio_t *aio, int ms) {
+#if defined(__linux__) && defined(RAII_IO_URING)
+    if (aio->is_uring)
+        aio_uring_run(aio, ms);
+    else
+#endif
+        aio_poll_run(aio, ms);
+
+    return aio_deliver(aio);
+}
+
+aio_t *aio_create(memory_t *scope, unsigned int depth) {
+    aio_t *aio = try_calloc(1, sizeof(aio_t));
+    aio->depth = depth < 8 ? 8 : depth;
+#if defined(__linux__) && defined(RAII_IO_URING)
+    aio->is_uring = aio_uring_init(aio->ring, aio->depth);
+#endif
+    aio->type = RAII_AIO;
+    if (!is_empty(scope))
+        raii_deferred(scope, (func_t)aio_free, aio);
+
+    return aio;
+}
+
+void aio_free(aio_t *aio) {
+    aio_op_t *op, *next;
+    if (is_empty(aio) || !is_type(aio, RAII_AIO))
+        return;
+
+    for (op = aio->inflight->head; !is_empty(op); op = next) {
+        next = op->next;
+        op->done = NULL;
+        aio_stop(op);
+    }
+
+    /* cancels complete once kernel lets go of their buffers */
+    while (aio->pending > 0)
+        aio_run(aio, -1);
+
+    aio_deliver(aio);
+#if defined(__linux__) && defined(RAII_IO_URING)
+    if (aio->is_uring)
+        aio_uring_close(aio->ring);
+#endif
+    RAII_FREE(aio->fds);
+    RAII_FREE(aio->polled);
+    aio->type = RAII_NULL;
+    RAII_FREE(aio);
+}
+
+static aio_op_t *aio_op(memory_t *scope, aio_t *aio, int opcode, raii_socket_t fd,
+                        size_t length, long long offset, aio_func done, void *data) {
+    aio_op_t *op;
+    if (UNLIKELY(is_empty(aio) || !is_type(aio, RAII_AIO)))
+        raii_panic("Failed! invalid `aio_t` queue");
+
+    op = try_calloc(1, sizeof(aio_op_t));
+    op->aio = aio;
+    op->opcode = opcode;
+    op->fd = fd;
+    op->length = length;
+    op->offset = offset;
+    op->done = done;
+    op->data = data;
+    if (length > 0)
+        op->buf = try_malloc(length);
+
+    if (!is_empty(scope))
+        raii_deferred(scope, (func_t)aio_op_free, op);
+
+    return op;
+}
+
+aio_op_t *aio_read(memory_t *scope, aio_t *aio, int fd, size_t length, long long offset, aio_func done, void *data) {
+    aio_op_t *op = aio_op(scope, aio, AIO_READ, (raii_socket_t)fd, length, offset, done, data);
+    aio_submit(op);
+    return op;
+}
+
+aio_op_t *aio_write(memory_t *scope, aio_t *aio, int fd, const void *buf, size_t length,
+                    long long offset, aio_func done, void *data) {
+    aio_op_t *op = aio_op(scope, aio, AIO_WRITE, (raii_socket_t)fd, length, offset, done, data);
+    if (length > 0)
+        memcpy(op->buf, buf, length);
+
+    aio_submit(op);
+    return op;
+}
+
+aio_op_t *aio_accept(memory_t *scope, aio_t *aio, raii_socket_t sock, aio_func done, void *data) {
+    aio_op_t *op = aio_op(scope, aio, AIO_ACCEPT, sock, 0, -1, done, data);
+    aio_submit(op);
+    return op;
+}
+
+void aio_op_free(aio_op_t *op) {
+    aio_t *aio;
+    if (is_empty(op))
+        return;
+
+    op->done = NULL;
+    op->waiter = NULL;
+    if (!is_empty(aio = op->aio) && aio_stop(op)) {
+        /* kernel may still be writing into `buf` */
+        while (op->list == aio->inflight)
+            aio_run(aio, -1);
+    }
+
+    aio_unlink(op);
+    RAII_FREE(op->buf);
+    RAII_FREE(op);
+}
+
+bool aio_cancel(aio_op_t *op) {
+    return !is_empty(op) && !op->is_done && aio_stop(op);
+}
+
+long aio_await(aio_op_t *op) {
+    routine_t *co = routine_current();
+    if (!is_empty(co)) {
+        op->waiter = co;
+        while (!op->is_done)
+            routine_suspend();
+
+        op->waiter = NULL;
+        return op->result;
+    }
+
+    while (!op->is_done) {
+        aio_run(op->aio, -1);
+        if (sched_count() > 0)
+            sched_run();
+    }
+
+    return op->result;
+}
+
+void aio_loop(aio_t *aio) {
+    do {
+        if (sched_count() > 0)
+            sched_run();
+
+        if (aio->pending == 0 && is_empty(aio->completed->head))
+            break;
+
+        aio_run(aio, -1);
+    } while (true);
+}
+
+RAII_INLINE long aio_result(aio_op_t *op) {
+    return op->result;
+}
+
+RAII_INLINE void *aio_buffer(aio_op_t *op) {
+    return op->buf;
+}
+
+RAII_INLINE bool aio_is_done(aio_op_t *op) {
+    return op->is_done;
+}
+
+RAII_INLINE size_t aio_pending(aio_t *aio) {
+    return aio->pending;
+}
+
+RAII_INLINE bool aio_is_uring(aio_t *aio) {
+#if defined(__linux__) && defined(RAII_IO_URING)
+    return aio->is_uring;
+#else
+    return false;
+#endif
+}
@@ -1,12 +1,63 @@
 #include "raii.h"
+#if !defined(_WIN32)
+    #include <sys/mman.h>
+#endif
+#if !defined(ARENA_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+    #include <emmintrin.h>
+    #define ARENA_SSE2 1
+#endif
 
 union header {
     arena_t tag;
     values_type slot;
 };
 
-static arena_t free_list = NULL;
-static int num_free = 0;
+/* Pages of one `arena_direct` request, ahead of it's block. */
+typedef union arena_map_u {
+    struct {
+        union arena_map_u *next;
+        /* bytes mapped */
+        size_t size;
+        /* bytes mapped, this and all older ones */
+        size_t total;
+    } head;
+    char pad[32];
+} arena_map_t;
+
+/* Per-thread cache of released chunks, only touched on chunk acquire/release. */
+typedef struct arena_cache_s {
+    arena_t list;
+    int count;
+    /* `arena_thread_bind`, chunks never go through overflow stack */
+    bool is_bound;
+    arena_stats_t stats;
+} arena_cache_t;
+
+static raii_tls_t arena_cache_key;
+static once_flag arena_cache_once = ONCE_FLAG_INIT;
+static volatile int arena_cache_closed = false;
+
+/* Process wide lock-free overflow stacks, one per chunk size class, `floor(log2(size))`,
+take chunks a thread cache can't hold. Entries are `ARENA_OVERFLOW_MAX` fixed slots,
+so stack heads hold slot index and an `ABA` tag, bumped on every change. */
+#define ARENA_CLASSES (sizeof(size_t) * 8)
+#define ARENA_SLOT_BITS 16
+#define ARENA_SLOT_MASK (((size_t)1 << ARENA_SLOT_BITS) - 1)
+#define ARENA_SLOT_TAG ((size_t)1 << ARENA_SLOT_BITS)
+
+typedef struct arena_slot_s {
+    arena_t chunk;
+    /* index, `1` based, of slot below on it's stack */
+    volatile size_t next;
+} arena_slot_t;
+
+static arena_slot_t arena_slots[ARENA_OVERFLOW_MAX + 1];
+static volatile size_t arena_overflow[ARENA_CLASSES];
+/* slots no longer holding a chunk */
+static volatile size_t arena_slots_free = 0;
+/* slots ever handed out, taken in order until all were */
+static volatile size_t arena_slots_used = 0;
+static volatile size_t arena_overflow_count = 0;
 
 /**
  * Will allow to translate back and forth between the pointer
@@ -14,122 +65,764 @@ static int num_free = 0;
  */
 #define ARENA_HEADER_SZ offsetof(union header, tag->base)
 
+static RAII_INLINE size_t arena_class(size_t size) {
+    size_t k = 0;
+    while (size >>= 1)
+        k++;
+
+    return k;
+}
+
+static RAII_INLINE size_t arena_chunk_size(arena_t chunk) {
+    return chunk->limit - (char *)((union header *)chunk + 1);
+}
+
+static void arena_slot_push(volatile size_t *head, size_t index) {
+    size_t top = atomic_size_load(head);
+    do {
+        atomic_size_store(&arena_slots[index].next, top & ARENA_SLOT_MASK);
+    } while (!atomic_size_cas(head, &top, index | ((top & ~ARENA_SLOT_MASK) + ARENA_SLOT_TAG)));
+}
+
+/* Index of slot popped off `head`, `0` if empty, tag makes a slot
+popped and pushed back meanwhile fail the swap. */
+static size_t arena_slot_pop(volatile size_t *head) {
+    size_t top = atomic_size_load(head), index, next;
+    do {
+        if (is_zero(index = top & ARENA_SLOT_MASK))
+            return 0;
+
+        next = atomic_size_load(&arena_slots[index].next);
+    } while (!atomic_size_cas(head, &top, next | ((top & ~ARENA_SLOT_MASK) + ARENA_SLOT_TAG)));
+
+    return index;
+}
+
+static void arena_overflow_push(arena_t chunk) {
+    size_t index;
+    if (arena_cache_closed) {
+        RAII_FREE(chunk);
+        return;
+    }
+
+    if (is_zero(index = arena_slot_pop(&arena_slots_free))) {
+        if ((index = atomic_size_add(&arena_slots_used, 1) + 1) > ARENA_OVERFLOW_MAX) {
+            atomic_size_sub(&arena_slots_used, 1);
+            RAII_FREE(chunk);
+            return;
+        }
+    }
+
+    arena_slots[index].chunk = chunk;
+    atomic_size_add(&arena_overflow_count, 1);
+    arena_slot_push(&arena_overflow[arena_class(arena_chunk_size(chunk))], index);
+}
+
+/* Top chunk of size `class` stack, `NULL` if none. */
+static arena_t arena_overflow_take(size_t class) {
+    size_t index;
+    arena_t chunk;
+    if (is_zero(index = arena_slot_pop(&arena_overflow[class])))
+        return NULL;
+
+    chunk = arena_slots[index].chunk;
+    arena_slots[index].chunk = NULL;
+    arena_slot_push(&arena_slots_free, index);
+    atomic_size_sub(&arena_overflow_count, 1);
+    chunk->next = NULL;
+    return chunk;
+}
+
+/* Whether chunk of `size` bytes holds `min` to `max` bytes, and is of no larger
+size class than next one up from `want`, so a small request never pins a big chunk. */
+static RAII_INLINE bool arena_chunk_fits(size_t size, size_t min, size_t max, size_t want) {
+    return size >= min && size <= max && arena_class(size) <= arena_class(want) + 1;
+}
+
+/* Unlink smallest chunk of `*list` that `arena_chunk_fits`, `NULL` if none. */
+static arena_t arena_chunk_take(arena_t *list, size_t min, size_t max, size_t want) {
+    arena_t chunk, *best = NULL;
+
+    for (; !is_empty(chunk = *list); list = &chunk->next) {
+        if (arena_chunk_fits(arena_chunk_size(chunk), min, max, want)
+            && (is_empty(best) || arena_chunk_size(chunk) < arena_chunk_size(*best)))
+            best = list;
+    }
+
+    if (is_empty(best))
+        return NULL;
+
+    chunk = *best;
+    *best = chunk->next;
+    chunk->next = NULL;
+    return chunk;
+}
+
+/* Chunk that `arena_chunk_fits` off overflow stacks, smallest size class first,
+only top of each looked at, one that does not fit goes back. */
+static arena_t arena_overflow_pop(size_t min, size_t max, size_t want) {
+    size_t i, last = arena_class(want) + 1;
+    arena_t chunk;
+    if (is_zero(atomic_size_load(&arena_overflow_count)))
+        return NULL;
+
+    for (i = arena_class(min); i <= last && i < ARENA_CLASSES; i++) {
+        if (is_empty(chunk = arena_overflow_take(i)))
+            continue;
+
+        if (arena_chunk_fits(arena_chunk_size(chunk), min, max, want))
+            return chunk;
+
+        arena_overflow_push(chunk);
+    }
+
+    return NULL;
+}
+
+static void arena_cache_drain(void *data) {
+    arena_cache_t *cache = (arena_cache_t *)data;
+    arena_t chunk;
+    if (is_empty(cache))
+        return;
+
+    while (!is_empty(chunk = cache->list)) {
+        cache->list = chunk->next;
+        if (cache->is_bound)
+            RAII_FREE(chunk);
+        else
+            arena_overflow_push(chunk);
+    }
+
+    RAII_FREE(cache);
+}
+
+static void arena_cache_shutdown(void) {
+    arena_t chunk;
+    size_t i;
+    arena_cache_closed = true;
+    arena_cache_drain(raii_tls_get(arena_cache_key));
+    raii_tls_set(arena_cache_key, NULL);
+    for (i = 0; i < ARENA_CLASSES; i++) {
+        while (!is_empty(chunk = arena_overflow_take(i)))
+            RAII_FREE(chunk);
+    }
+}
+
+static void arena_cache_setup(void) {
+    if (raii_tls_create(&arena_cache_key, 0, arena_cache_drain) != thrd_success)
+        raii_panic("Arena `raii_tls_create` failed!");
+
+    atexit(arena_cache_shutdown);
+}
+
+static arena_cache_t *arena_cache(bool create) {
+    arena_cache_t *cache;
+    call_once(&arena_cache_once, arena_cache_setup);
+    if (is_empty(cache = (arena_cache_t *)raii_tls_get(arena_cache_key)) && create && !arena_cache_closed) {
+        cache = try_calloc(1, sizeof(arena_cache_t));
+        if (raii_tls_set(arena_cache_key, cache) != thrd_success)
+            raii_panic("Arena `raii_tls_set` failed!");
+    }
+
+    return cache;
+}
+
+/* Returns an previously released chunk of `min` to `max` bytes, at most about `want` size,
+with `limit` marking it's end, from current `thread` cache first, then the global
+overflow stacks, others stay for later. */
+static arena_t arena_chunk_acquire(size_t min, size_t max, size_t want) {
+    arena_cache_t *cache = arena_cache(false);
+    arena_t chunk;
+#ifdef RAII_MEMCHECK
+    /* every chunk fresh, released ones stay inaccessible */
+    return NULL;
+#endif
+    if (!is_empty(cache) && !is_empty(chunk = arena_chunk_take(&cache->list, min, max, want))) {
+        cache->count--;
+        return chunk;
+    }
+
+    return !is_empty(cache) && cache->is_bound ? NULL : arena_overflow_pop(min, max, want);
+}
+
+static void arena_chunk_release(arena_t chunk, size_t threshold) {
+    arena_cache_t *cache;
+#ifdef RAII_MEMCHECK
+    raii_memcheck_chunk_free(chunk, chunk->limit);
+    return;
+#endif
+    cache = arena_cache(true);
+    if (!is_empty(cache) && cache->count < (int)threshold) {
+        chunk->next = cache->list;
+        cache->list = chunk;
+        cache->count++;
+    } else if (!is_empty(cache) && cache->is_bound) {
+        RAII_FREE(chunk);
+    } else {
+        arena_overflow_push(chunk);
+    }
+}
+
 arena_t arena_init(size_t threshold) {
     arena_t arena = try_malloc(sizeof(*arena));
     arena->next = NULL;
     arena->limit = arena->avail = NULL;
     arena->base = NULL;
+    arena->zeroed = NULL;
     arena->total = 0;
     arena->bytes = 0;
     arena->is_global = false;
-    arena->threshold = (threshold <= 0) ? 10 : threshold;
+    arena->threshold = (threshold <= 0) ? 10 : (unsigned int)threshold;
+    arena->chunk = MIN(arena->threshold * 1024, ARENA_CHUNK_MAX);
+    arena->max = ARENA_CHUNK_MAX;
+    arena->direct = ARENA_DIRECT;
+    arena->mapped = NULL;
+    arena->requested = 0;
+    arena->peak = 0;
+    arena->hits = 0;
+    arena->misses = 0;
+    arena->budget = 0;
     arena->type = RAII_ARENA + RAII_STRUCT;
+    RAII_MEMCHECKED(raii_memcheck_track(arena, sizeof(*arena)));
     return arena;
 }
 
+#ifdef RAII_STATS
+/* Chunks pushed by one `thread` can be popped by another, so totals are clamped. */
+static void arena_stats_pop(size_t size) {
+    arena_cache_t *cache = arena_cache(true);
+    if (is_empty(cache))
+        return;
+
+    cache->stats.reserved -= MIN(size, cache->stats.reserved);
+    cache->stats.chunks -= !is_zero(cache->stats.chunks);
+}
+
+static void arena_stats_grow(arena_t arena, size_t size, bool hit) {
+    arena_cache_t *cache = arena_cache(true);
+    if (hit)
+        arena->hits++;
+    else
+        arena->misses++;
+
+    arena->peak = MAX(arena->peak, arena->total);
+    if (is_empty(cache))
+        return;
+
+    if (hit)
+        cache->stats.hits++;
+    else
+        cache->stats.misses++;
+
+    cache->stats.reserved += size;
+    cache->stats.chunks++;
+    cache->stats.peak = MAX(cache->stats.peak, cache->stats.reserved);
+}
+#endif
+
+/* `avail` about to move back, bytes handed out up to it are no longer zero. */
+static RAII_INLINE void arena_dirty(arena_t arena) {
+    if (arena->zeroed < arena->avail)
+        arena->zeroed = arena->avail;
+}
+
+/* Detach current chunk, restoring the state saved in it's header,
+chunk's `limit` then marks it's end. */
+static arena_t arena_detach(arena_t arena) {
+    arena_t chunk = arena->next;
+    char *limit = arena->limit;
+
+    arena->next = chunk->next;
+    arena->avail = chunk->avail;
+    arena->limit = chunk->limit;
+    arena->zeroed = chunk->zeroed;
+    arena->bytes = chunk->bytes;
+    arena->total = chunk->total;
+
+    chunk->limit = limit;
+    RAII_POISON((union header *)chunk + 1, limit - (char *)((union header *)chunk + 1));
+    return chunk;
+}
+
+static void arena_release(arena_t arena, arena_t chunk) {
+    RAII_STAT(arena_stats_pop(arena_chunk_size(chunk)));
+    arena_chunk_release(chunk, arena->threshold);
+}
+
+/* Pop current chunk, back to `thread` cache. */
+static RAII_INLINE void arena_pop(arena_t arena) {
+    arena_release(arena, arena_detach(arena));
+}
+
+static RAII_INLINE size_t arena_mapped(arena_t arena) {
+    return is_empty(arena->mapped) ? 0 : ((arena_map_t *)arena->mapped)->head.total;
+}
+
+/* Unmap `arena_direct` pages newer than `until`. */
+static void arena_unmap(arena_t arena, void *until) {
+    arena_map_t *map;
+    while (!is_empty(arena->mapped) && arena->mapped != until) {
+        map = (arena_map_t *)arena->mapped;
+        arena->mapped = map->head.next;
+#if defined(_WIN32)
+        VirtualFree(map, 0, MEM_RELEASE);
+#else
+        munmap(map, map->head.size);
+#endif
+    }
+}
+
+static void arena_unwind(arena_t arena) {
+    while (!is_empty(arena->next) && is_type(arena->next, RAII_ARENA))
+        arena_pop(arena);
+
+    arena_unmap(arena, NULL);
+    arena->base = NULL;
+}
+
 void arena_free(arena_t arena) {
     if (is_empty(arena))
         return;
 
     if (is_type(arena, RAII_ARENA + RAII_STRUCT)) {
-        arena_clear(arena);
-        memset(arena, -1, sizeof(arena_t));
+        arena_unwind(arena);
+        RAII_MEMCHECKED(raii_memcheck_forget(arena));
+        memset(arena, -1, sizeof(*arena));
         RAII_FREE(arena);
         arena = NULL;
     }
 }
 
-void *arena_alloc(arena_t arena, long nbytes) {
+static RAII_INLINE bool arena_exceeded(arena_t arena, size_t nbytes) {
+    return !is_zero(arena->budget) && arena->total + arena_mapped(arena) + nbytes > arena->budget;
+}
+
+#define arena_is_direct(arena, nbytes) (!is_zero((arena)->direct) && (nbytes) >= (arena)->direct)
+
+/* Own pages for request past `direct`, zeroed, aligned to `align`,
+`NULL` with `ENOMEM` when out of memory or past budget, never throws. */
+static void *arena_map(arena_t arena, size_t nbytes, size_t align) {
+    size_t size = align_up(sizeof(arena_map_t), align) + nbytes;
+    arena_map_t *map;
+
+    if (UNLIKELY(arena_exceeded(arena, size))) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+#if defined(_WIN32)
+    map = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+    if ((map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED)
+        map = NULL;
+#endif
+    if (is_empty(map)) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    map->head.size = size;
+    map->head.total = arena_mapped(arena) + size;
+    map->head.next = (arena_map_t *)arena->mapped;
+    arena->mapped = map;
+    RAII_STAT(arena->requested += nbytes);
+    RAII_TRACED(raii_trace_event(RAII_TRACE_CHUNK, arena, 0, size));
+    return (char *)map + align_up(sizeof(arena_map_t), align);
+}
+
+/* Push a new chunk able to hold `nbytes`, smallest recycled one no larger than it would be,
+otherwise current growth size, doubling each time up to arena's `max`,
+`false` with `ENOMEM` when out of memory or past budget, never throws. */
+static bool arena_grow(arena_t arena, size_t nbytes, bool zero) {
+    arena_t ptr;
+    size_t size, want;
+    bool fresh = false;
+#ifdef RAII_STATS
+    bool hit = false;
+#endif
+    if (UNLIKELY(arena_exceeded(arena, nbytes))) {
+        errno = ENOMEM;
+        return false;
+    }
+
+    /* what a new chunk would be, growth size unless request is larger */
+    want = nbytes > arena->chunk ? align_up(nbytes, sizeof(union header)) : arena->chunk;
+    /* recycled one must also fit what budget has left */
+    if ((ptr = arena_chunk_acquire(nbytes, is_zero(arena->budget) ? SIZE_MAX
+                                   : arena->budget - arena->total - arena_mapped(arena), want)) != NULL) {
+        size = arena_chunk_size(ptr);
+        RAII_STAT(hit = true);
+    } else {
+        size = want;
+        if (nbytes <= arena->chunk)
+            arena->chunk = MIN(arena->chunk * 2, MAX(arena->max, arena->chunk));
+
+        /* last chunk shrinks to what budget has left */
+        if (!is_zero(arena->budget))
+            size = MAX(MIN(size, arena->budget - arena->total - arena_mapped(arena)), nbytes);
+
+#ifdef RAII_MEMCHECK
+        ptr = raii_memcheck_chunk(sizeof(union header) + size);
+#else
+        /* chunk sized for `arena_calloc` request alone, fresh pages come zeroed from system */
+        if ((fresh = zero && size == align_up(nbytes, sizeof(union header))))
+            ptr = RAII_CALLOC(1, sizeof(union header) + size);
+        else
+            ptr = RAII_MALLOC(sizeof(union header) + size);
+#endif
+        if (ptr == NULL) {
+            errno = ENOMEM;
+            return false;
+        }
+    }
+
+    if (is_empty(arena->base))
+        arena->base = ptr;
+
+    *ptr = *arena;
+    ptr->type = RAII_ARENA;
+    arena->avail = (char *)((union header *)ptr + 1);
+    arena->limit = arena->avail + size;
+    arena->zeroed = fresh ? arena->avail : arena->limit;
+    RAII_POISON(arena->avail, size);
+    arena->next = ptr;
+    arena->total += size;
+    RAII_STAT(arena_stats_grow(arena, size, hit));
+    RAII_TRACED(raii_trace_event(RAII_TRACE_CHUNK, arena, 0, size));
+    return true;
+}
+
+/* Throws `out_of_memory` if `nbytes` failed for budget, else `NULL`. */
+static void *arena_refuse(arena_t arena, size_t nbytes) {
+    C_API const char EX_NAME(out_of_memory)[];
+    if (arena_exceeded(arena, nbytes))
+        ex_throw(EX_NAME(out_of_memory), __FILE__, __LINE__, __FUNCTION__, "Arena budget exceeded!");
+
+    return NULL;
+}
+
+void *arena_take(arena_t arena, long nbytes) {
     if (is_empty(arena))
         raii_panic("Bad block, `NULL` detected!");
 
     RAII_ASSERT(nbytes > 0);
-    if (arena_capacity(arena) == arena_total(arena))
-        num_free = 0;
-
     nbytes = align_up(nbytes, sizeof(u16));
-    while (nbytes > arena->limit - arena->avail) {
-        arena_t ptr;
-        char *limit;
-        if ((ptr = free_list) != NULL) {
-            free_list = free_list->next;
-            num_free--;
-            limit = ptr->limit;
-        } else {
-            long m = align_up(sizeof(union header) + nbytes + arena->threshold * 1024, sizeof(u16));
-            arena->total += m;
-            ptr = RAII_MALLOC(arena->total);
-            if (ptr == NULL) {
-                errno = ENOMEM;
-                return NULL;
-            }
-
-            if (is_empty(arena->base))
-                arena->base = ptr;
-
-            limit = (char *)ptr + arena->total;
-        }
+    if (UNLIKELY(nbytes > arena->limit - arena->avail)) {
+        if (arena_is_direct(arena, (size_t)nbytes))
+            return arena_map(arena, nbytes, sizeof(u16));
 
-        *ptr = *arena;
-        arena->avail = (char *)((union header *)ptr + 1);
-        arena->limit = limit;
-        arena->next = ptr;
-        ptr->type = RAII_ARENA;
+        if (!arena_grow(arena, nbytes, false))
+            return NULL;
     }
 
-    if (arena->next)
-        arena->next->bytes = arena->bytes;
+    RAII_STAT(arena->requested += nbytes);
+    RAII_UNPOISON(arena->avail, nbytes);
+    arena->bytes = nbytes;
+    arena->avail += nbytes;
+
+    return arena->avail - nbytes;
+}
+
+void *arena_alloc(arena_t arena, long nbytes) {
+    void *ptr;
+    if (is_empty(arena))
+        raii_panic("Bad block, `NULL` detected!");
+
+    RAII_ASSERT(nbytes > 0);
+    nbytes = align_up(nbytes, sizeof(u16));
+    if (UNLIKELY(nbytes > arena->limit - arena->avail)) {
+        if (arena_is_direct(arena, (size_t)nbytes))
+            return !is_empty(ptr = arena_map(arena, nbytes, sizeof(u16))) ? ptr : arena_refuse(arena, nbytes);
 
+        if (!arena_grow(arena, nbytes, false))
+            return arena_refuse(arena, nbytes);
+    }
+
+    RAII_STAT(arena->requested += nbytes);
+    RAII_UNPOISON(arena->avail, nbytes);
     arena->bytes = nbytes;
     arena->avail += nbytes;
 
     return arena->avail - nbytes;
 }
 
+void *arena_alloc_aligned(arena_t arena, long nbytes, size_t align) {
+    char *ptr;
+    if (is_empty(arena))
+        raii_panic("Bad block, `NULL` detected!");
+
+    RAII_ASSERT(nbytes > 0 && align > 0 && (align & (align - 1)) == 0);
+    if (align <= sizeof(u16))
+        return arena_alloc(arena, nbytes);
+
+    nbytes = align_up(nbytes, sizeof(u16));
+    ptr = (char *)align_up((uintptr_t)arena->avail, align);
+    if (UNLIKELY(is_empty(arena->avail) || ptr + nbytes > arena->limit)) {
+        if (arena_is_direct(arena, (size_t)nbytes))
+            return !is_empty(ptr = arena_map(arena, nbytes, align)) ? ptr : arena_refuse(arena, nbytes);
+
+        if (!arena_grow(arena, nbytes + align - 1, false))
+            return arena_refuse(arena, nbytes + align - 1);
+
+        ptr = (char *)align_up((uintptr_t)arena->avail, align);
+    }
+
+    RAII_STAT(arena->requested += nbytes);
+    RAII_UNPOISON(ptr, nbytes);
+    arena->bytes = nbytes;
+    arena->avail = ptr + nbytes;
+
+    return ptr;
+}
+
+void *arena_realloc(arena_t arena, void *ptr, long old_size, long new_size) {
+    arena_map_t *map;
+    void *block;
+    if (is_empty(ptr))
+        return arena_alloc(arena, new_size);
+
+    RAII_ASSERT(new_size > 0 && old_size >= 0);
+    new_size = align_up(new_size, sizeof(u16));
+    if ((char *)ptr == arena->avail - arena->bytes
+        && new_size <= arena->limit - (char *)ptr) {
+        RAII_STAT(arena->requested += new_size > (long)arena->bytes ? new_size - arena->bytes : 0);
+        RAII_UNPOISON(ptr, new_size);
+        arena_dirty(arena);
+        arena->avail = (char *)ptr + new_size;
+        arena->bytes = new_size;
+        return ptr;
+    }
+
+    if (new_size <= old_size)
+        return ptr;
+
+    /* newest `arena_direct` block, room left in it's last page */
+    if (!is_empty(map = (arena_map_t *)arena->mapped) && (char *)ptr > (char *)map
+        && (char *)ptr + new_size <= (char *)map + map->head.size)
+        return ptr;
+
+    if (!is_empty(block = arena_alloc(arena, new_size)))
+        memcpy(block, ptr, old_size);
+
+    return block;
+}
+
+/* Clear `size` bytes, large ones by streaming stores bypassing cache. */
+static void arena_zero(char *ptr, size_t size) {
+#ifdef ARENA_SSE2
+    __m128i zero = _mm_setzero_si128();
+    char *end;
+    if (size >= ARENA_ZERO_STREAM) {
+        end = (char *)align_up((uintptr_t)ptr, 16);
+        memset(ptr, 0, end - ptr);
+        size -= end - ptr;
+        for (ptr = end, end = ptr + (size & ~(size_t)63); ptr < end; ptr += 64) {
+            _mm_stream_si128((__m128i *)ptr, zero);
+            _mm_stream_si128((__m128i *)(ptr + 16), zero);
+            _mm_stream_si128((__m128i *)(ptr + 32), zero);
+            _mm_stream_si128((__m128i *)(ptr + 48), zero);
+        }
+
+        _mm_sfence();
+        size &= 63;
+    }
+#endif
+    memset(ptr, 0, size);
+}
+
 void *arena_calloc(arena_t arena, long count, long nbytes) {
+    size_t size = (size_t)count * (size_t)nbytes;
+    char *ptr;
+
     RAII_ASSERT(count > 0);
-    void *ptr = arena_alloc(arena, count * nbytes);
-    memset(ptr, 0, count * nbytes);
+    if (UNLIKELY(is_empty(arena)))
+        raii_panic("Bad block, `NULL` detected!");
+
+    size = align_up(size, sizeof(u16));
+    if (size > (size_t)(arena->limit - arena->avail)) {
+        /* fresh pages, nothing to clear */
+        if (arena_is_direct(arena, size))
+            return !is_empty(ptr = arena_map(arena, size, sizeof(u16))) ? ptr : arena_refuse(arena, size);
+
+        if (!arena_grow(arena, size, true))
+            return arena_refuse(arena, size);
+    }
+
+    RAII_STAT(arena->requested += size);
+    RAII_UNPOISON(arena->avail, size);
+    ptr = arena->avail;
+    arena->bytes = size;
+    arena->avail += size;
+    /* only part below known zero bytes needs clearing */
+    if (ptr < arena->zeroed)
+        arena_zero(ptr, MIN(size, (size_t)(arena->zeroed - ptr)));
+
     return ptr;
 }
 
 void arena_clear(arena_t arena) {
-    if (is_empty(arena))
+    if (is_empty(arena) || arena->is_global)
         return;
 
-    while (!arena->is_global && arena->next && is_type(arena->next, RAII_ARENA)) {
-        arena_t tmp = arena->next;
-        if (num_free < (int)arena->threshold) {
-            arena->next->next = free_list;
-            free_list = arena->next;
-            num_free++;
-            free_list->limit = arena->limit;
-            if (is_zero(free_list->bytes))
-                arena->avail -= arena->bytes;
-            else
-                arena->avail -= free_list->bytes;
+    arena_unwind(arena);
+}
+
+void arena_reset(arena_t arena) {
+    arena_t chunk, keep = NULL;
+    size_t size, kept = 0;
+    char *limit;
+    if (is_empty(arena) || arena->is_global)
+        return;
+
+    arena_unmap(arena, NULL);
+    /* newest first, so of same sized chunks, most recently used one stays */
+    while (!is_empty(arena->next) && is_type(arena->next, RAII_ARENA)) {
+        chunk = arena_detach(arena);
+        if ((size = arena_chunk_size(chunk)) > kept) {
+            if (!is_empty(keep))
+                arena_release(arena, keep);
+
+            keep = chunk;
+            kept = size;
         } else {
-            memset(arena->next, -1, sizeof(arena_t));
-            RAII_FREE(arena->next);
-            arena->next = NULL;
+            arena_release(arena, chunk);
         }
+    }
+
+    arena->base = NULL;
+    if (is_empty(keep))
+        return;
+
+    /* attach again as only chunk, as `arena_grow` would */
+    limit = keep->limit;
+    arena->base = keep;
+    *keep = *arena;
+    keep->type = RAII_ARENA;
+    arena->avail = (char *)((union header *)keep + 1);
+    arena->limit = limit;
+    arena->zeroed = limit;
+    arena->bytes = 0;
+    arena->next = keep;
+    arena->total += kept;
+}
 
-        arena = tmp;
+RAII_INLINE arena_mark_t arena_mark(arena_t arena) {
+    arena_mark_t mark;
+    mark.chunk = arena->next;
+    mark.avail = arena->avail;
+    mark.bytes = arena->bytes;
+    mark.mapped = arena->mapped;
+    return mark;
+}
+
+void arena_rewind(arena_t arena, arena_mark_t mark) {
+    if (is_empty(arena))
+        return;
+
+    arena_unmap(arena, mark.mapped);
+    while (arena->next != mark.chunk && !is_empty(arena->next) && is_type(arena->next, RAII_ARENA))
+        arena_pop(arena);
+
+    if (arena->next == mark.chunk && !is_empty(mark.chunk)) {
+        RAII_POISON(mark.avail, arena->avail - mark.avail);
+        arena_dirty(arena);
+        arena->avail = mark.avail;
+        arena->bytes = mark.bytes;
+    } else if (is_empty(arena->next)) {
+        arena->base = NULL;
     }
 }
 
+/* Savepoint allocated from the arena itself, rewinding also releases it. */
+typedef struct arena_savepoint_s {
+    arena_t arena;
+    arena_mark_t mark;
+} arena_savepoint_t;
+
+static void arena_savepoint_rewind(void *data) {
+    arena_savepoint_t *point = (arena_savepoint_t *)data;
+    arena_rewind(point->arena, point->mark);
+}
+
+void arena_rewind_by(memory_t *scope, arena_t arena) {
+    arena_mark_t mark = arena_mark(arena);
+    arena_savepoint_t *point = arena_alloc(arena, sizeof(arena_savepoint_t));
+    if (is_empty(point))
+        raii_panic("Arena savepoint failed!");
+
+    point->arena = arena;
+    point->mark = mark;
+    raii_deferred(scope, arena_savepoint_rewind, point);
+}
+
+RAII_INLINE void arena_budget(arena_t arena, size_t bytes) {
+    arena->budget = bytes;
+}
+
+RAII_INLINE void arena_direct(arena_t arena, size_t bytes) {
+    arena->direct = (unsigned int)MIN(bytes, UINT_MAX);
+}
+
 void arena_print(const arena_t arena) {
-    printf("capacity: %zu, total: %zu, free_list:: %d\n", arena_capacity(arena), arena_total(arena), num_free);
+    arena_cache_t *cache = arena_cache(false);
+    printf("capacity: %zu, total: %zu, free_list:: %d, overflow: %zu\n",
+           arena_capacity(arena), arena_total(arena),
+           is_empty(cache) ? 0 : cache->count, atomic_size_load(&arena_overflow_count));
+#ifdef RAII_STATS
+    arena_stats_t stats = arena_stats(arena);
+    printf("requested: %zu, reserved: %zu, peak: %zu, chunks: %zu, hits: %zu, misses: %zu\n",
+           stats.requested, stats.reserved, stats.peak, stats.chunks, stats.hits, stats.misses);
+#endif
+}
+
+arena_stats_t arena_stats(const arena_t arena) {
+    arena_stats_t stats;
+    memset(&stats, 0, sizeof(stats));
+#ifdef RAII_STATS
+    arena_t chunk;
+    if (is_empty(arena) || !is_type(arena, RAII_ARENA + RAII_STRUCT))
+        return stats;
+
+    for (chunk = arena->next; !is_empty(chunk) && is_type(chunk, RAII_ARENA); chunk = chunk->next)
+        stats.chunks++;
+
+    stats.requested = arena->requested;
+    stats.reserved = arena->total;
+    stats.peak = arena->peak;
+    stats.hits = arena->hits;
+    stats.misses = arena->misses;
+#endif
+    if (!is_empty(arena) && is_type(arena, RAII_ARENA + RAII_STRUCT))
+        stats.mapped = arena_mapped(arena);
+
+    return stats;
+}
+
+void arena_thread_bind(void) {
+    arena_cache_t *cache = arena_cache(true);
+    if (!is_empty(cache))
+        cache->is_bound = true;
+}
+
+arena_stats_t arena_thread_stats(void) {
+    arena_stats_t stats;
+    memset(&stats, 0, sizeof(stats));
+#ifdef RAII_STATS
+    arena_cache_t *cache = arena_cache(false);
+    if (!is_empty(cache))
+        stats = cache->stats;
+#endif
+    return stats;
 }
 
-RAII_INLINE size_t arena_capacity(const arena_t arena) {
+RAII_INLINE size_t (arena_capacity)(const arena_t arena) {
     return !is_empty(arena) && is_type(arena, RAII_ARENA + RAII_STRUCT)
         ? arena->limit - arena->avail
         : 0;
 }
 
-RAII_INLINE size_t arena_total(const arena_t arena) {
+RAII_INLINE size_t (arena_total)(const arena_t arena) {
     return !is_empty(arena) && is_type(arena, RAII_ARENA + RAII_STRUCT)
-        ? MAX(arena->total, sizeof(union header)) - sizeof(union header)
+        ? arena->total
         : 0;
 }
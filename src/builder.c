@@ -0,0 +1,153 @@
+#include "raii.h"
+
+#ifndef va_copy
+    #define va_copy(dest, src) ((dest) = (src))
+#endif
+
+struct sb_s {
+    raii_type type;
+    char *data;
+    size_t length;
+    /* bytes `data` holds, including terminating `NUL` */
+    size_t capacity;
+    /* storage of `data`, `NULL` for heap */
+    arena_t arena;
+};
+
+/* Make room for `extra` more characters, doubling, arena buffer grows in place when last. */
+static char *sb_reserve(sb_t *sb, size_t extra) {
+    size_t need = sb->length + extra + 1, capacity = MAX(sb->capacity, 32);
+    char *data;
+
+    if (LIKELY(need <= sb->capacity))
+        return sb->data + sb->length;
+
+    while (capacity < need)
+        capacity <<= 1;
+
+    data = is_empty(sb->arena)
+        ? RAII_REALLOC(sb->data, capacity)
+        : arena_realloc(sb->arena, sb->data, (long)sb->capacity, (long)capacity);
+    if (UNLIKELY(is_empty(data)))
+        raii_panic("String builder allocation failed!");
+
+    sb->data = data;
+    sb->capacity = capacity;
+    return sb->data + sb->length;
+}
+
+static sb_t *sb_new(sb_t *sb, arena_t arena, size_t capacity) {
+    sb->type = RAII_STRING;
+    sb->arena = arena;
+    sb->data = NULL;
+    sb->length = 0;
+    sb->capacity = 0;
+    sb_reserve(sb, capacity);
+    sb->data[0] = '\0';
+    return sb;
+}
+
+sb_t *sb_create(memory_t *scope, size_t capacity) {
+    sb_t *sb;
+    if (!is_empty(scope) && scope->is_arena && !is_empty(scope->arena))
+        return sb_arena(scope->arena, capacity);
+
+    sb = sb_new(try_calloc(1, sizeof(sb_t)), NULL, capacity);
+    if (!is_empty(scope))
+        raii_deferred(scope, (func_t)sb_free, sb);
+
+    return sb;
+}
+
+RAII_INLINE sb_t *sb_arena(arena_t arena, size_t capacity) {
+    if (UNLIKELY(is_empty(arena)))
+        raii_panic("Failed! `sb_arena` invalid arena");
+
+    return sb_new(arena_alloc_aligned(arena, sizeof(sb_t), sizeof(void *)), arena, capacity);
+}
+
+void sb_free(sb_t *sb) {
+    if (is_empty(sb) || !is_type(sb, RAII_STRING))
+        return;
+
+    sb->type = RAII_NULL;
+    if (is_empty(sb->arena)) {
+        RAII_FREE(sb->data);
+        RAII_FREE(sb);
+    }
+}
+
+void sb_append(sb_t *sb, const char *str, size_t length) {
+    memcpy(sb_reserve(sb, length), str, length);
+    sb->length += length;
+    sb->data[sb->length] = '\0';
+}
+
+RAII_INLINE void sb_puts(sb_t *sb, const char *str) {
+    sb_append(sb, str, strlen(str));
+}
+
+void sb_putc(sb_t *sb, char c) {
+    *sb_reserve(sb, 1) = c;
+    sb->data[++sb->length] = '\0';
+}
+
+int sb_vprintf(sb_t *sb, const char *fmt, va_list args) {
+    size_t room = sb->capacity - sb->length;
+    va_list copy;
+    int n;
+
+    /* format straight into buffer, once more only if it did not fit */
+    va_copy(copy, args);
+    n = vsnprintf(sb->data + sb->length, room, fmt, copy);
+    va_end(copy);
+    if (UNLIKELY(n < 0)) {
+        sb->data[sb->length] = '\0';
+        return n;
+    }
+
+    if ((size_t)n >= room)
+        vsnprintf(sb_reserve(sb, (size_t)n), (size_t)n + 1, fmt, args);
+
+    sb->length += (size_t)n;
+    return n;
+}
+
+int sb_printf(sb_t *sb, const char *fmt, ...) {
+    va_list args;
+    int n;
+
+    va_start(args, fmt);
+    n = sb_vprintf(sb, fmt, args);
+    va_end(args);
+    return n;
+}
+
+RAII_INLINE const char *sb_str(sb_t *sb) {
+    return sb->data;
+}
+
+RAII_INLINE size_t sb_len(sb_t *sb) {
+    return sb->length;
+}
+
+void sb_truncate(sb_t *sb, size_t length) {
+    if (length < sb->length) {
+        sb->length = length;
+        sb->data[length] = '\0';
+    }
+}
+
+RAII_INLINE void sb_clear(sb_t *sb) {
+    sb_truncate(sb, 0);
+}
+
+char *sb_steal(sb_t *sb) {
+    char *data = sb->data;
+    sb->data = NULL;
+    sb->length = 0;
+    sb->capacity = 0;
+    sb_reserve(sb, 0);
+    sb->data[0] = '\0';
+    return data;
+}
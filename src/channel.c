@@ -0,0 +1,313 @@
+#include "raii.h"
+
+/* Ring slot, `seq` tells which lap of `head`/`tail` may use it next. */
+typedef struct {
+    volatile size_t seq;
+    void *data;
+} channel_cell_t;
+
+/* Coroutine parked on a channel, lives on it's own stack while parked. */
+typedef struct channel_waiter_s channel_waiter_t;
+struct channel_waiter_s {
+    routine_t *co;
+    channel_waiter_t *next;
+    /* still listed, unlisted by whoever wakes it */
+    bool is_parked;
+};
+
+/* Bounded lock-free MPMC ring, `mutex`, condition variables and parked lists are
+only touched by blocked callers, and by whoever wakes them. */
+struct channel_s {
+    raii_type type;
+    size_t mask;
+    channel_cell_t *cells;
+    char pad0[64];
+    volatile size_t tail;
+    char pad1[64 - sizeof(size_t)];
+    volatile size_t head;
+    char pad2[64 - sizeof(size_t)];
+    volatile int closed;
+    /* blocked `thread`s and coroutines */
+    volatile size_t send_waiters;
+    volatile size_t recv_waiters;
+    channel_waiter_t *send_parked;
+    channel_waiter_t *recv_parked;
+    mtx_t mutex[1];
+    cnd_t not_full[1];
+    cnd_t not_empty[1];
+};
+
+static bool channel_push(channel_t *ch, void *value) {
+    size_t pos = atomic_size_load(&ch->tail);
+    channel_cell_t *cell;
+    intptr_t diff;
+
+    for (;;) {
+        cell = &ch->cells[pos & ch->mask];
+        diff = (intptr_t)atomic_size_load(&cell->seq) - (intptr_t)pos;
+        if (diff == 0) {
+            if (atomic_size_cas(&ch->tail, &pos, pos + 1))
+                break;
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = atomic_size_load(&ch->tail);
+        }
+    }
+
+    cell->data = value;
+    atomic_size_store(&cell->seq, pos + 1);
+    return true;
+}
+
+static bool channel_pop(channel_t *ch, void **value) {
+    size_t pos = atomic_size_load(&ch->head);
+    channel_cell_t *cell;
+    intptr_t diff;
+
+    for (;;) {
+        cell = &ch->cells[pos & ch->mask];
+        diff = (intptr_t)atomic_size_load(&cell->seq) - (intptr_t)(pos + 1);
+        if (diff == 0) {
+            if (atomic_size_cas(&ch->head, &pos, pos + 1))
+                break;
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = atomic_size_load(&ch->head);
+        }
+    }
+
+    if (!is_empty(value))
+        *value = cell->data;
+
+    atomic_size_store(&cell->seq, pos + ch->mask + 1);
+    return true;
+}
+
+/* Wake all, or first, coroutine on `parked` list, caller holds `mutex`. */
+static bool channel_unpark(channel_waiter_t **parked, bool all) {
+    channel_waiter_t *waiter;
+    bool woke = false;
+
+    while (!is_empty(waiter = *parked)) {
+        *parked = waiter->next;
+        waiter->is_parked = false;
+        routine_wake(waiter->co);
+        woke = true;
+        if (!all)
+            break;
+    }
+
+    return woke;
+}
+
+/* Wake one coroutine parked, or else `thread` blocked on `cond`, only if any,
+`locked` when caller holds `mutex`. */
+static void channel_notify(channel_t *ch, cnd_t *cond, volatile size_t *waiters,
+                           channel_waiter_t **parked, bool locked) {
+    if (is_zero(atomic_size_load(waiters)))
+        return;
+
+    if (!locked)
+        mtx_lock(ch->mutex);
+
+    if (!channel_unpark(parked, false))
+        cnd_signal(cond);
+
+    if (!locked)
+        mtx_unlock(ch->mutex);
+}
+
+static bool channel_attempt(channel_t *ch, bool sending, void **value, bool locked) {
+    if (sending) {
+        if (atomic_int_load(&ch->closed) || !channel_push(ch, *value))
+            return false;
+
+        channel_notify(ch, ch->not_empty, &ch->recv_waiters, &ch->recv_parked, locked);
+        return true;
+    }
+
+    if (!channel_pop(ch, value))
+        return false;
+
+    channel_notify(ch, ch->not_full, &ch->send_waiters, &ch->send_parked, locked);
+    return true;
+}
+
+/* Coroutine with `deadline`, yields to it's scheduler between attempts,
+as no timer could wake it parked, counted a waiter so `channel_free` waits for it. */
+static bool channel_poll(channel_t *ch, bool sending, void **value, const struct timespec *deadline) {
+    volatile size_t *waiters = sending ? &ch->send_waiters : &ch->recv_waiters;
+    bool done;
+
+    atomic_size_add(waiters, 1);
+    while (!(done = channel_attempt(ch, sending, value, false))) {
+        if (atomic_int_load(&ch->closed)) {
+            done = !sending && channel_attempt(ch, sending, value, false);
+            break;
+        }
+
+        if (time_expired(deadline))
+            break;
+
+        routine_yield();
+    }
+
+    atomic_size_sub(waiters, 1);
+    return done;
+}
+
+/* Retry until done, `closed`, or past `deadline` if given. Coroutines park,
+suspended on channel's list, till woken, `thread`s block on condition variable. */
+static bool channel_block(channel_t *ch, bool sending, void **value, const struct timespec *deadline) {
+    volatile size_t *waiters = sending ? &ch->send_waiters : &ch->recv_waiters;
+    channel_waiter_t **parked = sending ? &ch->send_parked : &ch->recv_parked;
+    cnd_t *cond = sending ? ch->not_full : ch->not_empty;
+    channel_waiter_t waiter;
+    bool done;
+
+    if (channel_attempt(ch, sending, value, false))
+        return true;
+
+    waiter.co = routine_current();
+    waiter.next = NULL;
+    waiter.is_parked = false;
+    if (!is_empty(waiter.co) && !is_empty((void *)deadline))
+        return channel_poll(ch, sending, value, deadline);
+
+    mtx_lock(ch->mutex);
+    atomic_size_add(waiters, 1);
+    while (!(done = channel_attempt(ch, sending, value, true))) {
+        if (atomic_int_load(&ch->closed)) {
+            done = !sending && channel_attempt(ch, sending, value, true);
+            break;
+        }
+
+        if (!is_empty(waiter.co)) {
+            /* only an listed waiter is added, a stray `routine_resume` just parks again */
+            if (!waiter.is_parked) {
+                waiter.is_parked = true;
+                waiter.next = *parked;
+                *parked = &waiter;
+            }
+
+            mtx_unlock(ch->mutex);
+            routine_suspend();
+            mtx_lock(ch->mutex);
+        } else if (is_empty((void *)deadline)) {
+            cnd_wait(cond, ch->mutex);
+        } else if (cnd_timedwait(cond, ch->mutex, deadline) == thrd_timedout) {
+            done = channel_attempt(ch, sending, value, true);
+            break;
+        }
+    }
+
+    /* left by a stray `routine_resume`, still listed */
+    if (waiter.is_parked) {
+        while (*parked != &waiter)
+            parked = &(*parked)->next;
+
+        *parked = waiter.next;
+    }
+
+    atomic_size_sub(waiters, 1);
+    mtx_unlock(ch->mutex);
+    return done;
+}
+
+channel_t *channel_create(size_t capacity) {
+    channel_t *ch = try_calloc(1, sizeof(channel_t));
+    /* filled slot of an single slot ring, would look empty to next lap */
+    size_t i, size = 2;
+
+    while (size < capacity)
+        size <<= 1;
+
+    ch->type = RAII_CHANNEL;
+    ch->mask = size - 1;
+    ch->cells = try_calloc((int)size, sizeof(channel_cell_t));
+    for (i = 0; i < size; i++)
+        ch->cells[i].seq = i;
+
+    if (mtx_init(ch->mutex, mtx_plain) != thrd_success
+        || cnd_init(ch->not_full) != thrd_success
+        || cnd_init(ch->not_empty) != thrd_success)
+        raii_panic("Channel `mtx_init/cnd_init` failed!");
+
+    return ch;
+}
+
+channel_t *channel_by(memory_t *scope, size_t capacity) {
+    channel_t *ch = channel_create(capacity);
+    raii_deferred(scope, (func_t)channel_free, ch);
+    return ch;
+}
+
+void channel_close(channel_t *ch) {
+    if (is_empty(ch) || !is_type(ch, RAII_CHANNEL) || atomic_int_swap(&ch->closed, 1))
+        return;
+
+    mtx_lock(ch->mutex);
+    cnd_broadcast(ch->not_full);
+    cnd_broadcast(ch->not_empty);
+    channel_unpark(&ch->send_parked, true);
+    channel_unpark(&ch->recv_parked, true);
+    mtx_unlock(ch->mutex);
+}
+
+RAII_INLINE bool channel_is_closed(channel_t *ch) {
+    return atomic_int_load(&ch->closed) != 0;
+}
+
+void channel_free(channel_t *ch) {
+    if (is_empty(ch) || !is_type(ch, RAII_CHANNEL))
+        return;
+
+    channel_close(ch);
+    /* blocked callers leave holding `mutex`, after dropping their count, woken
+    coroutines of this `thread` scheduler need it to run */
+    while (!is_zero(atomic_size_load(&ch->send_waiters) + atomic_size_load(&ch->recv_waiters))) {
+        if (!routine_yield()) {
+            if (sched_count() > 0)
+                sched_run();
+            else
+                thrd_yield();
+        }
+    }
+
+    mtx_lock(ch->mutex);
+    mtx_unlock(ch->mutex);
+    ch->type = RAII_NULL;
+    mtx_destroy(ch->mutex);
+    cnd_destroy(ch->not_full);
+    cnd_destroy(ch->not_empty);
+    RAII_FREE(ch->cells);
+    RAII_FREE(ch);
+}
+
+RAII_INLINE bool channel_send(channel_t *ch, void *value) {
+    return channel_block(ch, true, &value, NULL);
+}
+
+RAII_INLINE bool channel_try_send(channel_t *ch, void *value) {
+    return channel_attempt(ch, true, &value, false);
+}
+
+bool channel_send_for(channel_t *ch, void *value, unsigned int ms) {
+    struct timespec deadline = time_deadline(ms);
+    return channel_block(ch, true, &value, &deadline);
+}
+
+RAII_INLINE bool channel_recv(channel_t *ch, void **value) {
+    return channel_block(ch, false, value, NULL);
+}
+
+RAII_INLINE bool channel_try_recv(channel_t *ch, void **value) {
+    return channel_attempt(ch, false, value, false);
+}
+
+bool channel_recv_for(channel_t *ch, void **value, unsigned int ms) {
+    struct timespec deadline = time_deadline(ms);
+    return channel_block(ch, false, value, &deadline);
+}
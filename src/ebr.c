@@ -0,0 +1,170 @@
+#include "raii.h"
+
+/* Retired object, waiting two epoch advances. */
+typedef struct ebr_node_s ebr_node_t;
+struct ebr_node_s {
+    void *ptr;
+    func_t dtor;
+    ebr_node_t *next;
+};
+
+/* Per `thread` epoch record, listed for good once made, recycled by later `thread`s,
+along with anything still retired on it. */
+typedef struct ebr_record_s ebr_record_t;
+struct ebr_record_s {
+    /* epoch seen by `ebr_enter`, `EBR_ACTIVE` set while inside */
+    volatile size_t epoch;
+    volatile int used;
+    int depth;
+    size_t retired;
+    ebr_node_t *limbo[3];
+    ebr_record_t *next;
+};
+
+#define EBR_ACTIVE ((size_t)1)
+/* retired objects that trigger an advance attempt */
+#ifndef EBR_THRESHOLD
+    #define EBR_THRESHOLD 64
+#endif
+
+/* epochs step by `2`, low bit is `EBR_ACTIVE` of records */
+static volatile size_t ebr_global = 2;
+static void *volatile ebr_records = NULL;
+static raii_tls_t ebr_key;
+static once_flag ebr_once = ONCE_FLAG_INIT;
+
+static void ebr_release(void *arg);
+static void ebr_setup(void) {
+    if (raii_tls_create(&ebr_key, 0, ebr_release) != thrd_success)
+        raii_panic("Ebr `raii_tls_create` failed!");
+}
+
+static ebr_record_t *ebr_record(void) {
+    ebr_record_t *rec;
+    void *head;
+    int unused;
+
+    call_once(&ebr_once, ebr_setup);
+    if (!is_empty(rec = (ebr_record_t *)raii_tls_get(ebr_key)))
+        return rec;
+
+    for (rec = (ebr_record_t *)atomic_ptr_load(&ebr_records); !is_empty(rec); rec = rec->next) {
+        unused = 0;
+        if (atomic_int_load(&rec->used) == 0 && atomic_int_cas(&rec->used, &unused, 1))
+            break;
+    }
+
+    if (is_empty(rec)) {
+        rec = try_calloc(1, sizeof(ebr_record_t));
+        rec->used = 1;
+        head = atomic_ptr_load(&ebr_records);
+        do {
+            rec->next = (ebr_record_t *)head;
+        } while (!atomic_ptr_cas(&ebr_records, &head, rec));
+    }
+
+    if (raii_tls_set(ebr_key, rec) != thrd_success)
+        raii_panic("Ebr `raii_tls_set` failed!");
+
+    return rec;
+}
+
+static void ebr_release(void *arg) {
+    ebr_record_t *rec = (ebr_record_t *)arg;
+    rec->depth = 0;
+    atomic_size_store(&rec->epoch, 0);
+    atomic_int_store(&rec->used, 0);
+}
+
+/* Run `dtor`s of one bucket, on calling `thread`, as it's defers would. */
+static void ebr_free(ebr_record_t *rec, int bucket) {
+    ebr_node_t *node = rec->limbo[bucket], *next;
+    rec->limbo[bucket] = NULL;
+    for (; !is_empty(node); node = next) {
+        next = node->next;
+        node->dtor(node->ptr);
+        RAII_FREE(node);
+        rec->retired--;
+    }
+}
+
+/* Advance global epoch, if every active record has seen current one. */
+static bool ebr_advance(size_t epoch) {
+    ebr_record_t *rec;
+    size_t seen;
+
+    for (rec = (ebr_record_t *)atomic_ptr_load(&ebr_records); !is_empty(rec); rec = rec->next) {
+        seen = atomic_size_load(&rec->epoch);
+        if ((seen & EBR_ACTIVE) && (seen & ~EBR_ACTIVE) != epoch)
+            return false;
+    }
+
+    /* failing, another `thread` advanced it */
+    atomic_size_cas(&ebr_global, &epoch, epoch + 2);
+    return true;
+}
+
+/* Objects retired two epochs back can no longer be reached by any reader,
+each advance makes one more bucket safe, till an active reader lags. */
+static void ebr_collect(ebr_record_t *rec) {
+    bool advanced = true;
+    int round;
+
+    for (round = 0; round < 3 && advanced && !is_zero(rec->retired); round++) {
+        advanced = ebr_advance(atomic_size_load(&ebr_global));
+        ebr_free(rec, (int)((atomic_size_load(&ebr_global) / 2 + 1) % 3));
+    }
+}
+
+void ebr_enter(void) {
+    ebr_record_t *rec = ebr_record();
+    if (rec->depth++ == 0)
+        atomic_size_store(&rec->epoch, atomic_size_load(&ebr_global) | EBR_ACTIVE);
+}
+
+void ebr_exit(void) {
+    ebr_record_t *rec = ebr_record();
+    RAII_ASSERT(rec->depth > 0);
+    if (--rec->depth == 0)
+        atomic_size_store(&rec->epoch, 0);
+}
+
+static void ebr_exit_func(void *arg) {
+    ebr_exit();
+}
+
+void ebr_guard(memory_t *scope) {
+    ebr_enter();
+    raii_deferred(scope, ebr_exit_func, NULL);
+}
+
+void ebr_retire(void *ptr, func_t dtor) {
+    ebr_record_t *rec = ebr_record();
+    ebr_node_t *node = try_malloc(sizeof(ebr_node_t));
+    int bucket = (int)((atomic_size_load(&ebr_global) / 2) % 3);
+
+    node->ptr = ptr;
+    node->dtor = dtor;
+    node->next = rec->limbo[bucket];
+    rec->limbo[bucket] = node;
+    if (++rec->retired >= EBR_THRESHOLD && rec->depth == 0)
+        ebr_collect(rec);
+}
+
+size_t ebr_flush(void) {
+    ebr_record_t *rec;
+    call_once(&ebr_once, ebr_setup);
+    if (is_empty(rec = (ebr_record_t *)raii_tls_get(ebr_key)) || is_zero(rec->retired))
+        return 0;
+
+    if (rec->depth == 0)
+        ebr_collect(rec);
+
+    return rec->retired;
+}
+
+RAII_INLINE size_t ebr_pending(void) {
+    ebr_record_t *rec;
+    call_once(&ebr_once, ebr_setup);
+    return is_empty(rec = (ebr_record_t *)raii_tls_get(ebr_key)) ? 0 : rec->retired;
+}
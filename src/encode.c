@@ -0,0 +1,319 @@
+#include "raii.h"
+
+/* Message header, native byte order, for processes of same host. */
+typedef struct {
+    /* whole message, header included */
+    uint32_t size;
+    uint16_t count;
+    /* `A` for `args_encode`, `R` for `reflect_encode` */
+    char kind;
+    char reserved;
+} encode_header_t;
+
+#define ENCODE_NULL_STR ((uint32_t)-1)
+
+typedef struct {
+    char *at;
+    char *end;
+    size_t need;
+} encode_out_t;
+
+typedef struct {
+    const char *at;
+    const char *end;
+} encode_in_t;
+
+/* Bytes past buffer end are only counted, so callers learn size needed. */
+static void encode_put(encode_out_t *out, const void *src, size_t length) {
+    if (!is_empty(out->at) && length <= (size_t)(out->end - out->at)) {
+        memcpy(out->at, src, length);
+        out->at += length;
+    } else {
+        out->at = NULL;
+    }
+
+    out->need += length;
+}
+
+static void encode_str(encode_out_t *out, const char *str) {
+    uint32_t length = is_empty((void *)str) ? ENCODE_NULL_STR : (uint32_t)strlen(str);
+    encode_put(out, &length, sizeof(length));
+    if (length != ENCODE_NULL_STR)
+        encode_put(out, str, (size_t)length + 1);
+}
+
+static bool decode_get(encode_in_t *in, void *dst, size_t length) {
+    if (length > (size_t)(in->end - in->at))
+        return false;
+
+    memcpy(dst, in->at, length);
+    in->at += length;
+    return true;
+}
+
+/* String refers into buffer, it's `NUL` checked, no copy. */
+static bool decode_str(encode_in_t *in, const char **str) {
+    uint32_t length;
+    if (!decode_get(in, &length, sizeof(length)))
+        return false;
+
+    if (length == ENCODE_NULL_STR) {
+        *str = NULL;
+        return true;
+    }
+
+    if ((size_t)length >= (size_t)(in->end - in->at) || in->at[length] != '\0')
+        return false;
+
+    *str = in->at;
+    in->at += (size_t)length + 1;
+    return true;
+}
+
+static void encode_begin(encode_out_t *out, void *buf, size_t size) {
+    out->at = (char *)buf;
+    out->end = (char *)buf + (is_empty(buf) ? 0 : size);
+    out->need = 0;
+}
+
+static size_t encode_end(encode_out_t *out, void *buf, size_t count, char kind) {
+    encode_header_t header;
+    if (out->need > (uint32_t)-1 || count > (uint16_t)-1)
+        return 0;
+
+    header.size = (uint32_t)out->need;
+    header.count = (uint16_t)count;
+    header.kind = kind;
+    header.reserved = 0;
+    if (!is_empty(out->at))
+        memcpy(buf, &header, sizeof(header));
+
+    return out->need;
+}
+
+static bool decode_begin(encode_in_t *in, const void *buf, size_t size, char kind, size_t *count) {
+    encode_header_t header;
+    if (is_empty((void *)buf) || size < sizeof(header))
+        return false;
+
+    memcpy(&header, buf, sizeof(header));
+    if (header.kind != kind || header.size < sizeof(header) || header.size > size)
+        return false;
+
+    in->at = (const char *)buf + sizeof(header);
+    in->end = (const char *)buf + header.size;
+    *count = header.count;
+    return true;
+}
+
+size_t raii_encoded_size(const void *buf, size_t size) {
+    encode_header_t header;
+    if (is_empty((void *)buf) || size < sizeof(header))
+        return 0;
+
+    memcpy(&header, buf, sizeof(header));
+    return header.size;
+}
+
+size_t args_encode(args_t *params, void *buf, size_t size) {
+    encode_header_t header = {0};
+    encode_out_t out;
+    const args_value_t *value;
+    size_t i;
+
+    encode_begin(&out, buf, size);
+    encode_put(&out, &header, sizeof(header));
+    for (i = 0; i < params->n_args; i++) {
+        value = &params->args[i];
+        switch (value->word.type) {
+            case 'i':
+            case 'd':
+            case 'c':
+            case 'f':
+                encode_put(&out, &value->word.type, 1);
+                encode_put(&out, &value->word.value, sizeof(value->word.value));
+                break;
+            case 's':
+            case 'S':
+                encode_put(&out, "s", 1);
+                encode_str(&out, raii_value_string(value));
+                break;
+            default:
+                /* addresses mean nothing to another process */
+                return 0;
+        }
+    }
+
+    return encode_end(&out, buf, params->n_args, 'A');
+}
+
+args_t *args_view(args_t *params, const void *buf, size_t size) {
+    encode_in_t in;
+    args_value_t *value;
+    const char *str;
+    size_t i, count;
+
+    if (!decode_begin(&in, buf, size, 'A', &count) || count > RAII_ARGS_INLINE)
+        return NULL;
+
+    for (i = 0; i < count; i++) {
+        value = &params->inlined[i];
+        memset(value, 0, sizeof(*value));
+        if (!decode_get(&in, &value->word.type, 1))
+            return NULL;
+
+        switch (value->word.type) {
+            case 'i':
+            case 'd':
+            case 'c':
+            case 'f':
+                if (!decode_get(&in, &value->word.value, sizeof(value->word.value)))
+                    return NULL;
+                break;
+            case 's':
+                if (!decode_str(&in, &str))
+                    return NULL;
+
+                value->word.value.char_ptr = (char *)str;
+                break;
+            default:
+                return NULL;
+        }
+    }
+
+    params->args = params->inlined;
+    params->context = NULL;
+    params->is_local = true;
+    params->defer_set = false;
+    params->n_args = count;
+    params->type = RAII_ARGS;
+    return params;
+}
+
+#define ENCODE_AT(obj, field) ((char *)(obj) + (field)->offset)
+
+/* Fields not encoded, addresses, are decoded as `NULL`. */
+static bool encode_skipped(const reflect_field_t *field) {
+    switch (field->type) {
+        case RAII_PTR:
+            return is_empty((void *)field->nested);
+        case RAII_UCHAR_P:
+        case RAII_CONST_CHAR:
+        case RAII_FUNC:
+        case RAII_ARRAY:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static void encode_struct(encode_out_t *out, const reflect_type_t *desc, const void *obj) {
+    const reflect_field_t *field;
+    void *ptr;
+    char present;
+    size_t i;
+
+    for (i = 0; i < desc->count; i++) {
+        field = &desc->fields[i];
+        if (encode_skipped(field))
+            continue;
+
+        switch (field->type) {
+            case RAII_OBJ:
+                encode_struct(out, field->nested, ENCODE_AT(obj, field));
+                break;
+            case RAII_CHAR_P:
+                memcpy(&ptr, ENCODE_AT(obj, field), sizeof(void *));
+                encode_str(out, (const char *)ptr);
+                break;
+            case RAII_PTR:
+                memcpy(&ptr, ENCODE_AT(obj, field), sizeof(void *));
+                present = !is_empty(ptr);
+                encode_put(out, &present, 1);
+                if (present)
+                    encode_struct(out, field->nested, ptr);
+                break;
+            default:
+                encode_put(out, ENCODE_AT(obj, field), field->size);
+                break;
+        }
+    }
+}
+
+size_t reflect_encode(const reflect_type_t *desc, const void *obj, void *buf, size_t size) {
+    encode_header_t header = {0};
+    encode_out_t out;
+
+    RAII_ASSERT(is_type((void *)desc, RAII_REFLECT_TYPE));
+    encode_begin(&out, buf, size);
+    encode_put(&out, &header, sizeof(header));
+    encode_struct(&out, desc, obj);
+    return encode_end(&out, buf, desc->count, 'R');
+}
+
+static bool decode_struct(encode_in_t *in, memory_t *scope, const reflect_type_t *desc, void *obj) {
+    const reflect_field_t *field;
+    const char *str;
+    void *ptr;
+    char present;
+    size_t i;
+
+    for (i = 0; i < desc->count; i++) {
+        field = &desc->fields[i];
+        if (encode_skipped(field)) {
+            memset(ENCODE_AT(obj, field), 0, field->size);
+            continue;
+        }
+
+        switch (field->type) {
+            case RAII_OBJ:
+                if (!decode_struct(in, scope, field->nested, ENCODE_AT(obj, field)))
+                    return false;
+                break;
+            case RAII_CHAR_P:
+                if (!decode_str(in, &str))
+                    return false;
+
+                memcpy(ENCODE_AT(obj, field), &str, sizeof(void *));
+                break;
+            case RAII_PTR:
+                if (!decode_get(in, &present, 1))
+                    return false;
+
+                ptr = NULL;
+                if (present) {
+                    /* nested struct layout differs from encoding, it can't be a view */
+                    if (is_empty(scope))
+                        return false;
+
+                    ptr = malloc_by(scope, field->nested->size);
+                    if (!decode_struct(in, scope, field->nested, ptr))
+                        return false;
+                }
+
+                memcpy(ENCODE_AT(obj, field), &ptr, sizeof(void *));
+                break;
+            default:
+                if (!decode_get(in, ENCODE_AT(obj, field), field->size))
+                    return false;
+                break;
+        }
+    }
+
+    return true;
+}
+
+size_t reflect_view(memory_t *scope, const reflect_type_t *desc, void *obj, const void *buf, size_t size) {
+    encode_in_t in;
+    size_t count;
+
+    RAII_ASSERT(is_type((void *)desc, RAII_REFLECT_TYPE));
+    if (!decode_begin(&in, buf, size, 'R', &count) || count != desc->count)
+        return 0;
+
+    memset(obj, 0, desc->size);
+    if (!decode_struct(&in, scope, desc, obj))
+        return 0;
+
+    return raii_encoded_size(buf, size);
+}
@@ -0,0 +1,113 @@
+#include "raii.h"
+
+#ifndef va_copy
+    #define va_copy(dest, src) ((dest) = (src))
+#endif
+
+/* Per `thread` ring of error records, preallocated, reused oldest first. */
+typedef struct {
+    raii_error_t slots[RAII_ERR_DEPTH];
+    size_t next;
+    raii_error_t *last;
+} raii_error_ring_t;
+
+#ifdef emulate_tls
+static raii_tls_t raii_error_key;
+static once_flag raii_error_once = ONCE_FLAG_INIT;
+
+static void raii_error_setup(void) {
+    if (raii_tls_create(&raii_error_key, 0, RAII_FREE) != thrd_success)
+        raii_panic("Error `raii_tls_create` failed!");
+}
+
+static raii_error_ring_t *raii_error_ring(void) {
+    raii_error_ring_t *ring;
+    call_once(&raii_error_once, raii_error_setup);
+    if (is_empty(ring = (raii_error_ring_t *)raii_tls_get(raii_error_key))) {
+        ring = try_calloc(1, sizeof(raii_error_ring_t));
+        if (raii_tls_set(raii_error_key, ring) != thrd_success)
+            raii_panic("Error `raii_tls_set` failed!");
+    }
+
+    return ring;
+}
+#else
+static thread_local raii_error_ring_t raii_error_local;
+
+static RAII_INLINE raii_error_ring_t *raii_error_ring(void) {
+    return &raii_error_local;
+}
+#endif
+
+raii_error_t *raii_verror(raii_error_t *cause, int code, const char *fmt, va_list args) {
+    raii_error_ring_t *ring = raii_error_ring();
+    raii_error_t *err = &ring->slots[ring->next++ % RAII_ERR_DEPTH];
+    size_t i;
+
+    /* chains through an reused record end there, never dangle */
+    for (i = 0; i < RAII_ERR_DEPTH; i++) {
+        if (ring->slots[i].cause == err)
+            ring->slots[i].cause = NULL;
+    }
+
+    err->type = RAII_ERR_CONTEXT;
+    err->code = code;
+    err->cause = cause == err ? NULL : cause;
+    err->ex = NULL;
+    err->file = NULL;
+    err->line = 0;
+    err->message[0] = '\0';
+    if (!is_empty((void *)fmt))
+        vsnprintf(err->message, sizeof(err->message), fmt, args);
+
+    ring->last = err;
+    return err;
+}
+
+raii_error_t *raii_error(raii_error_t *cause, int code, const char *fmt, ...) {
+    raii_error_t *err;
+    va_list args;
+
+    va_start(args, fmt);
+    err = raii_verror(cause, code, fmt, args);
+    va_end(args);
+    return err;
+}
+
+void raii_error_throw(const char *ex, const char *file, int line, const char *function, raii_error_t *err) {
+    err->ex = ex;
+    err->file = file;
+    err->line = line;
+    ex_throw(ex, file, line, function, err->message);
+}
+
+raii_error_t *raii_error_of(const char *message) {
+    raii_error_ring_t *ring = raii_error_ring();
+    size_t i;
+
+    if (is_empty((void *)message))
+        return NULL;
+
+    for (i = 0; i < RAII_ERR_DEPTH; i++) {
+        if (message == ring->slots[i].message && is_type(&ring->slots[i], RAII_ERR_CONTEXT))
+            return &ring->slots[i];
+    }
+
+    return NULL;
+}
+
+RAII_INLINE raii_error_t *raii_error_caught(void) {
+    return raii_error_of(raii_message());
+}
+
+RAII_INLINE raii_error_t *raii_error_last(void) {
+    return raii_error_ring()->last;
+}
+
+size_t raii_error_depth(const raii_error_t *err) {
+    size_t depth = 0;
+    for (; !is_empty((void *)err) && depth <= RAII_ERR_DEPTH; err = err->cause)
+        depth++;
+
+    return depth;
+}
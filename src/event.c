@@ -0,0 +1,171 @@
+#include "raii.h"
+
+typedef struct {
+    event_func fn;
+    void *data;
+    size_t id;
+} event_listener_t;
+
+/* Immutable listener array, replaced whole on every change, emitters walk it unlocked. */
+typedef struct event_snapshot_s event_snapshot_t;
+struct event_snapshot_s {
+    size_t count;
+    event_snapshot_t *retired;
+    event_listener_t listeners[1];
+};
+
+struct event_s {
+    raii_type type;
+    void *volatile current;
+    /* emitters inside an snapshot, retired ones are freed once it drops to `0` */
+    volatile size_t readers;
+    event_snapshot_t *retired;
+    size_t next_id;
+    mtx_t mutex[1];
+};
+
+/* Unsubscribe record of `event_on`, released along with it's scope. */
+typedef struct {
+    event_t *ev;
+    size_t id;
+} event_sub_t;
+
+static event_snapshot_t *event_snapshot(size_t count) {
+    event_snapshot_t *snap = try_calloc(1, sizeof(event_snapshot_t)
+        + (count > 0 ? count - 1 : 0) * sizeof(event_listener_t));
+    snap->count = count;
+    return snap;
+}
+
+static void event_drain(event_snapshot_t *snap) {
+    event_snapshot_t *next;
+    for (; !is_empty(snap); snap = next) {
+        next = snap->retired;
+        RAII_FREE(snap);
+    }
+}
+
+/* Mutex held, swap in `snap`, old one freed now if no emitter is inside any,
+otherwise by a later change, or `event_free`. Emitters count themselves before
+loading `current`, so one that saw old array is still counted once swapped out. */
+static void event_publish(event_t *ev, event_snapshot_t *snap) {
+    event_snapshot_t *old = (event_snapshot_t *)atomic_ptr_swap(&ev->current, snap);
+    old->retired = ev->retired;
+    ev->retired = old;
+    if (is_zero(atomic_size_load(&ev->readers))) {
+        event_drain(ev->retired);
+        ev->retired = NULL;
+    }
+}
+
+event_t *event_create(memory_t *scope) {
+    event_t *ev = try_calloc(1, sizeof(event_t));
+    ev->type = RAII_EVENT_ARG;
+    ev->current = event_snapshot(0);
+    ev->next_id = 1;
+    if (mtx_init(ev->mutex, mtx_plain) != thrd_success)
+        raii_panic("Event `mtx_init` failed!");
+
+    if (!is_empty(scope))
+        raii_deferred(scope, (func_t)event_free, ev);
+
+    return ev;
+}
+
+void event_free(event_t *ev) {
+    if (is_empty(ev) || !is_type(ev, RAII_EVENT_ARG))
+        return;
+
+    ev->type = RAII_NULL;
+    event_drain(ev->retired);
+    RAII_FREE(ev->current);
+    mtx_destroy(ev->mutex);
+    RAII_FREE(ev);
+}
+
+static void event_unsubscribe(void *arg) {
+    event_sub_t *sub = (event_sub_t *)arg;
+    event_off(sub->ev, sub->id);
+}
+
+size_t event_on(memory_t *scope, event_t *ev, event_func fn, void *data) {
+    event_snapshot_t *old, *snap;
+    event_sub_t *sub;
+    size_t id;
+
+    mtx_lock(ev->mutex);
+    old = (event_snapshot_t *)ev->current;
+    snap = event_snapshot(old->count + 1);
+    memcpy(snap->listeners, old->listeners, old->count * sizeof(event_listener_t));
+    snap->listeners[old->count].fn = fn;
+    snap->listeners[old->count].data = data;
+    snap->listeners[old->count].id = id = ev->next_id++;
+    event_publish(ev, snap);
+    mtx_unlock(ev->mutex);
+
+    if (!is_empty(scope)) {
+        sub = malloc_by(scope, sizeof(event_sub_t));
+        sub->ev = ev;
+        sub->id = id;
+        raii_deferred(scope, event_unsubscribe, sub);
+    }
+
+    return id;
+}
+
+bool event_off(event_t *ev, size_t id) {
+    event_snapshot_t *old, *snap;
+    size_t i, n = 0;
+
+    if (is_empty(ev) || !is_type(ev, RAII_EVENT_ARG))
+        return false;
+
+    mtx_lock(ev->mutex);
+    old = (event_snapshot_t *)ev->current;
+    for (i = 0; i < old->count && old->listeners[i].id != id; i++);
+    if (i == old->count) {
+        mtx_unlock(ev->mutex);
+        return false;
+    }
+
+    snap = event_snapshot(old->count - 1);
+    for (i = 0; i < old->count; i++) {
+        if (old->listeners[i].id != id)
+            snap->listeners[n++] = old->listeners[i];
+    }
+
+    event_publish(ev, snap);
+    mtx_unlock(ev->mutex);
+    return true;
+}
+
+size_t event_emit_batch(event_t *ev, void **args, size_t count) {
+    event_snapshot_t *snap;
+    event_listener_t *listener;
+    size_t i, j, called;
+
+    atomic_size_add(&ev->readers, 1);
+    snap = (event_snapshot_t *)atomic_ptr_load(&ev->current);
+    /* listener major, each handler runs it's whole batch while hot */
+    for (i = 0; i < snap->count; i++) {
+        listener = &snap->listeners[i];
+        for (j = 0; j < count; j++)
+            listener->fn(listener->data, args[j]);
+    }
+
+    called = snap->count;
+    atomic_size_sub(&ev->readers, 1);
+    return called;
+}
+
+RAII_INLINE size_t event_emit(event_t *ev, void *arg) {
+    return event_emit_batch(ev, &arg, 1);
+}
+
+size_t event_count(event_t *ev) {
+    size_t count;
+    atomic_size_add(&ev->readers, 1);
+    count = ((event_snapshot_t *)atomic_ptr_load(&ev->current))->count;
+    atomic_size_sub(&ev->readers, 1);
+    return count;
+}
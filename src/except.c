@@ -1,7 +1,22 @@
 #if defined(__GNUC__) || !defined(_WIN32)
 #undef _FORTIFY_SOURCE
 #endif
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+    /* `pthread_getattr_np` */
+    #define _GNU_SOURCE
+#endif
 #include "raii.h"
+#if !defined(_WIN32)
+    #include <sys/resource.h>
+#endif
+#if defined(EX_BACKTRACE) && !defined(emulate_tls) && (defined(__GLIBC__) || defined(__APPLE__))
+    #include <execinfo.h>
+    #define EX_BACKTRACE_CAPTURE(frames, max)   backtrace(frames, max)
+#elif defined(EX_BACKTRACE) && !defined(emulate_tls) && defined(_WIN32)
+    #define EX_BACKTRACE_CAPTURE(frames, max)   CaptureStackBackTrace(1, max, frames, NULL)
+#else
+    #undef EX_BACKTRACE
+#endif
 
 /* Some common exception */
 EX_EXCEPTION(invalid_type);
@@ -48,35 +63,131 @@ EX_EXCEPTION(single_step);
 EX_EXCEPTION(stack_overflow);
 EX_EXCEPTION(invalid_handle);
 EX_EXCEPTION(bad_alloc);
+EX_EXCEPTION(task_cancelled);
+EX_EXCEPTION(timeout_error);
+
+#ifdef emulate_tls
+/* `thread` context storage, and current context `ex_update` replaces,
+pointer slots of `raii_tls` block, as `thrd_local` buffer and pointer. */
+static raii_tls_t ex_storage_key;
+static raii_tls_t ex_context_key;
+static once_flag ex_context_once = ONCE_FLAG_INIT;
+static int ex_context_err = thrd_success;
+
+static void ex_context_setup(void) {
+    if (raii_tls_create(&ex_storage_key, 0, C11_FREE) != thrd_success
+        || raii_tls_create(&ex_context_key, 0, NULL) != thrd_success)
+        ex_context_err = thrd_error;
+}
+
+/* `NULL` when it's storage can't be allocated, nothing thrown. */
+static ex_context_t *except(void) {
+    ex_context_t *context;
+    call_once(&ex_context_once, ex_context_setup);
+    if (ex_context_err != thrd_success)
+        return NULL;
+
+    if (!is_empty(context = (ex_context_t *)raii_tls_get(ex_context_key)))
+        return context;
 
+    if (is_empty(context = (ex_context_t *)raii_tls_get(ex_storage_key))) {
+        if (is_empty(context = (ex_context_t *)C11_CALLOC(1, sizeof(ex_context_t))))
+            return NULL;
+
+        if (raii_tls_set(ex_storage_key, (void *)context) != thrd_success) {
+            C11_FREE(context);
+            return NULL;
+        }
+    }
+
+    raii_tls_set(ex_context_key, (void *)context);
+    return context;
+}
+#define ex_storage() ((ex_context_t *)raii_tls_get(ex_storage_key))
+#else
 thrd_local(ex_context_t, except)
-thread_storage(ex_context_t, local_except)
+#define ex_storage() (&thrd_except_buffer)
+#endif
+
+int local_except_tls = 0;
+raii_tls_t local_except_key = 0;
+
+ex_context_t *local_except(void) {
+    ex_context_t *context;
+    if (is_zero(local_except_tls))
+        return NULL;
+
+    if (is_empty(context = (ex_context_t *)raii_tls_get(local_except_key))
+        && !is_empty(context = (ex_context_t *)rp_malloc(local_except_tls))
+        && raii_tls_set(local_except_key, (void *)context) != thrd_success) {
+        rp_free(context);
+        context = NULL;
+    }
+
+    return context;
+}
+
+void local_except_delete(void) {
+    if (!is_zero(local_except_tls)) {
+        local_except_tls = 0;
+        rp_free(raii_tls_get(local_except_key));
+        raii_tls_set(local_except_key, NULL);
+        rpmalloc_shutdown();
+    }
+}
+#if defined(RAII_THREAD_STATE)
+#define ex_context_top raii_thread.context
+#elif !defined(emulate_tls)
+/* Last `ex_init` result, every `try` entry/exit reads it, `NULL` forces lookup. */
+static thread_local ex_context_t *ex_context_top = NULL;
+#endif
+
+/* Root context of last resort, when `thread` context storage can't be allocated,
+one per `thread` beside it's `ex_context_t`, except under `emulate_tls`, having no storage left. */
+static thread_local ex_context_t ex_emergency_context = {0};
 
 static volatile sig_atomic_t got_signal = false;
 static volatile sig_atomic_t got_uncaught_exception = false;
 static volatile sig_atomic_t got_ctrl_c = false;
 static volatile sig_atomic_t can_terminate = true;
+#ifdef _WIN32
+/* Nesting depth of `ex_signal_block`, and last signal deferred while blocked,
+process wide, console `CTRL_C` events run handler on another `thread` of their own. */
+static volatile LONG ex_signal_depth = 0;
+static volatile LONG ex_signal_pending = 0;
+#endif
 
-ex_setup_func exception_setup_func = NULL;
-ex_unwind_func exception_unwind_func = NULL;
+thread_local ex_setup_func exception_setup_func = NULL;
+ex_setup_func exception_throw_hook = NULL;
+ex_log_func exception_log_func = NULL;
+thread_local ex_unwind_func exception_unwind_func = NULL;
 ex_terminate_func exception_ctrl_c_func = NULL;
 ex_terminate_func exception_terminate_func = NULL;
 bool exception_signal_set = false;
 
 RAII_INLINE ex_context_t *ex_local_emulated(void) {
-    return (ex_context_t *)rpmalloc_tls_get(rpmalloc_local_except_tss);
+    return is_zero(local_except_tls) ? NULL : (ex_context_t *)raii_tls_get(local_except_key);
 }
 
 static ex_context_t *ex_init_local(void) {
     ex_context_t *context = ex_local_emulated();
     if (is_empty(context)) {
+#ifndef emulate_tls
+        ex_context_top = NULL;
+#endif
         ex_signal_block(all);
         context = local_except();
+        if (UNLIKELY(is_empty(context))) {
+            ex_signal_unblock(all);
+            return ex_init();
+        }
+
         context->is_rethrown = false;
         context->is_guarded = false;
         context->is_raii = false;
         context->is_emulated = true;
         context->caught = -1;
+        context->protect_base = 0;
         context->type = ex_context_st;
         ex_signal_unblock(all);
     }
@@ -86,6 +197,7 @@ static ex_context_t *ex_init_local(void) {
 
 static void ex_handler(int sig);
 #if !defined(_WIN32)
+static void ex_handler_info(int sig, siginfo_t *info, void *context);
 static struct sigaction ex_sig_sa = {0}, ex_sig_osa = {0};
 #endif
 
@@ -101,6 +213,67 @@ static struct {
 #endif
 } ex_sig[max_ex_sig];
 
+enum {
+    max_ex_class = 64
+};
+
+static struct {
+    const char *ex;
+    const char *parent;
+} ex_class[max_ex_class] = {
+    /* allocation failures, `catch (panic)` still catches them */
+    {EX_NAME(bad_alloc), EX_NAME(out_of_memory)},
+    {EX_NAME(out_of_memory), EX_NAME(panic)}
+};
+static int ex_class_count = 2;
+
+void ex_class_set(const char *ex, const char *parent) {
+    int i;
+    for (i = 0; i < ex_class_count; i++) {
+        if (ex_class[i].ex == ex) {
+            ex_class[i].parent = parent;
+            return;
+        }
+    }
+
+    if (ex_class_count == max_ex_class) {
+        fprintf(stderr,
+                "Cannot register exception class (%s), "
+                "too many exception classes registered (max %d)\n",
+                ex, max_ex_class);
+        return;
+    }
+
+    ex_class[ex_class_count].ex = ex;
+    ex_class[ex_class_count].parent = parent;
+    ex_class_count++;
+}
+
+const char *ex_class_parent(const char *ex) {
+    int i;
+    for (i = 0; i < ex_class_count; i++) {
+        if (ex_class[i].ex == ex)
+            return ex_class[i].parent;
+    }
+
+    return NULL;
+}
+
+bool ex_is_a(const char *ex, const char *base) {
+    int depth;
+    if (is_empty((void *)ex) || is_empty((void *)base))
+        return false;
+
+    for (depth = 0; !is_empty((void *)ex) && depth <= max_ex_class; depth++) {
+        if (ex == base)
+            return true;
+
+        ex = ex_class_parent(ex);
+    }
+
+    return false;
+}
+
 ex_ptr_t ex_protect_ptr(ex_ptr_t *const_ptr, void *ptr, void (*func)(void *)) {
     ex_context_t *ctx = is_protection_emulated(const_ptr) ? ex_init_local() : ex_init();
     const_ptr->next = ctx->stack;
@@ -119,6 +292,150 @@ void ex_unprotected_ptr(ex_ptr_t *const_ptr) {
         ex_local()->stack = const_ptr->next;
 }
 
+#ifdef RAII_STATS
+/* Open addressed by throw site, `last` is most recent throw, for counting as caught. */
+typedef struct {
+    ex_stats_t sites[EX_STATS_SITES];
+    ex_stats_t *last;
+    int count;
+} ex_stats_table_t;
+#endif
+
+#ifdef EX_PROTECT_STACK
+typedef struct {
+    void **ptr;
+    ex_unwind_func func;
+} ex_slot_t;
+
+typedef struct {
+    ex_slot_t slots[EX_PROTECT_DEPTH];
+    int top;
+} ex_protect_stack_t;
+#endif
+
+#if !defined(_WIN32)
+#ifndef EX_SIGNAL_PROTECTS
+    #define EX_SIGNAL_PROTECTS 64
+#endif
+
+/* What `ex_handler_info` saw, for `ex_signal_landed` to unwind once out of signal context.
+Protected pointers are copied while their frames still exist, `siglongjmp` discards them,
+any past `EX_SIGNAL_PROTECTS` are left unreleased. Alternate stack follows it. */
+typedef struct {
+    volatile sig_atomic_t pending;
+    ex_ptr_t chain[EX_SIGNAL_PROTECTS];
+    void *values[EX_SIGNAL_PROTECTS];
+} ex_signal_record_t;
+#endif
+
+#if defined(RAII_STATS) || defined(EX_PROTECT_STACK) || !defined(_WIN32)
+/* Per `thread` exception bookkeeping, beside it's `ex_context_t`, in native TLS,
+or under `emulate_tls` one zeroed `tss` block per `thread`, freed at it's exit. */
+typedef struct {
+#ifdef RAII_STATS
+    ex_stats_table_t stats;
+#endif
+#ifdef EX_PROTECT_STACK
+    ex_protect_stack_t protect;
+#endif
+#if !defined(_WIN32)
+    /* `ex_signal_thread` registered, and range faults count as an stack overflow in */
+    ex_signal_record_t *record;
+    char *stack_low;
+    char *stack_high;
+#endif
+} ex_thread_t;
+
+#ifdef emulate_tls
+static raii_tls_t ex_thread_key;
+static once_flag ex_thread_once = ONCE_FLAG_INIT;
+static int ex_thread_err = thrd_success;
+
+static void ex_thread_setup(void) {
+    ex_thread_err = raii_tls_create(&ex_thread_key, 0, C11_FREE);
+}
+
+/* `NULL` when it's storage can't be allocated. */
+static ex_thread_t *ex_thread(void) {
+    ex_thread_t *state;
+
+    call_once(&ex_thread_once, ex_thread_setup);
+    if (ex_thread_err != thrd_success)
+        return NULL;
+
+    if (is_empty(state = (ex_thread_t *)raii_tls_get(ex_thread_key))
+        && !is_empty(state = (ex_thread_t *)C11_CALLOC(1, sizeof(ex_thread_t)))
+        && raii_tls_set(ex_thread_key, (void *)state) != thrd_success) {
+        C11_FREE(state);
+        state = NULL;
+    }
+
+    return state;
+}
+#else
+static thread_local ex_thread_t ex_thread_tls;
+
+static RAII_INLINE ex_thread_t *ex_thread(void) {
+    return &ex_thread_tls;
+}
+#endif
+#endif
+
+#ifdef EX_PROTECT_STACK
+static ex_protect_stack_t *ex_protect_local(void) {
+    ex_thread_t *state = ex_thread();
+    if (UNLIKELY(is_empty(state)))
+        raii_panic("Protection stack storage failed!");
+
+    return &state->protect;
+}
+#endif
+
+int ex_protect_push(void **ptr, ex_unwind_func func) {
+#ifdef EX_PROTECT_STACK
+    ex_protect_stack_t *stack = ex_protect_local();
+    int depth = stack->top;
+    if (UNLIKELY(depth == EX_PROTECT_DEPTH))
+        raii_panic("Protection stack overflow, raise `EX_PROTECT_DEPTH`!");
+
+    stack->slots[depth].ptr = ptr;
+    stack->slots[depth].func = func;
+    stack->top = depth + 1;
+    return depth;
+#else
+    return 0;
+#endif
+}
+
+RAII_INLINE void ex_protect_pop(int depth) {
+#ifdef EX_PROTECT_STACK
+    ex_protect_stack_t *stack = ex_protect_local();
+    if (depth < stack->top)
+        stack->top = depth;
+#endif
+}
+
+RAII_INLINE int ex_protect_depth(void) {
+#ifdef EX_PROTECT_STACK
+    return ex_protect_local()->top;
+#else
+    return 0;
+#endif
+}
+
+#ifdef EX_PROTECT_STACK
+/* Run slots pushed since `ctx` entry, newest first, each popped before it's `func` runs. */
+static void ex_protect_unwind(ex_context_t *ctx) {
+    ex_protect_stack_t *stack = ex_protect_local();
+    ex_slot_t *slot;
+    while (stack->top > ctx->protect_base) {
+        slot = &stack->slots[--stack->top];
+        if (*slot->ptr)
+            slot->func(*slot->ptr);
+    }
+}
+#endif
+
 static void ex_unwind_stack(ex_context_t *ctx) {
     ex_ptr_t *p = ctx->stack;
     void *temp = NULL;
@@ -132,6 +449,9 @@ static void ex_unwind_stack(ex_context_t *ctx) {
     } else if (is_exception_emulated(ctx)) {
         raii_deferred_free(thrd_scope());
     } else {
+#ifdef EX_PROTECT_STACK
+        ex_protect_unwind(ctx);
+#endif
         while (p && p->type == ex_protected_st) {
             if ((got_uncaught_exception = (temp == *p->ptr)))
                 break;
@@ -148,23 +468,190 @@ static void ex_unwind_stack(ex_context_t *ctx) {
 
     ctx->unstack = 0;
     ctx->stack = 0;
+    ex_protect_pop(ctx->protect_base);
 }
 
-static void ex_print(ex_context_t *exception, const char *message) {
+#ifdef EX_BACKTRACE
+/* Raw return addresses only, capture is cheap, symbols resolved on print. */
+typedef struct {
+    void *frames[EX_BACKTRACE_RING][EX_BACKTRACE_DEPTH];
+    int count[EX_BACKTRACE_RING];
+    unsigned int next;
+} ex_trace_t;
+
+static thread_local ex_trace_t ex_trace = {0};
+
+static void ex_backtrace_capture(void) {
+    unsigned int slot = ex_trace.next++ % EX_BACKTRACE_RING;
+    ex_trace.count[slot] = EX_BACKTRACE_CAPTURE(ex_trace.frames[slot], EX_BACKTRACE_DEPTH);
+}
+#endif
+
+#ifdef RAII_STATS
+static ex_stats_table_t *ex_stats_local(void) {
+    ex_thread_t *state = ex_thread();
+    return is_empty(state) ? NULL : &state->stats;
+}
+
+static void ex_stats_throw(ex_context_t *ctx) {
+    ex_stats_table_t *table = ex_stats_local();
+    ex_stats_t *site;
+    size_t i, hash = ((uintptr_t)ctx->file >> 3) ^ ((uintptr_t)ctx->ex >> 3) ^ (size_t)ctx->line * 31;
+    if (is_empty(table))
+        return;
+
+    for (i = 0; i < EX_STATS_SITES; i++) {
+        site = &table->sites[(hash + i) % EX_STATS_SITES];
+        if (site->thrown == 0) {
+            site->ex = ctx->ex;
+            site->file = ctx->file;
+            site->function = ctx->function;
+            site->line = ctx->line;
+            table->count++;
+        } else if (site->ex != ctx->ex || site->line != ctx->line || site->file != ctx->file) {
+            continue;
+        }
+
+        site->thrown++;
+        table->last = site;
+        return;
+    }
+
+    table->last = NULL;
+}
+#endif
+
+RAII_INLINE void ex_stats_caught(ex_context_t *ctx) {
+#ifdef RAII_STATS
+    ex_stats_table_t *table = ex_stats_local();
+    if (!is_empty(table) && !is_empty(table->last) && table->last->ex == ctx->ex) {
+        table->last->caught++;
+        table->last = NULL;
+    }
+#endif
+}
+
+int ex_stats(ex_stats_t *sites, int max) {
+    int count = 0;
+#ifdef RAII_STATS
+    ex_stats_table_t *table = ex_stats_local();
+    int i;
+    for (i = 0; !is_empty(table) && i < EX_STATS_SITES && count < max; i++) {
+        if (table->sites[i].thrown > 0)
+            sites[count++] = table->sites[i];
+    }
+#endif
+    return count;
+}
+
+static int ex_stats_cmp(const void *a, const void *b) {
+    size_t x = ((const ex_stats_t *)a)->thrown, y = ((const ex_stats_t *)b)->thrown;
+    return (x < y) - (x > y);
+}
+
+void ex_stats_dump(void) {
+    ex_stats_t sites[EX_STATS_SITES];
+    int i, count = ex_stats(sites, EX_STATS_SITES);
+    if (count == 0)
+        return;
+
+    qsort(sites, count, sizeof(ex_stats_t), ex_stats_cmp);
     fflush(stdout);
-#ifndef USE_DEBUG
-    fprintf(stderr, "\nFatal Error: %s in function(%s)\n\n",
-                  ((void *)exception->panic != NULL ? exception->panic : exception->ex), exception->function);
+    fprintf(stderr, "%-24s %10s %10s  %s\n", "exception", "thrown", "caught", "site");
+    for (i = 0; i < count; i++)
+        fprintf(stderr, "%-24s %10zu %10zu  %s (%s:%d)\n", sites[i].ex, sites[i].thrown, sites[i].caught,
+                (sites[i].function != NULL ? sites[i].function : "?"),
+                (sites[i].file != NULL ? sites[i].file : "?"), sites[i].line);
+    fflush(stderr);
+}
+
+void ex_stats_reset(void) {
+#ifdef RAII_STATS
+    ex_stats_table_t *table = ex_stats_local();
+    if (!is_empty(table))
+        memset(table, 0, sizeof(ex_stats_table_t));
+#endif
+}
+
+int ex_backtrace(void **frames, int max) {
+#ifdef EX_BACKTRACE
+    unsigned int slot;
+    int count;
+    if (ex_trace.next == 0 || max <= 0)
+        return 0;
+
+    slot = (ex_trace.next - 1) % EX_BACKTRACE_RING;
+    count = MIN(max, ex_trace.count[slot]);
+    memcpy(frames, ex_trace.frames[slot], count * sizeof(void *));
+    return count;
 #else
-    fprintf(stderr, "\n%s: %s\n", message, (exception->panic != NULL ? exception->panic : exception->ex));
-    if (exception->file != NULL) {
-        if (exception->function != NULL) {
-            fprintf(stderr, "    thrown in %s at (%s:%d)\n\n", exception->function, exception->file, exception->line);
-        } else {
-            fprintf(stderr, "    thrown at %s:%d\n\n", exception->file, exception->line);
-        }
+    return 0;
+#endif
+}
+
+void ex_backtrace_print(void) {
+#ifdef EX_BACKTRACE
+    void *frames[EX_BACKTRACE_DEPTH];
+    int i, count = ex_backtrace(frames, EX_BACKTRACE_DEPTH);
+    if (count == 0)
+        return;
+
+    fprintf(stderr, "Backtrace:\n");
+#   if defined(_WIN32)
+    for (i = 0; i < count; i++)
+        fprintf(stderr, "    #%d %p\n", i, frames[i]);
+#   else
+    (void)i;
+    fflush(stderr);
+    backtrace_symbols_fd(frames, count, fileno(stderr));
+#   endif
+    fflush(stderr);
+#endif
+}
+
+void ex_log_write(int level, const char *text, size_t length) {
+    FILE *stream = level == EX_LOG_OUT ? stdout : stderr;
+    if (exception_log_func) {
+        exception_log_func(level, text, length);
+        return;
     }
+
+    if (level != EX_LOG_OUT)
+        fflush(stdout);
+
+    fwrite(text, 1, length, stream);
+    if (level != EX_LOG_OUT)
+        fflush(stream);
+}
+
+void ex_log(int level, const char *fmt, ...) {
+    char text[EX_LOG_LINE];
+    va_list args;
+    int length;
+
+    va_start(args, fmt);
+    length = vsnprintf(text, sizeof(text), fmt, args);
+    va_end(args);
+    if (length > 0)
+        ex_log_write(level, text, MIN((size_t)length, sizeof(text) - 1));
+}
+
+/* Whole report formatted first, then written once, so reports of
+different `thread`s never interleave. */
+static void ex_print(ex_context_t *exception, const char *message) {
+    const char *what = (void *)exception->panic != NULL ? exception->panic : exception->ex;
+#ifndef USE_DEBUG
+    ex_log(EX_LOG_FATAL, "\nFatal Error: %s in function(%s)\n\n", what, exception->function);
+#else
+    if (exception->file != NULL && exception->function != NULL)
+        ex_log(EX_LOG_FATAL, "\n%s: %s\n    thrown in %s at (%s:%d)\n\n",
+               message, what, exception->function, exception->file, exception->line);
+    else if (exception->file != NULL)
+        ex_log(EX_LOG_FATAL, "\n%s: %s\n    thrown at %s:%d\n\n", message, what, exception->file, exception->line);
+    else
+        ex_log(EX_LOG_FATAL, "\n%s: %s\n", message, what);
 #endif
+    ex_backtrace_print();
     fflush(stderr);
 }
 
@@ -195,39 +682,76 @@ void ex_flags_reset(void) {
 }
 
 RAII_INLINE ex_context_t *ex_local(void) {
+#ifdef emulate_tls
+    call_once(&ex_context_once, ex_context_setup);
+    return ex_context_err != thrd_success ? NULL : (ex_context_t *)raii_tls_get(ex_context_key);
+#else
     thrd_local_return(ex_context_t, except)
+#endif
 }
 
 void ex_update(ex_context_t *context) {
+#ifdef RAII_NO_EMULATED
+    thrd_except_tls = context;
+    ex_context_top = context;
+#else
     if (is_exception_emulated(context)) {
-        if (rpmalloc_tls_set(rpmalloc_local_except_tss, context) != thrd_success)
-            raii_panic("Except `tss_set` failed!");
+        if (raii_tls_set(local_except_key, context) != thrd_success)
+            raii_panic("Except `raii_tls_set` failed!");
+#ifndef emulate_tls
+        ex_context_top = context;
+#endif
     } else {
 #ifdef emulate_tls
-        if (tss_set(thrd_except_tss, context) != thrd_success)
-            raii_panic("Except `tss_set` failed!");
+        if (ex_context_err == thrd_success
+            && raii_tls_set(ex_context_key, context == &ex_emergency_context ? NULL : context) != thrd_success)
+            raii_panic("Except `raii_tls_set` failed!");
 #else
         thrd_except_tls = context;
+        /* an emulated context, when set, takes precedence in `ex_init` */
+        ex_context_top = is_empty(ex_local_emulated())
+            ? context : NULL;
 #endif
     }
+#endif
 }
 
 ex_context_t *ex_init(void) {
-    ex_context_t *context = is_zero((size_t)thrd_arena_tss) ? NULL : ex_local_emulated();
+#ifndef emulate_tls
+    ex_context_t *top = ex_context_top;
+#ifdef RAII_NO_EMULATED
+    if (LIKELY(!is_empty(top)))
+#else
+    if (LIKELY(!is_empty(top) && (!top->is_emulated || !is_zero(local_except_tls))))
+#endif
+        return top;
+#endif
+#ifdef RAII_NO_EMULATED
+    ex_context_t *context = NULL;
+#else
+    ex_context_t *context = ex_local_emulated();
+#endif
     if (is_empty(context)) {
         if (is_empty(context = ex_local())) {
             ex_signal_block(all);
             context = except();
+            if (UNLIKELY(is_empty(context)))
+                context = &ex_emergency_context;
+
             context->is_rethrown = false;
             context->is_guarded = false;
             context->is_raii = false;
             context->is_emulated = false;
             context->caught = -1;
+            context->protect_base = 0;
             context->type = ex_context_st;
             ex_signal_unblock(all);
         }
     }
 
+#ifndef emulate_tls
+    ex_context_top = context;
+#endif
     return context;
 }
 
@@ -260,13 +784,31 @@ void ex_terminate(void) {
         exit(EXIT_FAILURE);
 }
 
+/* Asynchronous signals deferred while `throw` unwinds, none to defer with `EX_NO_SIGNALS`. */
+#ifdef EX_NO_SIGNALS
+    #define ex_throw_block()
+    #define ex_throw_unblock()
+#else
+    #define ex_throw_block()    ex_signal_block(all)
+    #define ex_throw_unblock()  ex_signal_unblock(all)
+#endif
+
+/* No `try` left to land in, on `thread`. */
+static RAII_INLINE bool ex_is_root(ex_context_t *ctx) {
+    return ctx == (is_exception_emulated(ctx) ? ex_local_emulated() : ex_storage())
+        || ctx == &ex_emergency_context;
+}
+
 void ex_throw(const char *exception, const char *file, int line, const char *function, const char *message) {
     ex_context_t *ctx = ex_init();
 
     if (ctx->unstack)
         ex_terminate();
 
-    ex_signal_block(all);
+    ex_throw_block();
+#ifdef EX_BACKTRACE
+    ex_backtrace_capture();
+#endif
     ctx->ex = exception;
     ctx->file = file;
     ctx->line = line;
@@ -274,15 +816,20 @@ void ex_throw(const char *exception, const char *file, int line, const char *fun
     ctx->function = function;
     ctx->panic = message;
 
+    RAII_STAT(ex_stats_throw(ctx));
+    RAII_RECORDED(raii_record_site(RAII_RECORD_THROW, exception, file, line));
+    if (exception_throw_hook)
+        exception_throw_hook(ctx, ctx->ex, ctx->panic);
+
     if (exception_setup_func)
         exception_setup_func(ctx, ctx->ex, ctx->panic);
     else if (ctx->is_raii)
         raii_unwind_set(ctx, ctx->ex, ctx->panic);
 
     ex_unwind_stack(ctx);
-    ex_signal_unblock(all);
+    ex_throw_unblock();
 
-    if (ctx == (is_exception_emulated(ctx) ? ex_local_emulated() : &thrd_except_buffer))
+    if (ex_is_root(ctx))
         ex_terminate();
 
 #ifdef _WIN32
@@ -291,21 +838,39 @@ void ex_throw(const char *exception, const char *file, int line, const char *fun
     ex_longjmp(ctx->buf, ctx->state | ex_throw_st);
 }
 
+void ex_result_throw(ex_result_t result, const char *file, int line, const char *function) {
+    if (!ex_is_ok(result))
+        ex_throw(result.ex, file, line, function, result.message);
+}
+
 #ifdef _WIN32
+/* Same as `ex_is_a`, but `name` is an string, as `catch` passes on Windows. */
+static bool ex_is_named(const char *ex, const char *name) {
+    int depth;
+    for (depth = 0; !is_empty((void *)ex) && depth <= max_ex_class; depth++) {
+        if (is_str_eq(ex, name))
+            return true;
+
+        ex = ex_class_parent(ex);
+    }
+
+    return false;
+}
+
 int catch_seh(const char *exception, DWORD code, struct _EXCEPTION_POINTERS *ep) {
     ex_context_t *ctx = ex_init();
     const char *ex = 0;
     int i;
 
-    if (!is_str_eq(ctx->ex, exception) && is_empty((void *)ctx->panic))
+    if (!ex_is_named(ctx->ex, exception) && is_empty((void *)ctx->panic))
         return EXCEPTION_EXECUTE_HANDLER;
-    else if (!is_str_eq(ctx->panic, exception) && !is_str_eq(ctx->ex, exception))
+    else if (!is_str_eq(ctx->panic, exception) && !ex_is_named(ctx->ex, exception))
         return EXCEPTION_EXECUTE_HANDLER;
 
     for (i = 0; i < max_ex_sig; i++) {
         if (ex_sig[i].seh == code
             || ctx->caught == ex_sig[i].seh
-            || is_str_eq(ctx->ex, exception)
+            || ex_is_named(ctx->ex, exception)
             ) {
             ctx->state = ex_throw_st;
             ctx->is_rethrown = true;
@@ -382,10 +947,6 @@ void ex_handler(int sig) {
     const char *ex = NULL;
     int i;
 
-    got_signal = true;
-    if (sig == SIGINT)
-        got_ctrl_c = true;
-
 #ifdef _WIN32
     /*
      * Make signal handlers persistent.
@@ -393,8 +954,25 @@ void ex_handler(int sig) {
     if (signal(sig, ex_handler) == SIG_ERR)
         fprintf(stderr, "Cannot reinstall handler for signal no %d (%s)\n",
                 sig, ex);
+
+    /*
+     * Raised inside `ex_signal_block` section, delivered on unblock,
+     * faults can't be deferred, returning would re-execute them.
+     */
+    if (InterlockedCompareExchange(&ex_signal_depth, 0, 0) > 0
+        && sig != SIGSEGV && sig != SIGFPE && sig != SIGILL) {
+        InterlockedExchange(&ex_signal_pending, sig);
+        /* still blocked, or last unblock already took it */
+        if (InterlockedCompareExchange(&ex_signal_depth, 0, 0) > 0
+            || InterlockedExchange(&ex_signal_pending, 0) == 0)
+            return;
+    }
 #endif
 
+    got_signal = true;
+    if (sig == SIGINT)
+        got_ctrl_c = true;
+
     for (i = 0; i < max_ex_sig; i++) {
         if (ex_sig[i].sig == sig) {
             ex = ex_sig[i].ex;
@@ -403,9 +981,234 @@ void ex_handler(int sig) {
         }
     }
 
+#if !defined(_WIN32)
+    /*
+     * Unblock signal being handled, a `try` not saving
+     * signal mask will not restore it on `longjmp`.
+     */
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, sig);
+    pthread_sigmask(SIG_UNBLOCK, &set, NULL);
+#endif
+
     ex_throw(ex, "unknown", 0, NULL, NULL);
 }
 
+#if !defined(_WIN32)
+static bool ex_is_stack_overflow(ex_thread_t *state, int sig, siginfo_t *info) {
+    char *fault = (char *)info->si_addr;
+    return sig == SIGSEGV && info->si_code > 0 && fault < state->stack_high && fault >= state->stack_low;
+}
+
+/* Copy protections `ctx` unwinding would release, runs in signal context, stores only. */
+static void ex_signal_record(ex_signal_record_t *record, ex_context_t *ctx) {
+    ex_ptr_t *p, *last = NULL;
+    int n = 0;
+#ifdef EX_PROTECT_STACK
+    ex_protect_stack_t *stack = &ex_thread()->protect;
+    int i;
+
+    /* slots stay in place, only pointers to frame variables are redirected */
+    for (i = ctx->protect_base; i < stack->top; i++) {
+        if (n == EX_SIGNAL_PROTECTS) {
+            stack->top = i;
+            break;
+        }
+
+        record->values[n] = *stack->slots[i].ptr;
+        stack->slots[i].ptr = &record->values[n++];
+    }
+#endif
+
+    for (p = ctx->stack; p && p->type == ex_protected_st && n < EX_SIGNAL_PROTECTS; p = p->next, n++) {
+        record->values[n] = *p->ptr;
+        record->chain[n] = *p;
+        record->chain[n].ptr = &record->values[n];
+        record->chain[n].next = NULL;
+        if (!is_empty(last))
+            last->next = &record->chain[n];
+        else
+            ctx->stack = &record->chain[n];
+
+        last = &record->chain[n];
+    }
+
+    if (is_empty(last))
+        ctx->stack = NULL;
+
+    record->pending = true;
+}
+
+/*
+ * Short path of `thread`s registered by `ex_signal_thread`, running on their
+ * alternate stack: only records exception, and copies of protections, into
+ * preallocated state, restores signal mask, then `siglongjmp`. Everything else,
+ * setup hooks, unwinding, any `free`, runs in `ex_signal_landed` where `try` lands.
+ */
+static void ex_handler_info(int sig, siginfo_t *info, void *context) {
+    ucontext_t *uc = (ucontext_t *)context;
+    ex_thread_t *state = ex_thread();
+    const char *ex = NULL;
+    ex_context_t *ctx;
+    int i;
+
+    if (is_empty(state) || is_empty(state->record) || state->record->pending) {
+        pthread_sigmask(SIG_SETMASK, &uc->uc_sigmask, NULL);
+        ex_handler(sig);
+        return;
+    }
+
+    got_signal = true;
+    if (sig == SIGINT)
+        got_ctrl_c = true;
+
+    for (i = 0; i < max_ex_sig; i++) {
+        if (ex_sig[i].sig == sig) {
+            ex = ex_sig[i].ex;
+            break;
+        }
+    }
+
+    if (ex_is_stack_overflow(state, sig, info))
+        ex = EX_NAME(stack_overflow);
+
+    ctx = ex_init();
+    ctx->caught = sig;
+    if (ctx->unstack || ex_is_root(ctx)) {
+        /* nothing to land in, terminates */
+        pthread_sigmask(SIG_SETMASK, &uc->uc_sigmask, NULL);
+        ex_throw(ex, "unknown", 0, NULL, NULL);
+    }
+
+    ctx->ex = ex;
+    ctx->file = "unknown";
+    ctx->line = 0;
+    ctx->is_unwind = false;
+    ctx->function = NULL;
+    ctx->panic = NULL;
+    ex_signal_record(state->record, ctx);
+    pthread_sigmask(SIG_SETMASK, &uc->uc_sigmask, NULL);
+    ex_longjmp(ctx->buf, ctx->state | ex_throw_st);
+}
+
+/* Lowest, and one past highest, address of current `thread` stack. */
+static void ex_stack_bounds(char **low, char **high) {
+    size_t size = 0, guard_size = 0;
+    void *addr = NULL;
+    struct rlimit limit;
+    char top;
+#if defined(__linux__) || defined(__GLIBC__)
+    pthread_attr_t attr;
+    if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+        pthread_attr_getstack(&attr, &addr, &size);
+        pthread_attr_getguardsize(&attr, &guard_size);
+        pthread_attr_destroy(&attr);
+    }
+#elif defined(__APPLE__)
+    size = pthread_get_stacksize_np(pthread_self());
+    addr = (char *)pthread_get_stackaddr_np(pthread_self()) - size;
+#endif
+
+    if (is_empty(addr) || is_zero(size)) {
+        /* only main `thread` grows to it's limit, others get no better bound */
+        size = getrlimit(RLIMIT_STACK, &limit) != 0 || limit.rlim_cur == RLIM_INFINITY
+            ? Mb(8) : (size_t)limit.rlim_cur;
+        *high = &top;
+        *low = &top - size;
+    } else {
+        *high = (char *)addr + size;
+        *low = (char *)addr;
+    }
+
+    /* guard pages below, and a frame or two of slack past them */
+    *low -= guard_size + Kb(64);
+}
+#endif
+
+int ex_signal_thread(size_t size) {
+#if defined(_WIN32)
+    /* `EXCEPTION_STACK_OVERFLOW` already arrives by SEH */
+    return 0;
+#else
+    ex_thread_t *state = ex_thread();
+    ex_signal_record_t *record;
+    stack_t ss;
+
+    if (is_empty(state))
+        return -1;
+
+    if (!is_empty(state->record))
+        return 0;
+
+    /* handler must find context already set up */
+    ex_init();
+    ss.ss_size = size == 0 ? EX_ALTSTACK_SIZE : size;
+    ss.ss_flags = 0;
+    if (is_empty(record = (ex_signal_record_t *)RAII_CALLOC(1, sizeof(ex_signal_record_t) + ss.ss_size)))
+        return -1;
+
+    ss.ss_sp = (void *)(record + 1);
+    if (sigaltstack(&ss, NULL) != 0) {
+        RAII_FREE(record);
+        return -1;
+    }
+
+    ex_stack_bounds(&state->stack_low, &state->stack_high);
+    state->record = record;
+    return 0;
+#endif
+}
+
+void ex_signal_landed(ex_context_t *ctx) {
+#if !defined(_WIN32)
+    ex_thread_t *state = ex_thread();
+    if (LIKELY(is_empty(state) || is_empty(state->record) || !state->record->pending))
+        return;
+
+    state->record->pending = false;
+    ex_signal_block(all);
+    if (exception_setup_func)
+        exception_setup_func(ctx, ctx->ex, ctx->panic);
+    else if (ctx->is_raii)
+        raii_unwind_set(ctx, ctx->ex, ctx->panic);
+
+    ex_unwind_stack(ctx);
+    ex_signal_unblock(all);
+#endif
+}
+
+void ex_signal_thread_free(void) {
+#if !defined(_WIN32)
+    ex_thread_t *state = ex_thread();
+    stack_t ss;
+    if (is_empty(state) || is_empty(state->record))
+        return;
+
+    ss.ss_sp = NULL;
+    ss.ss_size = 0;
+    ss.ss_flags = SS_DISABLE;
+    sigaltstack(&ss, NULL);
+    RAII_FREE(state->record);
+    state->record = NULL;
+    state->stack_low = NULL;
+    state->stack_high = NULL;
+#endif
+}
+
+#ifdef _WIN32
+void ex_signal_defer(bool block) {
+    int sig;
+
+    if (block) {
+        InterlockedIncrement(&ex_signal_depth);
+    } else if (InterlockedDecrement(&ex_signal_depth) == 0
+               && (sig = (int)InterlockedExchange(&ex_signal_pending, 0)) != 0) {
+        raise(sig);
+    }
+}
+#endif
+
 void ex_signal_reset(int sig) {
 #if defined(_WIN32) || defined(_WIN64)
     if (signal(sig, SIG_DFL) == SIG_ERR)
@@ -416,6 +1219,7 @@ void ex_signal_reset(int sig) {
      * Make signal handlers persistent.
      */
     ex_sig_sa.sa_handler = SIG_DFL;
+    ex_sig_sa.sa_flags = 0;
     if (sigemptyset(&ex_sig_sa.sa_mask) != 0)
         fprintf(stderr, "Cannot setup handler for signal no %d\n", sig);
     else if (sigaction(sig, &ex_sig_sa, NULL) != 0)
@@ -448,11 +1252,12 @@ void ex_signal(int sig, const char *ex) {
         ex_sig[i].ex = ex, ex_sig[i].sig = sig;
 #else
     /*
-     * Make signal handlers persistent.
+     * Make signal handlers persistent, blocking all others while one runs,
+     * on alternate stack of `thread`s having one, see `ex_signal_thread`.
      */
-    ex_sig_sa.sa_handler = ex_handler;
-    ex_sig_sa.sa_flags = SA_RESTART;
-    if (sigemptyset(&ex_sig_sa.sa_mask) != 0)
+    ex_sig_sa.sa_sigaction = ex_handler_info;
+    ex_sig_sa.sa_flags = SA_RESTART | SA_SIGINFO | SA_ONSTACK;
+    if (sigfillset(&ex_sig_sa.sa_mask) != 0)
         fprintf(stderr, "Cannot setup handler for signal no %d (%s)\n",
                       sig, ex);
     else if (sigaction(sig, &ex_sig_sa, NULL) != 0)
@@ -466,6 +1271,17 @@ void ex_signal(int sig, const char *ex) {
 }
 
 void ex_signal_setup(void) {
+#if !defined(_WIN32)
+    ex_class_set(EX_NAME(stack_overflow), EX_NAME(sig_segv));
+#endif
+#ifdef EX_NO_SIGNALS
+    exception_signal_set = true;
+#else
+#if defined(EX_BACKTRACE) && !defined(_WIN32)
+    /* first `backtrace` call loads unwinder, not safe within an signal handler */
+    void *frame[1];
+    backtrace(frame, 1);
+#endif
 #ifdef _WIN32
     ex_signal_seh(EXCEPTION_ACCESS_VIOLATION, EX_NAME(sig_segv));
     ex_signal_seh(EXCEPTION_ARRAY_BOUNDS_EXCEEDED, EX_NAME(array_bounds_exceeded));
@@ -532,6 +1348,7 @@ void ex_signal_setup(void) {
 #elif SIG_BUS
     ex_signal(SIG_BUS, EX_NAME(sig_bus));
 #endif
+#endif
 }
 
 void ex_signal_default(void) {
@@ -0,0 +1,399 @@
+#if defined(_WIN32)
+    /* ahead of `windows.h`, that raii.h includes */
+    #include <winsock2.h>
+#endif
+#include "raii.h"
+#if defined(_WIN32)
+    #include <io.h>
+    #include <fcntl.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <sys/socket.h>
+#endif
+
+static void raii_map_advise(raii_map_t *map) {
+#if !defined(_WIN32)
+    int advice = MADV_NORMAL;
+    if (map->flags & RAII_MAP_SEQUENTIAL)
+        advice = MADV_SEQUENTIAL;
+    else if (map->flags & RAII_MAP_RANDOM)
+        advice = MADV_RANDOM;
+
+    if (advice != MADV_NORMAL)
+        madvise(map->data, map->length, advice);
+
+    if (map->flags & RAII_MAP_PREFETCH)
+        madvise(map->data, map->length, MADV_WILLNEED);
+#if defined(MADV_HUGEPAGE)
+    if (map->flags & RAII_MAP_HUGE)
+        madvise(map->data, map->length, MADV_HUGEPAGE);
+#endif
+#endif
+}
+
+raii_map_t *raii_mmap(memory_t *scope, const char *path, int flags) {
+    raii_map_t *map;
+    bool writable = (flags & RAII_MAP_WRITE) != 0;
+#if defined(_WIN32)
+    HANDLE file, mapping = NULL;
+    LARGE_INTEGER size;
+
+    file = CreateFileA(path, writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+                       FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                       (flags & RAII_MAP_SEQUENTIAL) ? FILE_FLAG_SEQUENTIAL_SCAN
+                       : (flags & RAII_MAP_RANDOM) ? FILE_FLAG_RANDOM_ACCESS : FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &size)) {
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+        errno = ENOENT;
+        return NULL;
+    }
+
+    map = try_calloc(1, sizeof(raii_map_t));
+    map->length = (size_t)size.QuadPart;
+    if (map->length > 0) {
+        mapping = CreateFileMappingA(file, NULL, writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, NULL);
+        if (is_empty(mapping) || is_empty(map->data = MapViewOfFile(mapping,
+                writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0))) {
+            if (!is_empty(mapping))
+                CloseHandle(mapping);
+            CloseHandle(file);
+            RAII_FREE(map);
+            errno = ENOMEM;
+            return NULL;
+        }
+
+        /* view stays valid once both handles closed */
+        CloseHandle(mapping);
+    }
+
+    CloseHandle(file);
+#else
+    struct stat info;
+    int fd = open(path, writable ? O_RDWR : O_RDONLY);
+
+    if (fd < 0)
+        return NULL;
+
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        return NULL;
+    }
+
+    map = try_calloc(1, sizeof(raii_map_t));
+    map->length = (size_t)info.st_size;
+    if (map->length > 0) {
+        map->data = mmap(NULL, map->length, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+#if defined(MAP_POPULATE)
+                         ((flags & RAII_MAP_PREFETCH) ? MAP_POPULATE : 0) |
+#endif
+                         (writable ? MAP_SHARED : MAP_PRIVATE), fd, 0);
+        if (map->data == MAP_FAILED) {
+            close(fd);
+            RAII_FREE(map);
+            return NULL;
+        }
+    }
+
+    /* mapping holds it's own reference to file */
+    close(fd);
+#endif
+    map->type = RAII_MAP_VALUE;
+    map->flags = flags;
+    if (map->length > 0)
+        raii_map_advise(map);
+
+    if (!is_empty(scope))
+        raii_deferred(scope, (func_t)raii_munmap, map);
+
+    return map;
+}
+
+void raii_munmap(raii_map_t *map) {
+    if (is_empty(map) || !is_type(map, RAII_MAP_VALUE))
+        return;
+
+    map->type = RAII_NULL;
+    if (!is_empty(map->data)) {
+#if defined(_WIN32)
+        if (map->flags & RAII_MAP_WRITE)
+            FlushViewOfFile(map->data, 0);
+        UnmapViewOfFile(map->data);
+#else
+        munmap(map->data, map->length);
+#endif
+    }
+
+    RAII_FREE(map);
+}
+
+/* Per `thread` pool of I/O buffers, `RAII_IO_BUFFER` bytes each, at most `RAII_IO_POOL` kept. */
+typedef struct raii_io_pool_s {
+    void *list;
+    int count;
+} raii_io_pool_t;
+
+struct raii_io_s {
+    raii_type type;
+    /* descriptor, or socket */
+    intptr_t fd;
+    bool is_writer;
+    bool is_socket;
+    char *buffer;
+    /* reader, unread bytes are `buffer[head..tail)`, writer, pending are `buffer[0..tail)` */
+    size_t head;
+    size_t tail;
+};
+
+static raii_tls_t raii_io_key;
+static once_flag raii_io_once = ONCE_FLAG_INIT;
+
+static void raii_io_drain(void *arg) {
+    raii_io_pool_t *pool = (raii_io_pool_t *)arg;
+    void *buffer;
+    if (is_empty(pool))
+        return;
+
+    while (!is_empty(buffer = pool->list)) {
+        pool->list = *(void **)buffer;
+        RAII_FREE(buffer);
+    }
+
+    RAII_FREE(pool);
+}
+
+static void raii_io_setup(void) {
+    if (raii_tls_create(&raii_io_key, 0, raii_io_drain) != thrd_success)
+        raii_panic("Io `raii_tls_create` failed!");
+}
+
+static raii_io_pool_t *raii_io_pool(void) {
+    raii_io_pool_t *pool;
+    call_once(&raii_io_once, raii_io_setup);
+    if (is_empty(pool = (raii_io_pool_t *)raii_tls_get(raii_io_key))) {
+        pool = try_calloc(1, sizeof(raii_io_pool_t));
+        if (raii_tls_set(raii_io_key, pool) != thrd_success)
+            raii_panic("Io `raii_tls_set` failed!");
+    }
+
+    return pool;
+}
+
+static char *raii_io_buffer(void) {
+    raii_io_pool_t *pool = raii_io_pool();
+    void *buffer;
+    if (!is_empty(buffer = pool->list)) {
+        pool->list = *(void **)buffer;
+        pool->count--;
+        return (char *)buffer;
+    }
+
+    return try_malloc(RAII_IO_BUFFER);
+}
+
+/* Back into pool of calling `thread`, which may not be the one it came from. */
+static void raii_io_recycle(char *buffer) {
+    raii_io_pool_t *pool = raii_io_pool();
+    if (pool->count >= RAII_IO_POOL) {
+        RAII_FREE(buffer);
+        return;
+    }
+
+    *(void **)buffer = pool->list;
+    pool->list = buffer;
+    pool->count++;
+}
+
+static void raii_close_func(void *arg) {
+    raii_close((int)(intptr_t)arg);
+}
+
+int raii_open(memory_t *scope, const char *path, int flags, int mode) {
+#if defined(_WIN32)
+    int fd = _open(path, flags | _O_BINARY, mode);
+#else
+    int fd = open(path, flags, mode);
+#endif
+    if (fd >= 0 && !is_empty(scope))
+        raii_deferred(scope, raii_close_func, (void *)(intptr_t)fd);
+
+    return fd;
+}
+
+RAII_INLINE int raii_close(int fd) {
+#if defined(_WIN32)
+    return _close(fd);
+#else
+    return close(fd);
+#endif
+}
+
+static void raii_socket_close_func(void *arg) {
+    raii_socket_close((raii_socket_t)(intptr_t)arg);
+}
+
+raii_socket_t raii_socket(memory_t *scope, int domain, int type, int protocol) {
+    raii_socket_t sock = socket(domain, type, protocol);
+    if (sock != RAII_BAD_SOCKET && !is_empty(scope))
+        raii_deferred(scope, raii_socket_close_func, (void *)(intptr_t)sock);
+
+    return sock;
+}
+
+RAII_INLINE int raii_socket_close(raii_socket_t sock) {
+#if defined(_WIN32)
+    return closesocket(sock);
+#else
+    return close(sock);
+#endif
+}
+
+static raii_io_t *raii_io(memory_t *scope, intptr_t fd, bool is_writer, bool is_socket) {
+    raii_io_t *io = try_calloc(1, sizeof(raii_io_t));
+    io->type = RAII_STRUCT;
+    io->fd = fd;
+    io->is_writer = is_writer;
+    io->is_socket = is_socket;
+    io->buffer = raii_io_buffer();
+    if (!is_empty(scope))
+        raii_deferred(scope, (func_t)raii_io_free, io);
+
+    return io;
+}
+
+RAII_INLINE raii_io_t *raii_reader(memory_t *scope, int fd) {
+    return raii_io(scope, fd, false, false);
+}
+
+RAII_INLINE raii_io_t *raii_writer(memory_t *scope, int fd) {
+    return raii_io(scope, fd, true, false);
+}
+
+RAII_INLINE raii_io_t *raii_socket_io(memory_t *scope, raii_socket_t sock, bool is_writer) {
+    return raii_io(scope, (intptr_t)sock, is_writer, true);
+}
+
+static long raii_io_sys(raii_io_t *io, void *buf, size_t length) {
+    long done;
+    do {
+#if defined(_WIN32)
+        if (io->is_socket)
+            done = io->is_writer ? send((SOCKET)io->fd, buf, (int)length, 0) : recv((SOCKET)io->fd, buf, (int)length, 0);
+        else
+            done = io->is_writer ? _write((int)io->fd, buf, (unsigned)length) : _read((int)io->fd, buf, (unsigned)length);
+#else
+        done = io->is_writer ? (long)write((int)io->fd, buf, length) : (long)read((int)io->fd, buf, length);
+#endif
+    } while (done < 0 && errno == EINTR);
+
+    return done;
+}
+
+long raii_read(raii_io_t *io, void *buf, size_t length) {
+    size_t avail;
+    long got;
+
+    RAII_ASSERT(!io->is_writer);
+    if (io->head == io->tail) {
+        /* large reads skip buffer */
+        if (length >= RAII_IO_BUFFER)
+            return raii_io_sys(io, buf, length);
+
+        if ((got = raii_io_sys(io, io->buffer, RAII_IO_BUFFER)) <= 0)
+            return got;
+
+        io->head = 0;
+        io->tail = (size_t)got;
+    }
+
+    avail = MIN(length, io->tail - io->head);
+    memcpy(buf, io->buffer + io->head, avail);
+    io->head += avail;
+    return (long)avail;
+}
+
+long raii_read_line(raii_io_t *io, char *line, size_t size) {
+    size_t length = 0;
+    long got;
+    char *end;
+
+    RAII_ASSERT(size > 0);
+    while (length + 1 < size) {
+        if (io->head == io->tail) {
+            if ((got = raii_io_sys(io, io->buffer, RAII_IO_BUFFER)) < 0)
+                return got;
+            if (got == 0)
+                break;
+
+            io->head = 0;
+            io->tail = (size_t)got;
+        }
+
+        got = (long)MIN(size - 1 - length, io->tail - io->head);
+        if (!is_empty(end = memchr(io->buffer + io->head, '\n', (size_t)got)))
+            got = (long)(end - (io->buffer + io->head)) + 1;
+
+        memcpy(line + length, io->buffer + io->head, (size_t)got);
+        io->head += (size_t)got;
+        length += (size_t)got;
+        if (!is_empty(end))
+            break;
+    }
+
+    line[length] = '\0';
+    return (long)length;
+}
+
+int raii_flush(raii_io_t *io) {
+    size_t done = 0;
+    long wrote;
+
+    while (done < io->tail) {
+        if ((wrote = raii_io_sys(io, io->buffer + done, io->tail - done)) <= 0)
+            return RAII_ERR;
+
+        done += (size_t)wrote;
+    }
+
+    io->tail = 0;
+    return RAII_OK;
+}
+
+long raii_write(raii_io_t *io, const void *buf, size_t length) {
+    RAII_ASSERT(io->is_writer);
+    if (io->tail + length > RAII_IO_BUFFER && raii_flush(io) != RAII_OK)
+        return -1;
+
+    if (length >= RAII_IO_BUFFER) {
+        size_t done = 0;
+        long wrote;
+        while (done < length) {
+            if ((wrote = raii_io_sys(io, (char *)buf + done, length - done)) <= 0)
+                return -1;
+
+            done += (size_t)wrote;
+        }
+
+        return (long)length;
+    }
+
+    memcpy(io->buffer + io->tail, buf, length);
+    io->tail += length;
+    return (long)length;
+}
+
+void raii_io_free(raii_io_t *io) {
+    if (is_empty(io) || !is_type(io, RAII_STRUCT))
+        return;
+
+    /* as `fclose`, pending output written out, unwinding too */
+    if (io->is_writer && io->tail > 0)
+        raii_flush(io);
+
+    io->type = RAII_NULL;
+    raii_io_recycle(io->buffer);
+    RAII_FREE(io);
+}
@@ -0,0 +1,325 @@
+#include "raii.h"
+#if !defined(HASH_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+    #include <emmintrin.h>
+    #define HASH_SSE2 1
+    #define HASH_GROUP 16
+#else
+    #define HASH_GROUP 8
+#endif
+
+/* Control bytes, full slots hold low `7` bits of their hash. */
+#define HASH_EMPTY      ((unsigned char)0x80)
+#define HASH_DELETED    ((unsigned char)0xFE)
+
+typedef struct {
+    uint64_t hash;
+    const char *key;
+    size_t length;
+    void *value;
+} hash_slot_t;
+
+/* Open addressing `SwissTable` style table, slots found by probing groups of
+`HASH_GROUP` control bytes at once, first `HASH_GROUP` mirrored past end of `ctrl`. */
+struct hash_s {
+    raii_type type;
+    size_t mask;
+    size_t count;
+    /* `HASH_DELETED` tombstones */
+    size_t deleted;
+    hash_slot_t *slots;
+    unsigned char *ctrl;
+    /* key copies, and table itself when `is_arena` */
+    arena_t keys;
+    bool is_arena;
+};
+
+/* Bit set per matching position, for `hash_next_bit`. */
+typedef uint32_t hash_bits_t;
+
+static RAII_INLINE int hash_next_bit(hash_bits_t *bits) {
+    int i = 0;
+#if defined(__GNUC__) || defined(__clang__)
+    i = __builtin_ctz(*bits);
+#else
+    while (!(*bits & ((hash_bits_t)1 << i)))
+        i++;
+#endif
+    *bits &= *bits - 1;
+    return i;
+}
+
+#ifdef HASH_SSE2
+static RAII_INLINE hash_bits_t hash_match(const unsigned char *ctrl, unsigned char h2) {
+    __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+    return (hash_bits_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8((char)h2), group));
+}
+
+static RAII_INLINE hash_bits_t hash_match_empty(const unsigned char *ctrl) {
+    return hash_match(ctrl, HASH_EMPTY);
+}
+
+static RAII_INLINE hash_bits_t hash_match_free(const unsigned char *ctrl) {
+    return (hash_bits_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+}
+#else
+#define HASH_LSB 0x0101010101010101ULL
+#define HASH_MSB 0x8080808080808080ULL
+
+/* Little endian load, whatever the byte order, byte `i` ends up at bits `8i`. */
+static RAII_INLINE uint64_t hash_group(const unsigned char *ctrl) {
+    uint64_t group = 0;
+    int i;
+    for (i = HASH_GROUP - 1; i >= 0; i--)
+        group = (group << 8) | ctrl[i];
+
+    return group;
+}
+
+/* Byte's high bit kept per position, folded to one bit per position. */
+static RAII_INLINE hash_bits_t hash_fold(uint64_t msb) {
+    hash_bits_t bits = 0;
+    int i;
+    for (i = 0; i < HASH_GROUP; i++)
+        bits |= (hash_bits_t)((msb >> (8 * i + 7)) & 1) << i;
+
+    return bits;
+}
+
+/* May report false positives, slot `hash` compare filters them. */
+static RAII_INLINE hash_bits_t hash_match(const unsigned char *ctrl, unsigned char h2) {
+    uint64_t x = hash_group(ctrl) ^ (HASH_LSB * h2);
+    return hash_fold((x - HASH_LSB) & ~x & HASH_MSB);
+}
+
+static RAII_INLINE hash_bits_t hash_match_empty(const unsigned char *ctrl) {
+    uint64_t group = hash_group(ctrl);
+    return hash_fold(group & ~(group << 6) & HASH_MSB);
+}
+
+static RAII_INLINE hash_bits_t hash_match_free(const unsigned char *ctrl) {
+    return hash_fold(hash_group(ctrl) & HASH_MSB);
+}
+#endif
+
+uint64_t hash_bytes(const void *key, size_t length) {
+    const unsigned char *p = (const unsigned char *)key;
+    uint64_t h = 0x9E3779B97F4A7C15ULL ^ (length * 0xFF51AFD7ED558CCDULL), word;
+    size_t i;
+
+    for (; length >= 8; p += 8, length -= 8) {
+        memcpy(&word, p, 8);
+        h = (h ^ word) * 0xBF58476D1CE4E5B9ULL;
+        h ^= h >> 31;
+    }
+
+    for (word = 0, i = 0; i < length; i++)
+        word |= (uint64_t)p[i] << (8 * i);
+
+    h = (h ^ word) * 0x94D049BB133111EBULL;
+    h ^= h >> 29;
+    h *= 0xBF58476D1CE4E5B9ULL;
+    return h ^ (h >> 32);
+}
+
+static RAII_INLINE void hash_set_ctrl(hash_t *map, size_t i, unsigned char c) {
+    map->ctrl[i] = c;
+    map->ctrl[((i - HASH_GROUP) & map->mask) + HASH_GROUP] = c;
+}
+
+static void hash_table(hash_t *map, size_t capacity) {
+    size_t size = capacity * sizeof(hash_slot_t) + capacity + HASH_GROUP;
+    char *block = map->is_arena
+        ? arena_alloc_aligned(map->keys, (long)size, 16)
+        : try_malloc(size);
+
+    if (UNLIKELY(is_empty(block)))
+        raii_panic("Hash table allocation failed!");
+
+    map->slots = (hash_slot_t *)block;
+    map->ctrl = (unsigned char *)(map->slots + capacity);
+    memset(map->ctrl, HASH_EMPTY, capacity + HASH_GROUP);
+    map->mask = capacity - 1;
+    map->deleted = 0;
+}
+
+/* Slot index of `key`, or `-1`. */
+static size_t hash_find(hash_t *map, const void *key, size_t length, uint64_t h) {
+    size_t pos = (size_t)(h >> 7) & map->mask, stride = 0, i;
+    unsigned char h2 = (unsigned char)(h & 0x7f);
+    hash_bits_t bits;
+
+    for (;;) {
+        bits = hash_match(map->ctrl + pos, h2);
+        while (bits) {
+            i = (pos + hash_next_bit(&bits)) & map->mask;
+            if (map->slots[i].hash == h && map->slots[i].length == length
+                && memcmp(map->slots[i].key, key, length) == 0)
+                return i;
+        }
+
+        if (hash_match_empty(map->ctrl + pos))
+            return -1;
+
+        /* triangular probing, visits every group once when capacity is power of `2` */
+        stride += HASH_GROUP;
+        pos = (pos + stride) & map->mask;
+    }
+}
+
+/* First empty, or deleted, slot on `h` probe sequence. */
+static size_t hash_find_free(hash_t *map, uint64_t h) {
+    size_t pos = (size_t)(h >> 7) & map->mask, stride = 0;
+    hash_bits_t bits;
+
+    while (!(bits = hash_match_free(map->ctrl + pos))) {
+        stride += HASH_GROUP;
+        pos = (pos + stride) & map->mask;
+    }
+
+    return (pos + hash_next_bit(&bits)) & map->mask;
+}
+
+static void hash_place(hash_t *map, hash_slot_t *slot) {
+    size_t i = hash_find_free(map, slot->hash);
+    if (map->ctrl[i] == HASH_DELETED)
+        map->deleted--;
+
+    hash_set_ctrl(map, i, (unsigned char)(slot->hash & 0x7f));
+    map->slots[i] = *slot;
+}
+
+/* Rebuild into table of `capacity`, dropping tombstones. */
+static void hash_rehash(hash_t *map, size_t capacity) {
+    hash_slot_t *slots = map->slots;
+    unsigned char *ctrl = map->ctrl;
+    size_t i, old = map->mask + 1;
+
+    hash_table(map, capacity);
+    for (i = 0; i < old; i++) {
+        if (!(ctrl[i] & 0x80))
+            hash_place(map, &slots[i]);
+    }
+
+    if (!map->is_arena)
+        RAII_FREE(slots);
+}
+
+/* Entries table holds, at `7/8` load, power of `2`, at least `HASH_GROUP`. */
+static size_t hash_capacity_for(size_t count) {
+    size_t capacity = HASH_GROUP;
+    while (capacity - capacity / 8 <= count)
+        capacity <<= 1;
+
+    return capacity;
+}
+
+static hash_t *hash_new(arena_t arena, size_t capacity) {
+    hash_t *map = try_calloc(1, sizeof(hash_t));
+    map->type = RAII_OA_HASH;
+    map->is_arena = !is_empty(arena);
+    map->keys = map->is_arena ? arena : arena_init(0);
+    hash_table(map, hash_capacity_for(capacity));
+    return map;
+}
+
+hash_t *hash_create(memory_t *scope, size_t capacity) {
+    hash_t *map = hash_new(NULL, capacity);
+    if (!is_empty(scope))
+        raii_deferred(scope, (func_t)hash_free, map);
+
+    return map;
+}
+
+hash_t *hash_create_arena(arena_t arena, size_t capacity) {
+    if (UNLIKELY(is_empty(arena)))
+        raii_panic("Failed! `hash_create_arena` invalid arena");
+
+    return hash_new(arena, capacity);
+}
+
+void hash_free(hash_t *map) {
+    if (is_empty(map) || !is_type(map, RAII_OA_HASH))
+        return;
+
+    if (!map->is_arena) {
+        RAII_FREE(map->slots);
+        arena_free(map->keys);
+    }
+
+    map->type = RAII_NULL;
+    RAII_FREE(map);
+}
+
+void *hash_get(hash_t *map, const void *key, size_t length) {
+    size_t i = hash_find(map, key, length, hash_bytes(key, length));
+    return i == (size_t)-1 ? NULL : map->slots[i].value;
+}
+
+RAII_INLINE bool hash_has(hash_t *map, const void *key, size_t length) {
+    return hash_find(map, key, length, hash_bytes(key, length)) != (size_t)-1;
+}
+
+void hash_put(hash_t *map, const void *key, size_t length, void *value) {
+    uint64_t h = hash_bytes(key, length);
+    size_t i = hash_find(map, key, length, h), capacity = map->mask + 1;
+    hash_slot_t slot;
+    char *copy;
+
+    if (i != (size_t)-1) {
+        map->slots[i].value = value;
+        return;
+    }
+
+    if (map->count + map->deleted + 1 > capacity - capacity / 8)
+        hash_rehash(map, hash_capacity_for(map->count + 1));
+
+    copy = arena_alloc(map->keys, (long)(length + 1));
+    if (UNLIKELY(is_empty(copy)))
+        raii_panic("Hash key allocation failed!");
+
+    memcpy(copy, key, length);
+    copy[length] = '\0';
+    slot.hash = h;
+    slot.key = copy;
+    slot.length = length;
+    slot.value = value;
+    hash_place(map, &slot);
+    map->count++;
+}
+
+bool hash_remove(hash_t *map, const void *key, size_t length) {
+    size_t i = hash_find(map, key, length, hash_bytes(key, length));
+    if (i == (size_t)-1)
+        return false;
+
+    hash_set_ctrl(map, i, HASH_DELETED);
+    map->deleted++;
+    map->count--;
+    return true;
+}
+
+RAII_INLINE size_t hash_count(hash_t *map) {
+    return map->count;
+}
+
+bool hash_next(hash_t *map, size_t *cursor, const char **key, size_t *length, void **value) {
+    size_t i;
+    for (i = *cursor; i <= map->mask; i++) {
+        if (!(map->ctrl[i] & 0x80)) {
+            if (!is_empty(key))
+                *key = map->slots[i].key;
+
+            if (!is_empty(length))
+                *length = map->slots[i].length;
+
+            if (!is_empty(value))
+                *value = map->slots[i].value;
+
+            *cursor = i + 1;
+            return true;
+        }
+    }
+
+    *cursor = i;
+    return false;
+}
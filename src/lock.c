@@ -0,0 +1,227 @@
+/* Real `mtx_lock` and `cnd_wait` below, not their `RAII_LOCK_PROFILE` wrappers. */
+#define RAII_LOCK_UNPROFILED
+#include "raii.h"
+
+#ifdef RAII_LOCK_PROFILE
+/* Slot `i` holds profile of lock at `lock_keys[i]`, linear probing by address,
+never removed, so lookups need no lock. Profile fields change only by holder of it's lock. */
+static void *volatile lock_keys[RAII_LOCK_PROFILES];
+static raii_lock_stats_t lock_profiles[RAII_LOCK_PROFILES];
+
+static raii_lock_stats_t *lock_profile(const void *lock) {
+    size_t i, start = ((uintptr_t)lock >> 4) * 0x9e3779b97f4a7c15ull % RAII_LOCK_PROFILES;
+    void *key;
+
+    for (i = 0; i < RAII_LOCK_PROFILES; i++) {
+        size_t slot = (start + i) % RAII_LOCK_PROFILES;
+        key = atomic_ptr_load(&lock_keys[slot]);
+        if (key == lock)
+            return &lock_profiles[slot];
+
+        if (is_empty(key)) {
+            if (atomic_ptr_cas(&lock_keys[slot], &key, (void *)lock)) {
+                lock_profiles[slot].lock = lock;
+                return &lock_profiles[slot];
+            }
+
+            /* lost to another lock, or same one */
+            if (key == lock)
+                return &lock_profiles[slot];
+        }
+    }
+
+    return NULL;
+}
+
+/* Holder at `file:line` made another wait. */
+static void lock_blocked_by(raii_lock_stats_t *profile, const char *file, int line) {
+    raii_lock_site_t *least = &profile->sites[0];
+    int i;
+
+    if (is_empty((void *)file))
+        return;
+
+    for (i = 0; i < RAII_LOCK_SITES; i++) {
+        raii_lock_site_t *site = &profile->sites[i];
+        if (site->line == line && site->file == file) {
+            site->count++;
+            return;
+        }
+
+        if (site->count < least->count)
+            least = site;
+    }
+
+    least->file = file;
+    least->line = line;
+    least->count = 1;
+}
+
+/* Lock just acquired by `file:line`, after `waited` nanoseconds if contended. */
+static void lock_acquired(raii_lock_stats_t *profile, bool contended, size_t waited,
+                          const char *file, int line) {
+    int bucket = 0;
+
+    profile->acquired++;
+    if (contended) {
+        profile->contended++;
+        profile->wait_ns += waited;
+        profile->max_ns = MAX(profile->max_ns, waited);
+        for (waited >>= 10; waited > 0 && bucket < RAII_LOCK_BUCKETS - 1; waited >>= 1)
+            bucket++;
+
+        profile->histogram[bucket]++;
+    }
+
+    profile->file = file;
+    profile->line = line;
+}
+#endif
+
+int raii_mtx_lock(mtx_t *mtx, const char *file, int line) {
+#ifdef RAII_LOCK_PROFILE
+    raii_lock_stats_t *profile = lock_profile(mtx);
+    const char *holder;
+    uint64_t start;
+    int result, holder_line;
+
+    if (is_empty(profile))
+        return mtx_lock(mtx);
+
+    if (mtx_trylock(mtx) == thrd_success) {
+        lock_acquired(profile, false, 0, file, line);
+        return thrd_success;
+    }
+
+    /* read unlocked, holder may be leaving, still worth blaming */
+    holder = profile->file;
+    holder_line = profile->line;
+    start = raii_trace_now();
+    if ((result = mtx_lock(mtx)) == thrd_success) {
+        lock_acquired(profile, true, (size_t)(raii_trace_now() - start), file, line);
+        lock_blocked_by(profile, holder, holder_line);
+    }
+
+    return result;
+#else
+    return mtx_lock(mtx);
+#endif
+}
+
+int raii_mtx_trylock(mtx_t *mtx, const char *file, int line) {
+    int result = mtx_trylock(mtx);
+#ifdef RAII_LOCK_PROFILE
+    raii_lock_stats_t *profile;
+    if (result == thrd_success && !is_empty(profile = lock_profile(mtx)))
+        lock_acquired(profile, false, 0, file, line);
+#endif
+    return result;
+}
+
+int raii_cnd_wait(cnd_t *cnd, mtx_t *mtx, const char *file, int line) {
+#ifdef RAII_LOCK_PROFILE
+    raii_lock_stats_t *profile = lock_profile(mtx);
+    uint64_t start = raii_trace_now();
+    int result = cnd_wait(cnd, mtx);
+
+    /* `mtx` held again, either way */
+    if (!is_empty(profile)) {
+        profile->cnd_waits++;
+        profile->cnd_ns += (size_t)(raii_trace_now() - start);
+        lock_acquired(profile, false, 0, file, line);
+    }
+
+    return result;
+#else
+    return cnd_wait(cnd, mtx);
+#endif
+}
+
+int raii_cnd_timedwait(cnd_t *cnd, mtx_t *mtx, const struct timespec *ts, const char *file, int line) {
+#ifdef RAII_LOCK_PROFILE
+    raii_lock_stats_t *profile = lock_profile(mtx);
+    uint64_t start = raii_trace_now();
+    int result = cnd_timedwait(cnd, mtx, ts);
+
+    if (!is_empty(profile) && result != thrd_error) {
+        profile->cnd_waits++;
+        profile->cnd_ns += (size_t)(raii_trace_now() - start);
+        lock_acquired(profile, false, 0, file, line);
+    }
+
+    return result;
+#else
+    return cnd_timedwait(cnd, mtx, ts);
+#endif
+}
+
+void raii_lock_name(const void *lock, const char *name) {
+#ifdef RAII_LOCK_PROFILE
+    raii_lock_stats_t *profile = lock_profile(lock);
+    if (!is_empty(profile))
+        profile->name = name;
+#endif
+}
+
+#ifdef RAII_LOCK_PROFILE
+static int lock_compare(const void *a, const void *b) {
+    size_t x = ((const raii_lock_stats_t *)a)->wait_ns, y = ((const raii_lock_stats_t *)b)->wait_ns;
+    return (x < y) - (x > y);
+}
+#endif
+
+int raii_lock_stats(raii_lock_stats_t *out, int max) {
+    int count = 0;
+#ifdef RAII_LOCK_PROFILE
+    raii_lock_stats_t *all = try_calloc(RAII_LOCK_PROFILES, sizeof(raii_lock_stats_t));
+    int i;
+
+    for (i = 0; i < RAII_LOCK_PROFILES; i++) {
+        if (!is_empty(atomic_ptr_load(&lock_keys[i])))
+            all[count++] = lock_profiles[i];
+    }
+
+    qsort(all, count, sizeof(raii_lock_stats_t), lock_compare);
+    count = MIN(count, max);
+    memcpy(out, all, count * sizeof(raii_lock_stats_t));
+    RAII_FREE(all);
+#endif
+    return count;
+}
+
+int raii_lock_report(FILE *out) {
+    int count = 0;
+#ifdef RAII_LOCK_PROFILE
+    raii_lock_stats_t *all = try_calloc(RAII_LOCK_PROFILES, sizeof(raii_lock_stats_t));
+    int i, j;
+
+    count = raii_lock_stats(all, RAII_LOCK_PROFILES);
+    fprintf(out, "%-24s %12s %12s %14s %12s %12s\n", "lock", "acquired", "contended",
+            "wait us", "max us", "cnd waits");
+    for (i = 0; i < count; i++) {
+        raii_lock_stats_t *profile = &all[i];
+        if (is_empty((void *)profile->name))
+            fprintf(out, "%-24p", profile->lock);
+        else
+            fprintf(out, "%-24s", profile->name);
+
+        fprintf(out, " %12zu %12zu %14.1f %12.1f %12zu\n", profile->acquired, profile->contended,
+                profile->wait_ns / 1e3, profile->max_ns / 1e3, profile->cnd_waits);
+        for (j = 0; j < RAII_LOCK_SITES; j++) {
+            if (profile->sites[j].count > 0)
+                fprintf(out, "    held at %s:%d, made %zu wait\n", profile->sites[j].file,
+                        profile->sites[j].line, profile->sites[j].count);
+        }
+    }
+
+    RAII_FREE(all);
+#endif
+    return count;
+}
+
+void raii_lock_reset(void) {
+#ifdef RAII_LOCK_PROFILE
+    memset(lock_profiles, 0, sizeof(lock_profiles));
+    memset((void *)lock_keys, 0, sizeof(lock_keys));
+#endif
+}
@@ -0,0 +1,291 @@
+#include "raii.h"
+#if !defined(_WIN32)
+    #include <unistd.h>
+    #include <sys/uio.h>
+#else
+    #include <io.h>
+#endif
+
+/* Records written back to back, never split across ring end, `length` of
+`LOG_SKIP` pads out to end, so next one starts at beginning. */
+typedef struct {
+    uint32_t length;
+    uint32_t level;
+} log_record_t;
+
+#define LOG_SKIP ((uint32_t)-1)
+#define LOG_ALIGN(n) (((n) + sizeof(log_record_t) - 1) & ~(sizeof(log_record_t) - 1))
+/* `iovec` entries per `writev`, as `IOV_MAX` is at least `16` */
+#define LOG_BATCH 16
+
+/* Single producer, it's `thread`, single consumer, drain `thread`, ring. */
+typedef struct log_ring_s log_ring_t;
+struct log_ring_s {
+    char *data;
+    size_t size;
+    volatile size_t head;
+    char pad[64];
+    volatile size_t tail;
+    /* owner `thread` exited, drainer frees once empty */
+    volatile int closed;
+    log_ring_t *next;
+};
+
+static struct {
+    volatile int running;
+    thrd_t thread;
+    mtx_t lock[1];
+    log_ring_t *rings;
+    size_t ring_size;
+    ex_log_func previous;
+    bool is_setup;
+} log_state;
+
+static raii_tls_t log_key;
+static once_flag log_once = ONCE_FLAG_INIT;
+
+static void log_ring_close(void *arg) {
+    atomic_int_store(&((log_ring_t *)arg)->closed, 1);
+}
+
+static void log_setup(void) {
+    if (raii_tls_create(&log_key, 0, log_ring_close) != thrd_success || mtx_init(log_state.lock, mtx_plain) != thrd_success)
+        raii_panic("Log `raii_tls_create/mtx_init` failed!");
+
+    raii_lock_name(log_state.lock, "log");
+    log_state.is_setup = true;
+}
+
+static log_ring_t *log_ring(void) {
+    log_ring_t *ring;
+    if (!is_empty(ring = (log_ring_t *)raii_tls_get(log_key)))
+        return ring;
+
+    ring = try_calloc(1, sizeof(log_ring_t));
+    ring->size = log_state.ring_size;
+    ring->data = try_malloc(ring->size);
+    if (raii_tls_set(log_key, ring) != thrd_success)
+        raii_panic("Log `raii_tls_set` failed!");
+
+    mtx_lock(log_state.lock);
+    ring->next = log_state.rings;
+    log_state.rings = ring;
+    mtx_unlock(log_state.lock);
+    return ring;
+}
+
+static void log_direct(int level, const char *text, size_t length) {
+#if defined(_WIN32)
+    _write(level == EX_LOG_OUT ? 1 : 2, text, (unsigned)length);
+#else
+    ssize_t done;
+    while (length > 0 && ((done = write(level == EX_LOG_OUT ? 1 : 2, text, length)) > 0 || errno == EINTR)) {
+        if (done > 0) {
+            text += done;
+            length -= (size_t)done;
+        }
+    }
+#endif
+}
+
+/* Reserve `need` contiguous bytes, `NULL` if ring too full. */
+static char *log_reserve(log_ring_t *ring, size_t need) {
+    size_t tail = ring->tail, head = atomic_size_load(&ring->head);
+    size_t at = tail % ring->size, room = ring->size - at;
+    log_record_t skip;
+
+    if (need > room) {
+        /* pad to end, write from beginning */
+        if (ring->size - (tail - head) < room + need)
+            return NULL;
+
+        if (room >= sizeof(log_record_t)) {
+            skip.length = LOG_SKIP;
+            skip.level = 0;
+            memcpy(ring->data + at, &skip, sizeof(skip));
+        }
+
+        tail += room;
+        atomic_size_store(&ring->tail, tail);
+        at = 0;
+    } else if (ring->size - (tail - head) < need) {
+        return NULL;
+    }
+
+    return ring->data + at;
+}
+
+/* Sink installed by `raii_log_start`, only blocks on output when it's ring
+is full, then drains in place, fatal and oversized messages are written
+directly after draining, keeping each `thread` messages in order. */
+static void log_sink(int level, const char *text, size_t length) {
+    size_t need = sizeof(log_record_t) + LOG_ALIGN(length);
+    log_ring_t *ring;
+    log_record_t record;
+    char *at;
+
+    if (level == EX_LOG_FATAL || !atomic_int_load(&log_state.running)) {
+        raii_log_flush();
+        log_direct(level, text, length);
+        return;
+    }
+
+    ring = log_ring();
+    if (need > ring->size / 2) {
+        raii_log_flush();
+        log_direct(level, text, length);
+        return;
+    }
+
+    if (is_empty(at = log_reserve(ring, need))) {
+        /* keep order, drain ourself rather than write around what's queued */
+        raii_log_flush();
+        at = log_reserve(ring, need);
+    }
+
+    record.length = (uint32_t)length;
+    record.level = (uint32_t)level;
+    memcpy(at, &record, sizeof(record));
+    memcpy(at + sizeof(record), text, length);
+    atomic_size_store(&ring->tail, ring->tail + need);
+}
+
+#if !defined(_WIN32)
+static void log_writev(int fd, struct iovec *iov, int count) {
+    ssize_t done;
+    int i = 0;
+
+    while (i < count) {
+        if ((done = writev(fd, iov + i, count - i)) < 0) {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+
+        for (; i < count && (size_t)done >= iov[i].iov_len; i++)
+            done -= (ssize_t)iov[i].iov_len;
+
+        if (i < count) {
+            iov[i].iov_base = (char *)iov[i].iov_base + done;
+            iov[i].iov_len -= (size_t)done;
+        }
+    }
+}
+#endif
+
+/* Write out everything queued on `ring`, runs of same destination by one `writev`. */
+static size_t log_drain(log_ring_t *ring) {
+    size_t head = ring->head, tail = atomic_size_load(&ring->tail), drained = 0;
+    log_record_t record;
+#if !defined(_WIN32)
+    struct iovec iov[LOG_BATCH];
+    int count = 0, fd = 1;
+#endif
+
+    while (head != tail) {
+        size_t at = head % ring->size, room = ring->size - at;
+        if (room < sizeof(log_record_t)) {
+            head += room;
+            continue;
+        }
+
+        memcpy(&record, ring->data + at, sizeof(record));
+        if (record.length == LOG_SKIP) {
+            head += room;
+            continue;
+        }
+
+#if !defined(_WIN32)
+        if (count == LOG_BATCH || (count > 0 && fd != (record.level == EX_LOG_OUT ? 1 : 2))) {
+            log_writev(fd, iov, count);
+            count = 0;
+        }
+
+        fd = record.level == EX_LOG_OUT ? 1 : 2;
+        iov[count].iov_base = ring->data + at + sizeof(record);
+        iov[count++].iov_len = record.length;
+#else
+        log_direct((int)record.level, ring->data + at + sizeof(record), record.length);
+#endif
+        head += sizeof(record) + LOG_ALIGN(record.length);
+        drained++;
+    }
+
+#if !defined(_WIN32)
+    if (count > 0)
+        log_writev(fd, iov, count);
+#endif
+    atomic_size_store(&ring->head, head);
+    return drained;
+}
+
+/* Lock held. */
+static size_t log_drain_all(void) {
+    log_ring_t **link = &log_state.rings, *ring;
+    size_t drained = 0;
+
+    while (!is_empty(ring = *link)) {
+        drained += log_drain(ring);
+        if (atomic_int_load(&ring->closed) && ring->head == atomic_size_load(&ring->tail)) {
+            *link = ring->next;
+            RAII_FREE(ring->data);
+            RAII_FREE(ring);
+            continue;
+        }
+
+        link = &ring->next;
+    }
+
+    return drained;
+}
+
+static int log_main(void *arg) {
+    struct timespec pause = {0, 1000000};
+    size_t drained;
+
+    while (atomic_int_load(&log_state.running)) {
+        mtx_lock(log_state.lock);
+        drained = log_drain_all();
+        mtx_unlock(log_state.lock);
+        if (is_zero(drained))
+            thrd_sleep(&pause, NULL);
+    }
+
+    return 0;
+}
+
+int raii_log_start(size_t ring_size) {
+    call_once(&log_once, log_setup);
+    if (atomic_int_load(&log_state.running))
+        return RAII_ERR;
+
+    log_state.ring_size = ring_size < 4096 ? 4096 : ring_size;
+    fflush(stdout);
+    atomic_int_store(&log_state.running, 1);
+    if (thrd_create(&log_state.thread, log_main, NULL) != thrd_success) {
+        atomic_int_store(&log_state.running, 0);
+        return RAII_ERR;
+    }
+
+    log_state.previous = exception_log_func;
+    exception_log_func = log_sink;
+    return RAII_OK;
+}
+
+void raii_log_flush(void) {
+    if (!log_state.is_setup)
+        return;
+
+    mtx_lock(log_state.lock);
+    log_drain_all();
+    mtx_unlock(log_state.lock);
+}
+
+void raii_log_stop(void) {
+    if (!log_state.is_setup || !atomic_int_swap(&log_state.running, 0))
+        return;
+
+    thrd_join(log_state.thread, NULL);
+    exception_log_func = log_state.previous;
+    raii_log_flush();
+}
@@ -0,0 +1,206 @@
+#include "raii.h"
+#include "compat/sys/tree.h"
+
+typedef struct map_node_s map_node_t;
+struct map_node_s {
+    RB_ENTRY(map_node_s) entry;
+    const void *key;
+    void *value;
+};
+
+RB_HEAD(map_tree_s, map_node_s);
+
+/* Ordered map, an red-black tree of nodes recycled by map's own object pool. */
+struct map_s {
+    raii_type type;
+    struct map_tree_s tree;
+    map_cmp_func cmp;
+    size_t count;
+    object_pool_t *nodes;
+};
+
+/* Tree's own `RB_INSERT`/`RB_FIND`/`RB_NFIND` are not used, their compare gets nodes only,
+needing `cmp` stored in every node, `map_descend` uses map's one instead. */
+static int map_node_cmp(map_node_t *a, map_node_t *b) {
+    return 0;
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+    #define MAP_TREE_ATTR __attribute__((__unused__)) static
+#else
+    #define MAP_TREE_ATTR static
+#endif
+RB_PROTOTYPE_INTERNAL(map_tree_s, map_node_s, entry, map_node_cmp, MAP_TREE_ATTR)
+RB_GENERATE_INTERNAL(map_tree_s, map_node_s, entry, map_node_cmp, MAP_TREE_ATTR)
+
+static int map_cmp_int(const void *a, const void *b) {
+    return (intptr_t)a < (intptr_t)b ? -1 : (intptr_t)a > (intptr_t)b;
+}
+
+RAII_INLINE int map_cmp_str(const void *a, const void *b) {
+    return strcmp((const char *)a, (const char *)b);
+}
+
+map_t *map_create(memory_t *scope, map_cmp_func cmp) {
+    map_t *map = try_calloc(1, sizeof(map_t));
+    map->type = RAII_MAP_STRUCT;
+    map->cmp = is_empty(cmp) ? map_cmp_int : cmp;
+    map->nodes = pool_create(NULL, sizeof(map_node_t), 0);
+    RB_INIT(&map->tree);
+    if (!is_empty(scope))
+        raii_deferred(scope, (func_t)map_free, map);
+
+    return map;
+}
+
+void map_free(map_t *map) {
+    if (is_empty(map) || !is_type(map, RAII_MAP_STRUCT))
+        return;
+
+    /* nodes all go with their pool */
+    pool_free(map->nodes);
+    map->type = RAII_NULL;
+    RAII_FREE(map);
+}
+
+/* Node with `key`, or `NULL`, with `parent` and `comp` of where it would attach,
+and `ceiling`, the smallest node greater. */
+static map_node_t *map_descend(map_t *map, const void *key,
+                               map_node_t **parent, int *comp, map_node_t **ceiling) {
+    map_node_t *node = RB_ROOT(&map->tree);
+    *parent = *ceiling = NULL;
+    *comp = 0;
+    while (!is_empty(node)) {
+        *parent = node;
+        if ((*comp = map->cmp(key, node->key)) == 0)
+            return node;
+
+        if (*comp < 0) {
+            *ceiling = node;
+            node = RB_LEFT(node, entry);
+        } else {
+            node = RB_RIGHT(node, entry);
+        }
+    }
+
+    return NULL;
+}
+
+static RAII_INLINE map_node_t *map_find(map_t *map, const void *key) {
+    map_node_t *parent, *ceiling;
+    int comp;
+    return map_descend(map, key, &parent, &comp, &ceiling);
+}
+
+void *map_put(map_t *map, const void *key, void *value) {
+    map_node_t *node, *parent, *ceiling;
+    void *previous;
+    int comp;
+
+    if (!is_empty(node = map_descend(map, key, &parent, &comp, &ceiling))) {
+        previous = node->value;
+        node->value = value;
+        return previous;
+    }
+
+    node = pool_get(map->nodes);
+    node->key = key;
+    node->value = value;
+    RB_SET(node, parent, entry);
+    if (is_empty(parent))
+        RB_ROOT(&map->tree) = node;
+    else if (comp < 0)
+        RB_LEFT(parent, entry) = node;
+    else
+        RB_RIGHT(parent, entry) = node;
+
+    map_tree_s_RB_INSERT_COLOR(&map->tree, node);
+    map->count++;
+    return NULL;
+}
+
+void *map_get(map_t *map, const void *key) {
+    map_node_t *node = map_find(map, key);
+    return is_empty(node) ? NULL : node->value;
+}
+
+RAII_INLINE bool map_has(map_t *map, const void *key) {
+    return !is_empty(map_find(map, key));
+}
+
+static void map_erase(map_t *map, map_node_t *node, const void **key, void **value) {
+    if (!is_empty(key))
+        *key = node->key;
+
+    if (!is_empty(value))
+        *value = node->value;
+
+    RB_REMOVE(map_tree_s, &map->tree, node);
+    pool_put(map->nodes, node);
+    map->count--;
+}
+
+bool map_remove(map_t *map, const void *key, void **value) {
+    map_node_t *node = map_find(map, key);
+    if (is_empty(node))
+        return false;
+
+    map_erase(map, node, NULL, value);
+    return true;
+}
+
+bool map_pop_first(map_t *map, const void **key, void **value) {
+    map_node_t *node = RB_MIN(map_tree_s, &map->tree);
+    if (is_empty(node))
+        return false;
+
+    map_erase(map, node, key, value);
+    return true;
+}
+
+RAII_INLINE size_t map_count(map_t *map) {
+    return map->count;
+}
+
+map_iter_t map_begin(map_t *map) {
+    map_iter_t it;
+    it.type = RAII_MAP_ITER;
+    it.map = map;
+    it.node = RB_MIN(map_tree_s, &map->tree);
+    it.hi = NULL;
+    it.is_bounded = false;
+    return it;
+}
+
+map_iter_t map_from(map_t *map, const void *lo) {
+    map_iter_t it = map_begin(map);
+    map_node_t *parent, *ceiling, *node;
+    int comp;
+
+    node = map_descend(map, lo, &parent, &comp, &ceiling);
+    it.node = is_empty(node) ? ceiling : node;
+    return it;
+}
+
+map_iter_t map_range(map_t *map, const void *lo, const void *hi) {
+    map_iter_t it = map_from(map, lo);
+    it.hi = hi;
+    it.is_bounded = true;
+    return it;
+}
+
+bool map_next(map_iter_t *it, const void **key, void **value) {
+    map_node_t *node = (map_node_t *)it->node;
+    if (is_empty(node) || (it->is_bounded && it->map->cmp(node->key, it->hi) >= 0))
+        return false;
+
+    if (!is_empty(key))
+        *key = node->key;
+
+    if (!is_empty(value))
+        *value = node->value;
+
+    /* advanced first, so caller may remove entry just returned */
+    it->node = RB_NEXT(map_tree_s, &it->map->tree, node);
+    return true;
+}
@@ -0,0 +1,315 @@
+#include "raii.h"
+#if defined(RAII_MEMCHECK)
+#   if defined(_WIN32)
+#       define MEMCHECK_CAPTURE(frames, max)    CaptureStackBackTrace(1, max, frames, NULL)
+#   else
+#       include <unistd.h>
+#       include <sys/mman.h>
+#       if defined(__GLIBC__) || defined(__APPLE__)
+#           include <execinfo.h>
+#           define MEMCHECK_CAPTURE(frames, max)    backtrace(frames, max)
+#           define MEMCHECK_SYMBOLS
+#       endif
+#   endif
+#endif
+
+#ifdef RAII_MEMCHECK
+#define MEMCHECK_BUCKETS 4096
+
+/* Tracked block, live till released through it's scope, then kept in quarantine,
+poisoned and not yet freed, so it's address can't be reused while a second release,
+or use after unwind, is still detectable. */
+typedef struct memcheck_s memcheck_t;
+struct memcheck_s {
+    const void *ptr;
+    size_t size;
+    bool is_freed;
+    bool is_reused;
+    int depth;
+    void *frames[RAII_MEMCHECK_DEPTH];
+    memcheck_t *next;
+    memcheck_t *quarantine;
+};
+
+/* Released arena chunk, whole mapping made inaccessible. */
+typedef struct {
+    void *base;
+    size_t length;
+} memcheck_chunk_t;
+
+static memcheck_t *memcheck_buckets[MEMCHECK_BUCKETS];
+static memcheck_t *memcheck_oldest = NULL, *memcheck_newest = NULL;
+static size_t memcheck_quarantined = 0;
+static memcheck_chunk_t memcheck_chunks[RAII_MEMCHECK_CHUNKS];
+static size_t memcheck_chunk_next = 0;
+static size_t memcheck_live_count = 0, memcheck_double_count = 0;
+static bool memcheck_reported = false;
+static mtx_t memcheck_lock[1];
+static once_flag memcheck_once = ONCE_FLAG_INIT;
+
+static void memcheck_exit(void) {
+    raii_memcheck_leaks();
+}
+
+static void memcheck_setup(void) {
+    if (mtx_init(memcheck_lock, mtx_plain) != thrd_success)
+        raii_panic("Memcheck `mtx_init` failed!");
+
+    atexit(memcheck_exit);
+}
+
+static RAII_INLINE void memcheck_locked(bool lock) {
+    if (lock) {
+        call_once(&memcheck_once, memcheck_setup);
+        mtx_lock(memcheck_lock);
+    } else {
+        mtx_unlock(memcheck_lock);
+    }
+}
+
+static RAII_INLINE memcheck_t **memcheck_slot(const void *ptr) {
+    memcheck_t **slot = &memcheck_buckets[((uintptr_t)ptr >> 4) % MEMCHECK_BUCKETS];
+    while (!is_empty(*slot) && (*slot)->ptr != ptr)
+        slot = &(*slot)->next;
+
+    return slot;
+}
+
+static void memcheck_print(FILE *out, memcheck_t *entry) {
+    int i;
+    for (i = 0; i < entry->depth; i++)
+        fprintf(out, "    #%d %p\n", i, entry->frames[i]);
+#ifdef MEMCHECK_SYMBOLS
+    if (entry->depth > 0) {
+        fflush(out);
+        backtrace_symbols_fd(entry->frames, entry->depth, fileno(out));
+    }
+#endif
+}
+
+void raii_memcheck_track(const void *ptr, size_t size) {
+    memcheck_t **slot, *entry, *old;
+    if (is_empty((void *)ptr))
+        return;
+
+    entry = RAII_CALLOC(1, sizeof(memcheck_t));
+    if (is_empty(entry))
+        return;
+
+    entry->ptr = ptr;
+    entry->size = size;
+#ifdef MEMCHECK_CAPTURE
+    entry->depth = (int)MEMCHECK_CAPTURE(entry->frames, RAII_MEMCHECK_DEPTH);
+#elif defined(__GNUC__) || defined(__clang__)
+    entry->frames[0] = __builtin_return_address(0);
+    entry->depth = 1;
+#endif
+    memcheck_locked(true);
+    /* address reused, block was freed outside it's scope */
+    if (!is_empty(old = *(slot = memcheck_slot(ptr)))) {
+        *slot = old->next;
+        if (old->is_freed) {
+            /* left in quarantine, not to be freed again */
+            old->is_reused = true;
+        } else {
+            memcheck_live_count--;
+            RAII_FREE(old);
+        }
+    }
+
+    entry->next = memcheck_buckets[((uintptr_t)ptr >> 4) % MEMCHECK_BUCKETS];
+    memcheck_buckets[((uintptr_t)ptr >> 4) % MEMCHECK_BUCKETS] = entry;
+    memcheck_live_count++;
+    memcheck_locked(false);
+}
+
+void raii_memcheck_forget(const void *ptr) {
+    memcheck_t **slot, *entry;
+    if (is_empty((void *)ptr))
+        return;
+
+    memcheck_locked(true);
+    if (!is_empty(entry = *(slot = memcheck_slot(ptr))) && !entry->is_freed) {
+        *slot = entry->next;
+        memcheck_live_count--;
+        RAII_FREE(entry);
+    }
+    memcheck_locked(false);
+}
+
+bool raii_memcheck_free(void *ptr) {
+    memcheck_t *entry, *oldest = NULL;
+    if (is_empty(ptr))
+        return false;
+
+    memcheck_locked(true);
+    if (is_empty(entry = *memcheck_slot(ptr))) {
+        memcheck_locked(false);
+        return false;
+    }
+
+    if (entry->is_freed) {
+        memcheck_double_count++;
+        fprintf(stderr, "\nMemcheck: double free of %p, %zu bytes, allocated at:\n", ptr, entry->size);
+        memcheck_print(stderr, entry);
+        memcheck_locked(false);
+        return true;
+    }
+
+    entry->is_freed = true;
+    memcheck_live_count--;
+    memset(ptr, 0xdd, entry->size);
+    RAII_POISON(ptr, entry->size);
+    if (is_empty(memcheck_newest))
+        memcheck_oldest = entry;
+    else
+        memcheck_newest->quarantine = entry;
+
+    memcheck_newest = entry;
+    if (++memcheck_quarantined > RAII_MEMCHECK_QUARANTINE) {
+        oldest = memcheck_oldest;
+        if (is_empty(memcheck_oldest = oldest->quarantine))
+            memcheck_newest = NULL;
+
+        memcheck_quarantined--;
+        if (!oldest->is_reused)
+            *memcheck_slot(oldest->ptr) = oldest->next;
+    }
+    memcheck_locked(false);
+
+    if (!is_empty(oldest)) {
+        if (!oldest->is_reused) {
+            RAII_UNPOISON(oldest->ptr, oldest->size);
+            RAII_FREE((void *)oldest->ptr);
+        }
+
+        RAII_FREE(oldest);
+    }
+
+    return true;
+}
+
+static size_t memcheck_page(void) {
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (size_t)info.dwPageSize;
+#else
+    return (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+void *raii_memcheck_chunk(size_t size) {
+    size_t page = memcheck_page(), length = align_up(size, page) + page;
+    char *base, *fence;
+#if defined(_WIN32)
+    DWORD old;
+    if (is_empty(base = VirtualAlloc(NULL, length, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE)))
+        return NULL;
+
+    fence = base + length - page;
+    VirtualProtect(fence, page, PAGE_NOACCESS, &old);
+#else
+    if ((base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED)
+        return NULL;
+
+    fence = base + length - page;
+    mprotect(fence, page, PROT_NONE);
+#endif
+    /* end flush against guard page, so running past it faults */
+    return fence - align_up(size, 16);
+}
+
+void raii_memcheck_chunk_free(void *chunk, void *limit) {
+    size_t page = memcheck_page();
+    memcheck_chunk_t *slot, old;
+    char *base = (char *)((uintptr_t)chunk & ~(uintptr_t)(page - 1));
+    size_t length = align_up((uintptr_t)limit, page) + page - (uintptr_t)base;
+#if defined(_WIN32)
+    DWORD protect;
+    VirtualProtect(base, length, PAGE_NOACCESS, &protect);
+#else
+    mprotect(base, length, PROT_NONE);
+#endif
+    memcheck_locked(true);
+    slot = &memcheck_chunks[memcheck_chunk_next++ % RAII_MEMCHECK_CHUNKS];
+    old = *slot;
+    slot->base = base;
+    slot->length = length;
+    memcheck_locked(false);
+
+    if (!is_empty(old.base)) {
+#if defined(_WIN32)
+        VirtualFree(old.base, 0, MEM_RELEASE);
+#else
+        munmap(old.base, old.length);
+#endif
+    }
+}
+#endif
+
+size_t raii_memcheck_report(FILE *out) {
+    size_t count = 0;
+#ifdef RAII_MEMCHECK
+    memcheck_t *entry;
+    size_t i;
+
+    memcheck_locked(true);
+    for (i = 0; i < MEMCHECK_BUCKETS; i++) {
+        for (entry = memcheck_buckets[i]; !is_empty(entry); entry = entry->next) {
+            if (entry->is_freed)
+                continue;
+
+            fprintf(out, "\nMemcheck: %p, %zu bytes still live, allocated at:\n", entry->ptr, entry->size);
+            memcheck_print(out, entry);
+            count++;
+        }
+    }
+    memcheck_locked(false);
+#endif
+    return count;
+}
+
+size_t raii_memcheck_leaks(void) {
+#ifdef RAII_MEMCHECK
+    size_t count;
+    memcheck_locked(true);
+    if (memcheck_reported) {
+        memcheck_locked(false);
+        return 0;
+    }
+
+    memcheck_reported = true;
+    memcheck_locked(false);
+    if ((count = raii_memcheck_report(stderr)) > 0)
+        fprintf(stderr, "\nMemcheck: %zu blocks leaked\n", count);
+
+    return count;
+#else
+    return 0;
+#endif
+}
+
+size_t raii_memcheck_live(void) {
+#ifdef RAII_MEMCHECK
+    size_t count;
+    memcheck_locked(true);
+    count = memcheck_live_count;
+    memcheck_locked(false);
+    return count;
+#else
+    return 0;
+#endif
+}
+
+size_t raii_memcheck_double_frees(void) {
+#ifdef RAII_MEMCHECK
+    size_t count;
+    memcheck_locked(true);
+    count = memcheck_double_count;
+    memcheck_locked(false);
+    return count;
+#else
+    return 0;
+#endif
+}
@@ -0,0 +1,59 @@
+#include "raii.h"
+#if defined(__linux__)
+    #include <unistd.h>
+    #include <linux/futex.h>
+    #include <sys/syscall.h>
+#endif
+
+/* Sleep while `*state` is still `2`, may return spuriously. */
+static void raii_mutex_park(volatile int *state) {
+#if defined(__linux__)
+    syscall(SYS_futex, (int *)state, FUTEX_WAIT_PRIVATE, 2, NULL, NULL, 0);
+#elif defined(_WIN32)
+    int parked = 2;
+    WaitOnAddress((volatile VOID *)state, &parked, sizeof(int), INFINITE);
+#else
+    /* no address wait here, give way to holder */
+    thrd_yield();
+#endif
+}
+
+static void raii_mutex_unpark(volatile int *state) {
+#if defined(__linux__)
+    syscall(SYS_futex, (int *)state, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#elif defined(_WIN32)
+    WakeByAddressSingle((PVOID)state);
+#endif
+}
+
+RAII_INLINE void raii_mutex_init(raii_mutex_t *mutex) {
+    atomic_int_store(&mutex->state, 0);
+}
+
+void raii_mutex_lock(raii_mutex_t *mutex) {
+    int state = 0, spin;
+
+    if (LIKELY(atomic_int_cas(&mutex->state, &state, 1)))
+        return;
+
+    /* holder likely leaves soon, unless others already parked */
+    for (spin = 0; spin < RAII_MUTEX_SPIN && state != 2; spin++) {
+        atomic_pause();
+        if ((state = atomic_int_load(&mutex->state)) == 0 && atomic_int_cas(&mutex->state, &state, 1))
+            return;
+    }
+
+    /* marked `2`, so unlock wakes, taken once it was `0` */
+    while (atomic_int_swap(&mutex->state, 2) != 0)
+        raii_mutex_park(&mutex->state);
+}
+
+RAII_INLINE bool raii_mutex_trylock(raii_mutex_t *mutex) {
+    int state = 0;
+    return atomic_int_cas(&mutex->state, &state, 1);
+}
+
+void raii_mutex_unlock(raii_mutex_t *mutex) {
+    if (atomic_int_swap(&mutex->state, 0) == 2)
+        raii_mutex_unpark(&mutex->state);
+}
@@ -0,0 +1,114 @@
+#include "raii.h"
+
+/* Chunk header, objects follow it, padded to keep them `16` byte aligned. */
+typedef union pool_chunk_s {
+    union pool_chunk_s *next;
+    char pad[16];
+} pool_chunk_t;
+
+struct object_pool_s {
+    raii_type type;
+    /* object size, rounded up to fit free list link, see `pool_round` */
+    size_t size;
+    size_t per_chunk;
+    size_t capacity;
+    pool_chunk_t *chunks;
+    /* carved lazily from newest chunk, before it's free list forms */
+    char *avail;
+    char *limit;
+    /* owner `thread` only, objects it returned */
+    void *free;
+    /* objects returned by other `thread`s */
+    void *volatile remote;
+    raii_inbox_t *owner;
+};
+
+static void pool_grow(object_pool_t *pool) {
+    pool_chunk_t *chunk = try_malloc(sizeof(pool_chunk_t) + pool->size * pool->per_chunk);
+    chunk->next = pool->chunks;
+    pool->chunks = chunk;
+    pool->avail = (char *)(chunk + 1);
+    pool->limit = pool->avail + pool->size * pool->per_chunk;
+    pool->capacity += pool->per_chunk;
+}
+
+/* Objects of `16` bytes or more round to `16`, smaller ones can need no more than
+pointer alignment, so every object stays aligned as `malloc` would for it's size. */
+static RAII_INLINE size_t pool_round(size_t size) {
+    size_t align = size >= 16 ? 16 : sizeof(void *);
+    return (MAX(size, sizeof(void *)) + align - 1) & ~(align - 1);
+}
+
+object_pool_t *pool_create(memory_t *scope, size_t size, size_t per_chunk) {
+    object_pool_t *pool;
+
+    if (UNLIKELY(size == 0))
+        raii_panic("Failed! `pool_create` invalid object size");
+
+    pool = try_calloc(1, sizeof(object_pool_t));
+    pool->type = RAII_OBJ;
+    pool->size = pool_round(size);
+    pool->per_chunk = per_chunk == 0 ? 64 : per_chunk;
+    pool->owner = raii_inbox();
+    if (!is_empty(scope))
+        raii_deferred(scope, (func_t)pool_free, pool);
+
+    return pool;
+}
+
+void pool_free(object_pool_t *pool) {
+    pool_chunk_t *chunk, *next;
+    if (is_empty(pool) || !is_type(pool, RAII_OBJ))
+        return;
+
+    for (chunk = pool->chunks; !is_empty(chunk); chunk = next) {
+        next = chunk->next;
+        RAII_FREE(chunk);
+    }
+
+    pool->type = RAII_NULL;
+    RAII_FREE(pool);
+}
+
+void *pool_get(object_pool_t *pool) {
+    void *ptr;
+
+    if (UNLIKELY(is_empty(pool) || !is_type(pool, RAII_OBJ) || pool->owner != raii_inbox()))
+        raii_panic("Failed! `pool_get` invalid pool, or not owner `thread`");
+
+    if (is_empty(pool->free) && !is_empty(atomic_ptr_load(&pool->remote)))
+        pool->free = atomic_ptr_swap(&pool->remote, NULL);
+
+    if (!is_empty(ptr = pool->free)) {
+        pool->free = *(void **)ptr;
+        return ptr;
+    }
+
+    if (pool->avail == pool->limit)
+        pool_grow(pool);
+
+    ptr = pool->avail;
+    pool->avail += pool->size;
+    return ptr;
+}
+
+void pool_put(object_pool_t *pool, void *ptr) {
+    void *head;
+    if (is_empty(ptr))
+        return;
+
+    if (pool->owner == raii_inbox()) {
+        *(void **)ptr = pool->free;
+        pool->free = ptr;
+        return;
+    }
+
+    head = atomic_ptr_load(&pool->remote);
+    do {
+        *(void **)ptr = head;
+    } while (!atomic_ptr_cas(&pool->remote, &head, ptr));
+}
+
+RAII_INLINE size_t pool_capacity(object_pool_t *pool) {
+    return pool->capacity;
+}
@@ -0,0 +1,205 @@
+#include "raii.h"
+#if !defined(_WIN32)
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+/* Written by creator once header set, attachers wait for it. */
+#define PROCESS_READY 0x52414949u
+
+/* Start of shared region, blocks follow, so offset `0` is never a block. */
+typedef union {
+    struct {
+        volatile size_t ready;
+        size_t length;
+        volatile size_t used;
+        volatile size_t root;
+    } head;
+    char pad[64];
+} process_header_t;
+
+/* This process view of region. */
+struct raii_process_s {
+    raii_type type;
+    bool is_owner;
+    process_header_t *base;
+    size_t length;
+#if !defined(_WIN32)
+    /* `fork` children inherit handle, only creating process removes `name` */
+    pid_t pid;
+#endif
+    /* empty for anonymous region */
+    char name[];
+};
+
+static raii_process_t *process_attach(process_header_t *base, size_t length, const char *name, bool is_owner) {
+    size_t size = is_empty((void *)name) ? 0 : strlen(name);
+    raii_process_t *arena = try_calloc(1, sizeof(raii_process_t) + size + 1);
+    arena->base = base;
+    arena->is_owner = is_owner;
+    if (size > 0)
+        memcpy(arena->name, name, size);
+
+#if !defined(_WIN32)
+    arena->pid = getpid();
+#endif
+    if (is_owner) {
+        /* fresh shared pages are zero, `used` counts header */
+        base->head.length = length;
+        base->head.used = sizeof(process_header_t);
+        atomic_size_store(&base->head.ready, PROCESS_READY);
+    } else {
+        while (atomic_size_load(&base->head.ready) != PROCESS_READY)
+            thrd_yield();
+    }
+
+    arena->length = base->head.length;
+    arena->type = RAII_PROCESS;
+    return arena;
+}
+
+raii_process_t *process_arena(memory_t *scope, const char *name, size_t size) {
+    raii_process_t *arena;
+    process_header_t *base;
+    bool is_owner = true;
+#if defined(_WIN32)
+    HANDLE mapping;
+    ULONGLONG length = (ULONGLONG)size + sizeof(process_header_t);
+
+    mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                                 (DWORD)(length >> 32), (DWORD)length, name);
+    if (is_empty(mapping)) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    is_owner = GetLastError() != ERROR_ALREADY_EXISTS;
+    base = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0);
+    /* view keeps mapping, and it's `name`, alive once handle closed */
+    CloseHandle(mapping);
+    if (is_empty(base)) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    arena = process_attach(base, (size_t)length, name, is_owner);
+#else
+    struct stat info;
+    size_t length = size + sizeof(process_header_t);
+    int fd = -1;
+
+    if (is_empty((void *)name)) {
+        base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    } else {
+        fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd < 0 && errno == EEXIST) {
+            is_owner = false;
+            fd = shm_open(name, O_RDWR, 0600);
+        }
+
+        if (fd < 0)
+            return NULL;
+
+        if (is_owner && ftruncate(fd, (off_t)length) != 0) {
+            close(fd);
+            shm_unlink(name);
+            return NULL;
+        }
+
+        /* creator may not have sized it yet */
+        while (!is_owner) {
+            if (fstat(fd, &info) != 0) {
+                close(fd);
+                return NULL;
+            }
+
+            if (info.st_size > 0) {
+                length = (size_t)info.st_size;
+                break;
+            }
+
+            thrd_yield();
+        }
+
+        base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        /* mapping holds it's own reference */
+        close(fd);
+    }
+
+    if (base == MAP_FAILED) {
+        if (is_owner && !is_empty((void *)name))
+            shm_unlink(name);
+        return NULL;
+    }
+
+    arena = process_attach(base, length, name, is_owner);
+#endif
+    if (!is_empty(scope))
+        raii_deferred(scope, (func_t)process_arena_free, arena);
+
+    return arena;
+}
+
+void process_arena_free(raii_process_t *arena) {
+    if (is_empty(arena) || !is_type(arena, RAII_PROCESS))
+        return;
+
+    arena->type = RAII_NULL;
+#if defined(_WIN32)
+    UnmapViewOfFile(arena->base);
+#else
+    munmap(arena->base, arena->length);
+    if (arena->is_owner && arena->name[0] != '\0' && arena->pid == getpid())
+        shm_unlink(arena->name);
+#endif
+    RAII_FREE(arena);
+}
+
+void *process_alloc(raii_process_t *arena, size_t size) {
+    process_header_t *base = arena->base;
+    size_t used, offset;
+
+    RAII_ASSERT(is_type(arena, RAII_PROCESS));
+    size = MAX(size, 1);
+    used = atomic_size_load(&base->head.used);
+    do {
+        offset = align_up(used, 16);
+        if (size > arena->length || offset > arena->length - size) {
+            errno = ENOMEM;
+            return NULL;
+        }
+    } while (!atomic_size_cas(&base->head.used, &used, offset + size));
+
+    return (char *)base + offset;
+}
+
+size_t process_offset(raii_process_t *arena, const void *ptr) {
+    if (is_empty((void *)ptr))
+        return 0;
+
+    RAII_ASSERT((const char *)ptr > (const char *)arena->base
+                && (const char *)ptr < (const char *)arena->base + arena->length);
+    return (size_t)((const char *)ptr - (const char *)arena->base);
+}
+
+void *process_ptr(raii_process_t *arena, size_t offset) {
+    if (is_zero(offset))
+        return NULL;
+
+    RAII_ASSERT(offset < arena->length);
+    return (char *)arena->base + offset;
+}
+
+void process_publish(raii_process_t *arena, const void *root) {
+    atomic_size_store(&arena->base->head.root, process_offset(arena, root));
+}
+
+void *process_root(raii_process_t *arena) {
+    return process_ptr(arena, atomic_size_load(&arena->base->head.root));
+}
+
+size_t process_used(raii_process_t *arena) {
+    return atomic_size_load(&arena->base->head.used);
+}
@@ -1,6 +1,191 @@
 #include "raii.h"
 
+#ifdef emulate_tls
+/* `thread` scope storage, and current scope `raii_local_swap` replaces,
+pointer slots of `raii_tls` block, as `thrd_local` buffer and pointer. */
+static raii_tls_t raii_storage_key;
+static raii_tls_t raii_scope_key;
+static once_flag raii_scope_once = ONCE_FLAG_INIT;
+
+static void raii_scope_setup(void) {
+    if (raii_tls_create(&raii_storage_key, 0, C11_FREE) != thrd_success
+        || raii_tls_create(&raii_scope_key, 0, NULL) != thrd_success)
+        raii_panic("Raii `raii_tls_create` failed!");
+}
+
+/* `NULL` when it's storage can't be allocated. */
+static memory_t *raii(void) {
+    memory_t *scope;
+    call_once(&raii_scope_once, raii_scope_setup);
+    if (!is_empty(scope = (memory_t *)raii_tls_get(raii_scope_key)))
+        return scope;
+
+    if (is_empty(scope = (memory_t *)raii_tls_get(raii_storage_key))) {
+        if (is_empty(scope = (memory_t *)C11_CALLOC(1, sizeof(memory_t))))
+            return NULL;
+
+        if (raii_tls_set(raii_storage_key, (void *)scope) != thrd_success) {
+            C11_FREE(scope);
+            return NULL;
+        }
+    }
+
+    raii_tls_set(raii_scope_key, (void *)scope);
+    return scope;
+}
+#define raii_storage() ((memory_t *)raii_tls_get(raii_storage_key))
+#else
 thrd_local(memory_t, raii)
+#define raii_storage() (&thrd_raii_buffer)
+#endif
+
+static raii_tls_t raii_inbox_key;
+static once_flag raii_inbox_once = ONCE_FLAG_INIT;
+/* spin lock of `raii_inbox_free` */
+static volatile size_t raii_inbox_lock = 0;
+/* inboxes of exited `thread`s, owner pointers of scopes may outlive them */
+static raii_inbox_t *raii_inbox_free = NULL;
+
+#ifdef RAII_THREAD_STATE
+thread_local raii_thread_t raii_thread RAII_TLS_MODEL = {NULL};
+#define raii_inbox_tls raii_thread.inbox
+#elif !defined(emulate_tls)
+static thread_local raii_inbox_t *raii_inbox_tls = NULL;
+#endif
+
+static void raii_inbox_locked(bool lock) {
+    size_t none = 0;
+    if (!lock) {
+        atomic_size_store(&raii_inbox_lock, 0);
+        return;
+    }
+
+    while (!atomic_size_cas(&raii_inbox_lock, &none, 1)) {
+        none = 0;
+        thrd_yield();
+    }
+}
+
+static size_t raii_inbox_flush(raii_inbox_t *inbox) {
+    size_t count = 0;
+    void *ptr, *next;
+
+    if (is_empty(atomic_ptr_load(&inbox->head)))
+        return 0;
+
+    for (ptr = atomic_ptr_swap(&inbox->head, NULL); !is_empty(ptr); ptr = next, count++) {
+        next = *(void **)ptr;
+        RAII_FREE(ptr);
+    }
+
+    atomic_size_sub(&inbox->count, count);
+    return count;
+}
+
+/* `thread` exit, anything still queued is freed, inbox kept for next new `thread`. */
+static void raii_inbox_delete(void *data) {
+    raii_inbox_t *inbox = (raii_inbox_t *)data;
+
+    atomic_int_store(&inbox->closed, 1);
+    raii_inbox_flush(inbox);
+#ifndef emulate_tls
+    raii_inbox_tls = NULL;
+#endif
+    raii_inbox_locked(true);
+    inbox->next = raii_inbox_free;
+    raii_inbox_free = inbox;
+    raii_inbox_locked(false);
+}
+
+static void raii_inbox_setup(void) {
+    if (raii_tls_create(&raii_inbox_key, 0, raii_inbox_delete) != thrd_success)
+        raii_panic("Raii `raii_tls_create` failed!");
+}
+
+static raii_inbox_t *raii_inbox_new(void) {
+    raii_inbox_t *inbox;
+
+    raii_inbox_locked(true);
+    if (!is_empty(inbox = raii_inbox_free))
+        raii_inbox_free = inbox->next;
+    raii_inbox_locked(false);
+
+    if (is_empty(inbox)) {
+        /* comes zeroed, open, at first `generation` */
+        inbox = try_calloc(1, sizeof(raii_inbox_t));
+    } else {
+        /* senders holding previous `generation` now free their blocks themselves */
+        atomic_size_add(&inbox->generation, 1);
+        atomic_int_store(&inbox->closed, 0);
+        inbox->next = NULL;
+    }
+    if (raii_tls_set(raii_inbox_key, (void *)inbox) != thrd_success)
+        raii_panic("Raii `raii_tls_set` failed!");
+
+    return inbox;
+}
+
+raii_inbox_t *raii_inbox(void) {
+#ifdef emulate_tls
+    raii_inbox_t *inbox;
+    call_once(&raii_inbox_once, raii_inbox_setup);
+    if (!is_empty(inbox = (raii_inbox_t *)raii_tls_get(raii_inbox_key)))
+        return inbox;
+
+    return raii_inbox_new();
+#else
+    if (LIKELY(!is_empty(raii_inbox_tls)))
+        return raii_inbox_tls;
+
+    call_once(&raii_inbox_once, raii_inbox_setup);
+    return raii_inbox_tls = raii_inbox_new();
+#endif
+}
+
+static RAII_INLINE bool raii_inbox_gone(raii_inbox_t *owner, size_t generation) {
+    return atomic_int_load(&owner->closed) || atomic_size_load(&owner->generation) != generation;
+}
+
+static void raii_inbox_push(raii_inbox_t *owner, size_t generation, void *ptr) {
+    void *head;
+
+    if (owner == raii_inbox() || raii_inbox_gone(owner, generation)
+        || atomic_size_load(&owner->count) >= RAII_INBOX_MAX) {
+        RAII_FREE(ptr);
+        return;
+    }
+
+    atomic_size_add(&owner->count, 1);
+    head = atomic_ptr_load(&owner->head);
+    do {
+        *(void **)ptr = head;
+    } while (!atomic_ptr_cas(&owner->head, &head, ptr));
+
+    /* owner exited meanwhile, it's last drain may have missed this block */
+    if (raii_inbox_gone(owner, generation))
+        raii_inbox_flush(owner);
+}
+
+void raii_free_to(raii_inbox_t *owner, void *ptr) {
+    if (is_empty(ptr))
+        return;
+
+    if (is_empty(owner)) {
+        RAII_FREE(ptr);
+        return;
+    }
+
+    raii_inbox_push(owner, atomic_size_load(&owner->generation), ptr);
+}
+
+RAII_INLINE size_t raii_inbox_drain(void) {
+    return raii_inbox_flush(raii_inbox());
+}
+
+static RAII_INLINE void raii_owner_set(memory_t *scope) {
+    scope->owner = raii_inbox();
+    scope->owner_generation = scope->owner->generation;
+}
 
 int raii_array_init(raii_array_t *a) {
     if (UNLIKELY(!a))
@@ -8,6 +193,7 @@ int raii_array_init(raii_array_t *a) {
 
     a->base = NULL;
     a->elements = 0;
+    a->capacity = 0;
     a->type = RAII_DEF_ARR;
 
     return 0;
@@ -17,7 +203,9 @@ int raii_array_reset(raii_array_t *a) {
     if (UNLIKELY(!a))
         return -EINVAL;
 
-    RAII_FREE(a->base);
+    if (is_empty(a->arena))
+        RAII_FREE(a->base);
+
     a->base = NULL;
     a->elements = 0;
     memset(a, 0, sizeof(raii_array_t));
@@ -25,7 +213,6 @@ int raii_array_reset(raii_array_t *a) {
     return 0;
 }
 
-#if !defined(HAS_REALLOC_ARRAY)
 #if !defined(HAVE_BUILTIN_MUL_OVERFLOW)
 /*
 * This is sqrt(SIZE_MAX+1), as s1*s2 <= SIZE_MAX
@@ -41,6 +228,8 @@ static inline bool umull_overflow(size_t a, size_t b, size_t *out) {
 #else
 #define umull_overflow __builtin_mul_overflow
 #endif
+
+#if !defined(HAS_REALLOC_ARRAY)
 void *realloc_array(void *optr, size_t nmemb, size_t size) {
     size_t total_size;
     if (UNLIKELY(umull_overflow(nmemb, size, &total_size))) {
@@ -57,35 +246,57 @@ static inline bool add_overflow(size_t a, size_t b, size_t *out) {
     if (UNLIKELY(a > 0 && b > SIZE_MAX - a))
         return true;
 
-    *out = a + INCREMENT;
+    *out = a + b;
     return false;
 }
 #else
 #define add_overflow __builtin_add_overflow
 #endif
 
-void *raii_array_append(raii_array_t *a, size_t element_size) {
-    if (!(a->elements % INCREMENT)) {
-        void *new_base;
-        size_t new_cap;
+/* Grow capacity geometrically, starting at `INCREMENT` elements, to at least `count`. */
+static int raii_array_grow_to(raii_array_t *a, size_t element_size, size_t count) {
+    void *new_base;
+    size_t new_cap, bytes;
 
-        if (UNLIKELY(add_overflow(a->elements, INCREMENT, &new_cap))) {
-            errno = EOVERFLOW;
-            return NULL;
-        }
+    if (UNLIKELY(add_overflow(a->capacity, MAX(a->capacity, INCREMENT), &new_cap))) {
+        errno = EOVERFLOW;
+        return -1;
+    }
 
+    new_cap = MAX(new_cap, count);
+    if (is_empty(a->arena)) {
         new_base = realloc_array(a->base, new_cap, element_size);
-        if (UNLIKELY(!new_base))
-            return NULL;
-
-        a->base = new_base;
+    } else if (UNLIKELY(umull_overflow(new_cap, element_size, &bytes) || bytes > LONG_MAX)) {
+        errno = ENOMEM;
+        new_base = NULL;
+    } else if (!is_empty(new_base = arena_alloc_aligned((arena_t)a->arena, (long)bytes, 16))
+               && a->elements > 0) {
+        /* arena keeps old block, until arena itself released */
+        memcpy(new_base, a->base, a->elements * element_size);
     }
 
+    if (UNLIKELY(!new_base))
+        return -1;
+
+    a->base = new_base;
+    a->capacity = new_cap;
+    return 0;
+}
+
+static RAII_INLINE int raii_array_grow(raii_array_t *a, size_t element_size) {
+    return raii_array_grow_to(a, element_size, a->capacity + 1);
+}
+
+void *raii_array_append(raii_array_t *a, size_t element_size) {
+    if (a->elements == a->capacity && UNLIKELY(raii_array_grow(a, element_size) < 0))
+        return NULL;
+
     return ((unsigned char *)a->base) + a->elements++ * element_size;
 }
 
 RAII_INLINE int raii_deferred_init(defer_t *array) {
-    return raii_array_init((raii_array_t *)array);
+    array->type = RAII_DEF_ARR;
+    return raii_array_init(&array->base);
 }
 
 void raii_unwind_set(ex_context_t *ctx, const char *ex, const char *message) {
@@ -96,17 +307,124 @@ void raii_unwind_set(ex_context_t *ctx, const char *ex, const char *message) {
     ex_unwind_set(ctx, scope->is_protected);
 }
 
+/* Allocation failures unwind as `bad_alloc`, nothing on throw path allocates. */
+static void raii_out_of_memory(const char *function, const char *message) {
+    C_API const char EX_NAME(bad_alloc)[];
+    errno = ENOMEM;
+    ex_throw(EX_NAME(bad_alloc), __FILE__, __LINE__, function, message);
+}
+
+/* Charge `size` to `scope` budget, if any, throws `out_of_memory` when over it. */
+static RAII_INLINE void raii_budget_charge(memory_t *scope, size_t size) {
+    C_API const char EX_NAME(out_of_memory)[];
+    raii_budget_t *budget = scope->budget;
+    if (LIKELY(is_empty(budget)))
+        return;
+
+    if (UNLIKELY(!is_zero(budget->limit) && atomic_size_add(&budget->used, size) + size > budget->limit)) {
+        atomic_size_sub(&budget->used, size);
+        errno = ENOMEM;
+        ex_throw(EX_NAME(out_of_memory), __FILE__, __LINE__, __FUNCTION__, "Scope budget exceeded!");
+    }
+
+    scope->charged += size;
+}
+
+/* Give back all `scope` charged, it's memory released. */
+static RAII_INLINE void raii_budget_release(memory_t *scope) {
+    if (!is_zero(scope->charged)) {
+        if (!is_empty(scope->budget))
+            atomic_size_sub(&scope->budget->used, scope->charged);
+
+        scope->charged = 0;
+    }
+}
+
+void raii_budget(memory_t *scope, size_t bytes) {
+    if (scope->budget == &scope->limits && !is_zero(bytes)) {
+        scope->limits.limit = bytes;
+        return;
+    }
+
+    raii_budget_release(scope);
+    scope->limits.limit = bytes;
+    scope->limits.used = 0;
+    scope->budget = is_zero(bytes) ? NULL : &scope->limits;
+}
+
+RAII_INLINE size_t raii_budget_used(memory_t *scope) {
+    return is_empty(scope->budget) ? 0 : atomic_size_load(&scope->budget->used);
+}
+
+void raii_budget_inherit(memory_t *scope, memory_t *parent) {
+    if (is_empty(parent))
+        parent = raii_local();
+
+    if (is_empty(scope->budget) && !is_empty(parent) && parent != scope)
+        scope->budget = parent->budget;
+}
+
+#ifndef RPMALLOC_FIRST_CLASS_HEAPS
+#define RPMALLOC_FIRST_CLASS_HEAPS 0
+#endif
+
+#if RPMALLOC_FIRST_CLASS_HEAPS
+/* rpmalloc first class heap API, as built into cthread's rpmalloc with `RAII_HEAPS`,
+not in shipped `rpmalloc.h`. Single threaded per heap, none are thread safe. */
+typedef struct heap_t rpmalloc_heap_t;
+RPMALLOC_EXPORT rpmalloc_heap_t *rpmalloc_heap_acquire(void);
+RPMALLOC_EXPORT void rpmalloc_heap_release(rpmalloc_heap_t *heap);
+RPMALLOC_EXPORT void *rpmalloc_heap_alloc(rpmalloc_heap_t *heap, size_t size);
+RPMALLOC_EXPORT void *rpmalloc_heap_calloc(rpmalloc_heap_t *heap, size_t num, size_t size);
+RPMALLOC_EXPORT void rpmalloc_heap_free_all(rpmalloc_heap_t *heap);
+
+static RAII_INLINE void *raii_heap_check(void *ptr) {
+    if (UNLIKELY(is_empty(ptr)))
+        raii_out_of_memory(__FUNCTION__, "Heap allocation failed!");
+
+    return ptr;
+}
+#endif
+
 RAII_INLINE memory_t *raii_local(void) {
+#ifdef RAII_THREAD_STATE
+    return raii_thread.scope;
+#else
+#ifdef emulate_tls
+    call_once(&raii_scope_once, raii_scope_setup);
+    return (memory_t *)raii_tls_get(raii_scope_key);
+#else
     thrd_local_return(memory_t, raii)
+#endif
+#endif
+}
+
+memory_t *raii_local_swap(memory_t *scope) {
+    memory_t *prev = raii_local();
+#ifdef emulate_tls
+    if (raii_tls_set(raii_scope_key, (void *)scope) != thrd_success)
+        raii_panic("Raii `raii_tls_set` failed!");
+#else
+    thrd_raii_tls = scope;
+#endif
+#ifdef RAII_THREAD_STATE
+    raii_thread.scope = scope;
+#endif
+    return prev;
 }
 
 memory_t *raii_init(void) {
     memory_t *scope;
     if (is_empty(scope = raii_local())) {
-        scope = raii();
+        if (UNLIKELY(is_empty(scope = raii())))
+            raii_out_of_memory(__FUNCTION__, "Thread scope storage failed!");
+
         if (UNLIKELY(raii_deferred_init(&scope->defer) < 0))
             raii_panic("Deferred initialization failed!");
 
+#ifdef RAII_THREAD_STATE
+        raii_thread.scope = scope;
+#endif
         scope->arena = NULL;
         scope->protector = NULL;
         scope->panic = NULL;
@@ -114,13 +432,13 @@ memory_t *raii_init(void) {
         scope->is_protected = false;
         scope->is_recovered = false;
         scope->mid = -1;
+        raii_owner_set(scope);
 
         ex_context_t *ctx = ex_init();
         ctx->data = (void *)scope;
         ctx->prev = (void *)scope;
         ctx->is_raii = true;
-        if (!exception_signal_set)
-            ex_signal_setup();
+        EX_SIGNAL_SETUP();
     }
 
     return scope;
@@ -136,36 +454,124 @@ RAII_INLINE size_t raii_last_mid(memory_t *scope) {
 
 void *try_calloc(int count, size_t size) {
     void *ptr = RAII_CALLOC(count, size);
-    if (ptr == NULL) {
-        errno = ENOMEM;
-        raii_panic("Calloc failed!");
-    }
+    if (ptr == NULL)
+        raii_out_of_memory(__FUNCTION__, "Calloc failed!");
 
     return ptr;
 }
 
 void *try_malloc(size_t size) {
     void *ptr = RAII_MALLOC(size);
-    if (ptr == NULL) {
-        errno = ENOMEM;
-        raii_panic("Malloc failed!");
-    }
+    if (ptr == NULL)
+        raii_out_of_memory(__FUNCTION__, "Malloc failed!");
 
     return ptr;
 }
 
 void *try_realloc(void *old_ptr, size_t size) {
     void *ptr = RAII_REALLOC(old_ptr, size);
-    if (ptr == NULL) {
-        errno = ENOMEM;
-        raii_panic("Realloc failed!");
-    }
+    if (ptr == NULL)
+        raii_out_of_memory(__FUNCTION__, "Realloc failed!");
 
     return ptr;
 }
 
+/* Released heap scopes, per `thread`, handed back out by `unique_init`,
+keeping their inline `defer` slots, so steady `guard` use allocates nothing. */
+typedef struct raii_scopes_s {
+    size_t count;
+    memory_t *slot[RAII_SCOPE_CACHE];
+} raii_scopes_t;
+
+static raii_tls_t raii_scopes_key;
+static once_flag raii_scopes_once = ONCE_FLAG_INIT;
+
+#ifdef RAII_THREAD_STATE
+#define raii_scopes_tls raii_thread.scopes
+#elif !defined(emulate_tls)
+static thread_local raii_scopes_t *raii_scopes_tls = NULL;
+#endif
+
+/* `thread` exit, cached scopes freed. */
+static void raii_scopes_delete(void *data) {
+    raii_scopes_t *cache = (raii_scopes_t *)data;
+    while (cache->count > 0) {
+        memory_t *ptr = cache->slot[--cache->count];
+        RAII_UNPOISON(ptr, sizeof(memory_t));
+        RAII_FREE(ptr);
+    }
+
+#ifndef emulate_tls
+    raii_scopes_tls = NULL;
+#endif
+    RAII_FREE(cache);
+}
+
+static void raii_scopes_setup(void) {
+    if (raii_tls_create(&raii_scopes_key, 0, raii_scopes_delete) != thrd_success)
+        raii_panic("Raii `raii_tls_create` failed!");
+}
+
+static raii_scopes_t *raii_scopes_new(void) {
+    raii_scopes_t *cache = try_calloc(1, sizeof(raii_scopes_t));
+    if (raii_tls_set(raii_scopes_key, (void *)cache) != thrd_success)
+        raii_panic("Raii `raii_tls_set` failed!");
+
+    return cache;
+}
+
+static RAII_INLINE raii_scopes_t *raii_scopes(void) {
+#ifdef emulate_tls
+    raii_scopes_t *cache;
+    call_once(&raii_scopes_once, raii_scopes_setup);
+    if (!is_empty(cache = (raii_scopes_t *)raii_tls_get(raii_scopes_key)))
+        return cache;
+
+    return raii_scopes_new();
+#else
+    if (LIKELY(!is_empty(raii_scopes_tls)))
+        return raii_scopes_tls;
+
+    call_once(&raii_scopes_once, raii_scopes_setup);
+    return raii_scopes_tls = raii_scopes_new();
+#endif
+}
+
+/* Cleared scope from cache, `defer` serial carried over, so handles of it's prior use stay stale. */
+static RAII_INLINE unique_t *raii_scopes_get(void) {
+    raii_scopes_t *cache = raii_scopes();
+    unique_t *raii;
+    unsigned int serial;
+
+    if (is_zero(cache->count))
+        return try_calloc(1, sizeof(unique_t));
+
+    raii = cache->slot[--cache->count];
+    RAII_UNPOISON(raii, sizeof(unique_t));
+    serial = raii->defer.serial;
+    memset(raii, 0, sizeof(unique_t));
+    raii->defer.serial = serial;
+    return raii;
+}
+
+/* Scope memory back to cache, freed if full. */
+static RAII_INLINE void raii_scopes_put(memory_t *ptr) {
+    raii_scopes_t *cache = raii_scopes();
+    unsigned int serial = ptr->defer.serial;
+
+    memset(ptr, -1, sizeof(memory_t));
+    if (cache->count == RAII_SCOPE_CACHE) {
+        RAII_FREE(ptr);
+        return;
+    }
+
+    ptr->defer.serial = serial;
+    RAII_POISON(ptr, sizeof(memory_t));
+    cache->slot[cache->count++] = ptr;
+}
+
 unique_t *unique_init(void) {
-    unique_t *raii = try_calloc(1, sizeof(unique_t));
+    unique_t *raii = raii_scopes_get();
     if (UNLIKELY(raii_deferred_init(&raii->defer) < 0))
         raii_panic("Deferred initialization failed!");
 
@@ -173,6 +579,23 @@ unique_t *unique_init(void) {
     raii->protector = NULL;
     raii->is_protected = false;
     raii->mid = -1;
+    raii_owner_set(raii);
+    RAII_TRACED(raii_trace_event(RAII_TRACE_SCOPE_BEGIN, raii, 0, 0));
+    RAII_RECORDED(raii_record_event(RAII_RECORD_SCOPE_CREATE, raii, 0));
+    return raii;
+}
+
+unique_t *unique_local(unique_frame_t *frame) {
+    unique_t *raii = &frame->scope;
+    memset(raii, 0, sizeof(unique_t));
+    if (UNLIKELY(raii_deferred_init(&raii->defer) < 0))
+        raii_panic("Deferred initialization failed!");
+
+    raii->is_local = true;
+    raii->mid = -1;
+    raii_owner_set(raii);
+    RAII_TRACED(raii_trace_event(RAII_TRACE_SCOPE_BEGIN, raii, 0, 0));
+    RAII_RECORDED(raii_record_event(RAII_RECORD_SCOPE_CREATE, raii, 0));
     return raii;
 }
 
@@ -184,15 +607,80 @@ unique_t *unique_init_arena(void) {
     return raii;
 }
 
-void *malloc_full(memory_t *scope, size_t size, func_t func) {
-    void *arena = try_malloc(size);
+unique_t *unique_init_heap(void) {
+#if RPMALLOC_FIRST_CLASS_HEAPS
+    unique_t *raii = unique_init();
+    if (UNLIKELY(is_empty(raii->heap = (void *)rpmalloc_heap_acquire())))
+        raii_out_of_memory(__FUNCTION__, "Heap acquire failed!");
+
+    return raii;
+#else
+    return unique_init_arena();
+#endif
+}
+
+static void raii_child_release(void *data) {
+    memory_t *child = (memory_t *)data;
+    /* entry being fired, nothing to detach */
+    child->parent = NULL;
+    raii_delete(child);
+}
+
+static RAII_INLINE void raii_child_detach(memory_t *ptr) {
+    if (!is_empty(ptr->parent)) {
+        raii_deferred_disarm(ptr->parent, ptr->child);
+        ptr->parent = NULL;
+    }
+}
+
+unique_t *unique_child(memory_t *parent) {
+    unique_t *raii = unique_init();
+    raii_budget_inherit(raii, parent);
+    raii->parent = parent;
+    raii->child = raii_deferred_arm(parent, raii_child_release, raii);
+    if (UNLIKELY(raii->child == 0)) {
+        raii->parent = NULL;
+        raii_delete(raii);
+        raii_panic("Child scope registration failed!");
+    }
+
+    return raii;
+}
+
+unique_t *unique_child_arena(memory_t *parent) {
+    unique_t *raii = unique_child(parent);
+    if (parent->is_arena && !is_empty(parent->arena)) {
+        raii->arena = parent->arena;
+        raii->is_borrowed = true;
+        arena_rewind_by(raii, (arena_t)raii->arena);
+    } else {
+        raii->arena = (void *)arena_init(0);
+    }
+
+    raii->is_arena = true;
+    return raii;
+}
+
+static RAII_INLINE ex_ptr_t *raii_protector(memory_t *scope) {
     if (is_empty(scope->protector))
-        scope->protector = try_malloc(sizeof(ex_ptr_t));
+        scope->protector = scope->is_local
+            ? &((unique_frame_t *)scope)->protector
+            : try_calloc(1, sizeof(ex_ptr_t));
+
+    return scope->protector;
+}
+
+void *malloc_full(memory_t *scope, size_t size, func_t func) {
+    void *arena;
+    raii_budget_charge(scope, size);
+    arena = try_malloc(size);
+    raii_protector(scope);
 
     scope->protector->is_emulated = scope->is_emulated;
     ex_protect_ptr(scope->protector, arena, func);
     scope->is_protected = true;
     scope->mid = raii_deferred(scope, func, arena);
+    RAII_MEMCHECKED(raii_memcheck_track(arena, size));
 
     return arena;
 }
@@ -202,25 +690,36 @@ RAII_INLINE void *malloc_default(size_t size) {
 }
 
 void *malloc_by(memory_t *scope, size_t size) {
-    if (scope->is_arena)
-        return arena_alloc(scope->arena, size);
+    if (scope->is_arena) {
+        raii_budget_charge(scope, size);
+        return arena_bump(scope->arena, size);
+    }
+#if RPMALLOC_FIRST_CLASS_HEAPS
+    if (!is_empty(scope->heap)) {
+        raii_budget_charge(scope, size);
+        return raii_heap_check(rpmalloc_heap_alloc((rpmalloc_heap_t *)scope->heap, size));
+    }
+#endif
 
     return malloc_full(scope, size, RAII_FREE);
 }
 
-RAII_INLINE void *malloc_arena(memory_t *scope, size_t size) {
-    return arena_alloc(scope->arena, size);
+RAII_INLINE void *(malloc_arena)(memory_t *scope, size_t size) {
+    raii_budget_charge(scope, size);
+    return arena_bump(scope->arena, size);
 }
 
 void *calloc_full(memory_t *scope, int count, size_t size, func_t func) {
-    void *arena = try_calloc(count, size);
-    if (is_empty(scope->protector))
-        scope->protector = try_calloc(1, sizeof(ex_ptr_t));
+    void *arena;
+    raii_budget_charge(scope, count * size);
+    arena = try_calloc(count, size);
+    raii_protector(scope);
 
     scope->protector->is_emulated = scope->is_emulated;
     ex_protect_ptr(scope->protector, arena, func);
     scope->is_protected = true;
     scope->mid = raii_deferred(scope, func, arena);
+    RAII_MEMCHECKED(raii_memcheck_track(arena, count * size));
 
     return arena;
 }
@@ -230,26 +729,57 @@ RAII_INLINE void *calloc_default(int count, size_t size) {
 }
 
 void *calloc_by(memory_t *scope, int count, size_t size) {
-    if (scope->is_arena)
+    if (scope->is_arena) {
+        raii_budget_charge(scope, count * size);
         return arena_calloc(scope->arena, (long)count, (long)size);
+    }
+#if RPMALLOC_FIRST_CLASS_HEAPS
+    if (!is_empty(scope->heap)) {
+        raii_budget_charge(scope, count * size);
+        return raii_heap_check(rpmalloc_heap_calloc((rpmalloc_heap_t *)scope->heap, count, size));
+    }
+#endif
 
     return calloc_full(scope, count, size, RAII_FREE);
 }
 
-RAII_INLINE void *calloc_arena(memory_t *scope, int count, size_t size) {
+RAII_INLINE void *(calloc_arena)(memory_t *scope, int count, size_t size) {
+    raii_budget_charge(scope, count * size);
     return arena_calloc(scope->arena, (long)count, (long)size);
 }
 
+/* Release scope's own `arena`, only when created by `unique_init_arena`. */
+static void raii_arena_release(memory_t *ptr) {
+    if (ptr->is_arena && !is_empty(ptr->arena)) {
+        if (!ptr->is_borrowed)
+            arena_free((arena_t)ptr->arena);
+
+        ptr->is_borrowed = false;
+        ptr->arena = NULL;
+        ptr->is_arena = false;
+    }
+
+#if RPMALLOC_FIRST_CLASS_HEAPS
+    if (!is_empty(ptr->heap)) {
+        rpmalloc_heap_free_all((rpmalloc_heap_t *)ptr->heap);
+        rpmalloc_heap_release((rpmalloc_heap_t *)ptr->heap);
+        ptr->heap = NULL;
+    }
+#endif
+}
+
 void raii_delete(memory_t *ptr) {
     if (ptr == NULL)
         return;
 
+    raii_child_detach(ptr);
     raii_deferred_free(ptr);
-    bool self = ptr != (is_scope_emulated(ptr) ? thrd_scope() : &thrd_raii_buffer);
-    if (self) {
-        memset(ptr, -1, sizeof(memory_t));
-        RAII_FREE(ptr);
-    }
+    raii_arena_release(ptr);
+    RAII_TRACED(raii_trace_event(RAII_TRACE_SCOPE_END, ptr, 0, 0));
+    RAII_RECORDED(raii_record_event(RAII_RECORD_SCOPE_RELEASE, ptr, 0));
+    bool self = !ptr->is_local && ptr != (is_scope_emulated(ptr) ? thrd_scope() : raii_storage());
+    if (self)
+        raii_scopes_put(ptr);
 
     ptr = NULL;
 }
@@ -258,16 +788,8 @@ void raii_delete_arena(memory_t *ptr) {
     if (ptr == NULL)
         return;
 
-    arena_t arena = NULL;
-    if (!is_empty(ptr->arena))
-        arena = (arena_t)ptr->arena;
-
+    ptr->is_arena = !is_empty(ptr->arena);
     raii_delete(ptr);
-    if (!is_empty(arena))
-        arena_free(arena);
-
-    ptr = NULL;
-    arena = NULL;
 }
 
 RAII_INLINE void raii_destroy(void) {
@@ -278,8 +800,7 @@ static void raii_array_free(void *data) {
     raii_array_t *array = data;
 
     raii_array_reset(array);
-    memset(array, 0, sizeof(raii_array_t));
-    data = NULL;
+    RAII_FREE(array);
 }
 
 raii_array_t *raii_array_new(memory_t *scope) {
@@ -289,30 +810,139 @@ raii_array_t *raii_array_new(memory_t *scope) {
     return array;
 }
 
-static RAII_INLINE defer_t *raii_deferred_array_new(memory_t *scope) {
-    return (defer_t *)raii_array_new(scope);
+raii_array_t *raii_array_typed(memory_t *scope, size_t size) {
+    raii_array_t *array;
+    if (UNLIKELY(size == 0))
+        raii_panic("Failed! `raii_array_typed` invalid element size");
+
+    array = raii_array_new(scope);
+    array->type = RAII_ARRAY;
+    array->size = size;
+    return array;
 }
 
-static RAII_INLINE defer_func_t *raii_deferred_array_append(defer_t *array) {
-    return (defer_func_t *)raii_array_append((raii_array_t *)array, sizeof(defer_func_t));
+raii_array_t *raii_array_arena(memory_t *scope, void *arena, size_t size) {
+    raii_array_t *array = raii_array_typed(scope, size);
+    array->arena = arena;
+    return array;
 }
 
-static RAII_INLINE int raii_deferred_array_reset(defer_t *array) {
-    return raii_array_reset((raii_array_t *)array);
+static RAII_INLINE size_t raii_array_size(raii_array_t *a) {
+    if (UNLIKELY(a->size == 0))
+        raii_panic("Failed! untyped `raii_array_t`, use `raii_array_append`");
+
+    return a->size;
 }
 
-static RAII_INLINE void raii_deferred_array_free(defer_t *array) {
-    raii_array_free((raii_array_t *)array);
+RAII_INLINE int raii_array_reserve(raii_array_t *a, size_t count) {
+    return count <= a->capacity ? 0 : raii_array_grow_to(a, raii_array_size(a), count);
 }
 
-static RAII_INLINE size_t raii_deferred_array_get_index(const defer_t *array, raii_array_t *elem) {
-    RAII_ASSERT(elem >= (raii_array_t *)array->base.base);
-    return (size_t)(elem - (raii_array_t *)array->base.base);
+void *raii_array_push(raii_array_t *a, const void *element) {
+    void *slot = raii_array_append(a, raii_array_size(a));
+    if (!is_empty(slot) && !is_empty((void *)element))
+        memcpy(slot, element, a->size);
+
+    return slot;
+}
+
+void *raii_array_extend(raii_array_t *a, const void *elements, size_t count) {
+    size_t size = raii_array_size(a), total;
+    unsigned char *first;
+
+    if (UNLIKELY(add_overflow(a->elements, count, &total)))
+        return NULL;
+
+    if (total > a->capacity && UNLIKELY(raii_array_grow_to(a, size, total) < 0))
+        return NULL;
+
+    first = (unsigned char *)a->base + a->elements * size;
+    if (count > 0 && !is_empty((void *)elements))
+        memcpy(first, elements, count * size);
+
+    a->elements = total;
+    return first;
+}
+
+void *raii_array_insert(raii_array_t *a, size_t index, const void *element) {
+    size_t size = raii_array_size(a);
+    unsigned char *slot;
+
+    if (UNLIKELY(index > a->elements))
+        return NULL;
+
+    if (UNLIKELY(is_empty(raii_array_append(a, size))))
+        return NULL;
+
+    slot = (unsigned char *)a->base + index * size;
+    memmove(slot + size, slot, (a->elements - 1 - index) * size);
+    if (!is_empty((void *)element))
+        memcpy(slot, element, size);
+
+    return slot;
+}
+
+bool raii_array_pop(raii_array_t *a, void *out) {
+    size_t size = raii_array_size(a);
+    if (a->elements == 0)
+        return false;
+
+    a->elements--;
+    if (!is_empty(out))
+        memcpy(out, (unsigned char *)a->base + a->elements * size, size);
+
+    return true;
+}
+
+RAII_INLINE void *raii_array_at(raii_array_t *a, size_t index) {
+    return index < a->elements ? (unsigned char *)a->base + index * raii_array_size(a) : NULL;
+}
+
+RAII_INLINE size_t raii_array_count(raii_array_t *a) {
+    return a->elements;
+}
+
+RAII_INLINE void raii_array_clear(raii_array_t *a) {
+    a->elements = 0;
+}
+
+static RAII_INLINE defer_func_t *raii_deferred_array_base(defer_t *array) {
+    return is_empty(array->base.base) ? array->local : (defer_func_t *)array->base.base;
 }
 
-static RAII_INLINE raii_array_t *raii_deferred_array_get_element(const defer_t *array, size_t index) {
+/* Entries live in `local` until full, then move to heap storage doubling in size. */
+static defer_func_t *raii_deferred_array_append(defer_t *array) {
+    raii_array_t *a = &array->base;
+    if (is_empty(a->base)) {
+        if (a->elements < RAII_DEFER_INLINE)
+            return &array->local[a->elements++];
+
+        a->capacity = RAII_DEFER_INLINE;
+        if (UNLIKELY(raii_array_grow(a, sizeof(defer_func_t)) < 0)) {
+            a->capacity = 0;
+            return NULL;
+        }
+
+        memcpy(a->base, array->local, sizeof(array->local));
+    }
+
+    return (defer_func_t *)raii_array_append(a, sizeof(defer_func_t));
+}
+
+/* Release heap storage, marks array as already freed. */
+static RAII_INLINE int raii_deferred_array_reset(defer_t *array) {
+    array->type = RAII_NULL;
+    return raii_array_reset(&array->base);
+}
+
+static RAII_INLINE size_t raii_deferred_array_get_index(defer_t *array, defer_func_t *elem) {
+    RAII_ASSERT(elem >= raii_deferred_array_base(array));
+    return (size_t)(elem - raii_deferred_array_base(array));
+}
+
+static RAII_INLINE defer_func_t *raii_deferred_array_get_element(defer_t *array, size_t index) {
     RAII_ASSERT(index <= array->base.elements);
-    return &((raii_array_t *)array->base.base)[index];
+    return &raii_deferred_array_base(array)[index];
 }
 
 static RAII_INLINE size_t raii_deferred_array_len(const defer_t *array) {
@@ -321,59 +951,309 @@ static RAII_INLINE size_t raii_deferred_array_len(const defer_t *array) {
 
 static void deferred_canceled(void *data) {}
 
-static void raii_deferred_internal(memory_t *scope, defer_func_t *deferred) {
-    const size_t num_defers = raii_deferred_array_len(&scope->defer);
+/* Memory check mode takes over scope `RAII_FREE` of tracked blocks, returns `true` if done. */
+static RAII_INLINE bool raii_memchecked(func_t func, void *data) {
+#ifdef RAII_MEMCHECK
+    if (func == (func_t)RAII_FREE)
+        return raii_memcheck_free(data);
+
+    raii_memcheck_forget(data);
+#endif
+    return false;
+}
 
-    RAII_ASSERT(num_defers != 0 && deferred != NULL);
+/* Call `entry` copy, storage can move if it defers more. Ranges expand `LIFO` over their
+objects, scope memory released on another `thread`, goes back to it's owner `inbox`,
+while owner still runs. */
+static void raii_deferred_call(memory_t *scope, defer_func_t entry, raii_inbox_t *inbox) {
+    bool to_owner = entry.func == (func_t)RAII_FREE && !is_empty(inbox) && scope->owner != inbox;
+    void **objects = (void **)entry.data;
+    size_t i;
+#ifdef RAII_TRACE
+    uint64_t start = raii_trace_now();
+#endif
 
-    if (deferred == (defer_func_t *)raii_deferred_array_get_element(&scope->defer, num_defers - 1)) {
-        /* If we're cancelling the last defer we armed, there's no need to waste
-         * space of a deferred callback to an empty function like
-         * disarmed_defer(). */
-        raii_array_t *defer_base = (raii_array_t *)&scope->defer;
-        defer_base->elements--;
+    if (entry.type != RAII_ARRAY) {
+        if (!raii_memchecked(entry.func, entry.data)) {
+            if (to_owner)
+                raii_inbox_push(scope->owner, scope->owner_generation, entry.data);
+            else
+                entry.func(entry.data);
+        }
     } else {
-        deferred->func = deferred_canceled;
-        deferred->check = NULL;
+        for (i = entry.count; i > 0; i--) {
+            if (raii_memchecked(entry.func, objects[i - 1]))
+                continue;
+
+            if (to_owner)
+                raii_inbox_push(scope->owner, scope->owner_generation, objects[i - 1]);
+            else
+                entry.func(objects[i - 1]);
+        }
+    }
+
+    RAII_TRACED(raii_trace_event(RAII_TRACE_DEFER, (void *)entry.func, start,
+                                 entry.type == RAII_ARRAY ? entry.count : 1));
+    RAII_RECORDED(raii_record_event(RAII_RECORD_DEFER_FIRE, (void *)entry.func, entry.serial));
+}
+
+/* `raii_defer_async` entries of one unwind, run on reclaimer `thread` in order collected. */
+typedef struct raii_reclaim_s {
+    struct raii_reclaim_s *next;
+    size_t count;
+    size_t capacity;
+    struct {
+        func_t func;
+        void *data;
+    } entries[1];
+} raii_reclaim_t;
+
+static once_flag raii_reclaim_once = ONCE_FLAG_INIT;
+/* set once reclaimer's locks are ready */
+static volatile int raii_reclaim_started = 0;
+static mtx_t raii_reclaim_mutex[1];
+static cnd_t raii_reclaim_ready[1];
+static cnd_t raii_reclaim_idle[1];
+static thrd_t raii_reclaim_thread;
+/* batches queued, oldest first */
+static raii_reclaim_t *raii_reclaim_head = NULL;
+static raii_reclaim_t *raii_reclaim_tail = NULL;
+static bool raii_reclaim_busy = false;
+/* set at exit, reclaimer returns once queue ran empty, later batches run in place */
+static bool raii_reclaim_stopping = false;
+
+static void raii_reclaim_run(raii_reclaim_t *batch) {
+    volatile size_t i;
+    for (i = 0; i < batch->count; i++) {
+        try {
+            batch->entries[i].func(batch->entries[i].data);
+        } catch_any {
+        } end_trying;
     }
+
+    RAII_FREE(batch);
+}
+
+static int raii_reclaimer(void *arg) {
+    raii_reclaim_t *batch;
+
+    mtx_lock(raii_reclaim_mutex);
+    for (;;) {
+        while (is_empty(raii_reclaim_head) && !raii_reclaim_stopping)
+            cnd_wait(raii_reclaim_ready, raii_reclaim_mutex);
+
+        if (is_empty(batch = raii_reclaim_head))
+            break;
+
+        if (is_empty(raii_reclaim_head = batch->next))
+            raii_reclaim_tail = NULL;
+
+        raii_reclaim_busy = true;
+        mtx_unlock(raii_reclaim_mutex);
+        raii_reclaim_run(batch);
+        mtx_lock(raii_reclaim_mutex);
+        raii_reclaim_busy = false;
+        if (is_empty(raii_reclaim_head))
+            cnd_broadcast(raii_reclaim_idle);
+    }
+
+    mtx_unlock(raii_reclaim_mutex);
+    return 0;
+}
+
+/* Run out what is queued, then join reclaimer, it's locks are kept for late batches. */
+static void raii_reclaim_stop(void) {
+    mtx_lock(raii_reclaim_mutex);
+    raii_reclaim_stopping = true;
+    cnd_signal(raii_reclaim_ready);
+    mtx_unlock(raii_reclaim_mutex);
+    thrd_join(raii_reclaim_thread, NULL);
+}
+
+static void raii_reclaim_start(void) {
+    if (mtx_init(raii_reclaim_mutex, mtx_plain) != thrd_success
+        || cnd_init(raii_reclaim_ready) != thrd_success
+        || cnd_init(raii_reclaim_idle) != thrd_success)
+        raii_panic("Reclaimer `mtx_init/cnd_init` failed!");
+
+    raii_lock_name(raii_reclaim_mutex, "raii_reclaim");
+    if (thrd_create(&raii_reclaim_thread, raii_reclaimer, NULL) != thrd_success)
+        raii_panic("Reclaimer `thrd_create` failed!");
+
+    atexit(raii_reclaim_stop);
+    atomic_int_store(&raii_reclaim_started, 1);
+}
+
+static raii_reclaim_t *raii_reclaim_add(raii_reclaim_t *batch, func_t func, void *data) {
+    size_t count = is_empty(batch) ? 0 : batch->count, capacity;
+    if (is_empty(batch) || count == batch->capacity) {
+        capacity = is_empty(batch) ? RAII_DEFER_INLINE : batch->capacity * 2;
+        batch = try_realloc(batch, sizeof(raii_reclaim_t) + (capacity - 1) * sizeof(batch->entries[0]));
+        batch->count = count;
+        batch->capacity = capacity;
+    }
+
+    batch->entries[batch->count].func = func;
+    batch->entries[batch->count++].data = data;
+    return batch;
+}
+
+static void raii_reclaim_push(raii_reclaim_t *batch) {
+    call_once(&raii_reclaim_once, raii_reclaim_start);
+    batch->next = NULL;
+    mtx_lock(raii_reclaim_mutex);
+    if (raii_reclaim_stopping) {
+        mtx_unlock(raii_reclaim_mutex);
+        raii_reclaim_run(batch);
+        return;
+    }
+
+    if (is_empty(raii_reclaim_tail))
+        raii_reclaim_head = batch;
+    else
+        raii_reclaim_tail->next = batch;
+
+    raii_reclaim_tail = batch;
+    cnd_signal(raii_reclaim_ready);
+    mtx_unlock(raii_reclaim_mutex);
+}
+
+void raii_reclaim_wait(void) {
+    if (!atomic_int_load(&raii_reclaim_started))
+        return;
+
+    mtx_lock(raii_reclaim_mutex);
+    while (!is_empty(raii_reclaim_head) || raii_reclaim_busy)
+        cnd_wait(raii_reclaim_idle, raii_reclaim_mutex);
+    mtx_unlock(raii_reclaim_mutex);
+}
+
+static void raii_deferred_detach(memory_t *scope, defer_func_t *deferred) {
+    defer_func_t *base = raii_deferred_array_base(&scope->defer);
+
+    RAII_ASSERT(raii_deferred_array_len(&scope->defer) != 0 && deferred != NULL);
+
+    deferred->func = deferred_canceled;
+    deferred->check = NULL;
+    /* If we're cancelling the last defer we armed, there's no need to waste
+     * space of a deferred callback to an empty function, trailing entries
+     * cancelled before it goes too, so arm/cancel cycles never inflate array. */
+    while (scope->defer.base.elements > 0
+           && base[scope->defer.base.elements - 1].func == deferred_canceled)
+        scope->defer.base.elements--;
+}
+
+static void raii_deferred_internal(memory_t *scope, defer_func_t *deferred) {
+    /* cancelled block is caller's to free, a fired one already released */
+    RAII_MEMCHECKED(raii_memcheck_forget(deferred->data));
+    raii_deferred_detach(scope, deferred);
+}
+
+/* Entry `handle` still refers to, `NULL` if stale: fired, cancelled,
+or it's slot reused, after scope was unwound. */
+static defer_func_t *raii_deferred_lookup(memory_t *scope, defer_handle_t handle) {
+    size_t index = (size_t)(handle & 0xffffffff);
+    unsigned int serial = (unsigned int)(handle >> 32);
+    defer_func_t *deferred;
+
+    if (is_empty(scope) || serial == 0 || !is_type(&scope->defer, RAII_DEF_ARR)
+        || index >= raii_deferred_array_len(&scope->defer))
+        return NULL;
+
+    deferred = raii_deferred_array_get_element(&scope->defer, index);
+    if (deferred->serial != serial || deferred->func == deferred_canceled)
+        return NULL;
+
+    return deferred;
 }
 
 void raii_deferred_cancel(memory_t *scope, size_t index) {
     RAII_ASSERT(index >= 0);
+    RAII_STAT(scope->stats.cancelled++);
 
-    raii_deferred_internal(scope, (defer_func_t *)raii_deferred_array_get_element(&scope->defer, index));
+    defer_func_t *deferred = raii_deferred_array_get_element(&scope->defer, index);
+    RAII_RECORDED(raii_record_event(RAII_RECORD_DEFER_CANCEL, (void *)deferred->func, deferred->serial));
+    raii_deferred_internal(scope, deferred);
 }
 
 void raii_deferred_fire(memory_t *scope, size_t index) {
     RAII_ASSERT(index >= 0);
 
-    defer_func_t *deferred = (defer_func_t *)raii_deferred_array_get_element(&scope->defer, index);
+    defer_func_t *deferred = raii_deferred_array_get_element(&scope->defer, index);
     RAII_ASSERT(scope);
 
-    deferred->func(deferred->data);
+    raii_deferred_call(scope, *deferred, NULL);
+    RAII_STAT(scope->stats.fired++);
+
+    raii_deferred_internal(scope, raii_deferred_array_get_element(&scope->defer, index));
+}
 
+RAII_INLINE bool raii_deferred_armed(memory_t *scope, defer_handle_t handle) {
+    return !is_empty(raii_deferred_lookup(scope, handle));
+}
+
+bool raii_deferred_disarm(memory_t *scope, defer_handle_t handle) {
+    defer_func_t *deferred = raii_deferred_lookup(scope, handle);
+    if (is_empty(deferred))
+        return false;
+
+    RAII_STAT(scope->stats.cancelled++);
+    RAII_RECORDED(raii_record_event(RAII_RECORD_DEFER_CANCEL, (void *)deferred->func, deferred->serial));
     raii_deferred_internal(scope, deferred);
+    return true;
+}
+
+bool raii_deferred_trigger(memory_t *scope, defer_handle_t handle) {
+    defer_func_t *deferred = raii_deferred_lookup(scope, handle);
+    if (is_empty(deferred))
+        return false;
+
+    raii_deferred_call(scope, *deferred, NULL);
+    RAII_STAT(scope->stats.fired++);
+    /* storage can move, if fired function defers more */
+    if (!is_empty(deferred = raii_deferred_lookup(scope, handle)))
+        raii_deferred_internal(scope, deferred);
+
+    return true;
 }
 
 static void raii_deferred_run(memory_t *scope, size_t generation) {
-    raii_array_t *array = (raii_array_t *)&scope->defer;
-    defer_func_t *defers = array->base;
+    raii_array_t *array = &scope->defer.base;
+    raii_inbox_t *inbox = raii_inbox();
+    raii_reclaim_t *batch = NULL;
     bool defer_ran = false;
     size_t i;
 
     scope->is_recovered = is_empty(scope->err);
 
     for (i = array->elements; i != generation; i--) {
-        defer_func_t *defer = &defers[i - 1];
+        /* storage can move, if a deferred function defers more */
+        defer_func_t *defer = &raii_deferred_array_base(&scope->defer)[i - 1];
         defer_ran = true;
 
         if (!is_empty(scope->err) && !is_empty(defer->check))
             scope->is_recovered = false;
 
-        defer->func(defer->data);
-        defer->data = NULL;
+        if (defer->func == deferred_canceled)
+            continue;
+
+        RAII_STAT(scope->stats.fired++);
+        /* popped first, a deferred function throwing, as `group_create` join does,
+        leaves only older ones for unwind to run */
+        array->elements = i - 1;
+        if (defer->type == RAII_DEF_ASYNC) {
+            RAII_RECORDED(raii_record_event(RAII_RECORD_DEFER_FIRE, (void *)defer->func, defer->serial));
+            if (!raii_memchecked(defer->func, defer->data))
+                batch = raii_reclaim_add(batch, defer->func, defer->data);
+        } else {
+            raii_deferred_call(scope, *defer, inbox);
+        }
+        raii_deferred_array_base(&scope->defer)[i - 1].data = NULL;
     }
 
+    if (!is_empty(batch))
+        raii_reclaim_push(batch);
+
     if (scope->is_protected && !is_empty(scope->protector) && !is_empty(scope->err)) {
         scope->is_protected = false;
         if (!defer_ran) {
@@ -385,15 +1265,25 @@ static void raii_deferred_run(memory_t *scope, size_t generation) {
     array->elements = generation;
     if (!is_empty(scope->protector)) {
         ex_unprotected_ptr(scope->protector);
-        RAII_FREE(scope->protector);
+        if (!scope->is_local)
+            RAII_FREE(scope->protector);
+
         scope->protector = NULL;
     }
 }
 
 size_t raii_deferred_count(memory_t *scope) {
-    const raii_array_t *array = (raii_array_t *)&scope->defer;
+    return scope->defer.base.elements;
+}
 
-    return array->elements;
+raii_stats_t raii_scope_stats(memory_t *scope) {
+    raii_stats_t stats;
+    memset(&stats, 0, sizeof(stats));
+#ifdef RAII_STATS
+    if (!is_empty(scope))
+        stats = scope->stats;
+#endif
+    return stats;
 }
 
 void raii_deferred_free(memory_t *scope) {
@@ -403,6 +1293,9 @@ void raii_deferred_free(memory_t *scope) {
         raii_deferred_run(scope, 0);
         raii_deferred_array_reset(&scope->defer);
     }
+
+    raii_budget_release(scope);
+    raii_inbox_drain();
 }
 
 RAII_INLINE void raii_deferred_clean(void) {
@@ -419,11 +1312,21 @@ static size_t raii_deferred_any(memory_t *scope, func_t func, void *data, void *
         RAII_LOG("Could not add new deferred function.");
         return -1;
     } else {
+        /* never `0`, and never repeated by slot reuse, until wrapping around */
+        if (++scope->defer.serial == 0)
+            scope->defer.serial = 1;
+
+        deferred->serial = scope->defer.serial;
+        deferred->type = RAII_DEF_FUNC;
+        deferred->count = 0;
         deferred->func = func;
         deferred->data = data;
         deferred->check = check;
+        RAII_STAT(scope->stats.registered++);
+        RAII_STAT(scope->stats.peak = MAX(scope->stats.peak, scope->defer.base.elements));
+        RAII_RECORDED(raii_record_event(RAII_RECORD_DEFER_ADD, (void *)func, deferred->serial));
 
-        return raii_deferred_array_get_index(&scope->defer, (raii_array_t *)deferred);
+        return raii_deferred_array_get_index(&scope->defer, deferred);
     }
 }
 
@@ -431,10 +1334,142 @@ RAII_INLINE size_t raii_deferred(memory_t *scope, func_t func, void *data) {
     return raii_deferred_any(scope, func, data, NULL);
 }
 
-RAII_INLINE size_t raii_defer(func_t func, void *data) {
+RAII_INLINE size_t (raii_defer)(func_t func, void *data) {
     return raii_deferred(raii_init(), func, data);
 }
 
+size_t raii_deferred_many(memory_t *scope, func_t func, void **data, size_t n) {
+    size_t index;
+    defer_func_t *deferred;
+
+    if (UNLIKELY(n == 0 || is_empty(data)))
+        return -1;
+
+    if (UNLIKELY((index = raii_deferred_any(scope, func, data, NULL)) == (size_t)-1))
+        return index;
+
+    deferred = raii_deferred_array_get_element(&scope->defer, index);
+    deferred->type = RAII_ARRAY;
+    deferred->count = n;
+    return index;
+}
+
+RAII_INLINE size_t raii_defer_many(func_t func, void **data, size_t n) {
+    return raii_deferred_many(raii_init(), func, data, n);
+}
+
+typedef struct {
+    void **head;
+    size_t link;
+    bool is_tailed;
+    func_t dtor;
+} raii_list_t;
+
+static void raii_list_walk(void *data) {
+    raii_list_t list = *(raii_list_t *)data;
+    char *elm, *next;
+
+    RAII_FREE(data);
+    for (elm = (char *)*list.head; !is_empty(elm); elm = next) {
+        /* before `dtor` may free element */
+        next = *(char **)(elm + list.link);
+        list.dtor(elm);
+    }
+
+    /* as `*_INIT` would, `head` may be reused */
+    *list.head = NULL;
+    if (list.is_tailed)
+        list.head[1] = (void *)list.head;
+}
+
+size_t raii_deferred_list(memory_t *scope, void *head, size_t link, bool is_tailed, func_t dtor) {
+    raii_list_t *list;
+
+    if (UNLIKELY(is_empty(head) || is_empty(dtor)))
+        return -1;
+
+    list = try_malloc(sizeof(raii_list_t));
+    list->head = (void **)head;
+    list->link = link;
+    list->is_tailed = is_tailed;
+    list->dtor = dtor;
+    return raii_deferred(scope, raii_list_walk, list);
+}
+
+defer_handle_t raii_deferred_arm(memory_t *scope, func_t func, void *data) {
+    size_t index = raii_deferred_any(scope, func, data, NULL);
+    if (UNLIKELY(index == (size_t)-1))
+        return 0;
+
+    return ((defer_handle_t)scope->defer.serial << 32) | (defer_handle_t)index;
+}
+
+/* Append copy of `from` entry at `index` to `to`, then detach original,
+returns handle of it in `to`, `0` if `to` could not take it. */
+static defer_handle_t raii_deferred_transfer(memory_t *from, size_t index, memory_t *to) {
+    defer_func_t entry = *raii_deferred_array_get_element(&from->defer, index);
+    defer_func_t *moved;
+    size_t slot;
+
+    if (UNLIKELY((slot = raii_deferred_any(to, entry.func, entry.data, entry.check)) == (size_t)-1))
+        return 0;
+
+    moved = raii_deferred_array_get_element(&to->defer, slot);
+    moved->type = entry.type;
+    moved->count = entry.count;
+    /* no longer `from` last allocation to free, should it unwind without running defers */
+    if (from->is_protected && !is_empty(from->protector) && (void *)from->protector->ptr == entry.data)
+        from->is_protected = false;
+
+    raii_deferred_detach(from, raii_deferred_array_get_element(&from->defer, index));
+    return ((defer_handle_t)to->defer.serial << 32) | (defer_handle_t)slot;
+}
+
+defer_handle_t raii_deferred_move(memory_t *from, defer_handle_t handle, memory_t *to) {
+    defer_func_t *deferred = raii_deferred_lookup(from, handle);
+    if (is_empty(deferred) || is_empty(to))
+        return 0;
+
+    if (from == to)
+        return handle;
+
+    return raii_deferred_transfer(from, raii_deferred_array_get_index(&from->defer, deferred), to);
+}
+
+defer_handle_t raii_move(memory_t *from, memory_t *to, void *ptr) {
+    defer_func_t *base;
+    size_t i;
+
+    if (is_empty(from) || is_empty(to) || is_empty(ptr) || !is_type(&from->defer, RAII_DEF_ARR))
+        return 0;
+
+    /* newest first, a block is usually moved soon after it's made */
+    base = raii_deferred_array_base(&from->defer);
+    for (i = raii_deferred_array_len(&from->defer); i > 0; i--) {
+        if (base[i - 1].data != ptr || base[i - 1].type == RAII_ARRAY || base[i - 1].func == deferred_canceled)
+            continue;
+
+        if (from == to)
+            return ((defer_handle_t)base[i - 1].serial << 32) | (defer_handle_t)(i - 1);
+
+        return raii_deferred_transfer(from, i - 1, to);
+    }
+
+    return 0;
+}
+
+size_t raii_deferred_async(memory_t *scope, func_t func, void *data) {
+    size_t index = raii_deferred_any(scope, func, data, NULL);
+    if (LIKELY(index != (size_t)-1))
+        raii_deferred_array_get_element(&scope->defer, index)->type = RAII_DEF_ASYNC;
+
+    return index;
+}
+
+RAII_INLINE size_t raii_defer_async(func_t func, void *data) {
+    return raii_deferred_async(raii_init(), func, data);
+}
+
 RAII_INLINE void raii_recover(func_t func, void *data) {
     raii_deferred_any(raii_init(), func, data, (void *)"err");
 }
@@ -443,16 +1478,21 @@ RAII_INLINE void raii_recover_by(memory_t *scope, func_t func, void *data) {
     raii_deferred_any(scope, func, data, (void *)"err");
 }
 
+/* Exception class identity first, string compare only for dynamically named errors. */
+static RAII_INLINE bool raii_is_a(const char *exception, const char *err) {
+    return ex_is_a(exception, err) || is_str_eq(err, exception);
+}
+
 bool raii_caught(const char *err) {
     memory_t *scope = raii_init();
     const char *exception = (const char *)(!is_empty((void *)scope->panic) ? scope->panic : scope->err);
 
-    if (exception == NULL && is_str_eq(err, ex_local()->ex)) {
+    if (exception == NULL && raii_is_a(ex_local()->ex, err)) {
         ex_local()->state = ex_catch_st;
         return true;
     }
 
-    if ((scope->is_recovered = is_str_eq(err, exception)))
+    if ((scope->is_recovered = raii_is_a(exception, err)))
         ex_local()->state = ex_catch_st;
 
     return scope->is_recovered;
@@ -460,7 +1500,7 @@ bool raii_caught(const char *err) {
 
 bool raii_is_caught(memory_t *scope, const char *err) {
     const char *exception = (const char *)(!is_empty((void *)scope->panic) ? scope->panic : scope->err);
-    if ((scope->is_recovered = is_str_eq(err, exception)))
+    if ((scope->is_recovered = raii_is_a(exception, err)))
         ex_init()->state = ex_catch_st;
 
     return scope->is_recovered;
@@ -502,9 +1542,12 @@ void guard_reset(void *scope, ex_setup_func set, ex_unwind_func unwind) {
 }
 
 void guard_delete(memory_t *ptr) {
-    if (is_guard(ptr)) {
-        memset(ptr, -1, sizeof(ptr));
-        RAII_FREE(ptr);
+    RAII_TRACED(raii_trace_event(RAII_TRACE_SCOPE_END, ptr, 0, 0));
+    RAII_RECORDED(raii_record_event(RAII_RECORD_SCOPE_RELEASE, ptr, 0));
+    if (is_guard(ptr) && !ptr->is_local) {
+        raii_child_detach(ptr);
+        raii_arena_release(ptr);
+        raii_scopes_put(ptr);
         ptr = NULL;
     }
 }
@@ -542,8 +1585,10 @@ int strpos(const char *text, char *pattern) {
 }
 
 void args_free(args_t *params) {
-    if (is_type(params, RAII_ARGS)) {
-        RAII_FREE(params->args);
+    if (is_type(params, RAII_ARGS) && !params->is_local) {
+        if (params->args != params->inlined)
+            RAII_FREE(params->args);
+
         memset(params, -1, sizeof(args_t));
         RAII_FREE(params);
     }
@@ -553,7 +1598,8 @@ values_type get_args(void *params, int item) {
     args_t *args = (args_t *)params;
     if (!args->defer_set) {
         args->defer_set = true;
-        raii_deferred(args->context, (func_t)args_free, args);
+        if (!args->is_local)
+            raii_deferred(args->context, (func_t)args_free, args);
     }
 
     return args_in(args, item);
@@ -561,107 +1607,280 @@ values_type get_args(void *params, int item) {
 
 RAII_INLINE values_type args_in(args_t *params, int index) {
     return (index > -1 && index < (int)params->n_args)
-        ? params->args[index].value
+        ? raii_value_wide(&params->args[index])
         : ((raii_values_t *)0)->value;
 }
 
-args_t *raii_args_for(memory_t *scope, const char *desc, ...) {
-    int i, count = (int)strlen(desc);
-    args_t *params = try_calloc(1, sizeof(args_t));
-    raii_values_t *args = try_calloc(count, sizeof(raii_values_t));
-    va_list argp;
+raii_value_t raii_value_str(const char *text) {
+    raii_value_t value;
+    size_t length = is_empty((void *)text) ? 0 : strlen(text);
+
+    memset(&value, 0, sizeof(value));
+    if (!is_empty((void *)text) && length <= RAII_VALUE_SMALL) {
+        memcpy(value.small.chars, text, length + 1);
+        value.small.type = 'S';
+    } else {
+        value.word.value.char_ptr = (char *)text;
+        value.word.type = 's';
+    }
+
+    return value;
+}
+
+RAII_INLINE const char *raii_value_string(const raii_value_t *value) {
+    switch (value->word.type) {
+        case 'S':
+            return value->small.chars;
+        case 's':
+            return value->word.value.char_ptr;
+        default:
+            return NULL;
+    }
+}
+
+RAII_INLINE char raii_value_type(const raii_value_t *value) {
+    return value->word.type;
+}
+
+values_type raii_value_wide(const raii_value_t *value) {
+    values_type wide;
+    if (value->word.type == 'S')
+        memcpy((char *)wide.const_char, value->small.chars, sizeof(value->small.chars));
+    else
+        memcpy(&wide, &value->word.value, sizeof(value->word.value));
+
+    return wide;
+}
+
+static void args_parse(args_t *params, const char *desc, int count, va_list argp) {
+    args_value_t *args = params->args;
+    int i;
 
-    va_start(argp, desc);
     for (i = 0; i < count; i++) {
+        /* whole slot defined, whichever member is read back */
+        memset(&args[i], 0, sizeof(args_value_t));
+        args[i].word.type = *desc;
         switch (*desc++) {
             case 'i':
                 // unsigned integer argument
-                args[i].value.max_size = va_arg(argp, size_t);
+                args[i].word.value.max_size = va_arg(argp, size_t);
                 break;
             case 'd':
                 // signed integer argument
-                args[i].value.long_long = va_arg(argp, int64_t);
+                args[i].word.value.long_long = va_arg(argp, int64_t);
                 break;
             case 'c':
                 // character argument
-                args[i].value.schar = (char)va_arg(argp, int);
+                args[i].word.value.schar = (char)va_arg(argp, int);
                 break;
             case 's':
                 // string argument
-                args[i].value.char_ptr = va_arg(argp, char *);
+                args[i].word.value.char_ptr = va_arg(argp, char *);
+                break;
+            case 'S':
+                // small string argument, copied inline if it fits
+                args[i] = raii_value_str(va_arg(argp, const char *));
                 break;
             case 'a':
                 // array argument
-                args[i].value.array = va_arg(argp, char **);
+                args[i].word.value.array = va_arg(argp, char **);
                 break;
             case 'x':
                 // executable argument
-                args[i].value.func = (raii_func_t)va_arg(argp, func_args_t);
+                args[i].word.value.func = (raii_func_t)va_arg(argp, func_args_t);
                 break;
             case 'f':
                 // float argument
-                args[i].value.precision = va_arg(argp, double);
+                args[i].word.value.precision = va_arg(argp, double);
                 break;
             case 'p':
                 // void pointer (any arbitrary pointer) argument
-                args[i].value.object = va_arg(argp, void *);
+                args[i].word.value.object = va_arg(argp, void *);
                 break;
             default:
-                args[i].value.object = NULL;
+                args[i].word.value.object = NULL;
                 break;
         }
     }
-    va_end(argp);
 
-    params->args = args;
     params->defer_set = false;
-    params->n_args = (int)count;
+    params->n_args = (size_t)count;
+    params->type = RAII_ARGS;
+}
+
+args_t *raii_args_for(memory_t *scope, const char *desc, ...) {
+    int count = (int)strlen(desc);
+    args_t *params = try_calloc(1, sizeof(args_t));
+    va_list argp;
+
+    params->args = count > RAII_ARGS_INLINE
+        ? try_calloc(count, sizeof(args_value_t))
+        : params->inlined;
     params->context = scope;
+    params->is_local = false;
+
+    va_start(argp, desc);
+    args_parse(params, desc, count, argp);
+    va_end(argp);
+    return params;
+}
+
+args_t *args_local(args_t *params, const char *desc, ...) {
+    int count = (int)strlen(desc);
+    va_list argp;
+
+    if (UNLIKELY(count > RAII_ARGS_INLINE))
+        raii_panic("Failed! `args_local` more than `RAII_ARGS_INLINE` arguments");
+
+    params->args = params->inlined;
+    params->context = NULL;
+    params->is_local = true;
+
+    va_start(argp, desc);
+    args_parse(params, desc, count, argp);
+    va_end(argp);
+    return params;
+}
+
+args_t *args_packed(args_t *params, int count, const args_value_t *values) {
+    if (UNLIKELY(count < 0 || count > RAII_ARGS_INLINE))
+        raii_panic("Failed! `args_packed` more than `RAII_ARGS_INLINE` arguments");
+
+    memcpy(params->inlined, values, count * sizeof(args_value_t));
+    params->args = params->inlined;
+    params->context = NULL;
+    params->is_local = true;
+    params->defer_set = false;
+    params->n_args = (size_t)count;
     params->type = RAII_ARGS;
     return params;
 }
 
-RAII_INLINE raii_type type_of(void *self) {
+RAII_INLINE args_value_t args_of_i(size_t value) {
+    args_value_t slot;
+    memset(&slot, 0, sizeof(slot));
+    slot.word.value.max_size = value;
+    slot.word.type = 'i';
+    return slot;
+}
+
+RAII_INLINE args_value_t args_of_d(int64_t value) {
+    args_value_t slot;
+    memset(&slot, 0, sizeof(slot));
+    slot.word.value.long_long = value;
+    slot.word.type = 'd';
+    return slot;
+}
+
+RAII_INLINE args_value_t args_of_c(int value) {
+    args_value_t slot;
+    memset(&slot, 0, sizeof(slot));
+    slot.word.value.schar = (char)value;
+    slot.word.type = 'c';
+    return slot;
+}
+
+RAII_INLINE args_value_t args_of_f(double value) {
+    args_value_t slot;
+    memset(&slot, 0, sizeof(slot));
+    slot.word.value.precision = value;
+    slot.word.type = 'f';
+    return slot;
+}
+
+RAII_INLINE args_value_t args_of_s(const char *value) {
+    args_value_t slot;
+    memset(&slot, 0, sizeof(slot));
+    slot.word.value.char_ptr = (char *)value;
+    slot.word.type = 's';
+    return slot;
+}
+
+RAII_INLINE args_value_t args_of_a(char **value) {
+    args_value_t slot;
+    memset(&slot, 0, sizeof(slot));
+    slot.word.value.array = value;
+    slot.word.type = 'a';
+    return slot;
+}
+
+RAII_INLINE args_value_t args_of_x(raii_func_t value) {
+    args_value_t slot;
+    memset(&slot, 0, sizeof(slot));
+    slot.word.value.func = value;
+    slot.word.type = 'x';
+    return slot;
+}
+
+RAII_INLINE args_value_t args_of_p(void *value) {
+    args_value_t slot;
+    memset(&slot, 0, sizeof(slot));
+    slot.word.value.object = value;
+    slot.word.type = 'p';
+    return slot;
+}
+
+RAII_INLINE raii_type (type_of)(void *self) {
     return ((var_t *)self)->type;
 }
 
-RAII_INLINE bool is_guard(void *self) {
+struct timespec time_deadline(unsigned int ms) {
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    now.tv_sec += ms / 1000;
+    now.tv_nsec += (long)(ms % 1000) * 1000000L;
+    if (now.tv_nsec >= 1000000000L) {
+        now.tv_sec++;
+        now.tv_nsec -= 1000000000L;
+    }
+
+    return now;
+}
+
+bool time_expired(const struct timespec *deadline) {
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return now.tv_sec > deadline->tv_sec
+        || (now.tv_sec == deadline->tv_sec && now.tv_nsec >= deadline->tv_nsec);
+}
+
+RAII_INLINE bool (is_guard)(void *self) {
     return !is_empty(self) && ((unique_t *)self)->status == RAII_GUARDED_STATUS;
 }
 
-RAII_INLINE bool is_type(void *self, raii_type check) {
+RAII_INLINE bool (is_type)(void *self, raii_type check) {
     return type_of(self) == check;
 }
 
-RAII_INLINE bool is_instance_of(void *self, void *check) {
+RAII_INLINE bool (is_instance_of)(void *self, void *check) {
     return type_of(self) == type_of(check);
 }
 
-RAII_INLINE bool is_value(void *self) {
+RAII_INLINE bool (is_value)(void *self) {
     return (type_of(self) > RAII_NULL) && (type_of(self) < RAII_NAN);
 }
 
-RAII_INLINE bool is_instance(void *self) {
+RAII_INLINE bool (is_instance)(void *self) {
     return (type_of(self) > RAII_NAN) && (type_of(self) < RAII_NO_INSTANCE);
 }
 
-RAII_INLINE bool is_valid(void *self) {
+RAII_INLINE bool (is_valid)(void *self) {
     return is_value(self) || is_instance(self);
 }
 
-RAII_INLINE bool is_zero(size_t self) {
+RAII_INLINE bool (is_zero)(size_t self) {
     return self == 0;
 }
 
-RAII_INLINE bool is_empty(void *self) {
+RAII_INLINE bool (is_empty)(void *self) {
     return self == NULL;
 }
 
-RAII_INLINE bool is_true(bool self) {
+RAII_INLINE bool (is_true)(bool self) {
     return self == true;
 }
 
-RAII_INLINE bool is_false(bool self) {
+RAII_INLINE bool (is_false)(bool self) {
     return self == false;
 }
 
@@ -670,21 +1889,23 @@ RAII_INLINE bool is_str_in(const char *text, char *pattern) {
 }
 
 RAII_INLINE bool is_str_eq(const char *str, const char *str2) {
-    return (str != NULL && str2 != NULL) && (strcmp(str, str2) == 0);
+    return (str != NULL && str2 != NULL) && (str == str2 || strcmp(str, str2) == 0);
 }
 
 RAII_INLINE bool is_str_empty(const char *str) {
     return is_str_eq(str, "");
 }
 
+#ifndef RAII_NO_EMULATED
 RAII_INLINE bool is_exception_emulated(ex_context_t *storage) {
-    return is_true(storage->is_emulated) && !is_zero(rpmalloc_local_except_tls);
+    return is_true(storage->is_emulated) && !is_zero(local_except_tls);
 }
 
 RAII_INLINE bool is_protection_emulated(ex_ptr_t *storage) {
-    return is_true(storage->is_emulated) && !is_zero(rpmalloc_local_except_tls);
+    return is_true(storage->is_emulated) && !is_zero(local_except_tls);
 }
 
 RAII_INLINE bool is_scope_emulated(memory_t *storage) {
-    return is_true(storage->is_emulated) && !is_zero(rpmalloc_local_except_tls);
+    return is_true(storage->is_emulated) && !is_zero(local_except_tls);
 }
+#endif
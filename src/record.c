@@ -0,0 +1,275 @@
+#include "raii.h"
+
+/* Leads every `raii_record_save` recording, last byte is format version. */
+static const char record_magic[8] = {'R', 'A', 'I', 'I', 'R', 'E', 'C', '1'};
+
+/* Per `thread` ring, oldest events overwritten once full, listed for good once made,
+recycled by later `thread`s, events of exited ones kept till then. */
+typedef struct record_ring_s record_ring_t;
+struct record_ring_s {
+    /* events ever recorded, slot is `head % RAII_RECORD_RING` */
+    size_t head;
+    int tid;
+    volatile int used;
+    record_ring_t *next;
+    raii_record_t events[RAII_RECORD_RING];
+};
+
+static void *volatile record_rings = NULL;
+static volatile int record_tids = 0;
+static volatile int record_on = true;
+static raii_tls_t record_key;
+static once_flag record_once = ONCE_FLAG_INIT;
+/* Slot `i` holds name of index `i + 1`, linear probing by address, never removed. */
+static void *volatile record_names[RAII_RECORD_NAMES];
+
+static void record_release(void *arg) {
+    atomic_int_store(&((record_ring_t *)arg)->used, 0);
+}
+
+static void record_setup(void) {
+    if (raii_tls_create(&record_key, 0, record_release) != thrd_success)
+        raii_panic("Record `raii_tls_create` failed!");
+}
+
+static record_ring_t *record_ring(void) {
+    record_ring_t *ring;
+    void *head;
+    int unused;
+
+    call_once(&record_once, record_setup);
+    if (!is_empty(ring = (record_ring_t *)raii_tls_get(record_key)))
+        return ring;
+
+    for (ring = (record_ring_t *)atomic_ptr_load(&record_rings); !is_empty(ring); ring = ring->next) {
+        unused = 0;
+        if (atomic_int_load(&ring->used) == 0 && atomic_int_cas(&ring->used, &unused, 1))
+            break;
+    }
+
+    if (is_empty(ring)) {
+        ring = try_calloc(1, sizeof(record_ring_t));
+        ring->used = 1;
+        ring->tid = atomic_int_add(&record_tids, 1) + 1;
+        head = atomic_ptr_load(&record_rings);
+        do {
+            ring->next = (record_ring_t *)head;
+        } while (!atomic_ptr_cas(&record_rings, &head, ring));
+    }
+
+    if (raii_tls_set(record_key, ring) != thrd_success)
+        raii_panic("Record `raii_tls_set` failed!");
+
+    return ring;
+}
+
+/* Index of `name`, `0` for none, or once table is full. */
+static uint16_t record_name(const char *name) {
+    size_t i, start = ((uintptr_t)name >> 3) * 0x9e3779b97f4a7c15ull % RAII_RECORD_NAMES;
+    void *key;
+
+    if (is_empty((void *)name))
+        return 0;
+
+    for (i = 0; i < RAII_RECORD_NAMES; i++) {
+        size_t slot = (start + i) % RAII_RECORD_NAMES;
+        key = atomic_ptr_load(&record_names[slot]);
+        if (key == (void *)name
+            || (is_empty(key) && (atomic_ptr_cas(&record_names[slot], &key, (void *)name) || key == (void *)name)))
+            return (uint16_t)(slot + 1);
+    }
+
+    return 0;
+}
+
+static RAII_INLINE raii_record_t *record_next(int kind) {
+    record_ring_t *ring = record_ring();
+    raii_record_t *event = &ring->events[ring->head++ % RAII_RECORD_RING];
+
+    event->ts = raii_trace_now();
+    event->kind = (uint16_t)kind;
+    return event;
+}
+
+void raii_record_event(int kind, const void *ref, unsigned int value) {
+    raii_record_t *event;
+    if (!atomic_int_load(&record_on))
+        return;
+
+    event = record_next(kind);
+    event->ref = (uint64_t)(uintptr_t)ref;
+    event->value = value;
+    event->site = 0;
+}
+
+void raii_record_site(int kind, const char *ex, const char *file, int line) {
+    raii_record_t *event;
+    if (!atomic_int_load(&record_on))
+        return;
+
+    event = record_next(kind);
+    event->ref = record_name(ex);
+    event->value = (uint32_t)line;
+    event->site = record_name(file);
+}
+
+void ex_record_caught(ex_context_t *ctx, const char *file, int line) {
+    raii_record_site(RAII_RECORD_CATCH, ctx->ex, file, line);
+}
+
+RAII_INLINE bool raii_record_enable(bool on) {
+    return atomic_int_swap(&record_on, on) != 0;
+}
+
+size_t raii_record_save(FILE *out) {
+    record_ring_t *ring;
+    uint64_t base = UINT64_MAX;
+    uint32_t count = 0, rings = 0, events;
+    uint16_t index, length;
+    size_t i, first, total = 0;
+    const char *name;
+
+    for (ring = (record_ring_t *)atomic_ptr_load(&record_rings); !is_empty(ring); ring = ring->next) {
+        if (ring->head == 0)
+            continue;
+
+        first = ring->head > RAII_RECORD_RING ? ring->head - RAII_RECORD_RING : 0;
+        base = MIN(base, ring->events[first % RAII_RECORD_RING].ts);
+        rings++;
+    }
+
+    for (i = 0; i < RAII_RECORD_NAMES; i++)
+        count += !is_empty(atomic_ptr_load(&record_names[i]));
+
+    base = rings > 0 ? base : 0;
+    fwrite(record_magic, 1, sizeof(record_magic), out);
+    fwrite(&base, sizeof(base), 1, out);
+    fwrite(&count, sizeof(count), 1, out);
+    for (i = 0; i < RAII_RECORD_NAMES; i++) {
+        if (is_empty((void *)(name = (const char *)atomic_ptr_load(&record_names[i]))))
+            continue;
+
+        index = (uint16_t)(i + 1);
+        length = (uint16_t)MIN(strlen(name), UINT16_MAX);
+        fwrite(&index, sizeof(index), 1, out);
+        fwrite(&length, sizeof(length), 1, out);
+        fwrite(name, 1, length, out);
+    }
+
+    fwrite(&rings, sizeof(rings), 1, out);
+    for (ring = (record_ring_t *)atomic_ptr_load(&record_rings); !is_empty(ring) && rings > 0; ring = ring->next) {
+        if (ring->head == 0)
+            continue;
+
+        first = ring->head > RAII_RECORD_RING ? ring->head - RAII_RECORD_RING : 0;
+        events = (uint32_t)(ring->head - first);
+        fwrite(&ring->tid, sizeof(uint32_t), 1, out);
+        fwrite(&events, sizeof(events), 1, out);
+        for (i = first; i < ring->head; i++, total++)
+            fwrite(&ring->events[i % RAII_RECORD_RING], sizeof(raii_record_t), 1, out);
+
+        rings--;
+    }
+
+    return total;
+}
+
+static const char *record_named(char **names, uint16_t index) {
+    return is_empty(names[index]) ? "?" : names[index];
+}
+
+/* Timeline line of `event`, `depth` scopes deep. */
+static void record_write(FILE *out, raii_record_t *event, char **names, uint64_t base, int depth) {
+    static const char *actions[] = {"registered", "fired", "cancelled"};
+
+    fprintf(out, "%14.3f us  %*s", (double)(event->ts - base) / 1000.0, MIN(depth, 32) * 2, "");
+    switch (event->kind) {
+        case RAII_RECORD_SCOPE_CREATE:
+        case RAII_RECORD_SCOPE_RELEASE:
+            fprintf(out, "scope 0x%" PRIx64 " %s\n", event->ref,
+                    event->kind == RAII_RECORD_SCOPE_CREATE ? "create" : "release");
+            break;
+        case RAII_RECORD_DEFER_ADD:
+        case RAII_RECORD_DEFER_FIRE:
+        case RAII_RECORD_DEFER_CANCEL:
+            fprintf(out, "defer 0x%" PRIx64 " #%" PRIu32 " %s\n", event->ref, event->value,
+                    actions[event->kind - RAII_RECORD_DEFER_ADD]);
+            break;
+        case RAII_RECORD_THROW:
+        case RAII_RECORD_CATCH:
+            fprintf(out, "%s %s at %s:%" PRIu32 "\n", event->kind == RAII_RECORD_THROW ? "throw" : "catch",
+                    record_named(names, (uint16_t)event->ref), record_named(names, event->site), event->value);
+            break;
+        default:
+            fprintf(out, "event %d\n", event->kind);
+            break;
+    }
+}
+
+size_t raii_record_decode(FILE *in, FILE *out) {
+    char magic[sizeof(record_magic)], **names;
+    raii_record_t event;
+    uint64_t base;
+    uint32_t count, rings, tid, events, i;
+    uint16_t index, length;
+    size_t total = 0;
+    bool valid = false;
+    int depth;
+
+    if (fread(magic, 1, sizeof(magic), in) != sizeof(magic) || memcmp(magic, record_magic, sizeof(magic)) != 0
+        || fread(&base, sizeof(base), 1, in) != 1 || fread(&count, sizeof(count), 1, in) != 1) {
+        errno = EINVAL;
+        return 0;
+    }
+
+    names = try_calloc(UINT16_MAX + 1, sizeof(char *));
+    for (i = 0; i < count; i++) {
+        if (fread(&index, sizeof(index), 1, in) != 1 || fread(&length, sizeof(length), 1, in) != 1)
+            goto done;
+
+        RAII_FREE(names[index]);
+        names[index] = try_calloc(1, length + 1);
+        if (fread(names[index], 1, length, in) != length)
+            goto done;
+    }
+
+    if (fread(&rings, sizeof(rings), 1, in) != 1)
+        goto done;
+
+    for (; rings > 0; rings--) {
+        if (fread(&tid, sizeof(tid), 1, in) != 1 || fread(&events, sizeof(events), 1, in) != 1)
+            goto done;
+
+        fprintf(out, "thread %" PRIu32 ", %" PRIu32 " events\n", tid, events);
+        for (depth = 0, i = 0; i < events; i++, total++) {
+            if (fread(&event, sizeof(event), 1, in) != 1)
+                goto done;
+
+            /* ring may begin inside scopes, whose creation was overwritten */
+            if (event.kind == RAII_RECORD_SCOPE_RELEASE && depth > 0)
+                depth--;
+
+            record_write(out, &event, names, base, depth);
+            if (event.kind == RAII_RECORD_SCOPE_CREATE)
+                depth++;
+        }
+    }
+
+    valid = true;
+
+done:
+    for (i = 0; i <= UINT16_MAX; i++)
+        RAII_FREE(names[i]);
+
+    RAII_FREE(names);
+    if (!valid)
+        errno = EINVAL;
+
+    return total;
+}
+
+void raii_record_clear(void) {
+    record_ring_t *ring;
+    for (ring = (record_ring_t *)atomic_ptr_load(&record_rings); !is_empty(ring); ring = ring->next)
+        ring->head = 0;
+}
@@ -0,0 +1,195 @@
+#include "raii.h"
+
+#define REFLECT_AT(obj, field) ((char *)(obj) + (field)->offset)
+
+const reflect_field_t *reflect_field(const reflect_type_t *desc, const char *name) {
+    size_t i;
+    RAII_ASSERT(is_type((void *)desc, RAII_REFLECT_TYPE));
+    for (i = 0; i < desc->count; i++) {
+        if (strcmp(desc->fields[i].name, name) == 0)
+            return &desc->fields[i];
+    }
+
+    return NULL;
+}
+
+/* Signedness of field `type`, for widening. */
+static bool reflect_signed(raii_type type) {
+    switch (type) {
+        case RAII_INT:
+        case RAII_ENUM:
+        case RAII_INTEGER:
+        case RAII_SLONG:
+        case RAII_LLONG:
+        case RAII_SHORT:
+        case RAII_CHAR:
+            return true;
+        default:
+            return false;
+    }
+}
+
+raii_values_t reflect_get(const void *obj, const reflect_field_t *field) {
+    raii_values_t out;
+    const char *at = REFLECT_AT(obj, field);
+    int64_t value = 0;
+
+    memset(&out, 0, sizeof(out));
+    out.type = field->type;
+    switch (field->type) {
+        case RAII_FLOAT:
+            memcpy(&out.value.point, at, sizeof(float));
+            return out;
+        case RAII_DOUBLE:
+            memcpy(&out.value.precision, at, sizeof(double));
+            return out;
+        case RAII_BOOL:
+            out.value.boolean = *(const bool *)at;
+            return out;
+        case RAII_CHAR_P:
+        case RAII_UCHAR_P:
+        case RAII_CONST_CHAR:
+        case RAII_PTR:
+        case RAII_OBJ:
+        case RAII_FUNC:
+            if (field->type == RAII_OBJ)
+                out.value.object = (void *)at;
+            else
+                memcpy(&out.value.object, at, sizeof(void *));
+            return out;
+        default:
+            break;
+    }
+
+    switch (field->size) {
+        case 1:
+            value = reflect_signed(field->type) ? (int64_t)*(const int8_t *)at : (int64_t)*(const uint8_t *)at;
+            break;
+        case 2:
+            value = reflect_signed(field->type) ? (int64_t)*(const int16_t *)at : (int64_t)*(const uint16_t *)at;
+            break;
+        case 4:
+            value = reflect_signed(field->type) ? (int64_t)*(const int32_t *)at : (int64_t)*(const uint32_t *)at;
+            break;
+        default:
+            memcpy(&value, at, MIN(field->size, sizeof(value)));
+            break;
+    }
+
+    out.value.long_long = (long long)value;
+    return out;
+}
+
+void reflect_set(void *obj, const reflect_field_t *field, values_type value) {
+    char *at = REFLECT_AT(obj, field);
+    int8_t i8;
+    int16_t i16;
+    int32_t i32;
+
+    switch (field->type) {
+        case RAII_FLOAT:
+            memcpy(at, &value.point, sizeof(float));
+            return;
+        case RAII_DOUBLE:
+            memcpy(at, &value.precision, sizeof(double));
+            return;
+        case RAII_BOOL:
+            *(bool *)at = value.boolean;
+            return;
+        case RAII_OBJ:
+            raii_panic("Failed! `reflect_set` of embedded struct");
+        case RAII_CHAR_P:
+        case RAII_UCHAR_P:
+        case RAII_CONST_CHAR:
+        case RAII_PTR:
+        case RAII_FUNC:
+            memcpy(at, &value.object, sizeof(void *));
+            return;
+        default:
+            break;
+    }
+
+    switch (field->size) {
+        case 1:
+            i8 = (int8_t)value.long_long;
+            memcpy(at, &i8, 1);
+            break;
+        case 2:
+            i16 = (int16_t)value.long_long;
+            memcpy(at, &i16, 2);
+            break;
+        case 4:
+            i32 = (int32_t)value.long_long;
+            memcpy(at, &i32, 4);
+            break;
+        default:
+            memcpy(at, &value.long_long, MIN(field->size, sizeof(value.long_long)));
+            break;
+    }
+}
+
+static void *reflect_alloc(memory_t *scope, size_t size) {
+    return is_empty(scope) ? try_malloc(size) : malloc_by(scope, size);
+}
+
+void *reflect_copy(memory_t *scope, const reflect_type_t *desc, void *dst, const void *src) {
+    const reflect_field_t *field;
+    size_t i, length;
+    void *from, *to;
+
+    RAII_ASSERT(is_type((void *)desc, RAII_REFLECT_TYPE));
+    memcpy(dst, src, desc->size);
+    for (i = 0; i < desc->count; i++) {
+        field = &desc->fields[i];
+        if (field->type == RAII_OBJ) {
+            reflect_copy(scope, field->nested, REFLECT_AT(dst, field), REFLECT_AT(src, field));
+            continue;
+        }
+
+        if (field->type != RAII_CHAR_P && (field->type != RAII_PTR || is_empty((void *)field->nested)))
+            continue;
+
+        memcpy(&from, REFLECT_AT(src, field), sizeof(void *));
+        if (is_empty(from))
+            continue;
+
+        if (field->type == RAII_CHAR_P) {
+            length = strlen((const char *)from) + 1;
+            memcpy(to = reflect_alloc(scope, length), from, length);
+        } else {
+            to = reflect_copy(scope, field->nested, reflect_alloc(scope, field->nested->size), from);
+        }
+
+        memcpy(REFLECT_AT(dst, field), &to, sizeof(void *));
+    }
+
+    return dst;
+}
+
+void reflect_free(const reflect_type_t *desc, void *obj) {
+    const reflect_field_t *field;
+    void *owned;
+    size_t i;
+
+    if (is_empty(obj))
+        return;
+
+    RAII_ASSERT(is_type((void *)desc, RAII_REFLECT_TYPE));
+    for (i = 0; i < desc->count; i++) {
+        field = &desc->fields[i];
+        if (field->type == RAII_OBJ) {
+            reflect_free(field->nested, REFLECT_AT(obj, field));
+            continue;
+        }
+
+        if (field->type != RAII_CHAR_P && (field->type != RAII_PTR || is_empty((void *)field->nested)))
+            continue;
+
+        memcpy(&owned, REFLECT_AT(obj, field), sizeof(void *));
+        if (field->type == RAII_PTR)
+            reflect_free(field->nested, owned);
+
+        RAII_FREE(owned);
+        memset(REFLECT_AT(obj, field), 0, sizeof(void *));
+    }
+}
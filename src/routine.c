@@ -0,0 +1,533 @@
+#if defined(__APPLE__) && !defined(_XOPEN_SOURCE)
+    /* `ucontext` is deprecated, but still provided, on macOS */
+    #define _XOPEN_SOURCE 600
+#endif
+#include "raii.h"
+#if !defined(_WIN32)
+    #include <ucontext.h>
+    #include <sys/mman.h>
+    #include <unistd.h>
+    #if !defined(MAP_ANONYMOUS)
+        #define MAP_ANONYMOUS MAP_ANON
+    #endif
+    #if !defined(MAP_STACK)
+        #define MAP_STACK 0
+    #endif
+#endif
+
+struct routine_s {
+    raii_type type;
+    bool is_done;
+    bool is_detached;
+    bool is_queued;
+    /* on scheduler's `remote` list, guarded by it's `lock` */
+    bool is_woken;
+    sched_t *sched;
+    /* next on ready queue */
+    routine_t *next;
+    /* next on scheduler's `remote` list */
+    routine_t *remote_next;
+    /* coroutine waiting in `routine_join` */
+    routine_t *joiner;
+    raii_func_t func;
+    void *arg;
+    void *result;
+    /* captured exception, `ex` is `NULL` if none */
+    const char *ex;
+    const char *panic;
+    const char *file;
+    const char *function;
+    int line;
+    /* own defer scope, root exception context, and `try` chain top when switched out */
+    unique_frame_t frame;
+    ex_context_t root;
+    ex_context_t *top;
+    ex_setup_func setup;
+    ex_unwind_func unwind;
+    /* set last by scheduler `thread`, for `routine_join` from any other */
+    volatile int finished;
+    mtx_t mutex[1];
+    cnd_t ready[1];
+#if defined(_WIN32)
+    LPVOID fiber;
+#else
+    /* mapping, lowest page is guard, `PROT_NONE` */
+    void *stack;
+    size_t stack_size;
+    ucontext_t context;
+#endif
+};
+
+struct sched_s {
+    raii_type type;
+    routine_t *current;
+    routine_t *head;
+    routine_t *tail;
+    /* unfinished coroutines */
+    size_t count;
+    /* woken by `routine_wake` from other `thread`s, moved to ready queue by owner */
+    void *volatile remote;
+    mtx_t lock[1];
+    cnd_t woken[1];
+    void (*waker)(void *);
+    void *waker_arg;
+#if defined(_WIN32)
+    LPVOID fiber;
+    bool is_fiber;
+#else
+    ucontext_t context;
+#endif
+};
+
+#ifdef emulate_tls
+static raii_tls_t sched_self_key = 0;
+static once_flag sched_self_once = ONCE_FLAG_INIT;
+
+static void sched_self_setup(void) {
+    if (raii_tls_create(&sched_self_key, 0, NULL) != thrd_success)
+        raii_panic("Sched `raii_tls_create` failed!");
+}
+#else
+static thread_local sched_t *sched_self = NULL;
+#endif
+
+static RAII_INLINE sched_t *sched_self_get(void) {
+#ifdef emulate_tls
+    call_once(&sched_self_once, sched_self_setup);
+    return (sched_t *)raii_tls_get(sched_self_key);
+#else
+    return sched_self;
+#endif
+}
+
+static void sched_self_set(sched_t *sched) {
+#ifdef emulate_tls
+    call_once(&sched_self_once, sched_self_setup);
+    if (raii_tls_set(sched_self_key, (void *)sched) != thrd_success)
+        raii_panic("Sched `raii_tls_set` failed!");
+#else
+    sched_self = sched;
+#endif
+}
+
+static void routine_enqueue(sched_t *sched, routine_t *co) {
+    co->next = NULL;
+    co->is_queued = true;
+    if (is_empty(sched->tail))
+        sched->head = co;
+    else
+        sched->tail->next = co;
+
+    sched->tail = co;
+}
+
+static routine_t *routine_dequeue(sched_t *sched) {
+    routine_t *co = sched->head;
+    if (!is_empty(co)) {
+        sched->head = co->next;
+        if (is_empty(sched->head))
+            sched->tail = NULL;
+
+        co->next = NULL;
+        co->is_queued = false;
+    }
+
+    return co;
+}
+
+static void routine_release(routine_t *co) {
+    raii_delete(&co->frame.scope);
+#if defined(_WIN32)
+    DeleteFiber(co->fiber);
+#else
+    munmap(co->stack, co->stack_size);
+#endif
+    mtx_destroy(co->mutex);
+    cnd_destroy(co->ready);
+    co->type = RAII_NULL;
+    RAII_FREE(co);
+}
+
+/* Move coroutines woken by other `thread`s onto ready queue, in wake order. */
+static void sched_collect(sched_t *sched) {
+    routine_t *co, *next, *list = NULL;
+    if (is_empty(atomic_ptr_load(&sched->remote)))
+        return;
+
+    mtx_lock(sched->lock);
+    co = (routine_t *)sched->remote;
+    atomic_ptr_store(&sched->remote, NULL);
+    for (; !is_empty(co); co = next) {
+        next = co->remote_next;
+        co->remote_next = list;
+        co->is_woken = false;
+        list = co;
+    }
+    mtx_unlock(sched->lock);
+
+    for (co = list; !is_empty(co); co = co->remote_next) {
+        if (!co->is_done && !co->is_queued)
+            routine_enqueue(sched, co);
+    }
+}
+
+/* Block scheduler `thread` until `routine_wake` from another `thread`. */
+static void sched_wait(sched_t *sched) {
+    mtx_lock(sched->lock);
+    while (is_empty(atomic_ptr_load(&sched->remote)))
+        cnd_wait(sched->woken, sched->lock);
+
+    mtx_unlock(sched->lock);
+}
+
+static void routine_main(routine_t *co) {
+    try {
+        co->result = co->func(co->arg);
+    } catch_any {
+        co->ex = ex_err.ex;
+        co->panic = ex_err.panic;
+        co->file = ex_err.file;
+        co->function = ex_err.function;
+        co->line = ex_err.line;
+    } ex_finally {
+        raii_deferred_free(&co->frame.scope);
+    } end_trying;
+
+    co->is_done = true;
+    if (!is_empty(co->joiner))
+        routine_enqueue(co->sched, co->joiner);
+}
+
+/* Back to scheduler, from running coroutine. */
+static void routine_leave(routine_t *co) {
+#if defined(_WIN32)
+    SwitchToFiber(co->sched->fiber);
+#else
+    if (swapcontext(&co->context, &co->sched->context) != 0)
+        raii_panic("Routine `swapcontext` failed!");
+#endif
+}
+
+#if defined(_WIN32)
+static void WINAPI routine_entry(LPVOID arg) {
+    routine_t *co = (routine_t *)arg;
+    routine_main(co);
+    /* fiber must never return */
+    routine_leave(co);
+}
+#else
+static void routine_entry(void) {
+    routine_main(sched_self_get()->current);
+    /* returns by `uc_link` to scheduler */
+}
+#endif
+
+/* Run `co` until it yields, suspends or finishes, swapping `thread` scope,
+exception chain and guard hooks, for the ones of coroutine. */
+static void routine_switch(sched_t *sched, routine_t *co) {
+    ex_context_t *top = ex_init();
+    memory_t *scope = raii_local_swap(&co->frame.scope);
+    ex_setup_func setup = exception_setup_func;
+    ex_unwind_func unwind = exception_unwind_func;
+
+    exception_setup_func = co->setup;
+    exception_unwind_func = co->unwind;
+    ex_update(co->top);
+    sched->current = co;
+#if defined(_WIN32)
+    SwitchToFiber(co->fiber);
+#else
+    if (swapcontext(&sched->context, &co->context) != 0)
+        raii_panic("Routine `swapcontext` failed!");
+#endif
+    sched->current = NULL;
+    co->top = ex_init();
+    co->setup = exception_setup_func;
+    co->unwind = exception_unwind_func;
+    exception_setup_func = setup;
+    exception_unwind_func = unwind;
+    raii_local_swap(scope);
+    ex_update(top);
+
+    if (co->is_done) {
+        sched->count--;
+        if (co->is_detached) {
+            routine_release(co);
+        } else {
+            /* joiner may release `co` right after */
+            mtx_lock(co->mutex);
+            atomic_int_store(&co->finished, 1);
+            cnd_broadcast(co->ready);
+            mtx_unlock(co->mutex);
+        }
+    }
+}
+
+sched_t *sched_init(void) {
+    sched_t *sched = sched_self_get();
+    if (is_empty(sched)) {
+        /* thread scope must exist, before any coroutine replaces it */
+        raii_init();
+        sched = try_calloc(1, sizeof(sched_t));
+        sched->type = RAII_SCHED;
+        if (mtx_init(sched->lock, mtx_plain) != thrd_success
+            || cnd_init(sched->woken) != thrd_success)
+            raii_panic("Sched `mtx_init/cnd_init` failed!");
+
+        raii_lock_name(sched->lock, "sched");
+#if defined(_WIN32)
+        if (IsThreadAFiber()) {
+            sched->fiber = GetCurrentFiber();
+        } else {
+            if (is_empty(sched->fiber = ConvertThreadToFiber(NULL)))
+                raii_panic("Sched `ConvertThreadToFiber` failed!");
+            sched->is_fiber = true;
+        }
+#endif
+        sched_self_set(sched);
+    }
+
+    return sched;
+}
+
+void sched_waker(void (*waker)(void *), void *arg) {
+    sched_t *sched = sched_init();
+    mtx_lock(sched->lock);
+    sched->waker = waker;
+    sched->waker_arg = arg;
+    mtx_unlock(sched->lock);
+}
+
+#if !defined(_WIN32)
+static RAII_INLINE size_t routine_guard(void) {
+    long page = sysconf(_SC_PAGESIZE);
+    return page > 0 ? (size_t)page : 4096;
+}
+
+/* Stack mapped with an extra lowest guard page, an overflow faults, instead
+of silently corrupting neighbouring memory. */
+static void routine_map(routine_t *co, size_t stack_size) {
+    size_t guard_size = routine_guard();
+
+    stack_size = (stack_size + guard_size - 1) & ~(guard_size - 1);
+    co->stack_size = stack_size + guard_size;
+    co->stack = mmap(NULL, co->stack_size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (co->stack == MAP_FAILED || mprotect(co->stack, guard_size, PROT_NONE) != 0)
+        raii_panic("Routine stack `mmap/mprotect` failed!");
+}
+
+/* Context runs on mapped stack, above it's guard page. */
+static void routine_stack(routine_t *co) {
+    size_t guard_size = routine_guard();
+
+    co->context.uc_stack.ss_sp = (char *)co->stack + guard_size;
+    co->context.uc_stack.ss_size = co->stack_size - guard_size;
+}
+#endif
+
+routine_t *routine_create(raii_func_t fn, void *arg, size_t stack_size) {
+    sched_t *sched = sched_init();
+    routine_t *co;
+
+    if (UNLIKELY(fn == NULL))
+        raii_panic("Failed! `routine_create` invalid function");
+
+    if (stack_size == 0)
+        stack_size = ROUTINE_STACK;
+
+    co = try_calloc(1, sizeof(routine_t));
+    co->type = RAII_ROUTINE;
+    co->sched = sched;
+    co->func = fn;
+    co->arg = arg;
+    unique_local(&co->frame);
+    if (mtx_init(co->mutex, mtx_plain) != thrd_success || cnd_init(co->ready) != thrd_success)
+        raii_panic("Routine `mtx_init/cnd_init` failed!");
+
+    co->root.type = ex_context_st;
+    co->root.caught = -1;
+    co->root.is_raii = true;
+    co->root.data = (void *)&co->frame.scope;
+    co->root.prev = (void *)&co->frame.scope;
+    co->top = &co->root;
+
+#if defined(_WIN32)
+    if (is_empty(co->fiber = CreateFiber(stack_size, routine_entry, co))) {
+        RAII_FREE(co);
+        raii_panic("Routine `CreateFiber` failed!");
+    }
+#else
+    /* `stack_size` not used past `getcontext`, which returns twice */
+    routine_map(co, stack_size);
+    if (getcontext(&co->context) != 0)
+        raii_panic("Routine `getcontext` failed!");
+
+    routine_stack(co);
+    co->context.uc_link = &sched->context;
+    makecontext(&co->context, routine_entry, 0);
+#endif
+
+    sched->count++;
+    routine_enqueue(sched, co);
+    return co;
+}
+
+RAII_INLINE routine_t *routine_current(void) {
+    sched_t *sched = sched_self_get();
+    return is_empty(sched) ? NULL : sched->current;
+}
+
+bool routine_yield(void) {
+    routine_t *co = routine_current();
+    if (is_empty(co))
+        return false;
+
+    routine_enqueue(co->sched, co);
+    routine_leave(co);
+    return true;
+}
+
+void routine_suspend(void) {
+    routine_t *co = routine_current();
+    if (UNLIKELY(is_empty(co)))
+        raii_panic("Failed! `routine_suspend` outside of coroutine");
+
+    routine_leave(co);
+}
+
+void routine_resume(routine_t *co) {
+    if (UNLIKELY(is_empty(co) || !is_type(co, RAII_ROUTINE) || co->sched != sched_self_get()))
+        raii_panic("Failed! `routine_resume` invalid coroutine");
+
+    if (!co->is_done && !co->is_queued && co != co->sched->current)
+        routine_enqueue(co->sched, co);
+}
+
+void routine_wake(routine_t *co) {
+    void (*waker)(void *) = NULL;
+    void *waker_arg = NULL;
+    sched_t *sched;
+
+    if (UNLIKELY(is_empty(co) || !is_type(co, RAII_ROUTINE)))
+        raii_panic("Failed! `routine_wake` invalid coroutine");
+
+    sched = co->sched;
+    if (sched == sched_self_get()) {
+        routine_resume(co);
+        return;
+    }
+
+    /* owner collects only once `co` has switched out, even if still running now */
+    mtx_lock(sched->lock);
+    if (!co->is_woken) {
+        co->is_woken = true;
+        co->remote_next = (routine_t *)sched->remote;
+        atomic_ptr_store(&sched->remote, co);
+        cnd_signal(sched->woken);
+        waker = sched->waker;
+        waker_arg = sched->waker_arg;
+    }
+    mtx_unlock(sched->lock);
+
+    if (!is_empty(waker))
+        waker(waker_arg);
+}
+
+/* Run one ready coroutine, returns `false` if none ready. */
+static bool sched_step(sched_t *sched) {
+    routine_t *co;
+
+    sched_collect(sched);
+    co = routine_dequeue(sched);
+    if (is_empty(co))
+        return false;
+
+    routine_switch(sched, co);
+    return true;
+}
+
+void sched_run(void) {
+    sched_t *sched = sched_init();
+    if (UNLIKELY(!is_empty(sched->current)))
+        raii_panic("Failed! `sched_run` from within coroutine");
+
+    while (sched_step(sched));
+}
+
+RAII_INLINE size_t sched_count(void) {
+    sched_t *sched = sched_self_get();
+    return is_empty(sched) ? 0 : sched->count;
+}
+
+void sched_free(void) {
+    sched_t *sched = sched_self_get();
+    if (is_empty(sched))
+        return;
+
+    if (UNLIKELY(!is_empty(sched->current) || sched->count > 0))
+        raii_panic("Failed! `sched_free` with unfinished coroutines");
+
+#if defined(_WIN32)
+    if (sched->is_fiber)
+        ConvertFiberToThread();
+#endif
+    sched_self_set(NULL);
+    mtx_destroy(sched->lock);
+    cnd_destroy(sched->woken);
+    sched->type = RAII_NULL;
+    RAII_FREE(sched);
+}
+
+void *routine_join(routine_t *co) {
+    const char *ex, *panic, *file, *function;
+    routine_t *self = routine_current();
+    sched_t *sched = sched_self_get();
+    void *result;
+    int line;
+
+    if (UNLIKELY(is_empty(co) || !is_type(co, RAII_ROUTINE) || co == self
+                 || co->is_detached || !is_empty(co->joiner)))
+        raii_panic("Failed! `routine_join` invalid coroutine");
+
+    if (co->sched != sched) {
+        /* of another `thread`, never step it's scheduler, block till it signals */
+        mtx_lock(co->mutex);
+        while (!atomic_int_load(&co->finished))
+            cnd_wait(co->ready, co->mutex);
+        mtx_unlock(co->mutex);
+    } else if (!is_empty(self)) {
+        if (!co->is_done) {
+            co->joiner = self;
+            routine_leave(self);
+        }
+    } else {
+        while (!co->is_done) {
+            if (!sched_step(sched))
+                sched_wait(sched);
+        }
+    }
+
+    result = co->result;
+    ex = co->ex;
+    panic = co->panic;
+    file = co->file;
+    function = co->function;
+    line = co->line;
+    routine_release(co);
+
+    if (!is_empty((void *)ex))
+        ex_throw(ex, file, line, function, panic);
+
+    return result;
+}
+
+void routine_detach(routine_t *co) {
+    if (UNLIKELY(is_empty(co) || !is_type(co, RAII_ROUTINE) || co->is_detached))
+        raii_panic("Failed! `routine_detach` invalid coroutine");
+
+    if (co->is_done && co != co->sched->current)
+        routine_release(co);
+    else
+        co->is_detached = true;
+}
@@ -0,0 +1,124 @@
+#include "raii.h"
+
+/* Counts, just before block, of same allocation, padded so block keeps `malloc` alignment.
+Strong references together hold one weak, so header outlives last strong one,
+while any `shared_weak` remains. */
+struct raii_weak_s {
+    raii_type type;
+    bool is_atomic;
+    volatile size_t strong;
+    volatile size_t weak;
+    func_t dtor;
+};
+
+typedef union {
+    struct raii_weak_s counts;
+    char pad[align_up(sizeof(struct raii_weak_s), 16)];
+} shared_header_t;
+
+static RAII_INLINE raii_weak_t *shared_header(void *ptr) {
+    raii_weak_t *header = &((shared_header_t *)ptr - 1)->counts;
+    RAII_ASSERT(header->type == RAII_SHARED);
+    return header;
+}
+
+static RAII_INLINE void *shared_block(raii_weak_t *header) {
+    return (shared_header_t *)header + 1;
+}
+
+static void *shared_create(size_t size, func_t dtor, bool is_atomic) {
+    shared_header_t *header = try_calloc(1, sizeof(shared_header_t) + size);
+    header->counts.type = RAII_SHARED;
+    header->counts.is_atomic = is_atomic;
+    header->counts.strong = 1;
+    header->counts.weak = 1;
+    header->counts.dtor = dtor;
+
+    return header + 1;
+}
+
+void *shared_alloc(size_t size, func_t dtor) {
+    return shared_create(size, dtor, true);
+}
+
+void *shared_local(size_t size, func_t dtor) {
+    return shared_create(size, dtor, false);
+}
+
+static RAII_INLINE size_t shared_add(raii_weak_t *header, volatile size_t *count) {
+    return header->is_atomic ? atomic_size_add(count, 1) : (*count)++;
+}
+
+/* Returns count `before` decrement. */
+static RAII_INLINE size_t shared_sub(raii_weak_t *header, volatile size_t *count) {
+    return header->is_atomic ? atomic_size_sub(count, 1) : (*count)--;
+}
+
+void *shared_retain(void *ptr) {
+    raii_weak_t *header = shared_header(ptr);
+    shared_add(header, &header->strong);
+    return ptr;
+}
+
+void *shared_retain_by(memory_t *scope, void *ptr) {
+    raii_deferred(scope, shared_release, shared_retain(ptr));
+    return ptr;
+}
+
+void *shared_by(memory_t *scope, size_t size, func_t dtor) {
+    void *ptr = shared_alloc(size, dtor);
+    raii_deferred(scope, shared_release, ptr);
+    return ptr;
+}
+
+void shared_weak_release(raii_weak_t *weak) {
+    if (!is_empty(weak) && shared_sub(weak, &weak->weak) == 1) {
+        weak->type = RAII_NULL;
+        RAII_FREE((shared_header_t *)weak);
+    }
+}
+
+void shared_release(void *ptr) {
+    raii_weak_t *header;
+    if (is_empty(ptr))
+        return;
+
+    header = shared_header(ptr);
+    if (shared_sub(header, &header->strong) == 1) {
+        if (header->dtor)
+            header->dtor(ptr);
+
+        shared_weak_release(header);
+    }
+}
+
+size_t shared_count(void *ptr) {
+    raii_weak_t *header = shared_header(ptr);
+    return header->is_atomic ? atomic_size_load(&header->strong) : header->strong;
+}
+
+raii_weak_t *shared_weak(void *ptr) {
+    raii_weak_t *header = shared_header(ptr);
+    shared_add(header, &header->weak);
+    return header;
+}
+
+void *shared_lock(raii_weak_t *weak) {
+    size_t strong;
+    if (!weak->is_atomic) {
+        if (is_zero(weak->strong))
+            return NULL;
+
+        weak->strong++;
+        return shared_block(weak);
+    }
+
+    strong = atomic_size_load(&weak->strong);
+    do {
+        /* released, `dtor` already run, or running */
+        if (is_zero(strong))
+            return NULL;
+    } while (!atomic_size_cas(&weak->strong, &strong, strong + 1));
+
+    return shared_block(weak);
+}
@@ -1,53 +1,129 @@
 #include "raii.h"
 
+/* Cache line sized, so shard locks are not falsely shared. */
+typedef union thrd_shard_s {
+    struct {
+        raii_fastlock_t mtx[1];
+        arena_t arena;
+    } s;
+    char pad[128];
+} thrd_shard_t;
+
 static unique_t *thrd_arena_tls = NULL;
-static mtx_t thrd_arena_mtx[1] = {0};
-tss_t thrd_arena_tss = 0;
+static thrd_shard_t thrd_shards[THRD_ARENA_SHARDS];
+static volatile size_t thrd_shard_next = 0;
+/* worker-less `thread` scopes, `thrd_unique` created */
+static raii_tls_t thrd_arena_key;
+static once_flag thrd_arena_once = ONCE_FLAG_INIT;
+#ifdef emulate_tls
+static raii_tls_t thrd_shard_key;
+#else
+/* `1` based index of assigned shard, `0` not yet assigned. */
+static thread_local size_t thrd_shard_slot = 0;
+#endif
 
 static void thrd_arena_delete(void) {
     if (is_empty(thrd_arena_tls))
         return;
 
-    if (!is_empty(thrd_arena_tls->arena))
-        arena_free((arena_t)thrd_arena_tls->arena);
+    size_t i;
+    for (i = 0; i < THRD_ARENA_SHARDS; i++) {
+        if (!is_empty(thrd_shards[i].s.arena))
+            arena_free(thrd_shards[i].s.arena);
 
-    mtx_destroy(thrd_arena_mtx);
+        thrd_shards[i].s.arena = NULL;
+        raii_fastlock_destroy(thrd_shards[i].s.mtx);
+    }
 
     thrd_arena_tls->arena = NULL;
-    memset(thrd_arena_tls, -1, sizeof(thrd_arena_tls));
+    memset(thrd_arena_tls, -1, sizeof(unique_t));
     RAII_FREE(thrd_arena_tls);
     thrd_arena_tls = NULL;
-    thrd_arena_tss = 0;
+#ifdef RAII_THREAD_STATE
+    raii_thread.thrd = NULL;
+#endif
     local_except_delete();
+    RAII_MEMCHECKED(raii_memcheck_leaks());
 }
 
-RAII_INLINE unique_t *thrd_scope(void) {
-    return (unique_t *)tss_get(thrd_arena_tss);
+unique_t *thrd_scope(void) {
+#ifdef RAII_THREAD_STATE
+    unique_t *scope = raii_thread.thrd;
+    if (LIKELY(!is_empty(scope)))
+        return scope;
+
+    return is_empty(thrd_arena_tls) ? NULL : (unique_t *)raii_tls_get(thrd_arena_key);
+#else
+    unique_t *scope = workers_scope();
+    if (!is_empty(scope) || is_empty(thrd_arena_tls))
+        return scope;
+
+    return (unique_t *)raii_tls_get(thrd_arena_key);
+#endif
 }
 
 RAII_INLINE void thrd_defer(func_t func, void *arg) {
     raii_deferred(thrd_scope(), func, arg);
 }
 
+int raii_config(const raii_config_t *config) {
+    rpmalloc_config_t settings;
+    const rpmalloc_config_t *applied = rpmalloc_config();
+    /* `page_size` is only set by process wide initialization, on any `thread`,
+    after which rpmalloc silently ignores a new config. */
+    if (applied->page_size != 0)
+        return RAII_ERR;
+
+    memset(&settings, 0, sizeof(settings));
+    settings.enable_huge_pages = config->huge_pages;
+    settings.span_map_count = config->span_map_count;
+    settings.page_name = config->page_name;
+    settings.huge_page_name = config->huge_page_name;
+    if (rpmalloc_initialize_config(&settings) != 0)
+        return RAII_ERR;
+
+    /* huge pages unavailable, or span count realigned to them */
+    applied = rpmalloc_config();
+    if ((config->huge_pages && !applied->enable_huge_pages)
+        || (config->span_map_count && applied->span_map_count != config->span_map_count))
+        return RAII_ERR;
+
+    return RAII_OK;
+}
+
+static void thrd_arena_setup(void) {
+    if (raii_tls_create(&thrd_arena_key, 0, (func_t)raii_deferred_free) != thrd_success)
+        raii_panic("Thrd `raii_tls_create` failed!");
+#ifdef emulate_tls
+    if (raii_tls_create(&thrd_shard_key, 0, NULL) != thrd_success)
+        raii_panic("Thrd `raii_tls_create` failed!");
+#endif
+}
+
 void thrd_init(void) {
-    if (rpmalloc_local_except_tls == 0) {
-            rpmalloc_local_except_tls = sizeof(ex_context_t);
-            rpmalloc_initialize();
-            if (rpmalloc_tls_create(&rpmalloc_local_except_tss, rp_free) != 0)
-                raii_panic("Thrd `rpmalloc_tls_create` failed!");
+#ifdef RAII_NO_EMULATED
+    raii_panic("Thrd emulated scopes disabled by `RAII_NO_EMULATED`!");
+#endif
+    if (local_except_tls == 0) {
+        rpmalloc_initialize();
+        if (raii_tls_create(&local_except_key, 0, (func_t)rp_free) != thrd_success)
+            raii_panic("Thrd `raii_tls_create` failed!");
+        local_except_tls = sizeof(ex_context_t);
     }
 
     if (is_empty(thrd_arena_tls)) {
-        if (mtx_init(thrd_arena_mtx, mtx_plain) != thrd_success)
-            raii_panic("Thrd `mtx_init` failed!");
-
+        size_t i;
+        call_once(&thrd_arena_once, thrd_arena_setup);
         thrd_arena_tls = unique_init_arena();
-        ((arena_t)thrd_arena_tls->arena)->is_global = true;
+        for (i = 0; i < THRD_ARENA_SHARDS; i++) {
+            if (raii_fastlock_init(thrd_shards[i].s.mtx) != thrd_success)
+                raii_panic("Thrd `raii_fastlock_init` failed!");
 
-        if (tss_create(&thrd_arena_tss, (func_t)raii_deferred_free) != thrd_success)
-            raii_panic("Thrd `tss_create` failed!");
+            raii_lock_name(thrd_shards[i].s.mtx, "thrd_shard");
+            thrd_shards[i].s.arena = i == 0 ? (arena_t)thrd_arena_tls->arena : arena_init(0);
+            thrd_shards[i].s.arena->is_global = true;
+        }
 
-        raii_deferred(thrd_arena_tls, (func_t)tss_delete, &thrd_arena_tss);
         if (is_empty(thrd_arena_tls->protector))
             thrd_arena_tls->protector = try_calloc(1, sizeof(ex_ptr_t));
 
@@ -59,28 +135,61 @@ void thrd_init(void) {
 
 void *thrd_unique(size_t size) {
     unique_t *scope;
-    if (is_empty(scope = tss_get(thrd_arena_tss))) {
-        if (is_empty(thrd_arena_tls))
-            raii_panic("Failed! Thrd not `thrd_init`");
+    if (is_empty(thrd_arena_tls))
+        raii_panic("Failed! Thrd not `thrd_init`");
 
+    if (is_empty(scope = raii_tls_get(thrd_arena_key))) {
         scope = unique_init();
         scope->is_emulated = true;
-        if (tss_set(thrd_arena_tss, (void *)scope) != thrd_success)
-            raii_panic("Thrd `tss_set` failed!");
+        if (raii_tls_set(thrd_arena_key, (void *)scope) != thrd_success)
+            raii_panic("Thrd `raii_tls_set` failed!");
 
+#ifdef RAII_THREAD_STATE
+        if (is_empty(raii_thread.thrd))
+            raii_thread.thrd = scope;
+#endif
         scope->arena = thrd_alloc(size);
     }
 
     return scope->arena;
 }
 
+static thrd_shard_t *thrd_shard(void) {
+    size_t slot;
+#ifdef emulate_tls
+    if (is_zero(slot = (size_t)raii_tls_get(thrd_shard_key))) {
+        slot = atomic_size_add(&thrd_shard_next, 1) % THRD_ARENA_SHARDS + 1;
+        if (raii_tls_set(thrd_shard_key, (void *)slot) != thrd_success)
+            raii_panic("Thrd `raii_tls_set` failed!");
+    }
+#else
+    if (is_zero(slot = thrd_shard_slot))
+        slot = thrd_shard_slot = atomic_size_add(&thrd_shard_next, 1) % THRD_ARENA_SHARDS + 1;
+#endif
+
+    return &thrd_shards[slot - 1];
+}
+
 void *thrd_alloc(size_t size) {
-    if (mtx_lock(thrd_arena_mtx) != thrd_success)
-        raii_panic("Thrd `mtx_lock` failed!");
+    C_API const char EX_NAME(out_of_memory)[];
+    thrd_shard_t *shard;
+    void *block;
+    bool exceeded;
+    if (is_empty(thrd_arena_tls))
+        raii_panic("Failed! Thrd not `thrd_init`");
 
-    void *block = malloc_arena(thrd_arena_tls, size);
-    if (mtx_unlock(thrd_arena_mtx) != thrd_success)
-        raii_panic("Thrd `mtx_unlock` failed!");
+    shard = thrd_shard();
+    if (raii_fastlock_lock(shard->s.mtx) != thrd_success)
+        raii_panic("Thrd `raii_fastlock_lock` failed!");
+
+    block = arena_take(shard->s.arena, (long)size);
+    exceeded = is_empty(block) && !is_zero(shard->s.arena->budget);
+    if (raii_fastlock_unlock(shard->s.mtx) != thrd_success)
+        raii_panic("Thrd `raii_fastlock_unlock` failed!");
+
+    /* thrown once unlocked, shard stays usable by other threads */
+    if (exceeded)
+        ex_throw(EX_NAME(out_of_memory), __FILE__, __LINE__, __FUNCTION__, "Arena budget exceeded!");
 
     return block;
 }
@@ -91,8 +200,68 @@ RAII_INLINE void *thrd_malloc(size_t size) {
 
 void *thrd_get(void) {
     void *ptr;
-    if (is_empty(ptr = tss_get(thrd_arena_tss)))
-        return ptr;
+    if (is_empty(thrd_arena_tls) || is_empty(ptr = raii_tls_get(thrd_arena_key)))
+        return NULL;
 
     return ((memory_t *)ptr)->arena;
 }
+
+/* Two arenas per `thread`, so a function can build it's result in one
+while scratch temporaries go to the other. */
+typedef struct thrd_scratch_s {
+    arena_t arena[2];
+} thrd_scratch_t;
+
+static raii_tls_t thrd_scratch_key = 0;
+static once_flag thrd_scratch_once = ONCE_FLAG_INIT;
+#ifndef emulate_tls
+static thread_local thrd_scratch_t *thrd_scratch_tls = NULL;
+#endif
+
+/* `thread` exit, both arenas freed. */
+static void thrd_scratch_delete(void *data) {
+    thrd_scratch_t *scratch = (thrd_scratch_t *)data;
+    arena_free(scratch->arena[0]);
+    arena_free(scratch->arena[1]);
+#ifndef emulate_tls
+    thrd_scratch_tls = NULL;
+#endif
+    RAII_FREE(scratch);
+}
+
+static void thrd_scratch_setup(void) {
+    if (raii_tls_create(&thrd_scratch_key, 0, thrd_scratch_delete) != thrd_success)
+        raii_panic("Thrd `raii_tls_create` failed!");
+}
+
+static thrd_scratch_t *thrd_scratch_new(void) {
+    thrd_scratch_t *scratch = try_calloc(1, sizeof(thrd_scratch_t));
+    scratch->arena[0] = arena_init(0);
+    scratch->arena[1] = arena_init(0);
+    if (raii_tls_set(thrd_scratch_key, (void *)scratch) != thrd_success)
+        raii_panic("Thrd `raii_tls_set` failed!");
+
+    return scratch;
+}
+
+arena_t thrd_scratch(arena_t conflict) {
+    thrd_scratch_t *scratch;
+#ifdef emulate_tls
+    call_once(&thrd_scratch_once, thrd_scratch_setup);
+    if (is_empty(scratch = (thrd_scratch_t *)raii_tls_get(thrd_scratch_key)))
+        scratch = thrd_scratch_new();
+#else
+    if (UNLIKELY(is_empty(scratch = thrd_scratch_tls))) {
+        call_once(&thrd_scratch_once, thrd_scratch_setup);
+        scratch = thrd_scratch_tls = thrd_scratch_new();
+    }
+#endif
+
+    return scratch->arena[0] == conflict ? scratch->arena[1] : scratch->arena[0];
+}
+
+arena_t thrd_scratch_by(memory_t *scope, arena_t conflict) {
+    arena_t arena = thrd_scratch(conflict);
+    arena_rewind_by(scope, arena);
+    return arena;
+}
@@ -0,0 +1,294 @@
+#include "raii.h"
+
+/* Levels of `TIMER_SLOTS` slots each, level `n` slot spans `TIMER_SLOTS^n`
+milliseconds, so `4` levels of `64` cover about four and half hours, longer delays
+wait in last slot, and get placed again each time it comes around. */
+#define TIMER_BITS      6
+#define TIMER_SLOTS     (1 << TIMER_BITS)
+#define TIMER_MASK      (TIMER_SLOTS - 1)
+#define TIMER_LEVELS    4
+#define TIMER_RANGE     ((uint64_t)1 << (TIMER_BITS * TIMER_LEVELS))
+
+/* Released timers each `thread` keeps for reuse. */
+#ifndef RAII_TIMER_CACHE
+    #define RAII_TIMER_CACHE 256
+#endif
+
+typedef struct timer_wheel_s timer_wheel_t;
+struct raii_timer_s {
+    raii_timer_t *next;
+    /* link pointing at this one, `NULL` once off wheel */
+    raii_timer_t **pprev;
+    timer_wheel_t *wheel;
+    /* monotonic milliseconds */
+    uint64_t expires;
+    /* `NULL` for `timer_timeout` */
+    func_t fn;
+    void *data;
+    memory_t *scope;
+    defer_handle_t handle;
+};
+
+/* Per `thread` wheel, made on first `timer_add`, left behind by exiting `thread`
+till it's last timer is gone. */
+struct timer_wheel_s {
+    /* last millisecond processed */
+    uint64_t now;
+    size_t count;
+    /* expired, not yet fired, kept here so a throwing one leaves rest for next run */
+    raii_timer_t *due;
+    raii_timer_t *cache;
+    size_t cached;
+    bool is_orphan;
+    raii_timer_t *slots[TIMER_LEVELS][TIMER_SLOTS];
+};
+
+static raii_tls_t timer_key;
+static once_flag timer_once = ONCE_FLAG_INIT;
+
+static void timer_wheel_free(timer_wheel_t *wheel) {
+    raii_timer_t *timer, *next;
+    for (timer = wheel->cache; !is_empty(timer); timer = next) {
+        next = timer->next;
+        RAII_FREE(timer);
+    }
+
+    RAII_FREE(wheel);
+}
+
+static void timer_release(void *arg) {
+    timer_wheel_t *wheel = (timer_wheel_t *)arg;
+    /* timers left are of scopes that outlive this `thread` */
+    if (wheel->count > 0)
+        wheel->is_orphan = true;
+    else
+        timer_wheel_free(wheel);
+}
+
+static void timer_setup(void) {
+    if (raii_tls_create(&timer_key, 0, timer_release) != thrd_success)
+        raii_panic("Timer `raii_tls_create` failed!");
+}
+
+static uint64_t timer_now(void) {
+#if defined(_WIN32)
+    return (uint64_t)GetTickCount64();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000u + (uint64_t)now.tv_nsec / 1000000u;
+#endif
+}
+
+static RAII_INLINE timer_wheel_t *timer_wheel_get(void) {
+    call_once(&timer_once, timer_setup);
+    return (timer_wheel_t *)raii_tls_get(timer_key);
+}
+
+static timer_wheel_t *timer_wheel(void) {
+    timer_wheel_t *wheel = timer_wheel_get();
+    if (!is_empty(wheel))
+        return wheel;
+
+    wheel = try_calloc(1, sizeof(timer_wheel_t));
+    wheel->now = timer_now();
+    if (raii_tls_set(timer_key, wheel) != thrd_success)
+        raii_panic("Timer `raii_tls_set` failed!");
+
+    return wheel;
+}
+
+static RAII_INLINE void timer_link(raii_timer_t **head, raii_timer_t *timer) {
+    timer->pprev = head;
+    if (!is_empty(timer->next = *head))
+        timer->next->pprev = &timer->next;
+
+    *head = timer;
+}
+
+static RAII_INLINE void timer_unlink(raii_timer_t *timer) {
+    if (!is_empty(timer->next))
+        timer->next->pprev = timer->pprev;
+
+    *timer->pprev = timer->next;
+    timer->pprev = NULL;
+    timer->next = NULL;
+}
+
+/* Slot by distance to `expires`, never behind `now`. */
+static void timer_place(timer_wheel_t *wheel, raii_timer_t *timer) {
+    uint64_t expires = timer->expires, delta = expires - wheel->now;
+    int level = 0;
+
+    if (delta >= TIMER_RANGE) {
+        expires = wheel->now + TIMER_RANGE - 1;
+        delta = TIMER_RANGE - 1;
+    }
+
+    while (level < TIMER_LEVELS - 1 && delta >= ((uint64_t)1 << (TIMER_BITS * (level + 1))))
+        level++;
+
+    timer_link(&wheel->slots[level][(expires >> (TIMER_BITS * level)) & TIMER_MASK], timer);
+}
+
+/* Place again each timer of higher level slot now come around. */
+static void timer_cascade(timer_wheel_t *wheel, int level) {
+    raii_timer_t **slot = &wheel->slots[level][(wheel->now >> (TIMER_BITS * level)) & TIMER_MASK];
+    raii_timer_t *timer;
+
+    while (!is_empty(timer = *slot)) {
+        timer_unlink(timer);
+        timer_place(wheel, timer);
+    }
+}
+
+/* Tick to `target`, moving each expired timer onto `due`. */
+static void timer_advance(timer_wheel_t *wheel, uint64_t target) {
+    raii_timer_t **slot, *timer;
+    int level;
+
+    while (wheel->now < target) {
+        if (wheel->count == 0) {
+            wheel->now = target;
+            break;
+        }
+
+        wheel->now++;
+        for (level = 1; level < TIMER_LEVELS
+             && ((wheel->now >> (TIMER_BITS * (level - 1))) & TIMER_MASK) == 0; level++)
+            timer_cascade(wheel, level);
+
+        slot = &wheel->slots[0][wheel->now & TIMER_MASK];
+        while (!is_empty(timer = *slot)) {
+            timer_unlink(timer);
+            timer_link(&wheel->due, timer);
+        }
+    }
+}
+
+static void timer_recycle(timer_wheel_t *wheel, raii_timer_t *timer) {
+    wheel->count--;
+    if (wheel->is_orphan && wheel->count == 0) {
+        RAII_FREE(timer);
+        timer_wheel_free(wheel);
+    } else if (wheel->cached < RAII_TIMER_CACHE) {
+        timer->next = wheel->cache;
+        wheel->cache = timer;
+        wheel->cached++;
+    } else {
+        RAII_FREE(timer);
+    }
+}
+
+/* Deferred by `timer_add`, scope exit or unwind takes it off wheel. */
+static void timer_drop(void *arg) {
+    raii_timer_t *timer = (raii_timer_t *)arg;
+    timer_unlink(timer);
+    timer_recycle(timer->wheel, timer);
+}
+
+raii_timer_t *timer_add(memory_t *scope, unsigned int ms, func_t fn, void *data) {
+    timer_wheel_t *wheel = timer_wheel();
+    raii_timer_t *timer;
+
+    if (!is_empty(timer = wheel->cache)) {
+        wheel->cache = timer->next;
+        wheel->cached--;
+    } else {
+        timer = try_malloc(sizeof(raii_timer_t));
+    }
+
+    timer->next = NULL;
+    timer->wheel = wheel;
+    timer->fn = fn;
+    timer->data = data;
+    timer->scope = scope;
+    timer->handle = 0;
+    /* `wheel->now` lags clock till next `timer_run` */
+    timer->expires = timer_now() + ms;
+    if (timer->expires <= wheel->now)
+        timer->expires = wheel->now + 1;
+
+    wheel->count++;
+    timer_place(wheel, timer);
+    if (!is_empty(scope))
+        timer->handle = raii_deferred_arm(scope, timer_drop, timer);
+
+    return timer;
+}
+
+RAII_INLINE raii_timer_t *timer_timeout(memory_t *scope, unsigned int ms) {
+    return timer_add(scope, ms, NULL, NULL);
+}
+
+void timer_cancel(raii_timer_t *timer) {
+    if (is_empty(timer) || is_empty(timer->pprev))
+        return;
+
+    if (!is_empty(timer->scope))
+        raii_deferred_disarm(timer->scope, timer->handle);
+
+    timer_drop(timer);
+}
+
+int timer_run(void) {
+    timer_wheel_t *wheel = timer_wheel_get();
+    raii_timer_t *timer;
+    func_t fn;
+    void *data;
+    int fired = 0;
+
+    if (is_empty(wheel) || wheel->count == 0)
+        return 0;
+
+    timer_advance(wheel, timer_now());
+    while (!is_empty(timer = wheel->due)) {
+        timer_unlink(timer);
+        if (!is_empty(timer->scope))
+            raii_deferred_disarm(timer->scope, timer->handle);
+
+        fn = timer->fn;
+        data = timer->data;
+        timer_recycle(wheel, timer);
+        if (is_empty(fn))
+            throw(timeout_error);
+
+        fn(data);
+        fired++;
+    }
+
+    return fired;
+}
+
+int timer_next(void) {
+    timer_wheel_t *wheel = timer_wheel_get();
+    uint64_t now, span, at;
+    int level, i;
+
+    if (is_empty(wheel) || wheel->count == 0)
+        return -1;
+
+    if (!is_empty(wheel->due))
+        return 0;
+
+    /* first occupied slot of lowest level holding any, exact for level `0`,
+    otherwise when that slot gets placed again, still early enough to sleep till */
+    for (level = 0; level < TIMER_LEVELS; level++) {
+        span = (uint64_t)1 << (TIMER_BITS * level);
+        for (i = 1; i <= TIMER_SLOTS; i++) {
+            at = ((wheel->now >> (TIMER_BITS * level)) + i) & TIMER_MASK;
+            if (!is_empty(wheel->slots[level][at])) {
+                at = level == 0 ? wheel->now + i : ((wheel->now >> (TIMER_BITS * level)) + i) * span;
+                now = timer_now();
+                return at <= now ? 0 : (int)(at - now);
+            }
+        }
+    }
+
+    return 0;
+}
+
+RAII_INLINE size_t timer_count(void) {
+    timer_wheel_t *wheel = timer_wheel_get();
+    return is_empty(wheel) ? 0 : wheel->count;
+}
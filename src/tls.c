@@ -0,0 +1,159 @@
+#include "raii.h"
+
+/* Passes over pointer slots at `thread` exit, as `tss` does, for `dtor`s setting others again. */
+#define RAII_TLS_PASSES 4
+
+typedef struct {
+    /* `0` for pointer slot */
+    size_t size;
+    size_t offset;
+    func_t dtor;
+} raii_tls_slot_t;
+
+/* Per `thread` block, one for all slots. */
+struct raii_tls_s {
+    void *value[RAII_TLS_SLOTS];
+    char data[RAII_TLS_BYTES];
+};
+
+static raii_tls_slot_t raii_tls_slots[RAII_TLS_SLOTS];
+static volatile size_t raii_tls_count = 0;
+static size_t raii_tls_bytes = 0;
+/* spin lock of slot registration */
+static volatile size_t raii_tls_lock = 0;
+static tss_t raii_tls_tss = 0;
+static once_flag raii_tls_once = ONCE_FLAG_INIT;
+
+#ifdef RAII_THREAD_STATE
+#define raii_tls_local raii_thread.tls
+#elif !defined(emulate_tls)
+static thread_local struct raii_tls_s *raii_tls_local = NULL;
+#endif
+
+static void raii_tls_locked(bool lock) {
+    size_t none = 0;
+    if (!lock) {
+        atomic_size_store(&raii_tls_lock, 0);
+        return;
+    }
+
+    while (!atomic_size_cas(&raii_tls_lock, &none, 1)) {
+        none = 0;
+        thrd_yield();
+    }
+}
+
+/* `thread` exit, slots released last registered first, then block. */
+static void raii_tls_delete(void *data) {
+    struct raii_tls_s *block = (struct raii_tls_s *)data;
+    size_t count = atomic_size_load(&raii_tls_count), i;
+    bool pending = true;
+    void *value;
+    int pass;
+
+    for (pass = 0; pending && pass < RAII_TLS_PASSES; pass++) {
+        pending = false;
+        for (i = count; i-- > 0;) {
+            if (raii_tls_slots[i].size > 0) {
+                if (pass == 0 && !is_empty(raii_tls_slots[i].dtor))
+                    raii_tls_slots[i].dtor(block->data + raii_tls_slots[i].offset);
+                continue;
+            }
+
+            if (is_empty(value = block->value[i]))
+                continue;
+
+            block->value[i] = NULL;
+            if (!is_empty(raii_tls_slots[i].dtor)) {
+                raii_tls_slots[i].dtor(value);
+                pending = true;
+            }
+        }
+    }
+
+#ifndef emulate_tls
+    raii_tls_local = NULL;
+#endif
+    RAII_FREE(block);
+}
+
+static void raii_tls_setup(void) {
+    if (tss_create(&raii_tls_tss, raii_tls_delete) != thrd_success)
+        raii_panic("Raii `tss_create` failed!");
+}
+
+static struct raii_tls_s *raii_tls_new(void) {
+    struct raii_tls_s *block;
+
+    call_once(&raii_tls_once, raii_tls_setup);
+    /* not thrown, exception contexts themselves live in slots */
+    if (!is_empty(block = RAII_CALLOC(1, sizeof(struct raii_tls_s)))
+        && tss_set(raii_tls_tss, (void *)block) != thrd_success) {
+        RAII_FREE(block);
+        block = NULL;
+    }
+
+    return block;
+}
+
+/* Current `thread` block, `NULL` if none yet and not `create`, or it can't be allocated. */
+static RAII_INLINE struct raii_tls_s *raii_tls_block(bool create) {
+#ifdef emulate_tls
+    struct raii_tls_s *block;
+    call_once(&raii_tls_once, raii_tls_setup);
+    if (!is_empty(block = (struct raii_tls_s *)tss_get(raii_tls_tss)))
+        return block;
+
+    return create ? raii_tls_new() : NULL;
+#else
+    if (LIKELY(!is_empty(raii_tls_local)) || !create)
+        return raii_tls_local;
+
+    return raii_tls_local = raii_tls_new();
+#endif
+}
+
+int raii_tls_create(raii_tls_t *key, size_t size, func_t dtor) {
+    size_t count, offset = 0;
+
+    raii_tls_locked(true);
+    count = atomic_size_load(&raii_tls_count);
+    if (size > 0)
+        offset = align_up(raii_tls_bytes, 16);
+
+    if (count == RAII_TLS_SLOTS || (size > 0 && (size > RAII_TLS_BYTES || offset > RAII_TLS_BYTES - size))) {
+        raii_tls_locked(false);
+        return thrd_error;
+    }
+
+    raii_tls_slots[count].size = size;
+    raii_tls_slots[count].offset = offset;
+    raii_tls_slots[count].dtor = dtor;
+    if (size > 0)
+        raii_tls_bytes = offset + size;
+
+    *key = (raii_tls_t)count;
+    atomic_size_store(&raii_tls_count, count + 1);
+    raii_tls_locked(false);
+    return thrd_success;
+}
+
+void *raii_tls_get(raii_tls_t key) {
+    struct raii_tls_s *block;
+    if (raii_tls_slots[key].size > 0)
+        return is_empty(block = raii_tls_block(true)) ? NULL : block->data + raii_tls_slots[key].offset;
+
+    return is_empty(block = raii_tls_block(false)) ? NULL : block->value[key];
+}
+
+int raii_tls_set(raii_tls_t key, void *value) {
+    struct raii_tls_s *block;
+    if (raii_tls_slots[key].size > 0)
+        return thrd_error;
+
+    if (is_empty(block = raii_tls_block(true)))
+        return thrd_nomem;
+
+    block->value[key] = value;
+    return thrd_success;
+}
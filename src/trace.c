@@ -0,0 +1,146 @@
+#include "raii.h"
+#if defined(_WIN32)
+    #include <process.h>
+    #define getpid _getpid
+#else
+    #include <unistd.h>
+#endif
+
+typedef struct {
+    uint64_t ts;
+    uint64_t dur;
+    const void *ptr;
+    size_t value;
+    int kind;
+} trace_event_t;
+
+/* Per `thread` ring, oldest events overwritten once full, listed for good once made,
+recycled by later `thread`s, events of exited ones kept till then. */
+typedef struct trace_ring_s trace_ring_t;
+struct trace_ring_s {
+    /* events ever recorded, slot is `head % RAII_TRACE_RING` */
+    size_t head;
+    int tid;
+    volatile int used;
+    trace_ring_t *next;
+    trace_event_t events[RAII_TRACE_RING];
+};
+
+static void *volatile trace_rings = NULL;
+static volatile int trace_tids = 0;
+static raii_tls_t trace_key;
+static once_flag trace_once = ONCE_FLAG_INIT;
+
+static void trace_release(void *arg) {
+    atomic_int_store(&((trace_ring_t *)arg)->used, 0);
+}
+
+static void trace_setup(void) {
+    if (raii_tls_create(&trace_key, 0, trace_release) != thrd_success)
+        raii_panic("Trace `raii_tls_create` failed!");
+}
+
+static trace_ring_t *trace_ring(void) {
+    trace_ring_t *ring;
+    void *head;
+    int unused;
+
+    call_once(&trace_once, trace_setup);
+    if (!is_empty(ring = (trace_ring_t *)raii_tls_get(trace_key)))
+        return ring;
+
+    for (ring = (trace_ring_t *)atomic_ptr_load(&trace_rings); !is_empty(ring); ring = ring->next) {
+        unused = 0;
+        if (atomic_int_load(&ring->used) == 0 && atomic_int_cas(&ring->used, &unused, 1))
+            break;
+    }
+
+    if (is_empty(ring)) {
+        ring = try_calloc(1, sizeof(trace_ring_t));
+        ring->used = 1;
+        ring->tid = atomic_int_add(&trace_tids, 1) + 1;
+        head = atomic_ptr_load(&trace_rings);
+        do {
+            ring->next = (trace_ring_t *)head;
+        } while (!atomic_ptr_cas(&trace_rings, &head, ring));
+    }
+
+    if (raii_tls_set(trace_key, ring) != thrd_success)
+        raii_panic("Trace `raii_tls_set` failed!");
+
+    return ring;
+}
+
+uint64_t raii_trace_now(void) {
+#if defined(_WIN32)
+    LARGE_INTEGER count, frequency;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&count);
+    return (uint64_t)((double)count.QuadPart * 1e9 / (double)frequency.QuadPart);
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+#endif
+}
+
+void raii_trace_event(int kind, const void *ptr, uint64_t start, size_t value) {
+    trace_ring_t *ring = trace_ring();
+    trace_event_t *event = &ring->events[ring->head++ % RAII_TRACE_RING];
+    uint64_t now = raii_trace_now();
+
+    event->kind = kind;
+    event->ptr = ptr;
+    event->value = value;
+    event->ts = start > 0 ? start : now;
+    event->dur = start > 0 ? now - start : 0;
+}
+
+static void trace_write(FILE *out, trace_event_t *event, int pid, int tid) {
+    double ts = (double)event->ts / 1000.0;
+
+    switch (event->kind) {
+        case RAII_TRACE_SCOPE_BEGIN:
+        case RAII_TRACE_SCOPE_END:
+            fprintf(out, "{\"name\":\"scope\",\"cat\":\"scope\",\"ph\":\"%s\",\"id\":\"%p\","
+                    "\"ts\":%.3f,\"pid\":%d,\"tid\":%d}",
+                    event->kind == RAII_TRACE_SCOPE_BEGIN ? "b" : "e", event->ptr, ts, pid, tid);
+            break;
+        case RAII_TRACE_DEFER:
+            fprintf(out, "{\"name\":\"defer %p\",\"cat\":\"defer\",\"ph\":\"X\",\"ts\":%.3f,"
+                    "\"dur\":%.3f,\"pid\":%d,\"tid\":%d,\"args\":{\"func\":\"%p\",\"count\":%zu}}",
+                    event->ptr, ts, (double)event->dur / 1000.0, pid, tid, event->ptr, event->value);
+            break;
+        case RAII_TRACE_CHUNK:
+            fprintf(out, "{\"name\":\"arena chunk\",\"cat\":\"arena\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,"
+                    "\"pid\":%d,\"tid\":%d,\"args\":{\"arena\":\"%p\",\"bytes\":%zu}}",
+                    ts, pid, tid, event->ptr, event->value);
+            break;
+    }
+}
+
+size_t raii_trace_dump(FILE *out) {
+    trace_ring_t *ring;
+    size_t i, first, count = 0;
+    int pid = (int)getpid();
+
+    fputs("{\"traceEvents\":[\n", out);
+    for (ring = (trace_ring_t *)atomic_ptr_load(&trace_rings); !is_empty(ring); ring = ring->next) {
+        first = ring->head > RAII_TRACE_RING ? ring->head - RAII_TRACE_RING : 0;
+        for (i = first; i < ring->head; i++, count++) {
+            if (count > 0)
+                fputs(",\n", out);
+
+            trace_write(out, &ring->events[i % RAII_TRACE_RING], pid, ring->tid);
+        }
+    }
+
+    fputs("\n]}\n", out);
+    return count;
+}
+
+void raii_trace_clear(void) {
+    trace_ring_t *ring;
+    for (ring = (trace_ring_t *)atomic_ptr_load(&trace_rings); !is_empty(ring); ring = ring->next)
+        ring->head = 0;
+}
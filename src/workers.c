@@ -0,0 +1,1380 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+    /* `CPU_SET` and `pthread_setaffinity_np` */
+    #define _GNU_SOURCE
+#endif
+#include "raii.h"
+#if !defined(_WIN32)
+    #include <unistd.h>
+#endif
+#if defined(__linux__)
+    #include <sched.h>
+#endif
+
+typedef struct {
+    func_t func;
+    void *arg;
+    /* `workers_now` at submit */
+    uint64_t queued;
+} worker_task_t;
+
+/* `top` is stolen from, `bottom` pushed/popped only by owner, each on own cache line. */
+typedef struct worker_s {
+    volatile size_t top;
+    char pad0[64 - sizeof(size_t)];
+    volatile size_t bottom;
+    char pad1[64 - sizeof(size_t)];
+    workers_t *pool;
+    thrd_t thread;
+    size_t seed;
+    int index;
+    /* scope of task now running, persistent `frame` for outermost task */
+    unique_t *scope;
+    /* future of task now running, for `workers_checkpoint` */
+    future_t *future;
+    /* group of task now running, for `workers_checkpoint` */
+    workers_group_t *group;
+    /* has coroutine scheduler, by `workers_go` */
+    bool is_sched;
+    /* a coroutine of it's scheduler woken by another `thread`, by `workers_woken` */
+    volatile int woken;
+    unique_frame_t frame;
+    /* `workers_now` at creation, set before worker `thread` starts */
+    uint64_t started;
+    /* has live `thread`, cleared by an elastic pool worker retiring itself */
+    volatile int running;
+    /* a `thread` was started, and not yet joined */
+    bool joinable;
+    /* counters only written by owner, so relaxed load and store, summed by `workers_stats` */
+    volatile size_t completed;
+    volatile size_t busy_ns;
+    volatile size_t wait_ns[WORKERS_LATENCY_BUCKETS];
+    volatile size_t run_ns[WORKERS_LATENCY_BUCKETS];
+    worker_task_t tasks[WORKERS_DEQUE];
+} worker_t;
+
+struct future_s {
+    raii_type type;
+    volatile int done;
+    volatile int cancelled;
+    /* `workers_now` deadline, `0` if none */
+    uint64_t deadline;
+    workers_t *pool;
+    raii_func_t func;
+    args_t *args;
+    void *result;
+    /* captured exception, `ex` is `NULL` if none */
+    const char *ex;
+    const char *panic;
+    const char *file;
+    const char *function;
+    int line;
+    mtx_t mutex[1];
+    cnd_t ready[1];
+};
+
+struct workers_group_s {
+    raii_type type;
+    volatile int cancelled;
+    workers_t *pool;
+    memory_t *scope;
+    /* tasks spawned, not yet finished */
+    volatile size_t remaining;
+    /* first captured exception, `ex` is `NULL` if none */
+    void *volatile ex;
+    const char *panic;
+    const char *file;
+    const char *function;
+    int line;
+    mtx_t mutex[1];
+    cnd_t done[1];
+};
+
+struct workers_s {
+    worker_t **workers;
+    /* worker slots made so far, retired ones included, at most `max` */
+    volatile int count;
+    /* workers with live `thread`, elastic pools keep it within `[min, max]` */
+    volatile int live;
+    int min;
+    int max;
+    /* idle milliseconds before an elastic pool worker above `min` retires, `0` never */
+    unsigned int idle_ms;
+    volatile int shutdown;
+    volatile int sleeping;
+    /* submitted, not yet taken by any worker */
+    volatile size_t pending;
+    /* submitted, not yet finished */
+    volatile size_t unfinished;
+    volatile size_t peak;
+    volatile size_t rejected;
+    mtx_t lock[1];
+    cnd_t wake[1];
+    cnd_t done[1];
+    /* shared injection queue, a growable ring */
+    raii_fastlock_t inject_lock[1];
+    worker_task_t *inject;
+    size_t inject_head;
+    size_t inject_count;
+    size_t inject_cap;
+    /* CPU ids workers are restricted to, `cpu_count` of `0` for no placement */
+    int *cpus;
+    int cpu_count;
+    bool pin_each;
+};
+
+#ifdef emulate_tls
+static raii_tls_t workers_self_key = 0;
+static once_flag workers_self_once = ONCE_FLAG_INIT;
+
+static void workers_self_setup(void) {
+    if (raii_tls_create(&workers_self_key, 0, NULL) != thrd_success)
+        raii_panic("Workers `raii_tls_create` failed!");
+}
+#else
+static thread_local worker_t *workers_self = NULL;
+#endif
+
+static RAII_INLINE worker_t *workers_self_get(void) {
+#ifdef emulate_tls
+    call_once(&workers_self_once, workers_self_setup);
+    return (worker_t *)raii_tls_get(workers_self_key);
+#else
+    return workers_self;
+#endif
+}
+
+static void workers_self_set(worker_t *self) {
+#ifdef emulate_tls
+    if (raii_tls_set(workers_self_key, (void *)self) != thrd_success)
+        raii_panic("Workers `raii_tls_set` failed!");
+#else
+    workers_self = self;
+#endif
+}
+
+static int workers_cpus(void) {
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+#else
+    return 1;
+#endif
+}
+
+/* Monotonic nanoseconds, for task latency counters, 64-bit as `size_t` would wrap
+every few seconds on 32-bit targets. */
+static uint64_t workers_now(void) {
+#if defined(_WIN32)
+    LARGE_INTEGER count, frequency;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&count);
+    return (uint64_t)((double)count.QuadPart * 1e9 / (double)frequency.QuadPart);
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+#endif
+}
+
+/* Owner only counter update, no locked `add`, readers see some recent value. */
+static RAII_INLINE void workers_tally(volatile size_t *counter, size_t value) {
+    atomic_size_store_relaxed(counter, atomic_size_load_relaxed(counter) + value);
+}
+
+/* Histogram slot of `ns`, bucket `i` counts durations below `2^(i + 1)` nanoseconds. */
+static RAII_INLINE int workers_bucket(size_t ns) {
+    int bucket = 0;
+    while (ns > 1 && bucket < WORKERS_LATENCY_BUCKETS - 1) {
+        ns >>= 1;
+        bucket++;
+    }
+
+    return bucket;
+}
+
+static void workers_peak(workers_t *pool, size_t depth) {
+    size_t peak = atomic_size_load(&pool->peak);
+    while (depth > peak && !atomic_size_cas(&pool->peak, &peak, depth));
+}
+
+static int workers_reject(workers_t *pool, int status) {
+    atomic_size_add(&pool->rejected, 1);
+    return status;
+}
+
+/* Restrict calling worker to pool's CPU set, or it's single CPU with `pin_each`,
+before it touches any memory, so arena and allocator pages are first faulted node local. */
+static void worker_affinity(worker_t *self) {
+    workers_t *pool = self->pool;
+    int i;
+#if defined(__linux__)
+    cpu_set_t set;
+#elif defined(_WIN32)
+    DWORD_PTR mask = 0;
+#endif
+
+    if (pool->cpu_count == 0)
+        return;
+
+#if defined(__linux__)
+    CPU_ZERO(&set);
+    for (i = 0; i < pool->cpu_count; i++) {
+        if ((!pool->pin_each || i == self->index % pool->cpu_count)
+            && pool->cpus[i] >= 0 && pool->cpus[i] < CPU_SETSIZE)
+            CPU_SET(pool->cpus[i], &set);
+    }
+
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set) != 0)
+        RAII_LOG("Workers `pthread_setaffinity_np` failed!");
+#elif defined(_WIN32)
+    for (i = 0; i < pool->cpu_count; i++) {
+        if ((!pool->pin_each || i == self->index % pool->cpu_count) && pool->cpus[i] < (int)(sizeof(DWORD_PTR) * 8))
+            mask |= (DWORD_PTR)1 << pool->cpus[i];
+    }
+
+    if (SetThreadAffinityMask(GetCurrentThread(), mask) == 0)
+        RAII_LOG("Workers `SetThreadAffinityMask` failed!");
+#else
+    (void)i;
+#endif
+}
+
+/* Owner only, `false` when deque is full. */
+static bool worker_push(worker_t *self, worker_task_t *task) {
+    size_t b = atomic_size_load(&self->bottom);
+    if (b - atomic_size_load(&self->top) >= WORKERS_DEQUE)
+        return false;
+
+    self->tasks[b & (WORKERS_DEQUE - 1)] = *task;
+    atomic_size_store(&self->bottom, b + 1);
+    return true;
+}
+
+/* Owner only, takes newest task, races thieves only for the last one. */
+static bool worker_pop(worker_t *self, worker_task_t *task) {
+    size_t t, b = atomic_size_load(&self->bottom) - 1;
+    bool taken = true;
+
+    atomic_size_store(&self->bottom, b);
+    t = atomic_size_load(&self->top);
+    if (t > b) {
+        atomic_size_store(&self->bottom, b + 1);
+        return false;
+    }
+
+    *task = self->tasks[b & (WORKERS_DEQUE - 1)];
+    if (t == b) {
+        taken = atomic_size_cas(&self->top, &t, t + 1);
+        atomic_size_store(&self->bottom, b + 1);
+    }
+
+    return taken;
+}
+
+/* Any thread, takes oldest task. */
+static bool worker_steal(worker_t *victim, worker_task_t *task) {
+    size_t t = atomic_size_load(&victim->top);
+    if (t >= atomic_size_load(&victim->bottom))
+        return false;
+
+    *task = victim->tasks[t & (WORKERS_DEQUE - 1)];
+    return atomic_size_cas(&victim->top, &t, t + 1);
+}
+
+/* Grow injection ring to fit `extra` more tasks, `inject_lock` must be held. */
+static void workers_inject_reserve(workers_t *pool, size_t extra) {
+    worker_task_t *ring;
+    size_t i, cap;
+
+    if (pool->inject_count + extra <= pool->inject_cap)
+        return;
+
+    cap = MAX(pool->inject_cap * 2, WORKERS_DEQUE);
+    while (cap < pool->inject_count + extra)
+        cap *= 2;
+
+    ring = try_calloc((int)cap, sizeof(worker_task_t));
+    for (i = 0; i < pool->inject_count; i++)
+        ring[i] = pool->inject[(pool->inject_head + i) % pool->inject_cap];
+
+    RAII_FREE(pool->inject);
+    pool->inject = ring;
+    pool->inject_head = 0;
+    pool->inject_cap = cap;
+}
+
+static void workers_inject(workers_t *pool, worker_task_t *task) {
+    raii_fastlock_lock(pool->inject_lock);
+    workers_inject_reserve(pool, 1);
+    pool->inject[(pool->inject_head + pool->inject_count++) % pool->inject_cap] = *task;
+    raii_fastlock_unlock(pool->inject_lock);
+}
+
+static bool workers_injected(workers_t *pool, worker_task_t *task) {
+    bool taken = false;
+    raii_fastlock_lock(pool->inject_lock);
+    if (pool->inject_count > 0) {
+        *task = pool->inject[pool->inject_head];
+        pool->inject_head = (pool->inject_head + 1) % pool->inject_cap;
+        pool->inject_count--;
+        taken = true;
+    }
+    raii_fastlock_unlock(pool->inject_lock);
+
+    return taken;
+}
+
+/* Shared queue first, then every other worker, starting at an random victim. */
+static bool workers_take(workers_t *pool, worker_t *self, worker_task_t *task) {
+    int i, victim, count;
+
+    if (workers_injected(pool, task))
+        return true;
+
+    /* retired workers left empty deques, stealing from them just fails */
+    count = atomic_int_load(&pool->count);
+    self->seed ^= self->seed << 13;
+    self->seed ^= self->seed >> 7;
+    self->seed ^= self->seed << 17;
+    victim = (int)(self->seed % (size_t)count);
+    for (i = 0; i < count; i++, victim = (victim + 1) % count) {
+        if (victim != self->index && worker_steal(pool->workers[victim], task))
+            return true;
+    }
+
+    return false;
+}
+
+static void workers_wakeup(workers_t *pool) {
+    if (atomic_int_load(&pool->sleeping) > 0) {
+        mtx_lock(pool->lock);
+        cnd_signal(pool->wake);
+        mtx_unlock(pool->lock);
+    }
+}
+
+/* Elastic pool worker idle past `idle_ms`, leaves if pool stays above `min`,
+it's deque is empty, and no coroutine of it's scheduler is suspended. `lock` must be held. */
+static bool workers_retire(workers_t *pool, worker_t *self) {
+    if (atomic_int_load(&pool->live) <= pool->min || !is_zero(atomic_size_load(&pool->pending))
+        || (self->is_sched && sched_count() > 0))
+        return false;
+
+    atomic_int_add(&pool->live, -1);
+    atomic_int_store(&self->running, 0);
+    return true;
+}
+
+/* Sleep until work is pending, `false` once shutdown and nothing left,
+or this worker retired. */
+static bool workers_idle(workers_t *pool, worker_t *self) {
+    struct timespec deadline;
+    bool running, retired = false;
+
+    mtx_lock(pool->lock);
+    atomic_int_add(&pool->sleeping, 1);
+    if (pool->idle_ms > 0)
+        deadline = time_deadline(pool->idle_ms);
+
+    while (is_zero(atomic_size_load(&pool->pending)) && !atomic_int_load(&pool->shutdown)
+           && !atomic_int_load(&self->woken)) {
+        if (pool->idle_ms == 0) {
+            cnd_wait(pool->wake, pool->lock);
+        } else if (cnd_timedwait(pool->wake, pool->lock, &deadline) == thrd_timedout) {
+            if ((retired = workers_retire(pool, self)))
+                break;
+
+            deadline = time_deadline(pool->idle_ms);
+        }
+    }
+
+    atomic_int_add(&pool->sleeping, -1);
+    running = !retired && (!is_zero(atomic_size_load(&pool->pending)) || !atomic_int_load(&pool->shutdown)
+        || atomic_int_load(&self->woken));
+    mtx_unlock(pool->lock);
+
+    return running;
+}
+
+static int workers_guarded(unique_t *scope, worker_task_t *task)
+guard_by(scope) {
+    task->func(task->arg);
+} unguarded(0);
+
+/* Outermost task reuses worker's own scope, `arena` is cleared, not freed,
+tasks started while waiting, by `workers_yield`, get an `stack` scope instead. */
+static void workers_execute(workers_t *pool, worker_t *self, worker_task_t *task) {
+    unique_t *outer = self->scope;
+    /* plain tasks, run by a waiting future task, must not see it's cancellation */
+    future_t *future = self->future;
+    workers_group_t *group = self->group;
+    unique_frame_t frame;
+    uint64_t start = workers_now();
+    size_t run;
+#ifdef RAII_THREAD_STATE
+    unique_t *thrd = raii_thread.thrd;
+#endif
+
+    workers_tally(&self->wait_ns[workers_bucket((size_t)(start - task->queued))], 1);
+    self->future = NULL;
+    self->group = NULL;
+    self->scope = is_empty(outer) ? &self->frame.scope : unique_local(&frame);
+#ifdef RAII_THREAD_STATE
+    raii_thread.thrd = self->scope;
+#endif
+    try {
+        workers_guarded(self->scope, task);
+    } catch_any {
+    } end_trying;
+
+    run = (size_t)(workers_now() - start);
+    workers_tally(&self->run_ns[workers_bucket(run)], 1);
+    workers_tally(&self->completed, 1);
+    /* nested tasks already counted in waiting task's time */
+    if (is_empty(outer))
+        workers_tally(&self->busy_ns, run);
+
+    if (is_empty(outer)) {
+        arena_reset((arena_t)self->scope->arena);
+        if (!is_type(&self->scope->defer, RAII_DEF_ARR)
+            && UNLIKELY(raii_deferred_init(&self->scope->defer) < 0))
+            raii_panic("Deferred initialization failed!");
+
+        self->scope->status = 0;
+        self->scope->err = NULL;
+        self->scope->panic = NULL;
+        self->scope->is_recovered = false;
+    }
+
+    self->scope = outer;
+    self->future = future;
+    self->group = group;
+#ifdef RAII_THREAD_STATE
+    raii_thread.thrd = thrd;
+#endif
+
+    if (atomic_size_sub(&pool->unfinished, 1) == 1) {
+        mtx_lock(pool->lock);
+        cnd_broadcast(pool->done);
+        mtx_unlock(pool->lock);
+    }
+}
+
+/* Scheduler waker, coroutine of worker's `thread` woken, leaves `workers_idle`. */
+static void workers_woken(void *arg) {
+    worker_t *self = (worker_t *)arg;
+
+    mtx_lock(self->pool->lock);
+    atomic_int_store(&self->woken, 1);
+    cnd_broadcast(self->pool->wake);
+    mtx_unlock(self->pool->lock);
+}
+
+static int workers_main(void *arg) {
+    worker_t *self = (worker_t *)arg;
+    workers_t *pool = self->pool;
+    worker_task_t task;
+
+    worker_affinity(self);
+    /* chunks other nodes released would be remote memory */
+    if (pool->cpu_count > 0)
+        arena_thread_bind();
+
+    unique_local(&self->frame);
+    self->frame.scope.arena = (void *)arena_init(0);
+    self->frame.scope.is_arena = true;
+    workers_self_set(self);
+    do {
+        atomic_int_store(&self->woken, 0);
+        while (worker_pop(self, &task) || workers_take(pool, self, &task)) {
+            atomic_size_sub(&pool->pending, 1);
+            workers_execute(pool, self, &task);
+            /* coroutines made, or resumed, by that task */
+            if (self->is_sched)
+                sched_run();
+        }
+
+        if (self->is_sched)
+            sched_run();
+
+        /* objects tasks retired, safe by now, before sleeping on them */
+        ebr_flush();
+    } while (workers_idle(pool, self));
+
+    /* coroutines still suspended at shutdown are left as they are */
+    if (self->is_sched && sched_count() == 0)
+        sched_free();
+
+    workers_self_set(NULL);
+    raii_delete(&self->frame.scope);
+    return 0;
+}
+
+static worker_t *worker_new(workers_t *pool, int i) {
+    worker_t *self = pool->workers[i] = try_calloc(1, sizeof(worker_t));
+    /* `bottom - 1` on an empty deque must not wrap below `top` */
+    self->top = self->bottom = 1;
+    self->pool = pool;
+    self->index = i;
+    self->seed = (size_t)i * 2654435761u + 1;
+    return self;
+}
+
+static void worker_start(worker_t *self) {
+    self->started = workers_now();
+    /* retired one freed it's scheduler */
+    self->is_sched = false;
+    atomic_int_store(&self->running, 1);
+    atomic_int_add(&self->pool->live, 1);
+    if (thrd_create(&self->thread, workers_main, self) != thrd_success)
+        raii_panic("Workers `thrd_create` failed!");
+
+    self->joinable = true;
+}
+
+/* Queue outgrew workers, all busy, start one more, reusing a retired slot first. */
+static void workers_grow(workers_t *pool) {
+    worker_t *self = NULL;
+    int i;
+
+    mtx_lock(pool->lock);
+    if (atomic_int_load(&pool->live) < pool->max && !atomic_int_load(&pool->shutdown)) {
+        for (i = 0; i < pool->count && is_empty(self); i++) {
+            if (!atomic_int_load(&pool->workers[i]->running))
+                self = pool->workers[i];
+        }
+
+        if (is_empty(self)) {
+            self = worker_new(pool, pool->count);
+            atomic_int_store(&pool->count, pool->count + 1);
+        } else if (self->joinable) {
+            /* retired, it's `thread` done, or about to be */
+            thrd_join(self->thread, NULL);
+            self->joinable = false;
+        }
+
+        worker_start(self);
+    }
+    mtx_unlock(pool->lock);
+}
+
+/* Elastic pools only, nobody idle and more queued than workers to run it. */
+static RAII_INLINE void workers_demand(workers_t *pool) {
+    int live;
+    if (pool->max > pool->min && is_zero(atomic_int_load(&pool->sleeping))
+        && (live = atomic_int_load(&pool->live)) < pool->max
+        && atomic_size_load(&pool->pending) > (size_t)live)
+        workers_grow(pool);
+}
+
+workers_t *workers_create_by(const workers_config_t *config) {
+    workers_t *pool = try_calloc(1, sizeof(workers_t));
+    int i, count = config->count;
+
+#ifdef emulate_tls
+    call_once(&workers_self_once, workers_self_setup);
+#endif
+
+    if (config->cpu_count > 0 && !is_empty((void *)config->cpus)) {
+        pool->cpus = try_calloc(config->cpu_count, sizeof(int));
+        memcpy(pool->cpus, config->cpus, config->cpu_count * sizeof(int));
+        pool->cpu_count = config->cpu_count;
+        pool->pin_each = config->pin_each;
+    }
+
+    if (count <= 0)
+        count = pool->cpu_count > 0 ? pool->cpu_count : workers_cpus();
+
+    if (mtx_init(pool->lock, mtx_plain) != thrd_success
+        || raii_fastlock_init(pool->inject_lock) != thrd_success
+        || cnd_init(pool->wake) != thrd_success
+        || cnd_init(pool->done) != thrd_success)
+        raii_panic("Workers `mtx_init/cnd_init` failed!");
+
+    raii_lock_name(pool->lock, "workers");
+    raii_lock_name(pool->inject_lock, "workers_inject");
+    pool->min = count;
+    pool->max = MAX(config->max, count);
+    pool->idle_ms = pool->max > count ? config->idle_ms : 0;
+    pool->workers = try_calloc(pool->max, sizeof(worker_t *));
+    for (i = 0; i < count; i++)
+        worker_new(pool, i);
+
+    pool->count = count;
+    for (i = 0; i < count; i++)
+        worker_start(pool->workers[i]);
+
+    return pool;
+}
+
+workers_t *workers_create(int count) {
+    workers_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.count = count;
+    return workers_create_by(&config);
+}
+
+#if defined(__linux__)
+/* Parse `sysfs` CPU list format, as in `0-3,8,10-11`, `highest` id seen if not `NULL`. */
+static int workers_cpulist(const char *path, int *cpus, int max, int *highest) {
+    FILE *file = fopen(path, "r");
+    int first, last, found = 0;
+    char sep;
+
+    if (is_empty(file))
+        return 0;
+
+    while (fscanf(file, "%d", &first) == 1) {
+        last = first;
+        if (fscanf(file, "%c", &sep) == 1 && sep == '-') {
+            if (fscanf(file, "%d", &last) != 1)
+                break;
+            if (fscanf(file, "%c", &sep) != 1)
+                sep = '\n';
+        }
+
+        if (!is_empty(highest) && last > *highest)
+            *highest = last;
+
+        for (; first <= last; first++, found++) {
+            if (found < max)
+                cpus[found] = first;
+        }
+
+        if (sep != ',')
+            break;
+    }
+
+    fclose(file);
+    return found;
+}
+#endif
+
+int workers_numa_nodes(void) {
+#if defined(__linux__)
+    /* node ids can be sparse, as in `0,2`, ones in between have no CPUs */
+    int highest = -1;
+    workers_cpulist("/sys/devices/system/node/online", NULL, 0, &highest);
+    return highest >= 0 ? highest + 1 : 1;
+#elif defined(_WIN32)
+    ULONG highest = 0;
+    return GetNumaHighestNodeNumber(&highest) ? (int)highest + 1 : 1;
+#else
+    return 1;
+#endif
+}
+
+int workers_numa_cpus(int node, int *cpus, int max) {
+    int i, found = 0;
+#if defined(__linux__)
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    if ((found = workers_cpulist(path, cpus, max, NULL)) > 0 || node > 0)
+        return found;
+#elif defined(_WIN32)
+    ULONGLONG mask = 0;
+    if (GetNumaNodeProcessorMask((UCHAR)node, &mask)) {
+        for (i = 0; i < (int)(sizeof(mask) * 8); i++) {
+            if (mask & ((ULONGLONG)1 << i)) {
+                if (found < max)
+                    cpus[found] = i;
+                found++;
+            }
+        }
+
+        return found;
+    }
+
+    if (node > 0)
+        return 0;
+#else
+    if (node > 0)
+        return 0;
+#endif
+
+    /* no topology available, node `0` has every CPU */
+    found = workers_cpus();
+    for (i = 0; i < found && i < max; i++)
+        cpus[i] = i;
+
+    return found;
+}
+
+int workers_create_numa(workers_t **pools, int max) {
+    workers_config_t config;
+    int node, nodes = workers_numa_nodes(), created = 0;
+
+    memset(&config, 0, sizeof(config));
+    for (node = 0; node < nodes && created < max; node++) {
+        if ((config.cpu_count = workers_numa_cpus(node, NULL, 0)) == 0)
+            continue;
+
+        config.cpus = try_calloc(config.cpu_count, sizeof(int));
+        workers_numa_cpus(node, (int *)config.cpus, config.cpu_count);
+        pools[created++] = workers_create_by(&config);
+        RAII_FREE((void *)config.cpus);
+    }
+
+    return created;
+}
+
+int workers_submit(workers_t *pool, func_t func, void *arg) {
+    worker_t *self = workers_self_get();
+    worker_task_t task;
+
+    if (UNLIKELY(is_empty(pool)))
+        return pool_invalid;
+
+    if (UNLIKELY(func == NULL))
+        return workers_reject(pool, pool_invalid);
+
+    if (atomic_int_load(&pool->shutdown) && (is_empty(self) || self->pool != pool))
+        return workers_reject(pool, pool_shutdown);
+
+    task.func = func;
+    task.arg = arg;
+    task.queued = workers_now();
+    atomic_size_add(&pool->unfinished, 1);
+    if (is_empty(self) || self->pool != pool || !worker_push(self, &task))
+        workers_inject(pool, &task);
+
+    workers_peak(pool, atomic_size_add(&pool->pending, 1) + 1);
+    workers_wakeup(pool);
+    workers_demand(pool);
+    return 0;
+}
+
+int workers_submit_batch(workers_t *pool, func_t func, void **args, size_t count) {
+    worker_t *self = workers_self_get();
+    worker_task_t task;
+    size_t i = 0;
+    bool local;
+
+    if (UNLIKELY(is_empty(pool)))
+        return pool_invalid;
+
+    if (UNLIKELY(func == NULL || (count > 0 && args == NULL)))
+        return workers_reject(pool, pool_invalid);
+
+    local = !is_empty(self) && self->pool == pool;
+    if (atomic_int_load(&pool->shutdown) && !local)
+        return workers_reject(pool, pool_shutdown);
+
+    if (count == 0)
+        return 0;
+
+    task.func = func;
+    task.queued = workers_now();
+    atomic_size_add(&pool->unfinished, count);
+    if (local) {
+        for (; i < count; i++) {
+            task.arg = args[i];
+            if (!worker_push(self, &task))
+                break;
+        }
+    }
+
+    if (i < count) {
+        raii_fastlock_lock(pool->inject_lock);
+        workers_inject_reserve(pool, count - i);
+        for (; i < count; i++) {
+            task.arg = args[i];
+            pool->inject[(pool->inject_head + pool->inject_count++) % pool->inject_cap] = task;
+        }
+        raii_fastlock_unlock(pool->inject_lock);
+    }
+
+    workers_peak(pool, atomic_size_add(&pool->pending, count) + count);
+    if (atomic_int_load(&pool->sleeping) > 0) {
+        mtx_lock(pool->lock);
+        if (count == 1)
+            cnd_signal(pool->wake);
+        else
+            cnd_broadcast(pool->wake);
+        mtx_unlock(pool->lock);
+    }
+
+    workers_demand(pool);
+    return 0;
+}
+
+void workers_wait(workers_t *pool) {
+    mtx_lock(pool->lock);
+    while (!is_zero(atomic_size_load(&pool->unfinished)))
+        cnd_wait(pool->done, pool->lock);
+    mtx_unlock(pool->lock);
+}
+
+void workers_destroy(workers_t *pool) {
+    int i;
+    if (is_empty(pool))
+        return;
+
+    workers_wait(pool);
+    mtx_lock(pool->lock);
+    atomic_int_store(&pool->shutdown, 1);
+    cnd_broadcast(pool->wake);
+    mtx_unlock(pool->lock);
+
+    /* all joined first, stopping workers may still try stealing from others */
+    for (i = 0; i < pool->count; i++) {
+        if (pool->workers[i]->joinable)
+            thrd_join(pool->workers[i]->thread, NULL);
+    }
+
+    for (i = 0; i < pool->count; i++)
+        RAII_FREE(pool->workers[i]);
+
+    mtx_destroy(pool->lock);
+    raii_fastlock_destroy(pool->inject_lock);
+    cnd_destroy(pool->wake);
+    cnd_destroy(pool->done);
+    RAII_FREE(pool->inject);
+    RAII_FREE(pool->cpus);
+    RAII_FREE(pool->workers);
+    RAII_FREE(pool);
+}
+
+workers_t *workers_current(void) {
+    worker_t *self = workers_self_get();
+    return is_empty(self) ? NULL : self->pool;
+}
+
+size_t workers_defer(func_t func, void *arg) {
+    if (is_empty(workers_self_get()))
+        raii_panic("Failed! `workers_defer` outside of pool task");
+
+    return raii_deferred((memory_t *)raii_init()->arena, func, arg);
+}
+
+RAII_INLINE unique_t *workers_scope(void) {
+    worker_t *self = workers_self_get();
+    return is_empty(self) ? NULL : self->scope;
+}
+
+int workers_stats(workers_t *pool, workers_stats_t *stats, workers_worker_stats_t *workers, int max) {
+    uint64_t now = workers_now();
+    worker_t *worker;
+    int i, j;
+
+    memset(stats, 0, sizeof(workers_stats_t));
+    stats->count = atomic_int_load(&pool->live);
+    stats->queued = atomic_size_load(&pool->pending);
+    stats->peak = atomic_size_load(&pool->peak);
+    stats->rejected = atomic_size_load(&pool->rejected);
+    for (i = 0; i < pool->count; i++) {
+        worker = pool->workers[i];
+        stats->completed += atomic_size_load_relaxed(&worker->completed);
+        for (j = 0; j < WORKERS_LATENCY_BUCKETS; j++) {
+            stats->wait_ns[j] += atomic_size_load_relaxed(&worker->wait_ns[j]);
+            stats->run_ns[j] += atomic_size_load_relaxed(&worker->run_ns[j]);
+        }
+
+        if (i < max && !is_empty(workers)) {
+            workers[i].completed = atomic_size_load_relaxed(&worker->completed);
+            workers[i].busy_ns = atomic_size_load_relaxed(&worker->busy_ns);
+            workers[i].idle_ns = now - worker->started < (uint64_t)workers[i].busy_ns
+                ? 0 : (size_t)(now - worker->started - workers[i].busy_ns);
+        }
+    }
+
+    stats->submitted = stats->completed + atomic_size_load(&pool->unfinished);
+    return pool->count < max ? pool->count : max;
+}
+
+size_t workers_percentile(const size_t *histogram, double percent) {
+    size_t total = 0, seen = 0;
+    int i;
+
+    for (i = 0; i < WORKERS_LATENCY_BUCKETS; i++)
+        total += histogram[i];
+
+    for (i = 0; i < WORKERS_LATENCY_BUCKETS; i++) {
+        seen += histogram[i];
+        if (total > 0 && (double)seen >= (double)total * percent / 100.0)
+            return (size_t)2 << i;
+    }
+
+    return 0;
+}
+
+RAII_INLINE int workers_count(workers_t *pool) {
+    return atomic_int_load(&pool->live);
+}
+
+bool workers_yield(workers_t *pool) {
+    worker_t *self = workers_self_get();
+    worker_task_t task;
+
+    if (is_empty(self) || self->pool != pool)
+        return false;
+
+    if (worker_pop(self, &task) || workers_take(pool, self, &task)) {
+        atomic_size_sub(&pool->pending, 1);
+        workers_execute(pool, self, &task);
+        return true;
+    }
+
+    return false;
+}
+
+static bool future_abandoned(future_t *future) {
+    return atomic_int_load(&future->cancelled)
+        || (future->deadline > 0 && workers_now() >= future->deadline);
+}
+
+/* Task's own `workers_defer` cleanup unwinds here, before future is signalled ready. */
+static int future_guarded(future_t *future)
+guard_local {
+    future->result = future->func(future->args);
+} unguarded(0);
+
+static void future_execute(void *arg) {
+    future_t *future = (future_t *)arg;
+    workers_self_get()->future = future;
+    try {
+        /* cancelled, or timed out, while still queued */
+        if (future_abandoned(future))
+            throw(task_cancelled);
+
+        future_guarded(future);
+    } catch_any {
+        future->ex = ex_err.ex;
+        future->panic = ex_err.panic;
+        future->file = ex_err.file;
+        future->function = ex_err.function;
+        future->line = ex_err.line;
+    } end_trying;
+
+    mtx_lock(future->mutex);
+    atomic_int_store(&future->done, 1);
+    cnd_broadcast(future->ready);
+    mtx_unlock(future->mutex);
+}
+
+static future_t *future_submit(workers_t *pool, raii_func_t fn, args_t *args, uint64_t deadline) {
+    future_t *future = try_calloc(1, sizeof(future_t));
+    if (mtx_init(future->mutex, mtx_plain) != thrd_success || cnd_init(future->ready) != thrd_success)
+        raii_panic("Future `mtx_init/cnd_init` failed!");
+
+    future->type = RAII_FUTURE;
+    future->pool = pool;
+    future->func = fn;
+    future->args = args;
+    future->deadline = deadline;
+    if (workers_submit(pool, future_execute, future) != 0) {
+        mtx_destroy(future->mutex);
+        cnd_destroy(future->ready);
+        RAII_FREE(future);
+        raii_panic("Failed! `thrd_async` pool invalid or shutdown");
+    }
+
+    return future;
+}
+
+RAII_INLINE future_t *thrd_async(workers_t *pool, raii_func_t fn, args_t *args) {
+    return future_submit(pool, fn, args, 0);
+}
+
+RAII_INLINE future_t *thrd_async_for(workers_t *pool, raii_func_t fn, args_t *args, unsigned int ms) {
+    return future_submit(pool, fn, args, workers_now() + (uint64_t)ms * 1000000u);
+}
+
+bool future_cancel(future_t *future) {
+    if (is_empty(future) || !is_type(future, RAII_FUTURE) || future_is_ready(future))
+        return false;
+
+    atomic_int_store(&future->cancelled, 1);
+    return true;
+}
+
+bool workers_cancelled(void) {
+    worker_t *self = workers_self_get();
+    if (is_empty(self))
+        return false;
+
+    return (!is_empty(self->future) && future_abandoned(self->future))
+        || (!is_empty(self->group) && atomic_int_load(&self->group->cancelled));
+}
+
+void workers_checkpoint(void) {
+    if (workers_cancelled())
+        throw(task_cancelled);
+
+    timer_run();
+}
+
+RAII_INLINE bool future_is_ready(future_t *future) {
+    return atomic_int_load(&future->done) != 0;
+}
+
+bool future_wait_for(future_t *future, unsigned int ms) {
+    struct timespec deadline = time_deadline(ms);
+
+    if (workers_current() == future->pool) {
+        while (!future_is_ready(future) && !time_expired(&deadline)) {
+            if (!workers_yield(future->pool))
+                thrd_yield();
+        }
+
+        return future_is_ready(future);
+    }
+
+    mtx_lock(future->mutex);
+    while (!future_is_ready(future)) {
+        if (cnd_timedwait(future->ready, future->mutex, &deadline) == thrd_timedout)
+            break;
+    }
+    mtx_unlock(future->mutex);
+
+    return future_is_ready(future);
+}
+
+static void future_wait(future_t *future) {
+    if (workers_current() == future->pool) {
+        while (!future_is_ready(future)) {
+            if (!workers_yield(future->pool))
+                thrd_yield();
+        }
+
+        return;
+    }
+
+    mtx_lock(future->mutex);
+    while (!future_is_ready(future))
+        cnd_wait(future->ready, future->mutex);
+    mtx_unlock(future->mutex);
+}
+
+void future_free(future_t *future) {
+    if (is_empty(future) || !is_type(future, RAII_FUTURE))
+        return;
+
+    future_wait(future);
+    /* task may still be inside `future_execute` signalling section */
+    mtx_lock(future->mutex);
+    mtx_unlock(future->mutex);
+    future->type = RAII_NULL;
+    mtx_destroy(future->mutex);
+    cnd_destroy(future->ready);
+    RAII_FREE(future);
+}
+
+void *future_get(future_t *future) {
+    const char *ex, *panic, *file, *function;
+    void *result;
+    int line;
+
+    if (UNLIKELY(is_empty(future) || !is_type(future, RAII_FUTURE)))
+        raii_panic("Failed! `future_get` invalid future");
+
+    future_wait(future);
+    result = future->result;
+    ex = future->ex;
+    panic = future->panic;
+    file = future->file;
+    function = future->function;
+    line = future->line;
+    future_free(future);
+
+    if (!is_empty((void *)ex))
+        ex_throw(ex, file, line, function, panic);
+
+    return result;
+}
+
+typedef struct {
+    workers_for_func func;
+    void *arg;
+    volatile size_t remaining;
+    /* first captured exception, `ex` is `NULL` if none */
+    void *volatile ex;
+    const char *panic;
+    const char *file;
+    const char *function;
+    int line;
+    mtx_t mutex[1];
+    cnd_t done[1];
+} workers_range_t;
+
+typedef struct {
+    workers_range_t *range;
+    size_t begin;
+    size_t end;
+} workers_chunk_t;
+
+static void workers_for_execute(void *arg) {
+    workers_chunk_t *chunk = (workers_chunk_t *)arg;
+    workers_range_t *range = chunk->range;
+    void *none = NULL;
+
+    try {
+        range->func(chunk->begin, chunk->end, range->arg);
+    } catch_any {
+        if (atomic_ptr_cas(&range->ex, &none, (void *)ex_err.ex)) {
+            range->panic = ex_err.panic;
+            range->file = ex_err.file;
+            range->function = ex_err.function;
+            range->line = ex_err.line;
+        }
+    } end_trying;
+
+    if (atomic_size_sub(&range->remaining, 1) == 1) {
+        mtx_lock(range->mutex);
+        cnd_broadcast(range->done);
+        mtx_unlock(range->mutex);
+    }
+}
+
+void workers_for(workers_t *pool, size_t begin, size_t end, size_t grain, workers_for_func fn, void *arg) {
+    workers_range_t range;
+    workers_chunk_t *chunks;
+    void **args;
+    size_t i, count;
+
+    if (UNLIKELY(is_empty(pool) || fn == NULL))
+        raii_panic("Failed! `workers_for` invalid pool or function");
+
+    if (end <= begin)
+        return;
+
+    if (grain == 0)
+        grain = MAX((end - begin) / ((size_t)pool->count * 4), 1);
+
+    count = (end - begin + grain - 1) / grain;
+    chunks = try_calloc((int)count, sizeof(workers_chunk_t));
+    args = try_calloc((int)count, sizeof(void *));
+    memset(&range, 0, sizeof(range));
+    range.func = fn;
+    range.arg = arg;
+    range.remaining = count;
+    if (mtx_init(range.mutex, mtx_plain) != thrd_success || cnd_init(range.done) != thrd_success)
+        raii_panic("Workers `mtx_init/cnd_init` failed!");
+
+    for (i = 0; i < count; i++) {
+        chunks[i].range = &range;
+        chunks[i].begin = begin + i * grain;
+        chunks[i].end = MIN(chunks[i].begin + grain, end);
+        args[i] = &chunks[i];
+    }
+
+    if (workers_submit_batch(pool, workers_for_execute, args, count) != 0) {
+        mtx_destroy(range.mutex);
+        cnd_destroy(range.done);
+        RAII_FREE(chunks);
+        RAII_FREE(args);
+        raii_panic("Failed! `workers_for` pool shutdown");
+    }
+
+    if (workers_current() == pool) {
+        while (!is_zero(atomic_size_load(&range.remaining))) {
+            if (!workers_yield(pool))
+                thrd_yield();
+        }
+    }
+
+    mtx_lock(range.mutex);
+    while (!is_zero(atomic_size_load(&range.remaining)))
+        cnd_wait(range.done, range.mutex);
+    mtx_unlock(range.mutex);
+
+    mtx_destroy(range.mutex);
+    cnd_destroy(range.done);
+    RAII_FREE(chunks);
+    RAII_FREE(args);
+    if (!is_empty(range.ex))
+        ex_throw((const char *)range.ex, range.file, range.line, range.function, range.panic);
+}
+
+typedef struct {
+    workers_group_t *group;
+    func_t func;
+    void *arg;
+} workers_member_t;
+
+/* Member's own `workers_defer` cleanup unwinds here, before group counts it done. */
+static int group_guarded(workers_member_t *member)
+guard_local {
+    member->func(member->arg);
+} unguarded(0);
+
+static void group_execute(void *arg) {
+    workers_member_t *member = (workers_member_t *)arg;
+    workers_group_t *group = member->group;
+    worker_t *self = workers_self_get();
+    void *none = NULL;
+
+    self->group = group;
+    try {
+        /* sibling failed, or group cancelled, while still queued */
+        if (atomic_int_load(&group->cancelled))
+            throw(task_cancelled);
+
+        group_guarded(member);
+    } catch_any {
+        if (atomic_ptr_cas(&group->ex, &none, (void *)ex_err.ex)) {
+            group->panic = ex_err.panic;
+            group->file = ex_err.file;
+            group->function = ex_err.function;
+            group->line = ex_err.line;
+            atomic_int_store(&group->cancelled, 1);
+        }
+    } end_trying;
+
+    self->group = NULL;
+    RAII_FREE(member);
+    if (atomic_size_sub(&group->remaining, 1) == 1) {
+        mtx_lock(group->mutex);
+        cnd_broadcast(group->done);
+        mtx_unlock(group->mutex);
+    }
+}
+
+static void group_join(workers_group_t *group) {
+    if (workers_current() == group->pool) {
+        while (!is_zero(atomic_size_load(&group->remaining))) {
+            if (!workers_yield(group->pool))
+                thrd_yield();
+        }
+    }
+
+    mtx_lock(group->mutex);
+    while (!is_zero(atomic_size_load(&group->remaining)))
+        cnd_wait(group->done, group->mutex);
+    mtx_unlock(group->mutex);
+}
+
+static void group_throw(workers_group_t *group) {
+    const char *ex = (const char *)group->ex;
+    if (!is_empty((void *)ex)) {
+        group->ex = NULL;
+        ex_throw(ex, group->file, group->line, group->function, group->panic);
+    }
+}
+
+RAII_INLINE void group_cancel(workers_group_t *group) {
+    atomic_int_store(&group->cancelled, 1);
+}
+
+/* Owning scope exit, group released before any rethrow. */
+static void group_deferred(void *arg) {
+    workers_group_t *group = (workers_group_t *)arg;
+    workers_group_t copy;
+
+    if (!is_empty(group->scope->err))
+        group_cancel(group);
+
+    group_join(group);
+    copy = *group;
+    /* scope already unwinding, it's exception wins */
+    if (!is_empty(group->scope->err))
+        copy.ex = NULL;
+
+    group->type = RAII_NULL;
+    mtx_destroy(group->mutex);
+    cnd_destroy(group->done);
+    RAII_FREE(group);
+    group_throw(&copy);
+}
+
+workers_group_t *group_create(memory_t *scope, workers_t *pool) {
+    workers_group_t *group;
+    if (UNLIKELY(is_empty(scope) || is_empty(pool)))
+        raii_panic("Failed! `group_create` invalid scope or pool");
+
+    group = try_calloc(1, sizeof(workers_group_t));
+    if (mtx_init(group->mutex, mtx_plain) != thrd_success || cnd_init(group->done) != thrd_success)
+        raii_panic("Group `mtx_init/cnd_init` failed!");
+
+    group->type = RAII_GROUP;
+    group->pool = pool;
+    group->scope = scope;
+    raii_deferred(scope, group_deferred, group);
+    return group;
+}
+
+int group_spawn(workers_group_t *group, func_t fn, void *arg) {
+    workers_member_t *member;
+    if (UNLIKELY(is_empty(group) || !is_type(group, RAII_GROUP) || fn == NULL))
+        raii_panic("Failed! `group_spawn` invalid group or function");
+
+    if (atomic_int_load(&group->cancelled))
+        return 0;
+
+    member = try_calloc(1, sizeof(workers_member_t));
+    member->group = group;
+    member->func = fn;
+    member->arg = arg;
+    atomic_size_add(&group->remaining, 1);
+    if (workers_submit(group->pool, group_execute, member) != 0) {
+        atomic_size_sub(&group->remaining, 1);
+        RAII_FREE(member);
+        return pool_shutdown;
+    }
+
+    return 0;
+}
+
+void group_wait(workers_group_t *group) {
+    group_join(group);
+    group_throw(group);
+}
+
+typedef struct {
+    workers_t *pool;
+    raii_func_t func;
+    void *arg;
+} workers_routine_t;
+
+/* Coroutine finished, by it's own scope defer, as `workers_execute` ends a task. */
+static void workers_routine_done(void *arg) {
+    workers_t *pool = (workers_t *)arg;
+    if (atomic_size_sub(&pool->unfinished, 1) == 1) {
+        mtx_lock(pool->lock);
+        cnd_broadcast(pool->done);
+        mtx_unlock(pool->lock);
+    }
+}
+
+static void *workers_routine(void *arg) {
+    workers_routine_t task = *(workers_routine_t *)arg;
+    RAII_FREE(arg);
+    raii_defer(workers_routine_done, task.pool);
+    return task.func(task.arg);
+}
+
+/* Coroutine counts as unfinished till it returns, so `workers_wait` covers it,
+worker loop runs it, and later resumes, after this task. */
+static void workers_routine_task(void *arg) {
+    worker_t *self = workers_self_get();
+    workers_routine_t *task = (workers_routine_t *)arg;
+
+    if (!self->is_sched) {
+        sched_waker(workers_woken, self);
+        self->is_sched = true;
+    }
+
+    atomic_size_add(&self->pool->unfinished, 1);
+    routine_detach(routine_create(workers_routine, task, 0));
+}
+
+int workers_go(workers_t *pool, raii_func_t fn, void *arg) {
+    workers_routine_t *task;
+    int status;
+
+    if (UNLIKELY(fn == NULL))
+        return pool_invalid;
+
+    task = try_malloc(sizeof(workers_routine_t));
+    task->pool = pool;
+    task->func = fn;
+    task->arg = arg;
+    if ((status = workers_submit(pool, workers_routine_task, task)) != 0)
+        RAII_FREE(task);
+
+    return status;
+}
@@ -0,0 +1,176 @@
+#include "raii.h"
+#include "test_assert.h"
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+static aio_t *queue = NULL;
+static int pipes[2];
+static int delivered = 0;
+
+static void on_done(aio_op_t *op, void *data) {
+    delivered++;
+    *(long *)data = aio_result(op);
+}
+
+int test_pipe(void) {
+    long read_result = 0, write_result = 0;
+    aio_op_t *reading, *writing;
+
+    delivered = 0;
+    reading = aio_read(NULL, queue, pipes[0], 64, -1, on_done, &read_result);
+    writing = aio_write(NULL, queue, pipes[1], "hello", 5, -1, on_done, &write_result);
+    ASSERT_UEQ((size_t)2, aio_pending(queue));
+    aio_loop(queue);
+    ASSERT_EQ(2, delivered);
+    ASSERT_EQ(true, aio_is_done(reading));
+    ASSERT_EQ(5, (int)read_result);
+    ASSERT_EQ(5, (int)write_result);
+    ASSERT_EQ(0, memcmp(aio_buffer(reading), "hello", 5));
+    aio_op_free(reading);
+    aio_op_free(writing);
+    return 0;
+}
+
+int test_offset(void) {
+    FILE *file = tmpfile();
+    aio_op_t *op;
+
+    ASSERT_NOTNULL(file);
+    fputs("0123456789", file);
+    fflush(file);
+    op = aio_read(NULL, queue, fileno(file), 4, 3, NULL, NULL);
+    ASSERT_EQ(4, (int)aio_await(op));
+    ASSERT_EQ(0, memcmp(aio_buffer(op), "3456", 4));
+    aio_op_free(op);
+    fclose(file);
+    return 0;
+}
+
+int test_cancel(void) {
+    aio_op_t *op = aio_read(NULL, queue, pipes[0], 16, -1, NULL, NULL);
+    ASSERT_EQ(true, aio_cancel(op));
+    ASSERT_EQ(-ECANCELED, (int)aio_await(op));
+    ASSERT_EQ(false, aio_cancel(op));
+    aio_op_free(op);
+    ASSERT_UEQ((size_t)0, aio_pending(queue));
+    return 0;
+}
+
+static void *reader(void *arg) {
+    aio_op_t *op = aio_read(NULL, queue, pipes[0], 1, -1, NULL, NULL);
+    long result = aio_await(op);
+    *(char *)arg = result == 1 ? *(char *)aio_buffer(op) : 0;
+    aio_op_free(op);
+    return NULL;
+}
+
+int test_routines(void) {
+    routine_t *first, *second;
+    char a = 0, b = 0;
+
+    first = routine_go(reader, &a);
+    second = routine_go(reader, &b);
+    sched_run();
+    ASSERT_UEQ((size_t)2, aio_pending(queue));
+    ASSERT_EQ(2, (int)write(pipes[1], "xy", 2));
+    aio_loop(queue);
+    routine_join(first);
+    routine_join(second);
+    ASSERT_EQ(true, ((a == 'x' && b == 'y') || (a == 'y' && b == 'x')));
+    return 0;
+}
+
+int test_accept(void) {
+    struct sockaddr_in addr;
+    socklen_t length = sizeof(addr);
+    raii_socket_t server = raii_socket(NULL, AF_INET, SOCK_STREAM, 0);
+    raii_socket_t client = raii_socket(NULL, AF_INET, SOCK_STREAM, 0);
+    aio_op_t *op;
+    long accepted;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(0, bind(server, (struct sockaddr *)&addr, sizeof(addr)));
+    ASSERT_EQ(0, listen(server, 4));
+    ASSERT_EQ(0, getsockname(server, (struct sockaddr *)&addr, &length));
+    op = aio_accept(NULL, queue, server, NULL, NULL);
+    ASSERT_EQ(0, connect(client, (struct sockaddr *)&addr, sizeof(addr)));
+    ASSERT_EQ(true, ((accepted = aio_await(op)) >= 0));
+    close((int)accepted);
+    aio_op_free(op);
+    raii_socket_close(client);
+    raii_socket_close(server);
+    return 0;
+}
+
+/* Header read, then body read left in flight when header is not `OK`. */
+static int read_request(void)
+guard {
+    aio_op_t *header = _aio_read(queue, pipes[0], 2, -1);
+    aio_op_t *body;
+
+    ASSERT_EQ(2, (int)aio_await(header));
+    body = _aio_read(queue, pipes[0], 64, -1);
+    if (memcmp(aio_buffer(header), "OK", 2) != 0)
+        throw(invalid_type);
+
+    ASSERT_EQ(4, (int)aio_await(body));
+} unguarded(0);
+
+int test_request(void) {
+    volatile int caught = 0;
+    char byte = 0;
+
+    ASSERT_EQ(2, (int)write(pipes[1], "NO", 2));
+    try {
+        read_request();
+    } catch (invalid_type) {
+        caught = 1;
+    } end_trying;
+    ASSERT_EQ(1, caught);
+    ASSERT_UEQ((size_t)0, aio_pending(queue));
+
+    /* body read cancelled, nothing left to take what is written next */
+    ASSERT_EQ(1, (int)write(pipes[1], "u", 1));
+    ASSERT_EQ(1, (int)read(pipes[0], &byte, 1));
+    ASSERT_EQ('u', byte);
+
+    ASSERT_EQ(6, (int)write(pipes[1], "OKbody", 6));
+    ASSERT_EQ(0, read_request());
+    ASSERT_UEQ((size_t)0, aio_pending(queue));
+    return 0;
+}
+
+int main(void) {
+    ASSERT_EQ(0, pipe(pipes));
+    queue = aio_create(NULL, 32);
+    printf("\n%s backend\n", aio_is_uring(queue) ? "io_uring" : "poll");
+
+    puts("\naio_read, aio_write, aio_loop over pipe");
+    ASSERT_EQ(0, test_pipe());
+
+    puts("\naio_read at offset, aio_await");
+    ASSERT_EQ(0, test_offset());
+
+    puts("\naio_cancel");
+    ASSERT_EQ(0, test_cancel());
+
+    puts("\naio_await, suspending only awaiting coroutines");
+    ASSERT_EQ(0, test_routines());
+
+    puts("\naio_accept");
+    ASSERT_EQ(0, test_accept());
+
+    puts("\n_aio_read, cancelled and released on unwind");
+    ASSERT_EQ(0, test_request());
+
+    puts("\naio_free, cancelling operations in flight");
+    aio_read(NULL, queue, pipes[0], 64, -1, NULL, NULL);
+    aio_free(queue);
+    close(pipes[0]);
+    close(pipes[1]);
+    return 0;
+}
@@ -1,7 +1,281 @@
 #include "raii.h"
 #include "test_assert.h"
 
+#define THREAD_COUNT 4
+
+/* Each thread owns an arena, chunks recycle through `thread` caches. */
+int arena_worker(void *arg) {
+    arena_t arena = arena_init(2);
+    int i, j;
+
+    for (i = 0; i < 500; i++) {
+        for (j = 0; j < 8; j++)
+            memset(arena_alloc(arena, 1024 + j * 512), i & 0xff, 1024 + j * 512);
+
+        arena_clear(arena);
+    }
+
+    ASSERT_EQ(0, arena_capacity(arena));
+    arena_free(arena);
+    return 0;
+}
+
+int arena_guarded(arena_t arena, bool panicking)
+guard {
+    _arena_mark(arena);
+    memset(arena_alloc(arena, 20000), 0, 20000);
+    if (panicking)
+        _panic("scratch");
+} unguarded(0);
+
+int arena_guarded_rewind(arena_t arena) {
+    size_t capacity = arena_capacity(arena);
+    try {
+        arena_guarded(arena, false);
+        ASSERT_UEQ(capacity, arena_capacity(arena));
+        arena_guarded(arena, true);
+    } catch_any {
+        ASSERT_STR("scratch", ex_err.panic);
+        ASSERT_UEQ(capacity, arena_capacity(arena));
+    } end_try;
+
+    return 0;
+}
+
+int arena_scoped(int count)
+guard_arena {
+    _assign_ptr(scope);
+    int i, value, *last = NULL;
+    for (i = 0; i < count; i++) {
+        last = _malloc(sizeof(int) * 16);
+        last[15] = i;
+    }
+
+    ASSERT_EQ(true, (_calloc(4, sizeof(int)) == (void *)(last + 16)));
+    ASSERT_UEQ((size_t)0, raii_deferred_count(scope));
+    ASSERT_EQ(true, arena_total(scope->arena) >= (size_t)count * 64);
+    value = last[15];
+    _return(value);
+} unguarded(-1);
+
+/* Heap scope memory, released all at once. */
+int heap_scoped(int count) {
+    unique_t *scope = unique_init_heap();
+    int i, sum = 0, *values = calloc_by(scope, count, sizeof(int));
+    for (i = 0; i < count; i++) {
+        sum += values[i];
+        memset(malloc_by(scope, 64), 0, 64);
+    }
+
+    raii_delete(scope);
+    return sum;
+}
+
+/* Nested guard joins enclosing budget, going over unwinds it. */
+int budget_inner(void)
+guard {
+    _assign_ptr(scope);
+    _malloc(600);
+    ASSERT_UEQ(1100, raii_budget_used(scope));
+    _malloc(600);
+} unguarded(-1);
+
+int budget_outer(void)
+guard {
+    _assign_ptr(scope);
+    _budget(2000);
+    _malloc(500);
+    ASSERT_EQ(-1, budget_inner());
+    ASSERT_UEQ(500, raii_budget_used(scope));
+} unguarded(0);
+
+int test_budget(void) {
+    arena_t arena = arena_init(0);
+    int caught = 0;
+
+    ASSERT_EQ(0, budget_outer());
+
+    arena_budget(arena, 32768);
+    arena_alloc(arena, 20000);
+    try {
+        arena_alloc(arena, 20000);
+    } catch (out_of_memory) {
+        caught = 2;
+    } end_trying;
+    ASSERT_EQ(2, caught);
+    ASSERT_EQ(true, arena_total(arena) <= 32768);
+    arena_free(arena);
+    return 0;
+}
+
+static bool all_zero(const char *ptr, size_t size) {
+    size_t i;
+    for (i = 0; i < size; i++) {
+        if (ptr[i] != 0)
+            return false;
+    }
+
+    return true;
+}
+
+/* Fresh chunks sized for request come zeroed, recycled or rewound bytes cleared again. */
+int test_calloc(void) {
+    arena_t arena = arena_init(0);
+    arena_mark_t mark;
+    char *big = arena_calloc(arena, 300, 1000), *small;
+
+    ASSERT_EQ(true, all_zero(big, 300000));
+    memset(big, 0xff, 300000);
+    arena_clear(arena);
+    big = arena_calloc(arena, 300, 1000);
+    ASSERT_EQ(true, all_zero(big, 300000));
+
+    small = arena_alloc(arena, 64);
+    memset(small, 0xff, 64);
+    arena_clear(arena);
+    ASSERT_EQ(true, all_zero(arena_calloc(arena, 8, 8), 64));
+
+    mark = arena_mark(arena);
+    small = arena_alloc(arena, 32);
+    memset(small, 0xff, 32);
+    arena_rewind(arena, mark);
+    ASSERT_EQ(true, (small == arena_calloc(arena, 4, 8)));
+    ASSERT_EQ(true, all_zero(small, 32));
+
+    /* rewound across chunks, recycled dirty one is current again */
+    arena_direct(arena, 0);
+    memset(arena_alloc(arena, 300000), 0xff, 300000);
+    arena_clear(arena);
+    arena_alloc(arena, 16);
+    mark = arena_mark(arena);
+    arena_calloc(arena, 400, 1000);
+    arena_rewind(arena, mark);
+    ASSERT_EQ(true, all_zero(arena_calloc(arena, 200, 1), 200));
+    arena_free(arena);
+    return 0;
+}
+
+int test_direct(void) {
+    arena_t arena = arena_init(0);
+    char *small = arena_alloc(arena, 64), *big;
+    size_t total = arena_total(arena), mapped;
+    arena_mark_t mark;
+
+    /* own pages, current chunk neither grown nor left */
+    big = arena_alloc(arena, ARENA_DIRECT);
+    memset(big, 'd', ARENA_DIRECT);
+    ASSERT_UEQ(total, arena_total(arena));
+    ASSERT_EQ(true, (arena_stats(arena).mapped > ARENA_DIRECT));
+    ASSERT_EQ(true, (small + 64 == (char *)arena_alloc(arena, 16)));
+    ASSERT_EQ(true, all_zero(arena_calloc(arena, 2, ARENA_DIRECT), ARENA_DIRECT * 2));
+    ASSERT_EQ(0, (int)((uintptr_t)arena_alloc_aligned(arena, ARENA_DIRECT, 4096) % 4096));
+
+    mapped = arena_stats(arena).mapped;
+    mark = arena_mark(arena);
+    arena_alloc(arena, ARENA_DIRECT);
+    ASSERT_EQ(true, (arena_stats(arena).mapped > mapped));
+    arena_rewind(arena, mark);
+    ASSERT_UEQ(mapped, arena_stats(arena).mapped);
+
+    arena_clear(arena);
+    ASSERT_UEQ((size_t)0, arena_stats(arena).mapped);
+
+    arena_budget(arena, Kb(100));
+    ASSERT_NULL(arena_take(arena, ARENA_DIRECT));
+    arena_budget(arena, 0);
+
+    arena_direct(arena, 0);
+    arena_alloc(arena, ARENA_DIRECT);
+    ASSERT_UEQ((size_t)0, arena_stats(arena).mapped);
+    ASSERT_EQ(true, (arena_total(arena) >= ARENA_DIRECT));
+    arena_free(arena);
+    return 0;
+}
+
+/* Largest chunk stays attached, same memory handed out again. */
+int test_reset(void) {
+    arena_t arena = arena_init(0);
+    char *kept;
+    size_t total;
+
+    arena_alloc(arena, 5000);
+    arena_alloc(arena, 8000);
+    arena_alloc(arena, 30000);
+    total = arena_total(arena);
+
+    arena_reset(arena);
+    ASSERT_EQ(true, (arena_total(arena) <= total));
+    ASSERT_EQ(true, (arena_capacity(arena) >= 30000));
+    ASSERT_EQ(arena_total(arena), arena_capacity(arena));
+    kept = arena_alloc(arena, 30000);
+    arena_alloc(arena, 100);
+
+    arena_reset(arena);
+    ASSERT_EQ(true, (kept == (char *)arena_alloc(arena, 16)));
+    ASSERT_EQ(true, all_zero(arena_calloc(arena, 4, 8), 32));
+
+    /* nothing held, nothing kept */
+    arena_clear(arena);
+    arena_reset(arena);
+    ASSERT_EQ(0, arena_total(arena));
+    arena_free(arena);
+    return 0;
+}
+
+/* Released chunk too small for one request stays cached, for the next that fits. */
+int test_recycle(void) {
+    arena_t first = arena_init(0), large = arena_init(0), next = arena_init(0);
+    char *small = arena_alloc(first, 100);
+
+    arena_free(first);
+    arena_direct(large, 0);
+    arena_alloc(large, Mb(2));
+#ifndef RAII_MEMCHECK
+    ASSERT_EQ(true, (small == (char *)arena_alloc(next, 100)));
+#endif
+    arena_free(large);
+    arena_free(next);
+    return 0;
+}
+
+/* Result built in `out`, temporaries in the other scratch arena, rewound on exit. */
+char *scratch_join(arena_t out, int count)
+guard {
+    arena_t tmp = _scratch(out);
+    char *parts = arena_alloc(tmp, count), *result;
+    memset(parts, 'x', count);
+    result = arena_alloc(out, count + 1);
+    memcpy(result, parts, count);
+    result[count] = '\0';
+    _return(result);
+} unguarded(NULL);
+
+int test_scratch(void) {
+    arena_t first = thrd_scratch(NULL), second = thrd_scratch(first);
+    size_t capacity;
+    char *joined;
+
+    ASSERT_EQ(false, (first == second));
+    ASSERT_EQ(true, (first == thrd_scratch(second)));
+    arena_alloc(second, 8);
+    capacity = arena_capacity(second);
+    joined = scratch_join(first, 100);
+    ASSERT_UEQ((size_t)100, strlen(joined));
+    ASSERT_UEQ(capacity, arena_capacity(second));
+
+    /* nested, result arena is now caller's scratch */
+    joined = scratch_join(second, 50);
+    ASSERT_UEQ((size_t)50, strlen(joined));
+    arena_clear(first);
+    arena_clear(second);
+    return 0;
+}
+
 int main(void) {
+    raii_config_t config = {false, 0, "raii", NULL};
+    ASSERT_EQ(RAII_OK, raii_config(&config));
+    ASSERT_EQ(RAII_ERR, raii_config(&config));
+
     puts("\narena_init");
     arena_t arena = arena_init(0);
     ASSERT_EQ(0, arena_capacity(arena));
@@ -9,8 +283,8 @@ int main(void) {
 
     puts("\nmalloc_arena initialled");
     void *ptr = arena_alloc(arena, 18);
-    ASSERT_EQ(10240, arena_capacity(arena));
-    ASSERT_EQ(10258, arena_total(arena));
+    ASSERT_EQ(10222, arena_capacity(arena));
+    ASSERT_EQ(10240, arena_total(arena));
 
     char *ptr2 = arena_alloc(arena, 11);
     arena_print(arena);
@@ -25,14 +299,14 @@ int main(void) {
     void *ptr7 = arena_alloc(arena, 2000);
     arena_print(arena);
     void *ptr8 = arena_alloc(arena, 4000);
-    ASSERT_EQ(986, arena_capacity(arena));
-    ASSERT_EQ(10258, arena_total(arena));
+    ASSERT_EQ(968, arena_capacity(arena));
+    ASSERT_EQ(10240, arena_total(arena));
     puts("arena_alloc initialled ended");
 
-    puts("\nmalloc_arena(4000) cause total allocation to increase!");
+    puts("\nmalloc_arena(4000) cause new chunk, double the size!");
     void *ptr9 = arena_alloc(arena, 4000);
-    ASSERT_EQ(20626, arena_capacity(arena));
-    ASSERT_EQ(24626, arena_total(arena));
+    ASSERT_EQ(16480, arena_capacity(arena));
+    ASSERT_EQ(30720, arena_total(arena));
 
     puts("\nmalloc_arena(4000) again");
     void *ptr10 = arena_alloc(arena, 4000);
@@ -40,12 +314,15 @@ int main(void) {
 
     puts("\n1. arena_clear");
     arena_clear(arena);
-    ASSERT_EQ(20626, arena_capacity(arena));
+    ASSERT_EQ(0, arena_capacity(arena));
+    ASSERT_EQ(0, arena_total(arena));
     arena_print(arena);
 
     puts("\nmalloc_aren(6000)a again");
     void *ptr11 = arena_alloc(arena, 6000);
     arena_print(arena);
+    ASSERT_EQ(4240, arena_capacity(arena));
+    ASSERT_EQ(10240, arena_total(arena));
 
     puts("\n2. arena_clear");
     arena_clear(arena);
@@ -57,7 +334,7 @@ int main(void) {
 
     puts("\n3. arena_clear");
     arena_clear(arena);
-    ASSERT_EQ(10626, arena_capacity(arena));
+    ASSERT_EQ(0, arena_capacity(arena));
 
     puts("\nmalloc_arena(1000) x2 again");
     void *ptr13 = arena_alloc(arena, 1000);
@@ -65,15 +342,89 @@ int main(void) {
     void *ptr14 = arena_alloc(arena, 1000);
     arena_print(arena);
 
-    puts("\nmalloc_arena(61000)");
+    puts("\nmalloc_arena(61000) larger than next chunk, sized to fit");
     void *ptr15 = arena_alloc(arena, 61000);
     arena_print(arena);
-    ASSERT_EQ(34994, arena_capacity(arena));
-    ASSERT_EQ(95994, arena_total(arena));
+    ASSERT_EQ(56, arena_capacity(arena));
+    ASSERT_EQ(71296, arena_total(arena));
 
     puts("\nmalloc_arena(7000)");
     void *ptr16 = arena_alloc(arena, 7000);
     arena_print(arena);
+    ASSERT_EQ(13480, arena_capacity(arena));
+    ASSERT_EQ(91776, arena_total(arena));
+
+    puts("\narena_bump inlined fast path");
+    char *bump = arena_bump(arena, 16);
+    char *bump2 = arena_bump(arena, 16);
+    ASSERT_EQ(true, (bump2 == bump + 16));
+    ASSERT_EQ(13448, arena_capacity(arena));
+
+    puts("\narena_mark/arena_rewind");
+    arena_mark_t mark = arena_mark(arena);
+    arena_alloc(arena, 100);
+    arena_alloc(arena, 50000);
+    ASSERT_UEQ((size_t)141824, arena_total(arena));
+    arena_rewind(arena, mark);
+    ASSERT_EQ(13448, arena_capacity(arena));
+    ASSERT_EQ(91776, arena_total(arena));
+
+    puts("\n_arena_mark within guard");
+    ASSERT_FUNC(arena_guarded_rewind(arena));
+    ASSERT_EQ(13448, arena_capacity(arena));
+
+    puts("\narena_alloc_aligned");
+    arena_alloc(arena, 3);
+    ASSERT_EQ(0, (int)((uintptr_t)arena_alloc_aligned(arena, 10, 64) % 64));
+    ASSERT_EQ(0, (int)((uintptr_t)arena_alloc_aligned(arena, 100, 4096) % 4096));
+    double *doubles = arena_new(arena, double, 4);
+    ASSERT_EQ(0, (int)((uintptr_t)doubles % RAII_ALIGNOF(double)));
+    doubles[3] = 1.5;
+    arena_clear(arena);
+    ASSERT_EQ(0, arena_capacity(arena));
+    arena_alloc(arena, 2000);
+    char *bump3 = arena_bump(arena, 16);
+    ASSERT_EQ(true, (bump3 + 16 == (char *)arena_new(arena, char, 1)));
+
+    puts("\narena_realloc");
+    char *buffer = arena_alloc(arena, 100);
+    size_t capacity = arena_capacity(arena);
+    memset(buffer, 'r', 100);
+    ASSERT_EQ(true, (buffer == arena_realloc(arena, buffer, 100, 400)));
+    ASSERT_UEQ(capacity - 300, arena_capacity(arena));
+    ASSERT_EQ(true, (buffer == arena_realloc(arena, buffer, 400, 50)));
+    ASSERT_UEQ(capacity + 50, arena_capacity(arena));
+    arena_alloc(arena, 8);
+    char *moved = arena_realloc(arena, buffer, 50, 200);
+    ASSERT_EQ(true, (moved != buffer));
+    ASSERT_EQ('r', moved[49]);
+
+    puts("\narena_calloc, known zero chunks");
+    ASSERT_FUNC(test_calloc());
+
+    puts("\narena_direct, large requests on own pages");
+    ASSERT_FUNC(test_direct());
+
+    puts("\narena_reset, largest chunk kept");
+    ASSERT_FUNC(test_reset());
+
+    puts("\narena chunks recycled by size");
+    ASSERT_FUNC(test_recycle());
+
+    puts("\nthrd_scratch, _scratch");
+    ASSERT_FUNC(test_scratch());
+
+#ifdef RAII_STATS
+    puts("\narena_stats");
+    arena_stats_t stats = arena_stats(arena);
+    arena_print(arena);
+    ASSERT_UEQ(arena_total(arena), stats.reserved);
+    ASSERT_EQ(true, stats.requested >= (size_t)61000);
+    ASSERT_EQ(true, stats.peak >= stats.reserved);
+    ASSERT_EQ(true, stats.hits > 0 && stats.misses > 0);
+    ASSERT_EQ(true, stats.chunks > 0);
+    ASSERT_EQ(true, arena_thread_stats().chunks >= stats.chunks);
+#endif
 
     puts("\narena_free");
     arena_free(arena);
@@ -81,5 +432,26 @@ int main(void) {
     ASSERT_EQ(0, arena_total(arena));
     puts("");
 
+    puts("\nguard_arena scope allocations");
+    ASSERT_EQ(999, arena_scoped(1000));
+
+    puts("\nunique_init_heap scope allocations");
+    ASSERT_EQ(0, heap_scoped(1000));
+
+    puts("\nraii_budget, arena_budget");
+    ASSERT_EQ(0, test_budget());
+
+    puts("\narena per thread free lists");
+    thrd_t t[THREAD_COUNT];
+    int i, res;
+    for (i = 0; i < THREAD_COUNT; i++)
+        thrd_create(t + i, arena_worker, NULL);
+
+    for (i = 0; i < THREAD_COUNT; i++) {
+        thrd_join(t[i], &res);
+        ASSERT_EQ(0, res);
+    }
+    puts("");
+
     return 0;
 }
@@ -0,0 +1,110 @@
+#include "raii.h"
+#include "test_assert.h"
+
+int test_append(void) {
+    sb_t *sb = sb_create(NULL, 4);
+    char *stolen;
+    int i;
+
+    ASSERT_STR("", sb_str(sb));
+    sb_puts(sb, "GET ");
+    sb_append(sb, "/index.html?x", 11);
+    sb_putc(sb, ' ');
+    ASSERT_EQ(12, sb_printf(sb, "HTTP/%d.%d\\r\\n", 1, 1));
+    ASSERT_STR("GET /index.html HTTP/1.1\\r\\n", sb_str(sb));
+    ASSERT_UEQ((size_t)28, sb_len(sb));
+
+    sb_truncate(sb, 3);
+    ASSERT_STR("GET", sb_str(sb));
+    sb_clear(sb);
+    for (i = 0; i < 1000; i++)
+        sb_printf(sb, "%04d", i);
+
+    ASSERT_UEQ((size_t)4000, sb_len(sb));
+    ASSERT_EQ(0, strncmp(sb_str(sb) + 3996, "0999", 4));
+
+    stolen = sb_steal(sb);
+    ASSERT_UEQ((size_t)4000, strlen(stolen));
+    ASSERT_UEQ((size_t)0, sb_len(sb));
+    ASSERT_STR("", sb_str(sb));
+    RAII_FREE(stolen);
+    sb_free(sb);
+    return 0;
+}
+
+int test_arena(void) {
+    arena_t arena = arena_init(0);
+    sb_t *sb = sb_arena(arena, 0);
+    int i;
+
+    for (i = 0; i < 500; i++)
+        sb_printf(sb, "line %d\n", i);
+
+    ASSERT_EQ(0, strncmp(sb_str(sb), "line 0\nline 1\n", 14));
+    arena_free(arena);
+    return 0;
+}
+
+/* Response outgrowing `arena` budget, unwinds back to mark. */
+static int builder_overrun(arena_t arena, int lines)
+guard {
+    sb_t *sb;
+    int i;
+
+    _arena_mark(arena);
+    sb = sb_arena(arena, 0);
+    for (i = 0; i < lines; i++)
+        sb_printf(sb, "line %d\n", i);
+} unguarded(0);
+
+int test_overrun(void) {
+    arena_t arena = arena_init(0);
+    size_t capacity, total;
+    volatile int caught = 0;
+
+    arena_budget(arena, 16384);
+    capacity = arena_capacity(arena);
+    total = arena_total(arena);
+    try {
+        builder_overrun(arena, 5000);
+    } catch (out_of_memory) {
+        caught = 1;
+    } end_trying;
+
+    /* builder, and each buffer it outgrew, handed back */
+    ASSERT_EQ(1, caught);
+    ASSERT_UEQ(capacity, arena_capacity(arena));
+    ASSERT_UEQ(total, arena_total(arena));
+
+    ASSERT_EQ(0, builder_overrun(arena, 50));
+    ASSERT_UEQ(capacity, arena_capacity(arena));
+    arena_free(arena);
+    return 0;
+}
+
+static int builder_arena(void)
+guard_arena {
+    sb_t *sb = _sb(0);
+    int i, length;
+    for (i = 0; i < 100; i++)
+        sb_puts(sb, "chunk");
+
+    /* builder goes with scope's arena */
+    length = (int)sb_len(sb);
+    _return(length);
+} unguarded(0);
+
+int main(void) {
+    puts("\nsb_append, sb_printf, sb_steal");
+    ASSERT_FUNC(test_append());
+
+    puts("\nsb_arena");
+    ASSERT_FUNC(test_arena());
+
+    puts("\n_sb, guard_arena");
+    ASSERT_EQ(500, builder_arena());
+
+    puts("\nsb_arena, past arena budget, released on unwind");
+    ASSERT_FUNC(test_overrun());
+    return 0;
+}
@@ -0,0 +1,194 @@
+#include "raii.h"
+#include "test_assert.h"
+
+#define THREAD_COUNT 4
+#define MESSAGE_COUNT 20000
+
+static channel_t *shared = NULL;
+static volatile size_t received = 0;
+static volatile size_t summed = 0;
+
+static int producer(void *arg) {
+    size_t i, base = (size_t)arg * MESSAGE_COUNT;
+    for (i = 1; i <= MESSAGE_COUNT; i++)
+        ASSERT_EQ(true, channel_send(shared, (void *)(base + i)));
+
+    return 0;
+}
+
+static int consumer(void *arg) {
+    void *value;
+    while (channel_recv(shared, &value)) {
+        atomic_size_add(&summed, (size_t)value);
+        atomic_size_add(&received, 1);
+    }
+
+    return 0;
+}
+
+int test_try(void) {
+    channel_t *ch = channel_create(3);
+    void *value = NULL;
+
+    ASSERT_EQ(false, channel_try_recv(ch, &value));
+    ASSERT_EQ(true, channel_try_send(ch, (void *)1));
+    ASSERT_EQ(true, channel_try_send(ch, (void *)2));
+    ASSERT_EQ(true, channel_try_send(ch, (void *)3));
+    ASSERT_EQ(true, channel_try_send(ch, (void *)4));
+    ASSERT_EQ(false, channel_try_send(ch, (void *)5));
+    ASSERT_EQ(false, channel_send_for(ch, (void *)5, 10));
+
+    ASSERT_EQ(true, channel_try_recv(ch, &value));
+    ASSERT_EQ(1, (int)(intptr_t)value);
+    ASSERT_EQ(true, channel_recv(ch, &value));
+    ASSERT_EQ(2, (int)(intptr_t)value);
+
+    channel_close(ch);
+    ASSERT_EQ(true, channel_is_closed(ch));
+    ASSERT_EQ(false, channel_send(ch, (void *)6));
+    ASSERT_EQ(true, channel_recv(ch, &value));
+    ASSERT_EQ(3, (int)(intptr_t)value);
+    ASSERT_EQ(true, channel_recv(ch, &value));
+    ASSERT_EQ(4, (int)(intptr_t)value);
+    ASSERT_EQ(false, channel_recv(ch, &value));
+    channel_free(ch);
+
+    ch = channel_create(1);
+    ASSERT_EQ(false, channel_recv_for(ch, &value, 10));
+    ASSERT_EQ(true, channel_try_send(ch, (void *)1));
+    ASSERT_EQ(true, channel_try_send(ch, (void *)2));
+    ASSERT_EQ(false, channel_try_send(ch, (void *)3));
+    channel_free(ch);
+    return 0;
+}
+
+int test_threads(void) {
+    thrd_t producers[THREAD_COUNT], consumers[THREAD_COUNT];
+    size_t i, n = THREAD_COUNT * MESSAGE_COUNT;
+
+    shared = channel_create(64);
+    for (i = 0; i < THREAD_COUNT; i++) {
+        ASSERT_EQ(thrd_success, thrd_create(&consumers[i], consumer, NULL));
+        ASSERT_EQ(thrd_success, thrd_create(&producers[i], producer, (void *)i));
+    }
+
+    for (i = 0; i < THREAD_COUNT; i++)
+        thrd_join(producers[i], NULL);
+
+    channel_close(shared);
+    for (i = 0; i < THREAD_COUNT; i++)
+        thrd_join(consumers[i], NULL);
+
+    ASSERT_UEQ(n, received);
+    ASSERT_UEQ(n * (n + 1) / 2, summed);
+    channel_free(shared);
+    return 0;
+}
+
+/* Full or empty channel yields to other coroutines, instead of blocking `thread`. */
+static void *routine_producer(void *arg) {
+    intptr_t i;
+    for (i = 1; i <= 100; i++)
+        channel_send((channel_t *)arg, (void *)i);
+
+    channel_close((channel_t *)arg);
+    return NULL;
+}
+
+static void *routine_consumer(void *arg) {
+    size_t sum = 0;
+    void *value;
+    while (channel_recv((channel_t *)arg, &value))
+        sum += (size_t)value;
+
+    return (void *)sum;
+}
+
+/* Sends from plain `thread`, waking coroutine parked on other `thread` scheduler. */
+static int thread_producer(void *arg) {
+    routine_producer(arg);
+    return 0;
+}
+
+static void *routine_receive(void *arg) {
+    void *value;
+    return (void *)(intptr_t)channel_recv((channel_t *)arg, &value);
+}
+
+int test_routines(void) {
+    channel_t *ch = channel_create(1);
+    routine_t *consumer = routine_go(routine_consumer, ch);
+    thrd_t thread;
+
+    routine_detach(routine_go(routine_producer, ch));
+    ASSERT_EQ(5050, (int)(intptr_t)routine_join(consumer));
+    channel_free(ch);
+
+    ch = channel_create(1);
+    consumer = routine_go(routine_consumer, ch);
+    ASSERT_EQ(thrd_success, thrd_create(&thread, thread_producer, ch));
+    ASSERT_EQ(5050, (int)(intptr_t)routine_join(consumer));
+    thrd_join(thread, NULL);
+    channel_free(ch);
+
+    /* parked coroutine counted, `channel_free` runs it out before release */
+    ch = channel_create(1);
+    consumer = routine_go(routine_receive, ch);
+    sched_run();
+    ASSERT_UEQ(1, sched_count());
+    channel_free(ch);
+    ASSERT_UEQ(0, sched_count());
+    ASSERT_EQ(false, (bool)(intptr_t)routine_join(consumer));
+    return 0;
+}
+
+/* Consumer parked on guard's channel when a bad value unwinds it. */
+static int channel_guarded(routine_t **consumer, intptr_t value)
+guard {
+    channel_t *ch = _channel(1);
+
+    *consumer = routine_go(routine_consumer, ch);
+    ASSERT_EQ(true, channel_try_send(ch, (void *)7));
+    sched_run();
+    if (value < 0)
+        throw(range_error);
+
+    ASSERT_EQ(true, channel_try_send(ch, (void *)value));
+    sched_run();
+} unguarded(0);
+
+int test_unwind(void) {
+    routine_t *consumer = NULL;
+    volatile int caught = 0;
+
+    try {
+        channel_guarded(&consumer, -1);
+    } catch (range_error) {
+        caught = 1;
+    } end_trying;
+
+    /* closed by release, consumer ran out with what it had */
+    ASSERT_EQ(1, caught);
+    ASSERT_UEQ(0, sched_count());
+    ASSERT_EQ(7, (int)(intptr_t)routine_join(consumer));
+
+    ASSERT_EQ(0, channel_guarded(&consumer, 3));
+    ASSERT_UEQ(0, sched_count());
+    ASSERT_EQ(10, (int)(intptr_t)routine_join(consumer));
+    return 0;
+}
+
+int main(void) {
+    puts("\nchannel_try_send, channel_try_recv");
+    ASSERT_FUNC(test_try());
+
+    puts("\nchannel_send, channel_recv, threads");
+    ASSERT_FUNC(test_threads());
+
+    puts("\nchannel_send, channel_recv, coroutines");
+    ASSERT_FUNC(test_routines());
+
+    puts("\nchannel_by, released on unwind");
+    ASSERT_FUNC(test_unwind());
+    return 0;
+}
@@ -1,4 +1,5 @@
 #include "raii.h"
+#include "compat/sys/queue.h"
 #include "test_assert.h"
 
 char number[20];
@@ -43,6 +44,546 @@ guard {
     puts("Returned normally from g.");
 } guarded;
 
+int order[20], fired = 0;
+void push_order(void *arg) {
+    order[fired++] = (int)(intptr_t)arg;
+}
+
+int test_inline_growth() {
+    unique_t *scope = unique_init();
+    size_t i, mid = 0;
+    for (i = 0; i < 20; i++) {
+        size_t index = raii_deferred(scope, push_order, (void *)(intptr_t)i);
+        ASSERT_UEQ(i, index);
+        if (i == 5)
+            mid = index;
+    }
+
+    ASSERT_UEQ((size_t)20, raii_deferred_count(scope));
+    raii_deferred_cancel(scope, mid);
+    raii_deferred_cancel(scope, 19);
+    ASSERT_UEQ((size_t)19, raii_deferred_count(scope));
+    raii_deferred_free(scope);
+#ifdef RAII_STATS
+    raii_stats_t stats = raii_scope_stats(scope);
+    ASSERT_UEQ((size_t)20, stats.registered);
+    ASSERT_UEQ((size_t)2, stats.cancelled);
+    ASSERT_UEQ((size_t)18, stats.fired);
+    ASSERT_UEQ((size_t)20, stats.peak);
+#endif
+    raii_delete(scope);
+
+    ASSERT_EQ(18, fired);
+    ASSERT_EQ(18, order[0]);
+    ASSERT_EQ(6, order[12]);
+    ASSERT_EQ(4, order[13]);
+    ASSERT_EQ(0, order[17]);
+    return 0;
+}
+
+int timeouts = 0;
+void timeout_fired(void *arg) {
+    timeouts++;
+}
+
+int test_handles() {
+    unique_t *scope = unique_init();
+    defer_handle_t first, timer, stale;
+    int i;
+
+    first = raii_deferred_arm(scope, timeout_fired, NULL);
+    for (i = 0; i < 10000; i++) {
+        timer = raii_deferred_arm(scope, timeout_fired, NULL);
+        raii_deferred(scope, push_order, NULL);
+        ASSERT_EQ(true, raii_deferred_armed(scope, timer));
+        ASSERT_EQ(true, raii_deferred_disarm(scope, timer));
+        ASSERT_EQ(false, raii_deferred_armed(scope, timer));
+        ASSERT_EQ(false, raii_deferred_disarm(scope, timer));
+        raii_deferred_cancel(scope, raii_deferred_count(scope) - 1);
+    }
+
+    /* cancelled slots trimmed along with last entry */
+    ASSERT_UEQ((size_t)1, raii_deferred_count(scope));
+    stale = timer;
+    timer = raii_deferred_arm(scope, timeout_fired, NULL);
+    ASSERT_EQ(false, raii_deferred_disarm(scope, stale));
+    ASSERT_EQ(true, raii_deferred_armed(scope, timer));
+
+    ASSERT_EQ(true, raii_deferred_trigger(scope, first));
+    ASSERT_EQ(1, timeouts);
+    ASSERT_EQ(false, raii_deferred_trigger(scope, first));
+    ASSERT_UEQ((size_t)2, raii_deferred_count(scope));
+
+    raii_deferred_free(scope);
+    ASSERT_EQ(2, timeouts);
+    ASSERT_EQ(false, raii_deferred_disarm(scope, timer));
+
+    /* slot reused after unwind, old handle stays stale */
+    raii_deferred_init(&scope->defer);
+    first = raii_deferred_arm(scope, timeout_fired, NULL);
+    stale = raii_deferred_arm(scope, timeout_fired, NULL);
+    ASSERT_EQ(false, raii_deferred_disarm(scope, timer));
+    ASSERT_EQ(true, raii_deferred_disarm(scope, stale));
+    ASSERT_EQ(true, raii_deferred_disarm(scope, first));
+    ASSERT_UEQ((size_t)0, raii_deferred_count(scope));
+    ASSERT_EQ(false, raii_deferred_armed(scope, 0));
+    raii_delete(scope);
+    return 0;
+}
+
+int test_many() {
+    unique_t *scope = unique_init();
+    void *objects[5], *blocks[3];
+    int i;
+
+    fired = 0;
+    for (i = 0; i < 5; i++)
+        objects[i] = (void *)(intptr_t)(i + 1);
+
+    for (i = 0; i < 3; i++)
+        blocks[i] = malloc(16);
+
+    raii_deferred(scope, push_order, (void *)0);
+    raii_deferred_many(scope, RAII_FREE, blocks, 3);
+    ASSERT_UEQ((size_t)2, raii_deferred_many(scope, push_order, objects, 5));
+    raii_deferred(scope, push_order, (void *)6);
+    ASSERT_UEQ((size_t)4, raii_deferred_count(scope));
+    ASSERT_UEQ((size_t)-1, raii_deferred_many(scope, push_order, objects, 0));
+
+    raii_deferred_free(scope);
+    ASSERT_EQ(7, fired);
+    for (i = 0; i < 7; i++)
+        ASSERT_EQ(6 - i, order[i]);
+
+    fired = 0;
+    raii_deferred_init(&scope->defer);
+    raii_deferred_fire(scope, raii_deferred_many(scope, push_order, objects, 2));
+    ASSERT_EQ(2, fired);
+    ASSERT_EQ(2, order[0]);
+    ASSERT_UEQ((size_t)0, raii_deferred_count(scope));
+    raii_delete(scope);
+    return 0;
+}
+
+typedef struct {
+    int id;
+    double weight;
+} item_t;
+
+int test_vectors() {
+    unique_t *scope = unique_init();
+    arena_t arena = arena_init(0);
+    raii_array_t *items = raii_array_of(scope, item_t);
+    raii_array_t *ids = raii_array_arena(scope, arena, sizeof(int));
+    int values[100], i, last = 0;
+    item_t item;
+
+    ASSERT_EQ(0, raii_array_reserve(items, 100));
+    ASSERT_UEQ((size_t)100, items->capacity);
+    for (i = 0; i < 1000; i++) {
+        item.id = i;
+        item.weight = i * 0.5;
+        raii_array_push(items, &item);
+    }
+
+    ASSERT_UEQ((size_t)1000, raii_array_count(items));
+    ASSERT_EQ(999, raii_array_get(items, item_t, 999).id);
+    raii_array_emplace(items, item_t)->id = 1000;
+    ASSERT_EQ(true, raii_array_pop(items, &item));
+    ASSERT_EQ(1000, item.id);
+
+    item.id = -1;
+    raii_array_insert(items, 0, &item);
+    ASSERT_EQ(-1, ((item_t *)raii_array_at(items, 0))->id);
+    ASSERT_EQ(0, ((item_t *)raii_array_at(items, 1))->id);
+    ASSERT_NULL(raii_array_at(items, 1001));
+
+    for (i = 0; i < 100; i++)
+        values[i] = i;
+
+    for (i = 0; i < 10; i++)
+        raii_array_extend(ids, values, 100);
+
+    ASSERT_UEQ((size_t)1000, raii_array_count(ids));
+    ASSERT_EQ(99, raii_array_get(ids, int, 999));
+    ASSERT_EQ(true, raii_array_pop(ids, &last));
+    ASSERT_EQ(99, last);
+    raii_array_clear(ids);
+    ASSERT_EQ(false, raii_array_pop(ids, NULL));
+
+    raii_delete(scope);
+    arena_free(arena);
+    return 0;
+}
+
+struct conn {
+    int fd;
+    TAILQ_ENTRY(conn) link;
+};
+TAILQ_HEAD(conn_list, conn);
+
+struct frame {
+    SLIST_ENTRY(frame) next;
+    int id;
+};
+SLIST_HEAD(frame_list, frame);
+
+int closed = 0;
+void conn_close(struct conn *c) {
+    order[closed++] = c->fd;
+    free(c);
+}
+
+int test_queues() {
+    unique_t *scope = unique_init();
+    struct conn_list conns;
+    struct frame_list frames;
+    struct frame stack_frames[3];
+    struct conn *c;
+    int i;
+
+    TAILQ_INIT(&conns);
+    SLIST_INIT(&frames);
+    raii_tailq_by(scope, &conns, conn, link, conn_close);
+    raii_slist_by(scope, &frames, frame, next, push_order);
+    ASSERT_UEQ((size_t)2, raii_deferred_count(scope));
+
+    for (i = 0; i < 5; i++) {
+        c = malloc(sizeof(struct conn));
+        c->fd = i;
+        TAILQ_INSERT_TAIL(&conns, c, link);
+    }
+
+    c = TAILQ_FIRST(&conns);
+    TAILQ_REMOVE(&conns, c, link);
+    free(c);
+    for (i = 0; i < 3; i++)
+        SLIST_INSERT_HEAD(&frames, &stack_frames[i], next);
+
+    fired = 0;
+    raii_deferred_free(scope);
+    ASSERT_EQ(3, fired);
+    ASSERT_EQ(true, (stack_frames[0].next.sle_next == NULL));
+    ASSERT_EQ(4, closed);
+    ASSERT_EQ(1, order[0]);
+    ASSERT_EQ(4, order[3]);
+    ASSERT_EQ(true, TAILQ_EMPTY(&conns));
+    ASSERT_EQ(true, (conns.tqh_last == &conns.tqh_first));
+
+    raii_delete(scope);
+
+    /* head reused after walk */
+    closed = 0;
+    scope = unique_init();
+    raii_tailq_by(scope, &conns, conn, link, conn_close);
+    for (i = 10; i < 12; i++) {
+        c = malloc(sizeof(struct conn));
+        c->fd = i;
+        TAILQ_INSERT_TAIL(&conns, c, link);
+    }
+
+    ASSERT_EQ(10, TAILQ_FIRST(&conns)->fd);
+    ASSERT_EQ(11, TAILQ_LAST(&conns, conn_list)->fd);
+    raii_deferred_free(scope);
+    ASSERT_EQ(2, closed);
+    ASSERT_EQ(10, order[0]);
+    ASSERT_EQ(11, order[1]);
+    raii_delete(scope);
+    return 0;
+}
+
+int local_runs = 0;
+void local_done(void *arg) {
+    local_runs += (int)(intptr_t)arg;
+}
+
+int local_sum(int n)
+guard_local {
+    int *values = _malloc(sizeof(int) * n);
+    int i, total = 0;
+    _defer(local_done, (void *)1);
+    for (i = 0; i < n; i++)
+        values[i] = i;
+
+    for (i = 0; i < n; i++)
+        total += values[i];
+
+    if (n > 10) {
+        _return(-total);
+    }
+
+    _return(total);
+} unguarded(0);
+
+void local_panic(void)
+guard_local {
+    _defer(local_done, (void *)10);
+    _panic("local");
+} guarded;
+
+int test_guard_local() {
+    ASSERT_EQ(6, local_sum(4));
+    ASSERT_EQ(1, local_runs);
+    ASSERT_EQ(-66, local_sum(12));
+    ASSERT_EQ(2, local_runs);
+    try {
+        local_panic();
+    } catch_any {
+        ASSERT_NOTNULL(err);
+    } end_try;
+    ASSERT_EQ(12, local_runs);
+    return 0;
+}
+
+/* Scope memory released on another `thread`, queued back to creating one. */
+static int release_scope(void *scope) {
+    raii_delete((unique_t *)scope);
+    return 0;
+}
+
+static int release_block(void *owner) {
+    raii_free_to((raii_inbox_t *)owner, malloc(64));
+    raii_free_to(raii_inbox(), malloc(64));
+    return 0;
+}
+
+/* Scope outlives creating `thread`, nothing routed to it's exited inbox. */
+static int orphan_scope(void *arg) {
+    unique_t *scope = unique_init();
+    raii_deferred(scope, RAII_FREE, malloc(32));
+    *(unique_t **)arg = scope;
+    return 0;
+}
+
+/* Queued blocks, never drained by owner, released at it's exit. */
+static int queued_exit(void *arg) {
+    raii_inbox_t **owner = (raii_inbox_t **)arg;
+    *owner = raii_inbox();
+    while (atomic_ptr_load((void *volatile *)owner) != NULL)
+        thrd_yield();
+
+    return 0;
+}
+
+static int flood_blocks(void *owner) {
+    int i;
+    for (i = 0; i < RAII_INBOX_MAX + 10; i++)
+        raii_free_to((raii_inbox_t *)owner, malloc(16));
+
+    return 0;
+}
+
+int test_inbox() {
+    unique_t *scope = unique_init();
+    raii_inbox_t *owner = NULL, *exited;
+    thrd_t thread;
+    int i;
+
+    for (i = 0; i < 3; i++)
+        raii_deferred(scope, RAII_FREE, memset(malloc(32), 0, 32));
+
+    ASSERT_EQ(0, (int)raii_inbox_drain());
+    ASSERT_EQ(thrd_success, thrd_create(&thread, release_scope, scope));
+    thrd_join(thread, NULL);
+    ASSERT_EQ(3, (int)raii_inbox_drain());
+
+    ASSERT_EQ(thrd_success, thrd_create(&thread, release_block, raii_inbox()));
+    thrd_join(thread, NULL);
+    ASSERT_EQ(1, (int)raii_inbox_drain());
+    ASSERT_EQ(0, (int)raii_inbox_drain());
+
+    scope = NULL;
+    ASSERT_EQ(thrd_success, thrd_create(&thread, orphan_scope, &scope));
+    thrd_join(thread, NULL);
+    raii_delete(scope);
+    ASSERT_EQ(0, (int)raii_inbox_drain());
+
+    ASSERT_EQ(thrd_success, thrd_create(&thread, queued_exit, &owner));
+    while (is_empty(atomic_ptr_load((void *volatile *)&owner)))
+        thrd_yield();
+    raii_free_to(owner, malloc(64));
+    ASSERT_UEQ((size_t)1, atomic_size_load(&owner->count));
+    exited = owner;
+    atomic_ptr_store((void *volatile *)&owner, NULL);
+    thrd_join(thread, NULL);
+    ASSERT_EQ(1, atomic_int_load(&exited->closed));
+    ASSERT_UEQ((size_t)0, atomic_size_load(&exited->count));
+    raii_free_to(exited, malloc(64));
+    ASSERT_UEQ((size_t)0, atomic_size_load(&exited->count));
+
+    ASSERT_EQ(thrd_success, thrd_create(&thread, flood_blocks, raii_inbox()));
+    thrd_join(thread, NULL);
+    ASSERT_EQ(RAII_INBOX_MAX, (int)raii_inbox_drain());
+    return 0;
+}
+
+static int moved_released = 0;
+static void moved_release(void *ptr) {
+    moved_released++;
+    free(ptr);
+}
+
+int test_move() {
+    unique_t *request = unique_init(), *connection = unique_init();
+    defer_handle_t handle;
+    void *block = malloc_by(request, 64), *other;
+
+    moved_released = 0;
+    ASSERT_NOTNULL(block);
+    ASSERT_EQ(true, raii_move(request, connection, block) != 0);
+    ASSERT_EQ(false, raii_move(request, connection, block) != 0);
+    ASSERT_UEQ((size_t)0, raii_deferred_count(request));
+    ASSERT_UEQ((size_t)1, raii_deferred_count(connection));
+
+    other = malloc(32);
+    handle = raii_deferred_arm(request, moved_release, other);
+    raii_deferred(request, moved_release, malloc(16));
+    handle = raii_deferred_move(request, handle, connection);
+    ASSERT_EQ(true, raii_deferred_armed(connection, handle));
+
+    /* request releases only what stayed with it */
+    raii_deferred_free(request);
+    ASSERT_EQ(1, moved_released);
+    memset(block, 0, 64);
+    raii_deferred_free(connection);
+    ASSERT_EQ(2, moved_released);
+    ASSERT_EQ(false, raii_deferred_armed(connection, handle));
+    raii_delete(request);
+    raii_delete(connection);
+    return 0;
+}
+
+static int child_order[4];
+static int child_fired = 0;
+static void child_mark(void *data) {
+    child_order[child_fired++] = (int)(intptr_t)data;
+}
+
+int test_children() {
+    unique_t *request = unique_init_arena(), *stage, *task, *early;
+    arena_mark_t mark;
+    char *bytes;
+
+    child_fired = 0;
+    malloc_by(request, 16);
+    mark = arena_mark((arena_t)request->arena);
+    stage = unique_child(request);
+    task = unique_child_arena(stage);
+    raii_deferred(stage, child_mark, (void *)1);
+    raii_deferred(task, child_mark, (void *)2);
+
+    early = unique_child_arena(request);
+    bytes = malloc_by(early, 128);
+    ASSERT_NOTNULL(bytes);
+    raii_deferred(early, child_mark, (void *)3);
+    raii_delete(early);
+    ASSERT_EQ(1, child_fired);
+    ASSERT_EQ(3, child_order[0]);
+    /* rewound to where child started */
+    ASSERT_EQ(true, (arena_mark((arena_t)request->arena).avail == mark.avail));
+    ASSERT_UEQ((size_t)1, raii_deferred_count(request));
+
+    /* whole tree released with root, each scope `LIFO`, a child where it was
+    registered, so `task`, made before `stage` mark, goes after it */
+    raii_delete(request);
+    ASSERT_EQ(3, child_fired);
+    ASSERT_EQ(1, child_order[1]);
+    ASSERT_EQ(2, child_order[2]);
+    return 0;
+}
+
+int test_recycle() {
+    unique_t *first = unique_init(), *again;
+    defer_handle_t stale = raii_deferred_arm(first, child_mark, (void *)1), fresh;
+
+    child_fired = 0;
+    raii_delete(first);
+    ASSERT_EQ(1, child_fired);
+
+    /* same memory handed back, cleared, prior handles no longer match */
+    again = unique_init();
+    ASSERT_EQ(true, (again == first));
+    ASSERT_UEQ((size_t)0, raii_deferred_count(again));
+    ASSERT_NULL(again->arena);
+    fresh = raii_deferred_arm(again, child_mark, (void *)2);
+    ASSERT_EQ(true, raii_deferred_armed(again, fresh));
+    ASSERT_EQ(false, raii_deferred_armed(again, stale));
+    raii_delete(again);
+    ASSERT_EQ(2, child_order[1]);
+    return 0;
+}
+
+static int reclaimed[4];
+static volatile size_t reclaim_count = 0;
+static thrd_t reclaim_thread;
+static void reclaim_mark(void *data) {
+    reclaim_thread = thrd_current();
+    reclaimed[atomic_size_add(&reclaim_count, 1)] = (int)(intptr_t)data;
+}
+
+int test_async() {
+    unique_t *scope = unique_init();
+
+    raii_deferred_async(scope, reclaim_mark, (void *)1);
+    raii_deferred_async(scope, reclaim_mark, (void *)2);
+    raii_deferred(scope, child_mark, (void *)3);
+    raii_deferred_async(scope, reclaim_mark, (void *)4);
+    child_fired = 0;
+    raii_delete(scope);
+    ASSERT_EQ(1, child_fired);
+
+    /* one batch, same `LIFO` order, not on this thread */
+    raii_reclaim_wait();
+    ASSERT_UEQ((size_t)3, reclaim_count);
+    ASSERT_EQ(4, reclaimed[0]);
+    ASSERT_EQ(2, reclaimed[1]);
+    ASSERT_EQ(1, reclaimed[2]);
+    ASSERT_EQ(false, thrd_equal(reclaim_thread, thrd_current()));
+    return 0;
+}
+
+raii_thread_local(int, tls_counter)
+static raii_tls_t tls_key;
+static volatile size_t tls_released = 0;
+static void tls_release(void *data) {
+    atomic_size_add(&tls_released, (size_t)(intptr_t)data);
+}
+
+static int tls_thread(void *arg) {
+    int i;
+
+    if (raii_tls_get(tls_key) != NULL || *tls_counter() != 0)
+        return -1;
+
+    raii_tls_set(tls_key, arg);
+    for (i = 0; i < 100; i++)
+        (*tls_counter())++;
+
+    return raii_tls_get(tls_key) == arg && *tls_counter() == 100 ? 0 : -1;
+}
+
+int test_tls() {
+    thrd_t threads[4];
+    int i, result;
+
+    ASSERT_EQ(thrd_success, raii_tls_create(&tls_key, 0, tls_release));
+    ASSERT_EQ(thrd_error, raii_tls_create(&tls_key, RAII_TLS_BYTES + 1, NULL));
+    *tls_counter() = 7;
+    for (i = 0; i < 4; i++)
+        thrd_create(&threads[i], tls_thread, (void *)(intptr_t)(i + 1));
+
+    /* each `thread` had it's own block, pointer slots released at it's exit */
+    for (i = 0; i < 4; i++) {
+        thrd_join(threads[i], &result);
+        ASSERT_EQ(0, result);
+    }
+
+    ASSERT_UEQ((size_t)10, tls_released);
+    ASSERT_EQ(7, *tls_counter());
+    ASSERT_NULL(raii_tls_get(tls_key));
+    return 0;
+}
+
 int test_main() {
     f();
     puts("Returned normally from f.");
@@ -52,6 +593,18 @@ int test_main() {
 int main(int argc, char **argv) {
 
     ASSERT_FUNC(test_main());
+    ASSERT_FUNC(test_inline_growth());
+    ASSERT_FUNC(test_handles());
+    ASSERT_FUNC(test_many());
+    ASSERT_FUNC(test_vectors());
+    ASSERT_FUNC(test_queues());
+    ASSERT_FUNC(test_guard_local());
+    ASSERT_FUNC(test_inbox());
+    ASSERT_FUNC(test_move());
+    ASSERT_FUNC(test_children());
+    ASSERT_FUNC(test_recycle());
+    ASSERT_FUNC(test_async());
+    ASSERT_FUNC(test_tls());
 
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,117 @@
+#include "raii.h"
+#include "test_assert.h"
+
+#define THREAD_COUNT 4
+#define SWAP_COUNT 20000
+#define NODE_LIVE 0x5eed
+
+typedef struct {
+    volatile int magic;
+    size_t value;
+} node_t;
+
+static void *volatile current = NULL;
+static volatile int running = 1;
+static volatile size_t torn = 0, freed = 0;
+static volatile int reader_state = 0;
+
+static void node_free(void *ptr) {
+    ((node_t *)ptr)->magic = 0;
+    RAII_FREE(ptr);
+    atomic_size_add(&freed, 1);
+}
+
+static node_t *node_new(size_t value) {
+    node_t *node = try_malloc(sizeof(node_t));
+    node->magic = NODE_LIVE;
+    node->value = value;
+    return node;
+}
+
+static int reader(void *arg) {
+    node_t *node;
+    while (atomic_int_load(&running)) {
+        ebr_enter();
+        node = (node_t *)atomic_ptr_load(&current);
+        if (node->magic != NODE_LIVE)
+            atomic_size_add(&torn, 1);
+        ebr_exit();
+    }
+
+    return 0;
+}
+
+int test_swap(void) {
+    thrd_t threads[THREAD_COUNT];
+    size_t i;
+
+    current = node_new(0);
+    for (i = 0; i < THREAD_COUNT; i++)
+        ASSERT_EQ(thrd_success, thrd_create(&threads[i], reader, NULL));
+
+    for (i = 1; i <= SWAP_COUNT; i++)
+        ebr_retire(atomic_ptr_swap(&current, node_new(i)), node_free);
+
+    atomic_int_store(&running, 0);
+    for (i = 0; i < THREAD_COUNT; i++)
+        thrd_join(threads[i], NULL);
+
+    ASSERT_UEQ((size_t)0, torn);
+    ASSERT_UEQ((size_t)0, ebr_flush());
+    ASSERT_UEQ((size_t)SWAP_COUNT, freed);
+    node_free(current);
+    return 0;
+}
+
+/* Reader parked inside it's section, holds back reclamation. */
+static int parked(void *arg) {
+    ebr_enter();
+    atomic_int_store(&reader_state, 1);
+    while (atomic_int_load(&reader_state) == 1)
+        thrd_yield();
+
+    ebr_exit();
+    return 0;
+}
+
+int test_lagging(void) {
+    thrd_t thread;
+    freed = 0;
+
+    ASSERT_EQ(thrd_success, thrd_create(&thread, parked, NULL));
+    while (atomic_int_load(&reader_state) == 0)
+        thrd_yield();
+
+    ebr_retire(node_new(1), node_free);
+    ASSERT_UEQ((size_t)1, ebr_flush());
+    ASSERT_UEQ((size_t)1, ebr_pending());
+    ASSERT_UEQ((size_t)0, freed);
+
+    atomic_int_store(&reader_state, 2);
+    thrd_join(thread, NULL);
+    ASSERT_UEQ((size_t)0, ebr_flush());
+    ASSERT_UEQ((size_t)1, freed);
+    return 0;
+}
+
+static int guarded_read(void)
+guard {
+    _ebr();
+    _return(0);
+} unguarded(1);
+
+int main(void) {
+    puts("\nebr_enter, ebr_retire, while readers run");
+    ASSERT_FUNC(test_swap());
+
+    puts("\nebr_flush, held back by lagging reader");
+    ASSERT_FUNC(test_lagging());
+
+    puts("\n_ebr, exited with guard scope");
+    ASSERT_EQ(0, guarded_read());
+    freed = 0;
+    ebr_retire(node_new(2), node_free);
+    ASSERT_UEQ((size_t)0, ebr_flush());
+    ASSERT_UEQ((size_t)1, freed);
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include "raii.h"
+#include "test_assert.h"
+
+typedef struct {
+    int x, y;
+} spot_t;
+
+typedef struct {
+    unsigned short port;
+    char *host;
+    double ratio;
+    spot_t at;
+    spot_t *origin;
+    void *opaque;
+} route_t;
+
+RAII_REFLECT(spot_reflect, spot_t,
+    RAII_FIELD(spot_t, x, RAII_INT),
+    RAII_FIELD(spot_t, y, RAII_INT));
+
+RAII_REFLECT(route_reflect, route_t,
+    RAII_FIELD(route_t, port, RAII_USHORT),
+    RAII_FIELD(route_t, host, RAII_CHAR_P),
+    RAII_FIELD(route_t, ratio, RAII_DOUBLE),
+    RAII_FIELD_OBJ(route_t, at, spot_reflect),
+    RAII_FIELD_PTR(route_t, origin, spot_reflect),
+    RAII_FIELD(route_t, opaque, RAII_PTR));
+
+int test_args(void) {
+    args_t local, view;
+    char buf[256];
+    size_t need;
+
+    args_local(&local, "dsSf", (int64_t)-42, "a string longer then inline", "tiny", 1.5);
+    ASSERT_UEQ((size_t)0, args_encode(args_local(&view, "p", buf), buf, sizeof(buf)));
+
+    need = args_encode(&local, NULL, 0);
+    ASSERT_EQ(true, (need > 0));
+    ASSERT_UEQ(need, args_encode(&local, buf, 8));
+    ASSERT_UEQ(need, args_encode(&local, buf, sizeof(buf)));
+    ASSERT_UEQ(need, raii_encoded_size(buf, sizeof(buf)));
+
+    ASSERT_NULL(args_view(&view, buf, need - 1));
+    ASSERT_NOTNULL(args_view(&view, buf, sizeof(buf)));
+    ASSERT_UEQ((size_t)4, view.n_args);
+    ASSERT_EQ(-42, (int)args_in(&view, 0).long_long);
+    ASSERT_STR("a string longer then inline", args_in(&view, 1).char_ptr);
+    ASSERT_EQ(true, (args_in(&view, 1).char_ptr > buf && args_in(&view, 1).char_ptr < buf + need));
+    ASSERT_STR("tiny", raii_value_string(&view.args[2]));
+    ASSERT_EQ(true, (args_in(&view, 3).precision == 1.5));
+
+    /* unterminated string */
+    need = args_encode(args_local(&local, "s", "abc"), buf, sizeof(buf));
+    ASSERT_NOTNULL(args_view(&view, buf, need));
+    buf[need - 1] = 'x';
+    ASSERT_NULL(args_view(&view, buf, need));
+    return 0;
+}
+
+int test_struct(unique_t *scope) {
+    spot_t origin = {-5, 9};
+    route_t route = {8080, "example.org", 0.25, {1, 2}, NULL, NULL}, view;
+    char buf[256];
+    size_t need;
+
+    route.origin = &origin;
+    route.opaque = &route;
+    need = reflect_encode(&route_reflect, &route, buf, sizeof(buf));
+    ASSERT_EQ(true, (need > 0 && need <= sizeof(buf)));
+    ASSERT_UEQ((size_t)0, reflect_view(NULL, &route_reflect, &view, buf, need));
+    ASSERT_UEQ((size_t)0, reflect_view(scope, &spot_reflect, &view, buf, need));
+    ASSERT_UEQ(need, reflect_view(scope, &route_reflect, &view, buf, need));
+
+    ASSERT_EQ(8080, view.port);
+    ASSERT_STR("example.org", view.host);
+    ASSERT_EQ(true, (view.host > buf && view.host < buf + need));
+    ASSERT_EQ(true, (view.ratio == 0.25));
+    ASSERT_EQ(2, view.at.y);
+    ASSERT_EQ(-5, view.origin->x);
+    ASSERT_NULL(view.opaque);
+
+    route.origin = NULL;
+    route.host = NULL;
+    need = reflect_encode(&route_reflect, &route, buf, sizeof(buf));
+    ASSERT_UEQ(need, reflect_view(NULL, &route_reflect, &view, buf, need));
+    ASSERT_NULL(view.host);
+    ASSERT_NULL(view.origin);
+    return 0;
+}
+
+int main(void) {
+    unique_t *scope = unique_init();
+    puts("\nargs_encode, args_view");
+    ASSERT_FUNC(test_args());
+
+    puts("\nreflect_encode, reflect_view");
+    ASSERT_FUNC(test_struct(scope));
+    raii_delete(scope);
+    return 0;
+}
@@ -0,0 +1,136 @@
+#include "raii.h"
+#include "test_assert.h"
+
+#define THREAD_COUNT 4
+#define EMIT_COUNT 20000
+
+static event_t *shared = NULL;
+static volatile size_t summed = 0;
+static volatile int churning = 1;
+
+static void on_add(void *data, void *arg) {
+    atomic_size_add((volatile size_t *)data, (size_t)arg);
+}
+
+static void on_count(void *data, void *arg) {
+    (*(int *)data)++;
+}
+
+static int emitter(void *arg) {
+    size_t i;
+    for (i = 0; i < EMIT_COUNT; i++)
+        event_emit(shared, (void *)1);
+
+    return 0;
+}
+
+/* Subscribe and unsubscribe while others emit, forcing snapshots to retire. */
+static int churner(void *arg) {
+    volatile size_t ignored = 0;
+    while (atomic_int_load(&churning))
+        event_off(shared, event_on(NULL, shared, on_add, (void *)&ignored));
+
+    return 0;
+}
+
+int test_emit(void) {
+    event_t *ev = event_create(NULL);
+    volatile size_t sum = 0;
+    int calls = 0;
+    size_t first, second;
+    void *batch[3];
+
+    ASSERT_UEQ((size_t)0, event_emit(ev, (void *)1));
+    first = event_on(NULL, ev, on_add, (void *)&sum);
+    second = event_on(NULL, ev, on_count, &calls);
+    ASSERT_UEQ((size_t)2, event_count(ev));
+    ASSERT_UEQ((size_t)2, event_emit(ev, (void *)5));
+    ASSERT_UEQ((size_t)5, sum);
+    ASSERT_EQ(1, calls);
+
+    batch[0] = (void *)1;
+    batch[1] = (void *)2;
+    batch[2] = (void *)3;
+    ASSERT_UEQ((size_t)2, event_emit_batch(ev, batch, 3));
+    ASSERT_UEQ((size_t)11, sum);
+    ASSERT_EQ(4, calls);
+
+    ASSERT_EQ(true, event_off(ev, first));
+    ASSERT_EQ(false, event_off(ev, first));
+    ASSERT_UEQ((size_t)1, event_emit(ev, (void *)7));
+    ASSERT_UEQ((size_t)11, sum);
+    ASSERT_EQ(true, event_off(ev, second));
+    ASSERT_UEQ((size_t)0, event_count(ev));
+    event_free(ev);
+    return 0;
+}
+
+static int subscribed(event_t *ev, int *calls)
+guard {
+    int called;
+    _event_on(ev, on_count, calls);
+    called = (int)event_emit(ev, NULL);
+    _return(called);
+} unguarded(0);
+
+/* Emits until `limit` calls passed, unwinding with listener still on. */
+static int subscribed_past(event_t *ev, int *calls, int limit)
+guard {
+    _event_on(ev, on_count, calls);
+    while (event_emit(ev, NULL) > 0) {
+        if (*calls > limit)
+            throw(range_error);
+    }
+} unguarded(0);
+
+int test_threads(void) {
+    thrd_t threads[THREAD_COUNT], churn;
+    int i;
+
+    shared = event_create(NULL);
+    event_on(NULL, shared, on_add, (void *)&summed);
+    ASSERT_EQ(thrd_success, thrd_create(&churn, churner, NULL));
+    for (i = 0; i < THREAD_COUNT; i++)
+        ASSERT_EQ(thrd_success, thrd_create(&threads[i], emitter, NULL));
+
+    for (i = 0; i < THREAD_COUNT; i++)
+        thrd_join(threads[i], NULL);
+
+    atomic_int_store(&churning, 0);
+    thrd_join(churn, NULL);
+    ASSERT_UEQ((size_t)(THREAD_COUNT * EMIT_COUNT), summed);
+    ASSERT_UEQ((size_t)1, event_count(shared));
+    event_free(shared);
+    return 0;
+}
+
+int main(void) {
+    event_t *ev = event_create(NULL);
+    volatile int caught = 0;
+    int calls = 0;
+
+    puts("\nevent_on, event_emit, event_emit_batch, event_off");
+    ASSERT_FUNC(test_emit());
+
+    puts("\n_event_on, unsubscribed on scope exit");
+    ASSERT_EQ(1, subscribed(ev, &calls));
+    ASSERT_EQ(1, calls);
+    ASSERT_UEQ((size_t)0, event_count(ev));
+
+    puts("\n_event_on, unsubscribed on unwind");
+    calls = 0;
+    try {
+        subscribed_past(ev, &calls, 3);
+    } catch (range_error) {
+        caught = 1;
+    } end_trying;
+    ASSERT_EQ(1, caught);
+    ASSERT_EQ(4, calls);
+    ASSERT_UEQ((size_t)0, event_count(ev));
+    ASSERT_UEQ((size_t)0, event_emit(ev, NULL));
+    event_free(ev);
+
+    puts("\nevent_emit, while other threads subscribe/unsubscribe");
+    ASSERT_FUNC(test_threads());
+    return 0;
+}
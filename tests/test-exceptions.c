@@ -190,6 +190,350 @@ int test_finally(void) {
     return 0;
 }
 
+/* Without signal mask saving, same signal must still be catchable again */
+int test_fast_try(void) {
+    int caught = 0, i;
+
+    for (i = 0; i < 3; i++) {
+        ex_try_fast {
+            raise(SIGINT);
+        } catch (sig_int) {
+            caught++;
+        } end_trying;
+    }
+
+    ex_try_signal {
+        raise(SIGINT);
+    } catch (sig_int) {
+        caught++;
+    } end_trying;
+
+    ASSERT_EQ(4, caught);
+    return 0;
+}
+
+#if !defined(_WIN32)
+static int recurse(volatile char *parent) {
+    volatile char frame[512];
+    frame[0] = parent ? parent[0] + 1 : 0;
+    return recurse(frame) + frame[1];
+}
+
+/* Registered `thread` recovers from overflowing it's stack, again and again */
+int test_stack_overflow(void) {
+    int caught = 0, i;
+
+    ASSERT_EQ(0, ex_signal_thread(0));
+    for (i = 0; i < 3; i++) {
+        try {
+            recurse(NULL);
+        } catch (stack_overflow) {
+            caught++;
+        } end_trying;
+    }
+
+    try {
+        raise(SIGSEGV);
+    } catch (stack_overflow) {
+        caught = -1;
+    } catch (sig_segv) {
+        caught++;
+    } end_trying;
+
+    try {
+        recurse(NULL);
+    } catch (sig_segv) {
+        caught++;
+    } end_trying;
+
+    ex_signal_thread_free();
+    ASSERT_EQ(5, caught);
+    return 0;
+}
+
+/* Stack bounds of an non-main `thread` are it's own, not `RLIMIT_STACK`. */
+static int overflow_thread(void *arg) {
+    int caught = 0;
+    if (ex_signal_thread(0) != 0)
+        return -1;
+
+    try {
+        recurse(NULL);
+    } catch (stack_overflow) {
+        caught = 1;
+    } end_trying;
+
+    ex_signal_thread_free();
+    return caught;
+}
+
+int test_thread_overflow(void) {
+    thrd_t thread;
+    int result = 0;
+
+    ASSERT_EQ(thrd_success, thrd_create(&thread, overflow_thread, NULL));
+    thrd_join(thread, &result);
+    ASSERT_EQ(1, result);
+    return 0;
+}
+#endif
+
+EX_EXCEPTION(io_error);
+EX_EXCEPTION(file_missing);
+
+/* catch of an base exception class, also catches subclasses */
+int test_classes(void) {
+    int caught = 0;
+    ex_extends(file_missing, io_error);
+    ASSERT_EQ(true, ex_is_a(EX_NAME(file_missing), EX_NAME(io_error)));
+    ASSERT_EQ(false, ex_is_a(EX_NAME(io_error), EX_NAME(file_missing)));
+
+    try {
+        throw(file_missing);
+    } catch (sig_int) {
+        caught = -1;
+    } catch (io_error) {
+        ASSERT_STR("file_missing", err);
+        caught = 1;
+    } end_trying;
+
+    ASSERT_EQ(1, caught);
+    return 0;
+}
+
+/* raw addresses of last throw, only recorded with `EX_BACKTRACE` */
+int test_backtrace(void) {
+    void *frames[EX_BACKTRACE_DEPTH];
+    try {
+        throw(io_error);
+    } catch_any {
+    } end_trying;
+
+#ifdef EX_BACKTRACE
+    ASSERT_EQ(true, ex_backtrace(frames, EX_BACKTRACE_DEPTH) > 0);
+#else
+    ASSERT_EQ(0, ex_backtrace(frames, EX_BACKTRACE_DEPTH));
+#endif
+    return 0;
+}
+
+EX_EXCEPTION(parse_error);
+
+ex_result_t parse_digit(char c) {
+    if (c < '0' || c > '9')
+        ex_fail(parse_error, "not a digit");
+
+    return ex_ok((intptr_t)(c - '0'));
+}
+
+ex_result_t parse_pair(const char *text) {
+    try_result(parse_digit(text[0]));
+    ex_result_t second = parse_digit(text[1]);
+    propagate(second);
+    return second;
+}
+
+int result_defers = 0;
+void result_defer(void *arg) {
+    result_defers++;
+}
+
+ex_result_t parse_guarded(const char *text)
+guard {
+    _defer(result_defer, NULL);
+    _propagate(parse_pair(text));
+    _return(ex_ok(1));
+} unguarded(ex_ok(0));
+
+/* error results, without any `longjmp` */
+int test_result(void) {
+    int caught = 0;
+    ex_result_t result = parse_pair("42");
+    ASSERT_EQ(true, ex_is_ok(result));
+    ASSERT_EQ(2, (int)(intptr_t)result.value);
+
+    result = parse_pair("4x");
+    ASSERT_EQ(false, ex_is_ok(result));
+    ASSERT_EQ(true, ex_result_is(result, parse_error));
+    ASSERT_STR("not a digit", result.message);
+
+    ASSERT_EQ(false, ex_is_ok(parse_guarded("x1")));
+    ASSERT_EQ(true, ex_is_ok(parse_guarded("12")));
+    ASSERT_EQ(2, result_defers);
+
+    try {
+        ex_unwrap(parse_digit('z'));
+    } catch (parse_error) {
+        caught = 1;
+    } end_trying;
+
+    ASSERT_EQ(1, caught);
+    return 0;
+}
+
+/* allocation failures, caught as `bad_alloc` and base classes */
+int test_out_of_memory(void) {
+    int caught = 0;
+    void *volatile ptr = NULL;
+
+    try {
+        ptr = try_malloc(SIZE_MAX);
+    } catch (bad_alloc) {
+        caught = 1;
+        ASSERT_STR("Malloc failed!", ex_err.panic);
+    } end_trying;
+    ASSERT_EQ(1, caught);
+    ASSERT_EQ(ENOMEM, errno);
+
+    try {
+        ptr = try_calloc(2, SIZE_MAX / 2);
+    } catch (out_of_memory) {
+        caught = 2;
+    } end_trying;
+    ASSERT_EQ(2, caught);
+
+    try {
+        ptr = try_malloc(SIZE_MAX);
+    } catch (panic) {
+        caught = 3;
+    } end_trying;
+    ASSERT_EQ(3, caught);
+    ASSERT_NULL(ptr);
+
+    return 0;
+}
+
+static int hook_calls = 0;
+static void hook_throw(ex_context_t *ctx, const char *ex, const char *message) {
+    hook_calls++;
+}
+
+/* throw hook and per thread throw site counters, counted with `RAII_STATS` */
+int test_stats(void) {
+    ex_stats_t sites[EX_STATS_SITES];
+    int i, count;
+
+    ex_stats_reset();
+    exception_throw_hook = hook_throw;
+    for (i = 0; i < 3; i++) {
+        try {
+            throw(io_error);
+        } catch (io_error) {
+        } end_trying;
+    }
+    exception_throw_hook = NULL;
+    ASSERT_EQ(3, hook_calls);
+
+    count = ex_stats(sites, EX_STATS_SITES);
+#ifdef RAII_STATS
+    ASSERT_EQ(1, count);
+    ASSERT_STR("io_error", sites[0].ex);
+    ASSERT_EQ(3, (int)sites[0].thrown);
+    ASSERT_EQ(3, (int)sites[0].caught);
+    ex_stats_dump();
+#else
+    ASSERT_EQ(0, count);
+#endif
+    return 0;
+}
+
+static int protect_freed = 0;
+static void protect_free(void *ptr) {
+    protect_freed++;
+    free(ptr);
+}
+
+static void protect_nested(void) {
+    char *inner = malloc(8);
+    protected(inner, protect_free);
+    throw(io_error);
+}
+
+/* protected pointers released on unwinding, only those of the throwing `try` */
+int test_protected(void) {
+    char *outer = malloc(8);
+    protected(outer, protect_free);
+    try {
+        char *first = malloc(8);
+        protected(first, protect_free);
+        char *second = NULL;
+        protected(second, protect_free);
+        try {
+            protect_nested();
+        } catch (io_error) {
+            ASSERT_EQ(1, protect_freed);
+        } end_trying;
+        second = malloc(8);
+        throw(io_error);
+    } catch_any {
+        ASSERT_EQ(3, protect_freed);
+    } end_trying;
+
+    ASSERT_EQ(3, protect_freed);
+    unprotected(outer);
+    free(outer);
+    return 0;
+}
+
+#if !defined(_WIN32)
+/* Protection of frame `siglongjmp` discards, released once `try` lands. */
+static void protect_fault(void) {
+    char *leaf = malloc(8);
+    protected(leaf, protect_free);
+    recurse(NULL);
+}
+
+int test_signal_protected(void) {
+    protect_freed = 0;
+    ASSERT_EQ(0, ex_signal_thread(0));
+    try {
+        protect_fault();
+    } catch (stack_overflow) {
+        ASSERT_EQ(1, protect_freed);
+    } end_trying;
+
+    ASSERT_EQ(1, protect_freed);
+    ex_signal_thread_free();
+    return 0;
+}
+#endif
+
+static void read_config(const char *path) {
+    raii_error_t *cause = raii_error(NULL, 2, "open %s failed", path);
+    throw_error(io_error, raii_error(cause, 22, "config %s unreadable, line %d", path, 7));
+}
+
+/* formatted error records, chained, reached from `catch`, none allocated */
+int test_error_context(void) {
+    raii_error_t *record = NULL;
+    int i;
+
+    try {
+        read_config("app.ini");
+    } catch (io_error) {
+        record = raii_error_caught();
+    } end_trying;
+
+    ASSERT_NOTNULL(record);
+    ASSERT_XEQ(RAII_ERR_CONTEXT, record->type);
+    ASSERT_EQ(22, record->code);
+    ASSERT_STR("config app.ini unreadable, line 7", record->message);
+    ASSERT_STR("io_error", record->ex);
+    ASSERT_EQ(true, (record == raii_error_last()));
+    ASSERT_UEQ((size_t)2, raii_error_depth(record));
+    ASSERT_EQ(2, record->cause->code);
+    ASSERT_STR("open app.ini failed", record->cause->message);
+    ASSERT_NULL(raii_error_of("plain message"));
+
+    /* cause record reused, chain ends instead of dangling */
+    for (i = 0; i < RAII_ERR_DEPTH - 1; i++)
+        raii_error(NULL, i, "filler %d", i);
+
+    ASSERT_NULL(record->cause);
+    ASSERT_UEQ((size_t)1, raii_error_depth(record));
+    return 0;
+}
+
 int test_list(void)
 {
     test_basic_catch();
@@ -199,6 +543,21 @@ int test_list(void)
     test_rethrow();
     test_throw_in_finally();
     test_assert();
+    test_fast_try();
+#if !defined(_WIN32)
+    test_stack_overflow();
+    test_thread_overflow();
+#endif
+    test_classes();
+    test_backtrace();
+    test_result();
+    test_error_context();
+    test_out_of_memory();
+    test_stats();
+    test_protected();
+#if !defined(_WIN32)
+    test_signal_protected();
+#endif
 
     return 0;
 }
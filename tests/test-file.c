@@ -0,0 +1,226 @@
+#include "raii.h"
+#include "test_assert.h"
+#include <fcntl.h>
+#if !defined(_WIN32)
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/socket.h>
+#endif
+
+#define TEST_FILE "test-file.tmp"
+#define TEST_COPY "test-file-copy.tmp"
+
+static int write_file(const char *path, const char *text) {
+    FILE *file = fopen(path, "wb");
+    if (is_empty(file))
+        return -1;
+
+    fputs(text, file);
+    fclose(file);
+    return 0;
+}
+
+int test_mmap(void) {
+    raii_map_t *map;
+    FILE *file;
+    char line[16];
+
+    ASSERT_EQ(0, write_file(TEST_FILE, "mapped contents"));
+    ASSERT_NULL(raii_mmap(NULL, "test-file-missing.tmp", RAII_MAP_READ));
+
+    ASSERT_NOTNULL((map = raii_mmap(NULL, TEST_FILE, RAII_MAP_SEQUENTIAL | RAII_MAP_PREFETCH | RAII_MAP_HUGE)));
+    ASSERT_XEQ(RAII_MAP_VALUE, map->type);
+    ASSERT_UEQ((size_t)15, map->length);
+    ASSERT_EQ(0, memcmp(map->data, "mapped contents", 15));
+    raii_munmap(map);
+
+    ASSERT_NOTNULL((map = raii_mmap(NULL, TEST_FILE, RAII_MAP_WRITE)));
+    memcpy(map->data, "MAPPED", 6);
+    raii_munmap(map);
+
+    ASSERT_NOTNULL((file = fopen(TEST_FILE, "rb")));
+    ASSERT_NOTNULL(fgets(line, sizeof(line), file));
+    fclose(file);
+    ASSERT_STR("MAPPED contents", line);
+
+    ASSERT_EQ(0, write_file(TEST_FILE, ""));
+    ASSERT_NOTNULL((map = raii_mmap(NULL, TEST_FILE, RAII_MAP_READ)));
+    ASSERT_NULL(map->data);
+    ASSERT_UEQ((size_t)0, map->length);
+    raii_munmap(map);
+    return 0;
+}
+
+int test_buffered(void) {
+    raii_io_t *io;
+    char line[64], big[RAII_IO_BUFFER + 10];
+    long got;
+    int fd, i;
+
+    ASSERT_EQ(-1, raii_open(NULL, "test-file-missing.tmp", O_RDONLY, 0));
+    ASSERT_EQ(true, ((fd = raii_open(NULL, TEST_FILE, O_WRONLY | O_CREAT | O_TRUNC, 0644)) >= 0));
+    io = raii_writer(NULL, fd);
+    for (i = 0; i < 1000; i++) {
+        sprintf(line, "line %d\n", i);
+        ASSERT_EQ(true, (raii_write(io, line, strlen(line)) > 0));
+    }
+
+    memset(big, 'x', sizeof(big));
+    big[sizeof(big) - 1] = '\n';
+    ASSERT_EQ((long)sizeof(big), raii_write(io, big, sizeof(big)));
+    raii_io_free(io);
+    ASSERT_EQ(0, raii_close(fd));
+
+    ASSERT_EQ(true, ((fd = raii_open(NULL, TEST_FILE, O_RDONLY, 0)) >= 0));
+    io = raii_reader(NULL, fd);
+    for (i = 0; i < 1000; i++) {
+        sprintf(big, "line %d\n", i);
+        ASSERT_EQ((long)strlen(big), raii_read_line(io, line, sizeof(line)));
+        ASSERT_STR(big, line);
+    }
+
+    /* longer then line buffer, read in pieces */
+    ASSERT_EQ((long)sizeof(line) - 1, raii_read_line(io, line, sizeof(line)));
+    ASSERT_EQ('x', line[0]);
+    for (got = (long)sizeof(line) - 1; (i = (int)raii_read(io, big, sizeof(big))) > 0; got += i);
+    ASSERT_EQ((long)RAII_IO_BUFFER + 10, got);
+    ASSERT_EQ(0, (int)raii_read_line(io, line, sizeof(line)));
+    raii_io_free(io);
+    raii_close(fd);
+    return 0;
+}
+
+/* Maps `TEST_FILE`, a view not starting with `magic` unwinds. */
+static int mapped_header(const char *magic, void **data, size_t *length)
+guard {
+    raii_map_t *map = _mmap(TEST_FILE, RAII_MAP_RANDOM | RAII_MAP_PREFETCH);
+    *data = map->data;
+    *length = map->length;
+    if (map->length < strlen(magic) || memcmp(map->data, magic, strlen(magic)) != 0)
+        throw(invalid_type);
+} unguarded(0);
+
+/* View gone once scope is, page no longer mapped. */
+static int unmapped(void *data, size_t length) {
+#if !defined(_WIN32)
+    errno = 0;
+    ASSERT_EQ(-1, msync(data, length, MS_ASYNC));
+    ASSERT_EQ(ENOMEM, errno);
+#endif
+    return 0;
+}
+
+int test_mapped(void) {
+    volatile int caught = 0;
+    void *data = NULL;
+    size_t length = 0;
+
+    ASSERT_EQ(0, write_file(TEST_FILE, "scoped view"));
+    try {
+        mapped_header("RIFF", &data, &length);
+    } catch (invalid_type) {
+        caught = 1;
+    } end_trying;
+    ASSERT_EQ(1, caught);
+    ASSERT_UEQ((size_t)11, length);
+    ASSERT_FUNC(unmapped(data, length));
+
+    ASSERT_EQ(0, mapped_header("scoped", &data, &length));
+    ASSERT_FUNC(unmapped(data, length));
+    return 0;
+}
+
+/* Copies `TEST_FILE` lines to `TEST_COPY` through scope owned descriptors and
+buffers, a line missing it's newline unwinds, what was copied gets flushed. */
+static int copy_lines(int *in, int *out)
+guard {
+    _assign_ptr(scope);
+    raii_io_t *reader, *writer;
+    char line[64];
+    long got;
+
+    *in = _file_open(TEST_FILE, O_RDONLY, 0);
+    *out = _file_open(TEST_COPY, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    reader = raii_reader(scope, *in);
+    writer = raii_writer(scope, *out);
+    while ((got = raii_read_line(reader, line, sizeof(line))) > 0) {
+        if (line[got - 1] != '\n')
+            throw(range_error);
+
+        raii_write(writer, line, got);
+    }
+} unguarded(0);
+
+#if !defined(_WIN32)
+static int socket_scoped(raii_socket_t *sock)
+guard {
+    _assign_ptr(scope);
+    *sock = raii_socket(scope, AF_INET, SOCK_STREAM, 0);
+} unguarded(0);
+#endif
+
+/* Descriptor no longer open. */
+static int closed(int fd) {
+    ASSERT_EQ(true, (fd >= 0));
+    ASSERT_EQ(-1, raii_close(fd));
+#if !defined(_WIN32)
+    errno = 0;
+    ASSERT_EQ(-1, fcntl(fd, F_GETFD));
+    ASSERT_EQ(EBADF, errno);
+#endif
+    return 0;
+}
+
+int test_copied(void) {
+    volatile int caught = 0;
+#if !defined(_WIN32)
+    raii_socket_t sock = RAII_BAD_SOCKET;
+#endif
+    int in = -1, out = -1;
+    FILE *file;
+    char text[32];
+
+    ASSERT_EQ(0, write_file(TEST_FILE, "first\nsecond\ncut"));
+    try {
+        copy_lines(&in, &out);
+    } catch (range_error) {
+        caught = 1;
+    } end_trying;
+    ASSERT_EQ(1, caught);
+    ASSERT_FUNC(closed(in));
+    ASSERT_FUNC(closed(out));
+
+    ASSERT_NOTNULL((file = fopen(TEST_COPY, "rb")));
+    ASSERT_UEQ((size_t)13, fread(text, 1, sizeof(text), file));
+    fclose(file);
+    ASSERT_EQ(0, memcmp(text, "first\nsecond\n", 13));
+
+    ASSERT_EQ(0, write_file(TEST_FILE, "whole\n"));
+    ASSERT_EQ(0, copy_lines(&in, &out));
+    ASSERT_FUNC(closed(in));
+    ASSERT_FUNC(closed(out));
+
+#if !defined(_WIN32)
+    ASSERT_EQ(0, socket_scoped(&sock));
+    ASSERT_EQ(true, (sock != RAII_BAD_SOCKET));
+    ASSERT_EQ(-1, raii_socket_close(sock));
+#endif
+    remove(TEST_COPY);
+    return 0;
+}
+
+int main(void) {
+    puts("\nraii_mmap, raii_munmap");
+    ASSERT_FUNC(test_mmap());
+
+    puts("\nraii_mmap, unmapped on unwind");
+    ASSERT_FUNC(test_mapped());
+
+    puts("\nraii_reader, raii_writer");
+    ASSERT_FUNC(test_buffered());
+
+    puts("\nraii_open, raii_socket, raii_reader, raii_writer, released on unwind");
+    ASSERT_FUNC(test_copied());
+    remove(TEST_FILE);
+    return 0;
+}
@@ -0,0 +1,142 @@
+#include "raii.h"
+#include "test_assert.h"
+
+#define KEY_COUNT 50000
+
+int test_basic(void) {
+    hash_t *map = hash_create(NULL, 0);
+    const char *key;
+    size_t cursor = 0, length, seen = 0;
+    void *value;
+
+    ASSERT_NULL(hash_str_get(map, "missing"));
+    hash_str_put(map, "session", (void *)1);
+    hash_str_put(map, "route", (void *)2);
+    ASSERT_UEQ((size_t)2, hash_count(map));
+    ASSERT_EQ(1, (int)(intptr_t)hash_str_get(map, "session"));
+    ASSERT_EQ(2, (int)(intptr_t)hash_str_get(map, "route"));
+
+    hash_str_put(map, "route", (void *)3);
+    ASSERT_UEQ((size_t)2, hash_count(map));
+    ASSERT_EQ(3, (int)(intptr_t)hash_str_get(map, "route"));
+
+    while (hash_next(map, &cursor, &key, &length, &value)) {
+        ASSERT_UEQ(strlen(key), length);
+        seen++;
+    }
+    ASSERT_UEQ((size_t)2, seen);
+
+    ASSERT_EQ(true, hash_str_remove(map, "session"));
+    ASSERT_EQ(false, hash_str_remove(map, "session"));
+    ASSERT_EQ(false, hash_has(map, "session", 7));
+    ASSERT_UEQ((size_t)1, hash_count(map));
+    hash_free(map);
+    return 0;
+}
+
+/* Integer keys, growth, and tombstones reused, across many inserts and removes. */
+int test_many(void) {
+    hash_t *map = hash_create(NULL, 16);
+    size_t i, missing = 0, wrong = 0;
+
+    for (i = 0; i < KEY_COUNT; i++)
+        hash_put(map, &i, sizeof(i), (void *)(i + 1));
+
+    ASSERT_UEQ((size_t)KEY_COUNT, hash_count(map));
+    for (i = 0; i < KEY_COUNT; i += 2)
+        hash_remove(map, &i, sizeof(i));
+
+    for (i = 0; i < KEY_COUNT; i++) {
+        void *value = hash_get(map, &i, sizeof(i));
+        if (i % 2 == 0)
+            wrong += !is_empty(value);
+        else if ((size_t)value != i + 1)
+            missing++;
+    }
+    ASSERT_UEQ((size_t)0, wrong);
+    ASSERT_UEQ((size_t)0, missing);
+
+    for (i = 0; i < KEY_COUNT; i += 2)
+        hash_put(map, &i, sizeof(i), (void *)i);
+
+    ASSERT_UEQ((size_t)KEY_COUNT, hash_count(map));
+    i = 1000;
+    ASSERT_UEQ((size_t)1000, (size_t)hash_get(map, &i, sizeof(i)));
+    hash_free(map);
+    return 0;
+}
+
+int test_arena(void) {
+    arena_t arena = arena_init(0);
+    hash_t *map = hash_create_arena(arena, 4);
+    char name[32];
+    int i;
+
+    for (i = 0; i < 1000; i++) {
+        snprintf(name, sizeof(name), "route-%d", i);
+        hash_str_put(map, name, (void *)(intptr_t)i);
+    }
+
+    ASSERT_EQ(777, (int)(intptr_t)hash_str_get(map, "route-777"));
+    hash_free(map);
+    arena_free(arena);
+    return 0;
+}
+
+EX_EXCEPTION(route_missing);
+
+static size_t held = 0;
+
+/* Routing table of guard, it's keys in map's own arena, a missing route unwinds it. */
+static int hash_route(const char *path)
+guard {
+    hash_t *routes = _hash(8);
+    char name[32];
+    int i;
+
+    for (i = 0; i < 1000; i++) {
+        snprintf(name, sizeof(name), "route-%d", i);
+        hash_str_put(routes, name, (void *)(intptr_t)(i + 1));
+    }
+
+    held = arena_thread_stats().chunks;
+    if (is_empty(hash_str_get(routes, path)))
+        throw(route_missing);
+} unguarded(0);
+
+int test_unwind(void) {
+    size_t chunks = arena_thread_stats().chunks;
+    volatile int caught = 0;
+
+    try {
+        hash_route("route-1000");
+    } catch (route_missing) {
+        caught = 1;
+    } end_trying;
+
+    /* key arena chunks handed back, counted with `RAII_STATS`, on in `Debug` builds */
+    ASSERT_EQ(1, caught);
+#ifdef RAII_STATS
+    ASSERT_EQ(true, (held > chunks));
+#endif
+    ASSERT_UEQ(chunks, arena_thread_stats().chunks);
+
+    ASSERT_EQ(0, hash_route("route-999"));
+    ASSERT_UEQ(chunks, arena_thread_stats().chunks);
+    return 0;
+}
+
+int main(void) {
+    puts("\nhash_put, hash_get, hash_remove");
+    ASSERT_FUNC(test_basic());
+
+    puts("\nhash_put, integer keys, growth");
+    ASSERT_FUNC(test_many());
+
+    puts("\nhash_create_arena");
+    ASSERT_FUNC(test_arena());
+
+    puts("\nhash_create, released on unwind");
+    ASSERT_FUNC(test_unwind());
+    return 0;
+}
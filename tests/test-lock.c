@@ -0,0 +1,125 @@
+#include "raii.h"
+#include "test_assert.h"
+
+#define LOCK_THREADS 4
+#define LOCK_ROUNDS 2000
+
+static mtx_t counted[1];
+static cnd_t signalled[1];
+static volatile int total = 0;
+static bool ready = false;
+static raii_mutex_t spinning = RAII_MUTEX_INIT;
+static volatile int spun = 0;
+
+static int hammer(void *arg) {
+    int i;
+    for (i = 0; i < LOCK_ROUNDS; i++) {
+        mtx_lock(counted);
+        total++;
+        mtx_unlock(counted);
+    }
+
+    return 0;
+}
+
+static int hammer_mutex(void *arg) {
+    int i;
+    for (i = 0; i < LOCK_ROUNDS; i++) {
+        raii_mutex_lock(&spinning);
+        spun++;
+        /* hold long enough, some waiters park */
+        if (i % 64 == 0)
+            thrd_yield();
+        raii_mutex_unlock(&spinning);
+    }
+
+    return 0;
+}
+
+static int signal_ready(void *arg) {
+    thrd_sleep(time_spec(0, 1000000), NULL);
+    mtx_lock(counted);
+    ready = true;
+    cnd_signal(signalled);
+    mtx_unlock(counted);
+    return 0;
+}
+
+int test_profile(void) {
+    thrd_t threads[LOCK_THREADS], signaller;
+    raii_lock_stats_t stats[8];
+    char text[4096];
+    FILE *file = tmpfile();
+    size_t length;
+    int i, count;
+
+    ASSERT_NOTNULL(file);
+    raii_lock_reset();
+    ASSERT_EQ(thrd_success, mtx_init(counted, mtx_plain));
+    ASSERT_EQ(thrd_success, cnd_init(signalled));
+    raii_lock_name(counted, "counted");
+    for (i = 0; i < LOCK_THREADS; i++)
+        thrd_create(&threads[i], hammer, NULL);
+
+    for (i = 0; i < LOCK_THREADS; i++)
+        thrd_join(threads[i], NULL);
+
+    thrd_create(&signaller, signal_ready, NULL);
+    mtx_lock(counted);
+    while (!ready)
+        cnd_wait(signalled, counted);
+    mtx_unlock(counted);
+    thrd_join(signaller, NULL);
+    ASSERT_EQ(LOCK_THREADS * LOCK_ROUNDS, total);
+
+    count = raii_lock_stats(stats, 8);
+    ASSERT_EQ(count, raii_lock_report(file));
+    rewind(file);
+    length = fread(text, 1, sizeof(text) - 1, file);
+    text[length] = '\0';
+    fclose(file);
+#ifdef RAII_LOCK_PROFILE
+    ASSERT_EQ(true, (count >= 1));
+    for (i = 0; i < count && stats[i].lock != counted; i++);
+    ASSERT_EQ(true, (i < count));
+    ASSERT_STR("counted", stats[i].name);
+    /* hammers, main thread once, signaller once, main again out of `cnd_wait` */
+    ASSERT_EQ(true, (stats[i].acquired >= LOCK_THREADS * LOCK_ROUNDS + 2));
+    ASSERT_EQ(true, (stats[i].cnd_waits >= 1));
+    ASSERT_EQ(true, (stats[i].contended == 0 || stats[i].wait_ns > 0));
+    ASSERT_NOTNULL(strstr(text, "counted"));
+    ASSERT_NOTNULL(strstr(stats[i].file, "test-lock.c"));
+#else
+    ASSERT_EQ(0, count);
+#endif
+    mtx_destroy(counted);
+    cnd_destroy(signalled);
+    return 0;
+}
+
+int test_mutex(void) {
+    thrd_t threads[LOCK_THREADS];
+    int i;
+
+    ASSERT_EQ(true, raii_mutex_trylock(&spinning));
+    ASSERT_EQ(false, raii_mutex_trylock(&spinning));
+    raii_mutex_unlock(&spinning);
+
+    for (i = 0; i < LOCK_THREADS; i++)
+        thrd_create(&threads[i], hammer_mutex, NULL);
+
+    for (i = 0; i < LOCK_THREADS; i++)
+        thrd_join(threads[i], NULL);
+
+    ASSERT_EQ(LOCK_THREADS * LOCK_ROUNDS, spun);
+    ASSERT_EQ(0, spinning.state);
+    return 0;
+}
+
+int main(void) {
+    puts("\nraii_lock_stats, raii_lock_report, per lock contention profile");
+    ASSERT_EQ(0, test_profile());
+    puts("\nraii_mutex_lock, spin then park");
+    ASSERT_EQ(0, test_mutex());
+    return 0;
+}
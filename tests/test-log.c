@@ -0,0 +1,71 @@
+#include "raii.h"
+#include "test_assert.h"
+#include <unistd.h>
+
+#define THREAD_COUNT 4
+#define LOG_COUNT 5000
+
+static int logger(void *arg) {
+    int i;
+    for (i = 0; i < LOG_COUNT; i++)
+        ex_log(EX_LOG_OUT, "thread %d line %d\n", (int)(intptr_t)arg, i);
+
+    return 0;
+}
+
+/* Every message arrives whole, none lost, each thread's in order. */
+static int check_lines(FILE *in) {
+    int next[THREAD_COUNT] = {0}, id, line, total = 0;
+    char text[64];
+
+    rewind(in);
+    while (fgets(text, sizeof(text), in)) {
+        ASSERT_EQ(2, sscanf(text, "thread %d line %d\n", &id, &line));
+        ASSERT_EQ(true, (id >= 0 && id < THREAD_COUNT));
+        ASSERT_EQ(next[id], line);
+        next[id]++;
+        total++;
+    }
+
+    ASSERT_EQ(THREAD_COUNT * LOG_COUNT, total);
+    return 0;
+}
+
+int test_threads(void) {
+    thrd_t threads[THREAD_COUNT];
+    FILE *out = tmpfile();
+    int i, saved, result, started, again;
+
+    ASSERT_NOTNULL(out);
+    fflush(stdout);
+    saved = dup(1);
+    dup2(fileno(out), 1);
+
+    started = raii_log_start(4096);
+    again = raii_log_start(4096);
+    for (i = 0; i < THREAD_COUNT; i++)
+        thrd_create(&threads[i], logger, (void *)(intptr_t)i);
+
+    for (i = 0; i < THREAD_COUNT; i++)
+        thrd_join(threads[i], NULL);
+
+    raii_log_stop();
+    dup2(saved, 1);
+    close(saved);
+    ASSERT_EQ(RAII_OK, started);
+    ASSERT_EQ(RAII_ERR, again);
+
+    result = check_lines(out);
+    fclose(out);
+    return result;
+}
+
+int main(void) {
+    puts("\nraii_log_start, several threads through asynchronous sink");
+    ASSERT_EQ(0, test_threads());
+    ASSERT_NULL(exception_log_func);
+
+    puts("\nraii_log_stop, restored direct writes");
+    ex_log(EX_LOG_OUT, "%s\n", "direct");
+    return 0;
+}
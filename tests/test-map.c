@@ -0,0 +1,141 @@
+#include "raii.h"
+#include "test_assert.h"
+
+#define TIMER_COUNT 10000
+
+int test_ordered(void) {
+    map_t *map = map_create(NULL, map_cmp_str);
+    const void *key;
+    void *value;
+    map_iter_t it;
+    int seen = 0;
+
+    ASSERT_NULL(map_put(map, "delta", (void *)4));
+    map_put(map, "alpha", (void *)1);
+    map_put(map, "charlie", (void *)3);
+    map_put(map, "bravo", (void *)2);
+    ASSERT_EQ(4, (int)(intptr_t)map_put(map, "delta", (void *)40));
+    ASSERT_UEQ((size_t)4, map_count(map));
+    ASSERT_EQ(40, (int)(intptr_t)map_get(map, "delta"));
+    ASSERT_NULL(map_get(map, "echo"));
+
+    it = map_begin(map);
+    ASSERT_EQ(true, map_next(&it, &key, &value));
+    ASSERT_STR("alpha", (const char *)key);
+    while (map_next(&it, &key, NULL))
+        seen++;
+    ASSERT_EQ(3, seen);
+
+    it = map_range(map, "b", "d");
+    ASSERT_EQ(true, map_next(&it, &key, NULL));
+    ASSERT_STR("bravo", (const char *)key);
+    ASSERT_EQ(true, map_next(&it, &key, NULL));
+    ASSERT_STR("charlie", (const char *)key);
+    ASSERT_EQ(false, map_next(&it, &key, NULL));
+
+    ASSERT_EQ(true, map_remove(map, "bravo", &value));
+    ASSERT_EQ(2, (int)(intptr_t)value);
+    ASSERT_EQ(false, map_remove(map, "bravo", NULL));
+    ASSERT_EQ(false, map_has(map, "bravo"));
+    map_free(map);
+    return 0;
+}
+
+/* Integer deadline keys, expired by popping smallest, node memory recycled. */
+int test_timers(void) {
+    map_t *map = map_create(NULL, NULL);
+    const void *key;
+    map_iter_t it;
+    intptr_t i, last = -1, count = 0;
+
+    for (i = TIMER_COUNT; i > 0; i--)
+        map_put(map, (void *)(i * 10), (void *)i);
+
+    ASSERT_UEQ((size_t)TIMER_COUNT, map_count(map));
+    it = map_from(map, (void *)(intptr_t)95000);
+    while (map_next(&it, &key, NULL)) {
+        map_remove(map, key, NULL);
+        count++;
+    }
+    ASSERT_EQ(true, (count == 501));
+
+    while (map_pop_first(map, &key, NULL)) {
+        ASSERT_EQ(true, ((intptr_t)key > last));
+        last = (intptr_t)key;
+        if (last == 500)
+            break;
+    }
+
+    ASSERT_UEQ((size_t)(TIMER_COUNT - 501 - 50), map_count(map));
+    for (i = 0; i < 50; i++)
+        map_put(map, (void *)(i + 1), NULL);
+
+    ASSERT_UEQ((size_t)(TIMER_COUNT - 501), map_count(map));
+    map_free(map);
+    return 0;
+}
+
+/* Deferred before guard's map, `map_gone` runs once map's release did,
+deferred after, `map_seen` while map still whole. */
+static size_t gone_at = 0, registered = 0;
+static volatile int gone = 0;
+static volatile size_t seen = 0;
+static void map_gone(void *arg) {
+    gone = raii_deferred_count((memory_t *)arg) == gone_at;
+}
+
+static void map_seen(void *arg) {
+    seen = map_count((map_t *)arg);
+}
+
+/* Deadlines expired smallest first, one already past `now` unwinds guard. */
+static int map_expire(intptr_t now)
+guard {
+    _assign_ptr(scope);
+    const void *key;
+    map_t *map;
+    intptr_t i;
+
+    gone_at = raii_deferred_count(scope);
+    raii_deferred(scope, map_gone, scope);
+    map = _map(NULL);
+    registered = raii_deferred_count(scope) - gone_at;
+    for (i = TIMER_COUNT; i > 0; i--)
+        map_put(map, (void *)(i * 10), (void *)i);
+
+    raii_deferred(scope, map_seen, map);
+    map_pop_first(map, &key, NULL);
+    if ((intptr_t)key < now)
+        throw(timeout_error);
+} unguarded(0);
+
+int test_unwind(void) {
+    volatile int caught = 0;
+
+    try {
+        map_expire(100);
+    } catch (timeout_error) {
+        caught = 1;
+    } end_trying;
+    ASSERT_EQ(1, caught);
+    ASSERT_UEQ((size_t)2, registered);
+    ASSERT_UEQ((size_t)(TIMER_COUNT - 1), seen);
+    ASSERT_EQ(1, gone);
+
+    gone = 0;
+    ASSERT_EQ(0, map_expire(0));
+    ASSERT_EQ(1, gone);
+    return 0;
+}
+
+int main(void) {
+    puts("\nmap_put, map_get, map_range");
+    ASSERT_FUNC(test_ordered());
+
+    puts("\nmap_pop_first, integer keys");
+    ASSERT_FUNC(test_timers());
+
+    puts("\nmap_create, released on unwind");
+    ASSERT_FUNC(test_unwind());
+    return 0;
+}
@@ -0,0 +1,86 @@
+#include "raii.h"
+#include "test_assert.h"
+
+static char *kept = NULL;
+
+static int allocated(void)
+guard {
+    char *block = _malloc(64);
+    memset(block, 'x', 64);
+} unguarded(0);
+
+int test_released(void) {
+    size_t live = raii_memcheck_live();
+    ASSERT_EQ(0, allocated());
+    ASSERT_UEQ(live, raii_memcheck_live());
+    return 0;
+}
+
+int test_leak(void) {
+    unique_t *scope = unique_init();
+    size_t live = raii_memcheck_live();
+    FILE *file = tmpfile();
+
+    ASSERT_NOTNULL(file);
+    kept = malloc_by(scope, 32);
+    /* ownership back to caller, no longer tracked */
+    raii_deferred_cancel(scope, raii_last_mid(scope));
+#ifdef RAII_MEMCHECK
+    ASSERT_UEQ(live, raii_memcheck_live());
+    malloc_by(scope, 16);
+    ASSERT_UEQ(live + 1, raii_memcheck_live());
+    ASSERT_UEQ(live + 1, raii_memcheck_report(file));
+#else
+    ASSERT_UEQ((size_t)0, raii_memcheck_report(file));
+#endif
+    raii_delete(scope);
+    ASSERT_UEQ(live, raii_memcheck_live());
+    RAII_FREE(kept);
+    fclose(file);
+    return 0;
+}
+
+#ifdef RAII_MEMCHECK
+static int released_twice(void)
+guard {
+    char *block = _malloc(32);
+    _defer(RAII_FREE, block);
+} unguarded(0);
+
+int test_double_free(void) {
+    size_t doubles = raii_memcheck_double_frees();
+    ASSERT_EQ(0, released_twice());
+    ASSERT_UEQ(doubles + 1, raii_memcheck_double_frees());
+    return 0;
+}
+#endif
+
+int test_arena(void) {
+    arena_t arena = arena_init(0);
+    char *first = arena_alloc(arena, 100), *big = arena_alloc(arena, 1 << 20);
+
+    memset(first, 1, 100);
+    memset(big, 2, 1 << 20);
+    arena_clear(arena);
+    first = arena_alloc(arena, 100);
+    memset(first, 3, 100);
+    arena_free(arena);
+    return 0;
+}
+
+int main(void) {
+    puts("\nmalloc_by, tracked block released by scope");
+    ASSERT_EQ(0, test_released());
+
+    puts("\nraii_memcheck_report, live blocks of scope");
+    ASSERT_EQ(0, test_leak());
+
+#ifdef RAII_MEMCHECK
+    puts("\nraii_memcheck_double_frees, second release skipped");
+    ASSERT_EQ(0, test_double_free());
+#endif
+
+    puts("\narena_alloc, guarded chunks released and made anew");
+    ASSERT_EQ(0, test_arena());
+    return 0;
+}
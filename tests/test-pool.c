@@ -0,0 +1,142 @@
+#include "raii.h"
+#include "test_assert.h"
+
+#define OBJECT_COUNT 1000
+
+typedef struct {
+    int id;
+    char name[20];
+} request_t;
+
+static object_pool_t *shared = NULL;
+static request_t *handed[OBJECT_COUNT];
+
+int test_recycle(void) {
+    object_pool_t *pool = pool_of(NULL, request_t, 8);
+    request_t *a, *b, *c;
+    int i;
+
+    ASSERT_UEQ((size_t)0, pool_capacity(pool));
+    a = pool_new(pool, request_t);
+    b = pool_new(pool, request_t);
+    ASSERT_NOTNULL(a);
+    ASSERT_EQ(true, (a != b));
+    ASSERT_UEQ((size_t)8, pool_capacity(pool));
+    /* `16` bytes or more, each `16` byte aligned */
+    ASSERT_EQ(0, (int)((uintptr_t)a % 16));
+    ASSERT_EQ(0, (int)((uintptr_t)b % 16));
+
+    pool_put(pool, a);
+    c = pool_new(pool, request_t);
+    ASSERT_EQ(true, (a == c));
+    pool_put(pool, b);
+    pool_put(pool, c);
+
+    /* steady get/put cycles never grow pool */
+    for (i = 0; i < 10000; i++) {
+        a = pool_new(pool, request_t);
+        a->id = i;
+        pool_put(pool, a);
+    }
+    ASSERT_UEQ((size_t)8, pool_capacity(pool));
+
+    for (i = 0; i < 20; i++) {
+        handed[i] = pool_new(pool, request_t);
+        handed[i]->id = i;
+    }
+    ASSERT_UEQ((size_t)24, pool_capacity(pool));
+    for (i = 0; i < 20; i++)
+        ASSERT_EQ(i, handed[i]->id);
+
+    pool_free(pool);
+    return 0;
+}
+
+/* Objects returned by other `thread`, recycled by owner. */
+static int return_objects(void *arg) {
+    int i;
+    for (i = 0; i < OBJECT_COUNT; i++)
+        pool_put(shared, handed[i]);
+
+    return 0;
+}
+
+int test_threads(void) {
+    thrd_t thread;
+    size_t capacity;
+    int i;
+
+    shared = pool_create(NULL, sizeof(request_t), 0);
+    for (i = 0; i < OBJECT_COUNT; i++)
+        handed[i] = pool_get(shared);
+
+    capacity = pool_capacity(shared);
+    ASSERT_EQ(thrd_success, thrd_create(&thread, return_objects, NULL));
+    thrd_join(thread, NULL);
+
+    for (i = 0; i < OBJECT_COUNT; i++)
+        handed[i] = pool_get(shared);
+    ASSERT_UEQ(capacity, pool_capacity(shared));
+
+    pool_free(shared);
+    return 0;
+}
+
+/* Deferred ahead of it's pool, unwinding reaches it only once pool's own release ran. */
+static volatile int released = 0;
+static size_t released_at = 0, registered = 0;
+static void pool_released(void *arg) {
+    released = raii_deferred_count((memory_t *)arg) == released_at;
+}
+
+static int pool_unwind(int id)
+guard {
+    _assign_ptr(scope);
+    request_t *req;
+
+    released_at = raii_deferred_count(scope);
+    raii_deferred(scope, pool_released, scope);
+    req = pool_new(_pool(request_t, 4), request_t);
+    registered = raii_deferred_count(scope) - released_at;
+    req->id = id;
+    if (req->id > 0)
+        throw(range_error);
+} unguarded(0);
+
+int test_unwind(void) {
+    volatile int caught = 0;
+
+    released = 0;
+    try {
+        pool_unwind(1);
+    } catch (range_error) {
+        caught = 1;
+    } end_trying;
+    ASSERT_EQ(1, caught);
+    ASSERT_UEQ((size_t)2, registered);
+    ASSERT_EQ(1, released);
+
+    released = 0;
+    ASSERT_EQ(0, pool_unwind(0));
+    ASSERT_EQ(1, released);
+    return 0;
+}
+
+int main(void) {
+    unique_t *scope;
+
+    puts("\npool_get, pool_put");
+    ASSERT_FUNC(test_recycle());
+
+    puts("\npool_put, other threads");
+    ASSERT_FUNC(test_threads());
+
+    puts("\npool_create, released with scope");
+    scope = unique_init();
+    pool_get(pool_create(scope, 100, 2));
+    raii_delete(scope);
+
+    puts("\npool_of, released on unwind");
+    ASSERT_FUNC(test_unwind());
+    return 0;
+}
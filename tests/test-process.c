@@ -0,0 +1,197 @@
+#include "raii.h"
+#include "test_assert.h"
+#if !defined(_WIN32)
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/wait.h>
+#endif
+
+#define PROCESS_CHILDREN 4
+#define PROCESS_ENTRIES 64
+
+/* Shared index, linked by offsets, same in every process. */
+typedef struct {
+    size_t next;
+    int key;
+    int value;
+} entry_t;
+
+static char process_name[64];
+
+static entry_t *build_index(raii_process_t *arena) {
+    entry_t *entry = NULL, *head = NULL;
+    int i;
+
+    for (i = 0; i < PROCESS_ENTRIES; i++) {
+        entry = process_alloc(arena, sizeof(entry_t));
+        entry->key = i;
+        entry->value = i * i;
+        entry->next = process_offset(arena, head);
+        head = entry;
+    }
+
+    return head;
+}
+
+static int sum_index(raii_process_t *arena) {
+    entry_t *entry = process_root(arena);
+    int sum = 0;
+
+    for (; !is_empty(entry); entry = process_ptr(arena, entry->next))
+        sum += entry->value;
+
+    return sum;
+}
+
+int test_alloc(void) {
+    raii_process_t *arena = process_arena(NULL, NULL, 4096);
+    size_t used;
+    char *block;
+
+    ASSERT_NOTNULL(arena);
+    ASSERT_EQ(true, (is_type(arena, RAII_PROCESS)));
+    ASSERT_NULL(process_root(arena));
+    ASSERT_NULL(process_ptr(arena, 0));
+    ASSERT_UEQ((size_t)0, process_offset(arena, NULL));
+
+    ASSERT_NOTNULL((block = process_alloc(arena, 5)));
+    ASSERT_UEQ((size_t)0, (size_t)block % 16);
+    ASSERT_EQ(0, block[0]);
+    ASSERT_EQ(true, (block == process_ptr(arena, process_offset(arena, block))));
+
+    process_publish(arena, build_index(arena));
+    ASSERT_EQ(85344, sum_index(arena));
+
+    used = process_used(arena);
+    ASSERT_NULL(process_alloc(arena, 4096));
+    ASSERT_EQ(ENOMEM, errno);
+    ASSERT_UEQ(used, process_used(arena));
+    process_arena_free(arena);
+    return 0;
+}
+
+#if !defined(_WIN32)
+/* Children read index parent built, and allocate from it at same time. */
+int test_fork(void) {
+    raii_process_t *arena = process_arena(NULL, NULL, 64 * 1024);
+    size_t *counts;
+    pid_t children[PROCESS_CHILDREN];
+    int i, j, status;
+
+    ASSERT_NOTNULL(arena);
+    counts = process_alloc(arena, sizeof(size_t) * PROCESS_CHILDREN);
+    process_publish(arena, build_index(arena));
+    for (i = 0; i < PROCESS_CHILDREN; i++) {
+        if ((children[i] = fork()) == 0) {
+            if (sum_index(arena) != 85344)
+                _exit(1);
+
+            for (j = 0; process_alloc(arena, 24) != NULL; j++);
+            counts[i] = j;
+            _exit(0);
+        }
+
+        ASSERT_EQ(true, (children[i] > 0));
+    }
+
+    for (i = 0; i < PROCESS_CHILDREN; i++) {
+        ASSERT_EQ(children[i], waitpid(children[i], &status, 0));
+        ASSERT_EQ(true, (WIFEXITED(status) && WEXITSTATUS(status) == 0));
+    }
+
+    /* every block handed out once, across all children */
+    for (j = 0, i = 0; i < PROCESS_CHILDREN; i++)
+        j += (int)counts[i];
+
+    ASSERT_EQ(true, (j > 0));
+    ASSERT_NULL(process_alloc(arena, 24));
+    ASSERT_EQ(true, (process_used(arena) <= 64 * 1024 + 64));
+    process_arena_free(arena);
+    return 0;
+}
+#endif
+
+/* Second view of named region maps elsewhere, offsets still agree. */
+int test_named(void) {
+    raii_process_t *owner = process_arena(NULL, process_name, 4096);
+    raii_process_t *other;
+    entry_t *head;
+
+    ASSERT_NOTNULL(owner);
+    process_publish(owner, (head = build_index(owner)));
+    ASSERT_NOTNULL((other = process_arena(NULL, process_name, 0)));
+    ASSERT_EQ(85344, sum_index(other));
+    ASSERT_UEQ(process_offset(owner, head), process_offset(other, process_root(other)));
+    ASSERT_UEQ(process_used(owner), process_used(other));
+
+    process_alloc(other, 32);
+    ASSERT_UEQ(process_used(owner), process_used(other));
+    process_arena_free(other);
+    process_arena_free(owner);
+    return 0;
+}
+
+/* Index published in named region of `size`, one too small unwinds. */
+static int publish_index(size_t size)
+guard {
+    raii_process_t *arena = _process_arena(process_name, size);
+    entry_t *entry, *head = NULL;
+    int i;
+
+    for (i = 0; i < PROCESS_ENTRIES; i++) {
+        if (is_empty(entry = process_alloc(arena, sizeof(entry_t))))
+            throw(out_of_memory);
+
+        entry->value = i * i;
+        entry->next = process_offset(arena, head);
+        head = entry;
+    }
+
+    process_publish(arena, head);
+} unguarded(0);
+
+/* Name removed along with region, none left to attach to. */
+static int removed(void) {
+#if !defined(_WIN32)
+    errno = 0;
+    ASSERT_EQ(-1, shm_open(process_name, O_RDWR, 0600));
+    ASSERT_EQ(ENOENT, errno);
+#endif
+    return 0;
+}
+
+int test_published(void) {
+    volatile int caught = 0;
+
+    try {
+        publish_index(PROCESS_ENTRIES * sizeof(entry_t) / 2);
+    } catch (out_of_memory) {
+        caught = 1;
+    } end_trying;
+    ASSERT_EQ(1, caught);
+    ASSERT_FUNC(removed());
+
+    ASSERT_EQ(0, publish_index(4096));
+    ASSERT_FUNC(removed());
+    return 0;
+}
+
+int main(void) {
+    snprintf(process_name, sizeof(process_name), "/raii-test-%d", (int)time(NULL));
+
+    puts("\nprocess_arena, process_alloc, process_offset, process_ptr");
+    ASSERT_EQ(0, test_alloc());
+
+#if !defined(_WIN32)
+    puts("\nprocess_alloc, from forked children at once");
+    ASSERT_EQ(0, test_fork());
+#endif
+
+    puts("\nprocess_arena, attached by name");
+    ASSERT_EQ(0, test_named());
+
+    puts("\n_process_arena, removed on unwind");
+    ASSERT_EQ(0, test_published());
+    return 0;
+}
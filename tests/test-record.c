@@ -0,0 +1,92 @@
+#include "raii.h"
+#include "test_assert.h"
+
+static int freed = 0;
+
+static void on_free(void *data) {
+    freed++;
+}
+
+static int recorded(void)
+guard {
+    _defer(on_free, NULL);
+    _defer(on_free, NULL);
+    throw(division_by_zero);
+} unguarded(0);
+
+#ifdef RAII_RECORD
+static int quiet(void)
+guard {
+    _defer(on_free, NULL);
+} unguarded(0);
+#endif
+
+int test_decode(void) {
+    char text[1 << 16];
+    FILE *file = tmpfile(), *timeline = tmpfile();
+    size_t count, length;
+
+    ASSERT_NOTNULL(file);
+    ASSERT_NOTNULL(timeline);
+    raii_record_clear();
+    try {
+        recorded();
+    } catch (division_by_zero) {
+        ASSERT_EQ(2, freed);
+    } end_trying;
+
+    count = raii_record_save(file);
+    rewind(file);
+    ASSERT_UEQ(count, raii_record_decode(file, timeline));
+    rewind(timeline);
+    length = fread(text, 1, sizeof(text) - 1, timeline);
+    text[length] = '\0';
+    fclose(file);
+    fclose(timeline);
+
+#ifdef RAII_RECORD
+    /* scope create, release, two deferred registered and fired, throw, catch */
+    ASSERT_EQ(true, (count >= 8));
+    ASSERT_NOTNULL(strstr(text, "thread "));
+    ASSERT_NOTNULL(strstr(text, " create"));
+    ASSERT_NOTNULL(strstr(text, " release"));
+    ASSERT_NOTNULL(strstr(text, " registered"));
+    ASSERT_NOTNULL(strstr(text, " fired"));
+    ASSERT_NOTNULL(strstr(text, "throw division_by_zero at "));
+    ASSERT_NOTNULL(strstr(text, "catch division_by_zero at "));
+    ASSERT_NOTNULL(strstr(text, "test-record.c"));
+
+    /* paused, nothing more recorded */
+    raii_record_clear();
+    ASSERT_EQ(true, raii_record_enable(false));
+    ASSERT_EQ(0, quiet());
+    ASSERT_EQ(false, raii_record_enable(true));
+    file = tmpfile();
+    ASSERT_UEQ((size_t)0, raii_record_save(file));
+    fclose(file);
+#else
+    ASSERT_UEQ((size_t)0, count);
+#endif
+    return 0;
+}
+
+int test_invalid(void) {
+    FILE *file = tmpfile();
+
+    ASSERT_NOTNULL(file);
+    fputs("not a recording", file);
+    rewind(file);
+    errno = 0;
+    ASSERT_UEQ((size_t)0, raii_record_decode(file, stdout));
+    ASSERT_EQ(EINVAL, errno);
+    fclose(file);
+    return 0;
+}
+
+int main(void) {
+    puts("\nraii_record_save, raii_record_decode, per thread exception and defer timelines");
+    ASSERT_EQ(0, test_decode());
+    puts("\nraii_record_decode, rejects other input");
+    ASSERT_EQ(0, test_invalid());
+    return 0;
+}
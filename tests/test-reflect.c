@@ -0,0 +1,110 @@
+#include "raii.h"
+#include "test_assert.h"
+
+typedef struct {
+    short x;
+    unsigned char y;
+} point_t;
+
+typedef struct {
+    int id;
+    char *name;
+    double weight;
+    bool active;
+    point_t at;
+    point_t *home;
+    void *opaque;
+} item_t;
+
+RAII_REFLECT(point_reflect, point_t,
+    RAII_FIELD(point_t, x, RAII_SHORT),
+    RAII_FIELD(point_t, y, RAII_UCHAR));
+
+RAII_REFLECT(item_reflect, item_t,
+    RAII_FIELD(item_t, id, RAII_INT),
+    RAII_FIELD(item_t, name, RAII_CHAR_P),
+    RAII_FIELD(item_t, weight, RAII_DOUBLE),
+    RAII_FIELD(item_t, active, RAII_BOOL),
+    RAII_FIELD_OBJ(item_t, at, point_reflect),
+    RAII_FIELD_PTR(item_t, home, point_reflect),
+    RAII_FIELD(item_t, opaque, RAII_PTR));
+
+int test_fields(void) {
+    item_t item = {-7, "widget", 2.5, true, {-3, 200}, NULL, NULL};
+    const reflect_field_t *field;
+    values_type value;
+
+    ASSERT_XEQ(RAII_REFLECT_TYPE, item_reflect.type);
+    ASSERT_STR("item_t", item_reflect.name);
+    ASSERT_UEQ((size_t)7, item_reflect.count);
+    ASSERT_UEQ(sizeof(item_t), item_reflect.size);
+    ASSERT_NULL(reflect_field(&item_reflect, "missing"));
+
+    ASSERT_NOTNULL((field = reflect_field(&item_reflect, "weight")));
+    ASSERT_UEQ(offsetof(item_t, weight), field->offset);
+    ASSERT_EQ(true, (reflect_get(&item, field).value.precision == 2.5));
+
+    field = reflect_field(&item_reflect, "id");
+    ASSERT_EQ(-7, (int)reflect_get(&item, field).value.long_long);
+    value.long_long = 42;
+    reflect_set(&item, field, value);
+    ASSERT_EQ(42, item.id);
+
+    field = reflect_field(&item_reflect, "name");
+    ASSERT_STR("widget", (char *)reflect_get(&item, field).value.object);
+
+    field = reflect_field(&point_reflect, "x");
+    ASSERT_EQ(-3, (int)reflect_get(&item.at, field).value.long_long);
+    field = reflect_field(&point_reflect, "y");
+    ASSERT_EQ(200, (int)reflect_get(&item.at, field).value.long_long);
+    return 0;
+}
+
+int test_copy(void) {
+    point_t home = {1, 2};
+    item_t item = {1, "original", 1.0, false, {5, 6}, NULL, NULL}, copy;
+    char name[] = "changes";
+
+    item.name = name;
+    item.home = &home;
+    item.opaque = &home;
+    reflect_copy(NULL, &item_reflect, &copy, &item);
+    name[0] = 'C';
+    home.x = 99;
+
+    ASSERT_STR("changes", copy.name);
+    ASSERT_EQ(true, (copy.home != &home));
+    ASSERT_EQ(1, copy.home->x);
+    ASSERT_EQ(true, (copy.opaque == (void *)&home));
+    ASSERT_EQ(6, copy.at.y);
+    reflect_free(&item_reflect, &copy);
+    ASSERT_NULL(copy.name);
+    ASSERT_NULL(copy.home);
+    return 0;
+}
+
+static int copy_scoped(item_t *item)
+guard {
+    item_t copy;
+    int same;
+    _reflect_copy(&item_reflect, &copy, item);
+    /* copies are released by `_return` itself */
+    same = strcmp(copy.name, item->name) == 0 && copy.home->y == item->home->y;
+    _return(same);
+} unguarded(0);
+
+int main(void) {
+    point_t home = {3, 4};
+    item_t item = {2, "scoped", 0.5, true, {0, 0}, NULL, NULL};
+
+    puts("\nRAII_REFLECT, reflect_field, reflect_get, reflect_set");
+    ASSERT_FUNC(test_fields());
+
+    puts("\nreflect_copy, reflect_free");
+    ASSERT_FUNC(test_copy());
+
+    puts("\nreflect_copy, bound to guard scope");
+    item.home = &home;
+    ASSERT_EQ(1, copy_scoped(&item));
+    return 0;
+}
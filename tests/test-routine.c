@@ -0,0 +1,228 @@
+#include "raii.h"
+#include "test_assert.h"
+
+#define ROUTINE_COUNT 10000
+#define WORKER_COUNT 4
+
+EX_EXCEPTION(routine_error);
+
+static int order[8];
+static int order_count = 0;
+static volatile size_t ran = 0;
+static volatile size_t deferred = 0;
+
+static void routine_deferred(void *arg) {
+    atomic_size_add(&deferred, 1);
+}
+
+static void *routine_square(void *arg) {
+    intptr_t n = (intptr_t)arg;
+    return (void *)(n * n);
+}
+
+static void *routine_order(void *arg) {
+    int i;
+    for (i = 0; i < 3; i++) {
+        order[order_count++] = (int)(intptr_t)arg + i;
+        routine_yield();
+    }
+
+    return NULL;
+}
+
+/* Each `try` chain survives other coroutines throwing meanwhile. */
+static void *routine_catch(void *arg) {
+    int caught = 0;
+    try {
+        routine_yield();
+        if (arg)
+            throw(routine_error);
+        routine_yield();
+    } catch (routine_error) {
+        caught = 1;
+    } end_trying;
+
+    return (void *)(intptr_t)caught;
+}
+
+static void *routine_throw(void *arg) {
+    raii_defer(routine_deferred, NULL);
+    routine_yield();
+    throw(routine_error);
+    return NULL;
+}
+
+static int routine_guarded(void)
+guard {
+    _defer(routine_deferred, NULL);
+    routine_yield();
+    ASSERT_EQ(0, (int)deferred);
+} unguarded(1);
+
+static void *routine_guard(void *arg) {
+    return (void *)(intptr_t)routine_guarded();
+}
+
+static void *routine_count(void *arg) {
+    atomic_size_add(&ran, 1);
+    routine_yield();
+    atomic_size_add(&ran, 1);
+    return NULL;
+}
+
+/* Joins suspend only caller, other coroutines keep running. */
+static void *routine_parent(void *arg) {
+    routine_t *child = routine_go(routine_square, 9);
+    return routine_join(child);
+}
+
+static routine_t *sleeper = NULL;
+static void *routine_sleep(void *arg) {
+    sleeper = routine_current();
+    routine_suspend();
+    return (void *)7;
+}
+
+static void *routine_waker(void *arg) {
+    routine_resume(sleeper);
+    return NULL;
+}
+
+int test_basic(void) {
+    routine_t *a, *b;
+    int caught = 0;
+
+    ASSERT_NULL(routine_current());
+    ASSERT_EQ(144, (int)(intptr_t)routine_join(routine_go(routine_square, 12)));
+
+    a = routine_go(routine_order, 10);
+    b = routine_go(routine_order, 20);
+    sched_run();
+    ASSERT_EQ(0, (int)sched_count());
+    ASSERT_EQ(6, order_count);
+    ASSERT_EQ(10, order[0]);
+    ASSERT_EQ(20, order[1]);
+    ASSERT_EQ(11, order[2]);
+    ASSERT_EQ(21, order[3]);
+    routine_join(a);
+    routine_join(b);
+
+    a = routine_go(routine_catch, 0);
+    b = routine_go(routine_catch, 1);
+    ASSERT_EQ(0, (int)(intptr_t)routine_join(a));
+    ASSERT_EQ(1, (int)(intptr_t)routine_join(b));
+
+    a = routine_go(routine_throw, 0);
+    try {
+        routine_join(a);
+    } catch (routine_error) {
+        caught = 1;
+    } end_trying;
+    ASSERT_EQ(1, caught);
+    ASSERT_EQ(1, (int)deferred);
+
+    deferred = 0;
+    ASSERT_EQ(1, (int)(intptr_t)routine_join(routine_go(routine_guard, 0)));
+    ASSERT_EQ(1, (int)deferred);
+
+    ASSERT_EQ(81, (int)(intptr_t)routine_join(routine_go(routine_parent, 0)));
+
+    a = routine_go(routine_sleep, 0);
+    routine_detach(routine_go(routine_waker, 0));
+    ASSERT_EQ(7, (int)(intptr_t)routine_join(a));
+    return 0;
+}
+
+static routine_t *volatile shared = NULL;
+static void *routine_napping(void *arg) {
+    struct timespec nap = {0, 10000000};
+    thrd_sleep(&nap, NULL);
+    return (void *)((intptr_t)arg * 2);
+}
+
+/* Coroutine lives on this `thread` scheduler, joined from `main`. */
+static int thread_sched(void *arg) {
+    routine_t *co = routine_go(routine_napping, 21);
+    atomic_ptr_store((void *volatile *)&shared, co);
+    sched_run();
+    sched_free();
+    return 0;
+}
+
+/* Wakes `sleeper` of another `thread` scheduler, once it's suspended. */
+static int thread_waker(void *arg) {
+    while (is_empty(atomic_ptr_load((void *volatile *)&sleeper)))
+        thrd_yield();
+
+    routine_wake(sleeper);
+    return 0;
+}
+
+static void *routine_sleep_shared(void *arg) {
+    atomic_ptr_store((void *volatile *)&sleeper, routine_current());
+    routine_suspend();
+    atomic_size_add(&ran, 1);
+    return (void *)9;
+}
+
+int test_threads(void) {
+    routine_t *co;
+    thrd_t thread;
+
+    ASSERT_EQ(thrd_success, thrd_create(&thread, thread_sched, NULL));
+    while (is_empty(co = (routine_t *)atomic_ptr_load((void *volatile *)&shared)))
+        thrd_yield();
+
+    ASSERT_EQ(42, (int)(intptr_t)routine_join(co));
+    thrd_join(thread, NULL);
+
+    /* nothing else ready, join waits for remote wake */
+    sleeper = NULL;
+    co = routine_go(routine_sleep_shared, 0);
+    ASSERT_EQ(thrd_success, thrd_create(&thread, thread_waker, NULL));
+    ASSERT_EQ(9, (int)(intptr_t)routine_join(co));
+    thrd_join(thread, NULL);
+    return 0;
+}
+
+int main(void) {
+    workers_t *pool;
+    thrd_t thread;
+    int i;
+
+    puts("\nroutine_go, routine_join");
+    ASSERT_FUNC(test_basic());
+
+    puts("\nroutine_join, routine_wake, across threads");
+    ASSERT_FUNC(test_threads());
+
+    puts("\nroutine_detach, many coroutines");
+    ran = 0;
+    for (i = 0; i < ROUTINE_COUNT; i++)
+        routine_detach(routine_create(routine_count, NULL, 16 * 1024));
+
+    ASSERT_EQ(ROUTINE_COUNT, (int)sched_count());
+    sched_run();
+    ASSERT_UEQ(ROUTINE_COUNT * 2, ran);
+    sched_free();
+
+    puts("\nworkers_go");
+    ran = 0;
+    pool = workers_create(WORKER_COUNT);
+    for (i = 0; i < ROUTINE_COUNT; i++)
+        ASSERT_EQ(0, workers_go(pool, routine_count, NULL));
+
+    workers_wait(pool);
+    ASSERT_UEQ(ROUTINE_COUNT * 2, ran);
+
+    puts("\nworkers_go, suspended coroutine woken by other thread");
+    ran = 0;
+    sleeper = NULL;
+    ASSERT_EQ(0, workers_go(pool, routine_sleep_shared, NULL));
+    ASSERT_EQ(thrd_success, thrd_create(&thread, thread_waker, NULL));
+    workers_wait(pool);
+    ASSERT_UEQ(1, ran);
+    thrd_join(thread, NULL);
+    workers_destroy(pool);
+    return 0;
+}
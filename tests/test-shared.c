@@ -0,0 +1,126 @@
+#include "raii.h"
+#include "test_assert.h"
+
+#define SHARED_THREADS 4
+#define SHARED_ROUNDS 100000
+
+static int destroyed = 0;
+
+static void on_destroy(void *ptr) {
+    destroyed++;
+}
+
+int test_counts(void) {
+    int *value = shared_alloc(sizeof(int), on_destroy);
+
+    destroyed = 0;
+    *value = 42;
+    ASSERT_UEQ((size_t)1, shared_count(value));
+    ASSERT_EQ(true, (value == shared_retain(value)));
+    ASSERT_UEQ((size_t)2, shared_count(value));
+    shared_release(value);
+    ASSERT_EQ(0, destroyed);
+    ASSERT_EQ(42, *value);
+    shared_release(value);
+    ASSERT_EQ(1, destroyed);
+    return 0;
+}
+
+int test_weak(void) {
+    void *ptr = shared_local(64, on_destroy);
+    raii_weak_t *weak = shared_weak(ptr);
+
+    destroyed = 0;
+    ASSERT_EQ(true, (ptr == shared_lock(weak)));
+    ASSERT_UEQ((size_t)2, shared_count(ptr));
+    shared_release(ptr);
+    shared_release(ptr);
+    ASSERT_EQ(1, destroyed);
+    ASSERT_NULL(shared_lock(weak));
+    shared_weak_release(weak);
+    return 0;
+}
+
+static int retain_release(void *arg) {
+    int i;
+    for (i = 0; i < SHARED_ROUNDS; i++)
+        shared_release(shared_retain(arg));
+
+    shared_release(arg);
+    return 0;
+}
+
+int test_threads(void) {
+    thrd_t threads[SHARED_THREADS];
+    void *ptr = shared_alloc(128, on_destroy);
+    int i;
+
+    destroyed = 0;
+    for (i = 0; i < SHARED_THREADS; i++)
+        thrd_create(&threads[i], retain_release, shared_retain(ptr));
+
+    for (i = 0; i < SHARED_THREADS; i++)
+        thrd_join(threads[i], NULL);
+
+    ASSERT_UEQ((size_t)1, shared_count(ptr));
+    shared_release(ptr);
+    ASSERT_EQ(1, destroyed);
+    return 0;
+}
+
+/* Takes over caller's reference, scope holding last one when a bad `size` unwinds. */
+static int adopt(void *ptr, int size)
+guard {
+    _shared_retain(ptr);
+    shared_release(ptr);
+    if (size < 0)
+        throw(range_error);
+
+    *(int *)ptr = size;
+} unguarded(0);
+
+int test_adopted(void) {
+    int *value = shared_alloc(sizeof(int), on_destroy);
+    raii_weak_t *weak = shared_weak(value);
+    volatile int caught = 0;
+
+    destroyed = 0;
+    try {
+        adopt(value, -1);
+    } catch (range_error) {
+        caught = 1;
+    } end_trying;
+
+    /* scope's reference was last, destroyed with it, weak one expired */
+    ASSERT_EQ(1, caught);
+    ASSERT_EQ(1, destroyed);
+    ASSERT_NULL(shared_lock(weak));
+    shared_weak_release(weak);
+
+    value = shared_alloc(sizeof(int), on_destroy);
+    weak = shared_weak(shared_retain(value));
+    ASSERT_EQ(0, adopt(value, 7));
+    ASSERT_EQ(1, destroyed);
+    ASSERT_UEQ((size_t)1, shared_count(value));
+    ASSERT_EQ(7, *value);
+    shared_release(value);
+    ASSERT_EQ(2, destroyed);
+    ASSERT_NULL(shared_lock(weak));
+    shared_weak_release(weak);
+    return 0;
+}
+
+int main(void) {
+    puts("\nshared_alloc, shared_retain, shared_release");
+    ASSERT_EQ(0, test_counts());
+
+    puts("\nshared_local, shared_weak, shared_lock");
+    ASSERT_EQ(0, test_weak());
+
+    puts("\nshared_retain, shared_release across threads");
+    ASSERT_EQ(0, test_threads());
+
+    puts("\n_shared_retain, last reference released on unwind");
+    ASSERT_EQ(0, test_adopted());
+    return 0;
+}
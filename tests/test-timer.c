@@ -0,0 +1,141 @@
+#include "raii.h"
+#include "test_assert.h"
+
+#define TIMER_MANY 100000
+
+static int order[4];
+static int fired = 0;
+
+static void on_fire(void *data) {
+    order[fired++] = (int)(intptr_t)data;
+}
+
+static void wait_ms(int ms) {
+    thrd_sleep(time_spec(0, ms * 1000000L), NULL);
+}
+
+int test_order(void) {
+    fired = 0;
+    timer_add(NULL, 30, on_fire, (void *)3);
+    timer_add(NULL, 10, on_fire, (void *)1);
+    timer_add(NULL, 20, on_fire, (void *)2);
+    ASSERT_UEQ((size_t)3, timer_count());
+    ASSERT_EQ(0, timer_run());
+    ASSERT_EQ(true, (timer_next() <= 10));
+    while (fired < 3)
+        timer_run();
+
+    ASSERT_EQ(1, order[0]);
+    ASSERT_EQ(2, order[1]);
+    ASSERT_EQ(3, order[2]);
+    ASSERT_UEQ((size_t)0, timer_count());
+    ASSERT_EQ(-1, timer_next());
+    return 0;
+}
+
+int test_cancel(void) {
+    raii_timer_t *timer;
+
+    fired = 0;
+    timer = timer_add(NULL, 5, on_fire, (void *)1);
+    timer_cancel(timer);
+    ASSERT_UEQ((size_t)0, timer_count());
+    wait_ms(10);
+    ASSERT_EQ(0, timer_run());
+    ASSERT_EQ(0, fired);
+    return 0;
+}
+
+/* Spans every wheel level, each cancelled in `O(1)`. */
+int test_many(void) {
+    raii_timer_t **timers = try_calloc(TIMER_MANY, sizeof(raii_timer_t *));
+    int i;
+
+    for (i = 0; i < TIMER_MANY; i++)
+        timers[i] = timer_add(NULL, (unsigned int)(i * 997) % 20000000u + 100, on_fire, NULL);
+
+    ASSERT_UEQ((size_t)TIMER_MANY, timer_count());
+    for (i = 0; i < TIMER_MANY; i++)
+        timer_cancel(timers[i]);
+
+    ASSERT_UEQ((size_t)0, timer_count());
+    RAII_FREE(timers);
+    return 0;
+}
+
+static int guarded_timeout(void)
+guard {
+    _timeout(5);
+    _timer(10000, on_fire, (void *)1);
+    while (true) {
+        wait_ms(1);
+        timer_run();
+    }
+} unguarded(0);
+
+int test_timeout(void) {
+    volatile int caught = 0;
+
+    fired = 0;
+    try {
+        guarded_timeout();
+    } catch (timeout_error) {
+        caught = 1;
+    } end_trying;
+
+    ASSERT_EQ(1, caught);
+    ASSERT_EQ(0, fired);
+    ASSERT_UEQ((size_t)0, timer_count());
+    return 0;
+}
+
+/* First of guard's timers fires, then a throw unwinds with second still pending. */
+static int fired_then_unwound(void)
+guard {
+    _timer(1, on_fire, (void *)1);
+    _timer(50, on_fire, (void *)2);
+    while (fired < 1) {
+        wait_ms(1);
+        timer_run();
+    }
+
+    throw(range_error);
+} unguarded(0);
+
+int test_unwind(void) {
+    volatile int caught = 0;
+
+    fired = 0;
+    try {
+        fired_then_unwound();
+    } catch (range_error) {
+        caught = 1;
+    } end_trying;
+
+    /* fired one released as is, pending one cancelled, never fires once due */
+    ASSERT_EQ(1, caught);
+    ASSERT_UEQ((size_t)0, timer_count());
+    wait_ms(60);
+    ASSERT_EQ(0, timer_run());
+    ASSERT_EQ(1, fired);
+    ASSERT_EQ(1, order[0]);
+    return 0;
+}
+
+int main(void) {
+    puts("\ntimer_add, fired in expiry order by timer_run");
+    ASSERT_EQ(0, test_order());
+
+    puts("\ntimer_cancel");
+    ASSERT_EQ(0, test_cancel());
+
+    puts("\ntimer_add, timer_cancel of many timers");
+    ASSERT_EQ(0, test_many());
+
+    puts("\n_timeout, throwing timeout_error out of guard");
+    ASSERT_EQ(0, test_timeout());
+
+    puts("\n_timer, fired and pending ones released on unwind");
+    ASSERT_EQ(0, test_unwind());
+    return 0;
+}
@@ -0,0 +1,48 @@
+#include "raii.h"
+#include "test_assert.h"
+
+static int freed = 0;
+
+static void on_free(void *data) {
+    freed++;
+}
+
+static int traced(void)
+guard {
+    _defer(on_free, NULL);
+    _defer(on_free, NULL);
+} unguarded(0);
+
+int test_dump(void) {
+    char text[1 << 16];
+    FILE *file = tmpfile();
+    size_t count, length;
+
+    ASSERT_NOTNULL(file);
+    raii_trace_clear();
+    ASSERT_EQ(0, traced());
+    ASSERT_EQ(2, freed);
+    count = raii_trace_dump(file);
+    rewind(file);
+    length = fread(text, 1, sizeof(text) - 1, file);
+    text[length] = '\0';
+    fclose(file);
+
+    ASSERT_NOTNULL(strstr(text, "{\"traceEvents\":["));
+#ifdef RAII_TRACE
+    /* scope begin and end, two deferred calls */
+    ASSERT_EQ(true, (count >= 4));
+    ASSERT_NOTNULL(strstr(text, "\"ph\":\"b\""));
+    ASSERT_NOTNULL(strstr(text, "\"ph\":\"e\""));
+    ASSERT_NOTNULL(strstr(text, "\"cat\":\"defer\""));
+#else
+    ASSERT_UEQ((size_t)0, count);
+#endif
+    return 0;
+}
+
+int main(void) {
+    puts("\nraii_trace_dump, Chrome trace JSON of scope and defer events");
+    ASSERT_EQ(0, test_dump());
+    return 0;
+}
@@ -0,0 +1,594 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+    /* `sched_getcpu` */
+    #define _GNU_SOURCE
+#endif
+#include "raii.h"
+#include "test_assert.h"
+#if defined(__linux__)
+    #include <sched.h>
+#endif
+
+#define WORKER_COUNT 4
+#define TASK_COUNT 5000
+
+static volatile size_t ran = 0;
+static volatile size_t deferred = 0;
+
+static void task_deferred(void *arg) {
+    atomic_size_add(&deferred, 1);
+}
+
+/* Defers run on task's own worker, when task returns or panics. */
+static void task_count(void *arg) {
+    workers_defer(task_deferred, NULL);
+    atomic_size_add(&ran, 1);
+    if ((intptr_t)arg % 100 == 0)
+        raii_panic("task failed");
+}
+
+/* Worker's persistent scope, arena memory and defers last until task ends. */
+static int task_scoped_check(void) {
+    unique_t *scope = thrd_scope();
+    ASSERT_NOTNULL(scope);
+    ASSERT_EQ(true, (scope == workers_scope()));
+    memset(malloc_by(scope, 256), 0, 256);
+    thrd_defer(task_deferred, NULL);
+    return 0;
+}
+
+static void task_scoped(void *arg) {
+    if (task_scoped_check() == 0)
+        atomic_size_add(&ran, 1);
+}
+
+/* Fan out from within tasks, pushed to current worker's deque. */
+static void task_split(void *arg) {
+    intptr_t depth = (intptr_t)arg;
+    /* top task outside the pool, stops fan out, run count falls short */
+    if (depth == 12 && is_empty(workers_current()))
+        return;
+
+    atomic_size_add(&ran, 1);
+    if (depth > 0) {
+        workers_submit(workers_current(), task_split, (void *)(depth - 1));
+        workers_submit(workers_current(), task_split, (void *)(depth - 1));
+    }
+}
+
+EX_EXCEPTION(task_error);
+
+static void *task_square(void *arg) {
+    intptr_t n = (intptr_t)args_in((args_t *)arg, 0).max_size;
+    if (n < 0)
+        throw(task_error);
+
+    return (void *)(n * n);
+}
+
+static void *task_sum(void *arg) {
+    args_t *args = (args_t *)arg;
+    intptr_t i, sum = 0;
+    for (i = 0; i < (intptr_t)args->n_args; i++)
+        sum += (intptr_t)args_in(args, (int)i).max_size;
+
+    return (void *)sum;
+}
+
+/* Small strings widen into `const_char`. */
+static bool wide_is(args_t *args, int index, const char *text) {
+    values_type wide = args_in(args, index);
+    return strcmp(wide.const_char, text) == 0;
+}
+
+/* Slots keep type picked at compile time, by `args_pack`. */
+args_signature(packed_args, int, char *, double, void *);
+static void *task_packed(void *arg) {
+    args_t *args = (args_t *)arg;
+    int scale = args_get(packed_args, args, 0);
+    double count = args_get(packed_args, args, 2);
+    return (void *)(intptr_t)(scale * (int)count + (intptr_t)args_get(packed_args, args, 3));
+}
+
+/* Joins on own subtasks, waiting worker runs pending tasks meanwhile. */
+static void *task_fib(void *arg) {
+    intptr_t n = (intptr_t)arg;
+    future_t *a, *b;
+    if (n < 2)
+        return (void *)n;
+
+    a = thrd_async(workers_current(), task_fib, (void *)(n - 1));
+    b = thrd_async(workers_current(), task_fib, (void *)(n - 2));
+    return (void *)((intptr_t)future_get(a) + (intptr_t)future_get(b));
+}
+
+static void *task_slow(void *arg) {
+    thrd_sleep(time_spec(0, 200000000), NULL);
+    return arg;
+}
+
+int test_futures(workers_t *pool) {
+    args_t *args = raii_args_for(raii_init(), "i", (size_t)12);
+    future_t *future = thrd_async(pool, task_square, args);
+    args_t local;
+    int caught = 0;
+
+    ASSERT_EQ(144, (int)(intptr_t)future_get(future));
+    args_free(args);
+
+    args = raii_args_for(raii_init(), "i", (size_t)-1);
+    future = thrd_async(pool, task_square, args);
+    try {
+        future_get(future);
+    } catch (task_error) {
+        caught = 1;
+    } end_trying;
+    ASSERT_EQ(1, caught);
+    args_free(args);
+
+    ASSERT_EQ(25, (int)(intptr_t)future_get(thrd_async(pool, task_square, args_local(&local, "i", (size_t)5))));
+    ASSERT_EQ(true, (local.args == local.inlined));
+    args_free(&local);
+    ASSERT_EQ(RAII_ARGS, local.type);
+
+    ASSERT_EQ(-29, (int)(intptr_t)future_get(thrd_async(pool, task_packed,
+        args_pack_as(packed_args, &local, -6, "six", 5.0, (void *)1))));
+    ASSERT_EQ(4, (int)local.n_args);
+    ASSERT_EQ('d', raii_value_type(&local.args[0]));
+    ASSERT_EQ('s', raii_value_type(&local.args[1]));
+    ASSERT_EQ('f', raii_value_type(&local.args[2]));
+    ASSERT_EQ('p', raii_value_type(&local.args[3]));
+    ASSERT_STR("six", args_get(packed_args, &local, 1));
+
+    ASSERT_EQ(16, (int)sizeof(raii_value_t));
+    args_local(&local, "SSi", "fourteen chars", "longer than fourteen", (size_t)3);
+    ASSERT_EQ('S', raii_value_type(&local.args[0]));
+    ASSERT_EQ('s', raii_value_type(&local.args[1]));
+    ASSERT_STR("fourteen chars", raii_value_string(&local.args[0]));
+    ASSERT_EQ(true, wide_is(&local, 0, "fourteen chars"));
+    ASSERT_STR("longer than fourteen", args_in(&local, 1).char_ptr);
+    ASSERT_NULL(raii_value_string(&local.args[2]));
+
+    /* narrow slots are zero extended, wider members read back defined */
+    memset(&local, 0xff, sizeof(local));
+    args_local(&local, "ci", 'z', (size_t)4);
+    ASSERT_UEQ((size_t)'z', args_in(&local, 0).max_size);
+    args = raii_args_for(raii_init(), "c", 'y');
+    ASSERT_UEQ((size_t)'y', args_in(args, 0).max_size);
+    local.args[0] = args_of_c('x');
+    ASSERT_UEQ((size_t)'x', raii_value_wide(&local.args[0]).max_size);
+    args_free(args);
+
+    args = raii_args_for(raii_init(), "iiiiiiiiii", (size_t)1, (size_t)2, (size_t)3, (size_t)4,
+                         (size_t)5, (size_t)6, (size_t)7, (size_t)8, (size_t)9, (size_t)10);
+    ASSERT_EQ(false, (args->args == args->inlined));
+    ASSERT_EQ(55, (int)(intptr_t)future_get(thrd_async(pool, task_sum, args)));
+    args_free(args);
+
+    ASSERT_EQ(610, (int)(intptr_t)future_get(thrd_async(pool, task_fib, (void *)15)));
+
+    future = thrd_async(pool, task_slow, (void *)7);
+    ASSERT_EQ(false, future_wait_for(future, 1));
+    ASSERT_EQ(true, future_wait_for(future, 5000));
+    ASSERT_EQ(true, future_is_ready(future));
+    ASSERT_EQ(7, (int)(intptr_t)future_get(future));
+    return 0;
+}
+
+static volatile int started = 0;
+static volatile int stopped = 0;
+static void task_stopped(void *arg) {
+    atomic_int_store(&stopped, 1);
+}
+
+/* Spins until cancelled, cleanup still runs while unwinding. */
+static void *task_spin(void *arg) {
+    workers_defer(task_stopped, NULL);
+    atomic_int_store(&started, 1);
+    for (;;) {
+        workers_checkpoint();
+        thrd_yield();
+    }
+
+    return NULL;
+}
+
+static void *task_never(void *arg) {
+    atomic_int_store(&started, 2);
+    return NULL;
+}
+
+static volatile int inner_cancelled = -1;
+static void task_inner(void *arg) {
+    atomic_int_store(&inner_cancelled, workers_cancelled());
+}
+
+/* Past deadline, runs a plain task while waiting, that task is not cancelled. */
+static void *task_expired(void *arg) {
+    while (!workers_cancelled())
+        thrd_yield();
+
+    workers_submit(workers_current(), task_inner, NULL);
+    while (atomic_int_load(&inner_cancelled) < 0)
+        workers_yield(workers_current());
+
+    return (void *)(intptr_t)workers_cancelled();
+}
+
+int test_cancel(workers_t *pool) {
+    future_t *spin, *never, *expired;
+    workers_t *single;
+    int caught = 0;
+
+    ASSERT_EQ(false, workers_cancelled());
+    spin = thrd_async(pool, task_spin, NULL);
+    while (!atomic_int_load(&started))
+        thrd_yield();
+
+    ASSERT_EQ(true, future_cancel(spin));
+    try {
+        future_get(spin);
+    } catch (task_cancelled) {
+        caught = 1;
+    } end_trying;
+    ASSERT_EQ(1, caught);
+    ASSERT_EQ(1, atomic_int_load(&stopped));
+
+    started = stopped = caught = 0;
+    spin = thrd_async_for(pool, task_spin, NULL, 20);
+    try {
+        future_get(spin);
+    } catch (task_cancelled) {
+        caught = 1;
+    } end_trying;
+    ASSERT_EQ(1, caught);
+    ASSERT_EQ(1, atomic_int_load(&stopped));
+
+    /* expired while queued, never started */
+    started = caught = 0;
+    never = thrd_async_for(pool, task_never, NULL, 0);
+    try {
+        future_get(never);
+    } catch (task_cancelled) {
+        caught = 1;
+    } end_trying;
+    ASSERT_EQ(1, caught);
+    ASSERT_EQ(0, atomic_int_load(&started));
+
+    /* single worker, plain task can only run nested in expired one */
+    single = workers_create(1);
+    expired = thrd_async_for(single, task_expired, NULL, 10);
+    future_wait_for(expired, 5000);
+    ASSERT_EQ(0, atomic_int_load(&inner_cancelled));
+    future_free(expired);
+    workers_destroy(single);
+
+    never = thrd_async(pool, task_never, NULL);
+    future_wait_for(never, 5000);
+    ASSERT_EQ(false, future_cancel(never));
+    future_free(never);
+    return 0;
+}
+
+static volatile size_t summed = 0;
+static void range_sum(size_t begin, size_t end, void *arg) {
+    size_t i, sum = 0;
+    for (i = begin; i < end; i++)
+        sum += ((size_t *)arg)[i];
+
+    atomic_size_add(&summed, sum);
+}
+
+static void range_fail(size_t begin, size_t end, void *arg) {
+    if (begin <= 500 && 500 < end)
+        throw(task_error);
+}
+
+/* Nested, from within an task, waiting worker runs sub ranges too. */
+static void task_for(void *arg) {
+    workers_for(workers_current(), 0, 1000, 10, range_sum, arg);
+}
+
+int test_batch(workers_t *pool) {
+    size_t i, values[1000];
+    void *args[TASK_COUNT];
+    int caught = 0;
+
+    ran = deferred = 0;
+    for (i = 0; i < TASK_COUNT; i++)
+        args[i] = (void *)(i + 1);
+
+    ASSERT_EQ(0, workers_submit_batch(pool, task_count, args, TASK_COUNT));
+    workers_wait(pool);
+    ASSERT_UEQ(TASK_COUNT, ran);
+    ASSERT_UEQ(TASK_COUNT, deferred);
+
+    for (i = 0; i < 1000; i++)
+        values[i] = i;
+
+    workers_for(pool, 0, 1000, 7, range_sum, values);
+    ASSERT_UEQ(499500, summed);
+
+    summed = 0;
+    workers_for(pool, 0, 1000, 0, range_sum, values);
+    ASSERT_UEQ(499500, summed);
+
+    summed = 0;
+    ASSERT_EQ(0, workers_submit(pool, task_for, values));
+    workers_wait(pool);
+    ASSERT_UEQ(499500, summed);
+
+    try {
+        workers_for(pool, 0, 1000, 10, range_fail, NULL);
+    } catch (task_error) {
+        caught = 1;
+    } end_trying;
+    ASSERT_EQ(1, caught);
+    return 0;
+}
+
+static volatile int placed = -1;
+static void task_placed(void *arg) {
+#if defined(__linux__)
+    atomic_int_store(&placed, sched_getcpu());
+#else
+    atomic_int_store(&placed, 0);
+#endif
+}
+
+int test_placement(void) {
+    workers_config_t config;
+    workers_t *pools[8];
+    int i, count, cpu = 0;
+
+    ASSERT_EQ(true, workers_numa_nodes() >= 1);
+    ASSERT_EQ(true, workers_numa_cpus(0, NULL, 0) >= 1);
+
+#if defined(__linux__)
+    cpu = sched_getcpu();
+#endif
+    memset(&config, 0, sizeof(config));
+    config.count = 2;
+    config.cpus = &cpu;
+    config.cpu_count = 1;
+    config.pin_each = true;
+    pools[0] = workers_create_by(&config);
+    ASSERT_EQ(2, workers_count(pools[0]));
+    for (i = 0; i < 8; i++) {
+        ASSERT_EQ(0, workers_submit(pools[0], task_placed, NULL));
+        workers_wait(pools[0]);
+        ASSERT_EQ(cpu, atomic_int_load(&placed));
+    }
+    workers_destroy(pools[0]);
+
+    count = workers_create_numa(pools, 8);
+    ASSERT_EQ(true, count >= 1);
+    for (i = 0; i < count; i++) {
+        atomic_int_store(&placed, -1);
+        ASSERT_EQ(0, workers_submit(pools[i], task_placed, NULL));
+        workers_wait(pools[i]);
+        ASSERT_EQ(true, atomic_int_load(&placed) >= 0);
+        workers_destroy(pools[i]);
+    }
+
+    return 0;
+}
+
+int test_stats(workers_t *pool) {
+    workers_worker_stats_t workers[WORKER_COUNT];
+    workers_stats_t stats;
+    size_t busy = 0;
+    int i;
+
+    /* members `group_wait` returned on may still be tallying */
+    workers_wait(pool);
+    ASSERT_EQ(WORKER_COUNT, workers_stats(pool, &stats, workers, WORKER_COUNT));
+    ASSERT_EQ(WORKER_COUNT, stats.count);
+    ASSERT_UEQ(0, stats.queued);
+    ASSERT_EQ(true, stats.peak > 0);
+    ASSERT_EQ(true, stats.completed >= TASK_COUNT);
+    ASSERT_UEQ(stats.completed, stats.submitted);
+    ASSERT_EQ(true, workers_percentile(stats.run_ns, 50) > 0);
+    ASSERT_EQ(true, workers_percentile(stats.run_ns, 50) <= workers_percentile(stats.run_ns, 99));
+    ASSERT_EQ(true, workers_percentile(stats.wait_ns, 99) > 0);
+    for (i = 0; i < WORKER_COUNT; i++)
+        busy += workers[i].busy_ns;
+    ASSERT_EQ(true, busy > 0);
+
+    ASSERT_EQ(pool_invalid, workers_submit(pool, NULL, NULL));
+    workers_stats(pool, &stats, NULL, 0);
+    ASSERT_UEQ(1, stats.rejected);
+    return 0;
+}
+
+static volatile int held = 1;
+static volatile size_t holding = 0;
+static void task_held(void *arg) {
+    atomic_size_add(&holding, 1);
+    while (atomic_int_load(&held))
+        thrd_yield();
+
+    atomic_size_add(&ran, 1);
+}
+
+/* Grows past `count` while all workers are held, retires back to it once idle. */
+int test_elastic(void) {
+    struct timespec pause = {0, 10000000};
+    workers_config_t config;
+    workers_t *elastic;
+    int i, waited = 0;
+
+    memset(&config, 0, sizeof(config));
+    config.count = 1;
+    config.max = 4;
+    config.idle_ms = 20;
+    elastic = workers_create_by(&config);
+    ASSERT_EQ(1, workers_count(elastic));
+
+    /* only worker busy first, so none is left idle */
+    ran = holding = 0;
+    ASSERT_EQ(0, workers_submit(elastic, task_held, NULL));
+    while (atomic_size_load(&holding) < 1)
+        thrd_yield();
+
+    for (i = 1; i < 16; i++)
+        ASSERT_EQ(0, workers_submit(elastic, task_held, NULL));
+
+    ASSERT_EQ(4, workers_count(elastic));
+    atomic_int_store(&held, 0);
+    workers_wait(elastic);
+    ASSERT_UEQ(16, ran);
+
+    while (workers_count(elastic) > 1 && waited++ < 500)
+        thrd_sleep(&pause, NULL);
+    ASSERT_EQ(1, workers_count(elastic));
+
+    /* retired slots restart */
+    atomic_int_store(&held, 1);
+    holding = 0;
+    ASSERT_EQ(0, workers_submit(elastic, task_held, NULL));
+    while (atomic_size_load(&holding) < 1)
+        thrd_yield();
+
+    for (i = 1; i < 8; i++)
+        ASSERT_EQ(0, workers_submit(elastic, task_held, NULL));
+
+    ASSERT_EQ(true, workers_count(elastic) > 1);
+    atomic_int_store(&held, 0);
+    workers_destroy(elastic);
+    ASSERT_UEQ(24, ran);
+    return 0;
+}
+
+static volatile size_t spun = 0;
+static volatile size_t halted = 0;
+static void member_halted(void *arg) {
+    atomic_size_add(&halted, 1);
+}
+
+/* Runs until a sibling fails, or it's group is cancelled. */
+static void member_spin(void *arg) {
+    workers_defer(member_halted, NULL);
+    atomic_size_add(&spun, 1);
+    for (;;) {
+        workers_checkpoint();
+        thrd_yield();
+    }
+}
+
+static void member_fail(void *arg) {
+    while (atomic_size_load(&spun) < (size_t)(intptr_t)arg)
+        thrd_yield();
+
+    throw(task_error);
+}
+
+/* Joined on exit, first failure of it's tasks rethrown here. */
+static int group_request(workers_t *pool)
+guard {
+    workers_group_t *group = _group(pool);
+    group_spawn(group, member_spin, NULL);
+    group_spawn(group, member_spin, NULL);
+    group_spawn(group, member_fail, (void *)2);
+} unguarded(0);
+
+/* Own failure wins, group cancelled instead. */
+static int group_abort(workers_t *pool)
+guard {
+    workers_group_t *group = _group(pool);
+    group_spawn(group, member_spin, NULL);
+    while (atomic_size_load(&spun) < 1)
+        thrd_yield();
+
+    throw(range_error);
+} unguarded(0);
+
+int test_group(workers_t *pool) {
+    workers_group_t *group;
+    int caught = 0;
+    intptr_t i;
+
+    try {
+        group_request(pool);
+    } catch (task_error) {
+        caught = 1;
+    } end_trying;
+    ASSERT_EQ(1, caught);
+    ASSERT_UEQ(2, spun);
+    ASSERT_UEQ(2, halted);
+
+    spun = halted = caught = 0;
+    try {
+        group_abort(pool);
+    } catch (range_error) {
+        caught = 1;
+    } end_trying;
+    ASSERT_EQ(1, caught);
+    ASSERT_UEQ(1, halted);
+
+    ran = deferred = 0;
+    guard {
+        group = _group(pool);
+        for (i = 1; i < 100; i++)
+            ASSERT_EQ(0, group_spawn(group, task_count, (void *)i));
+
+        group_wait(group);
+        ASSERT_UEQ(99, ran);
+    } guarded;
+    ASSERT_UEQ(99, deferred);
+    return 0;
+}
+
+int main(void) {
+    workers_t *pool = workers_create(WORKER_COUNT);
+    intptr_t i;
+
+    ASSERT_EQ(WORKER_COUNT, workers_count(pool));
+    ASSERT_NULL(workers_current());
+
+    puts("\nworkers_submit");
+    for (i = 1; i <= TASK_COUNT; i++)
+        ASSERT_EQ(0, workers_submit(pool, task_count, (void *)i));
+
+    workers_wait(pool);
+    ASSERT_UEQ(TASK_COUNT, ran);
+    ASSERT_UEQ(TASK_COUNT, deferred);
+
+    puts("\nworkers_submit, from tasks");
+    ran = 0;
+    ASSERT_EQ(0, workers_submit(pool, task_split, (void *)12));
+    workers_wait(pool);
+    ASSERT_UEQ((1 << 13) - 1, ran);
+
+    puts("\nthrd_scope, from tasks");
+    ran = deferred = 0;
+    ASSERT_NULL(workers_scope());
+    for (i = 1; i <= TASK_COUNT; i++)
+        ASSERT_EQ(0, workers_submit(pool, task_scoped, NULL));
+
+    workers_wait(pool);
+    ASSERT_UEQ(TASK_COUNT, ran);
+    ASSERT_UEQ(TASK_COUNT, deferred);
+
+    puts("\nthrd_async");
+    ASSERT_FUNC(test_futures(pool));
+
+    puts("\nfuture_cancel, thrd_async_for");
+    ASSERT_FUNC(test_cancel(pool));
+
+    puts("\nworkers_submit_batch, workers_for");
+    ASSERT_FUNC(test_batch(pool));
+
+    puts("\ngroup_create, group_spawn, group_wait");
+    ASSERT_FUNC(test_group(pool));
+
+    puts("\nworkers_create_by, workers_create_numa");
+    ASSERT_FUNC(test_placement());
+
+    puts("\nworkers_stats");
+    ASSERT_FUNC(test_stats(pool));
+
+    puts("\nworkers_create_by, elastic");
+    ASSERT_FUNC(test_elastic());
+    workers_destroy(pool);
+    return 0;
+}
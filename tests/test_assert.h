@@ -46,11 +46,11 @@
 
 #define ASSERT_STR(expected, actual) ASSERT_EQ_(expected, actual, strcmp(expected, actual) == 0, "%s")
 #define ASSERT_PTR(expected, actual) ASSERT_EQ_(expected, actual, memcmp(expected, actual, sizeof(actual)) == 0, "%p")
-#define ASSERT_UEQ(expected, actual) ASSERT_EQ_(expected, actual, expected == actual, "%zu")
-#define ASSERT_EQ(expected, actual) ASSERT_EQ_(expected, actual, expected == actual, "%d")
-#define ASSERT_XEQ(expected, actual) ASSERT_EQ_((int)(expected), (int)(actual), expected == actual, "%d")
-#define ASSERT_NULL(actual) ASSERT_EQ_(NULL, actual, NULL == actual, "%p")
-#define ASSERT_NOTNULL(actual) ASSERT_NEQ_(NULL, actual, NULL != actual, "%p")
+#define ASSERT_UEQ(expected, actual) ASSERT_EQ_(expected, actual, (expected) == (actual), "%zu")
+#define ASSERT_EQ(expected, actual) ASSERT_EQ_(expected, actual, (expected) == (actual), "%d")
+#define ASSERT_XEQ(expected, actual) ASSERT_EQ_((int)(expected), (int)(actual), (expected) == (actual), "%d")
+#define ASSERT_NULL(actual) ASSERT_EQ_(NULL, actual, NULL == (actual), "%p")
+#define ASSERT_NOTNULL(actual) ASSERT_NEQ_(NULL, actual, NULL != (actual), "%p")
 
 #define ASSERT_FUNC(FNC_CALL) do { \
     if (FNC_CALL) { \